@@ -0,0 +1,274 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// MinimizerFilter - Select the FM-index overlap searches of a read
+// from the minimizers it shares with the target reads
+//
+#include <omp.h>
+#include <algorithm>
+#include "MinimizerFilter.h"
+#include "SeqReader.h"
+
+// The most frequent minimizers, as a fraction of the distinct ones, are ignored
+static const double MAX_OCC_FRACTION = 0.0002;
+
+// Reads hashed by each batch of the index build
+static const size_t BUILD_BATCH_SIZE = 4096;
+
+// An invertible hash of the 2k-bit k-mer code key, so that
+// the minimizers do not favour poly-A runs
+static inline uint64_t hashKmer(uint64_t key, uint64_t mask)
+{
+    key = (~key + (key << 21)) & mask;
+    key = key ^ key >> 24;
+    key = ((key + (key << 3)) + (key << 8)) & mask;
+    key = key ^ key >> 14;
+    key = ((key + (key << 2)) + (key << 4)) & mask;
+    key = key ^ key >> 28;
+    key = (key + (key << 31)) & mask;
+    return key;
+}
+
+// True if the ranges [a0, a1] and [b0, b1] share a position
+static inline bool isIntersecting(int64_t a0, int64_t a1, int64_t b0, int64_t b1)
+{
+    return b0 <= b1 && a0 <= b1 && b0 <= a1;
+}
+
+//
+void MinimizerFilterStats::add(const MinimizerFilterStats& other)
+{
+    numReads += other.numReads;
+    numSkippedReads += other.numSkippedReads;
+    numSearches += other.numSearches;
+    numEdges += other.numEdges;
+    numKeptEdges += other.numKeptEdges;
+    numSubstrings += other.numSubstrings;
+    numMissedSubstrings += other.numMissedSubstrings;
+}
+
+//
+MinimizerFilter::MinimizerFilter(const std::string& targetFile, int k, int w, int minHits,
+                                 int minOverlap, double errorRate, bool isSelf) : m_k(k),
+                                                                                  m_w(w),
+                                                                                  m_minHits(minHits),
+                                                                                  m_minOverlap(minOverlap),
+                                                                                  m_errorRate(std::max(errorRate, 0.0)),
+                                                                                  m_isSelf(isSelf),
+                                                                                  m_maxOcc(0),
+                                                                                  m_bucketShift(0)
+{
+    assert(m_k > 0 && m_k <= 31 && m_w > 0);
+
+    // Hash the targets in batches with all threads
+    SeqReader reader(targetFile, SRF_NO_VALIDATION);
+    SeqRecord record;
+    bool bDone = false;
+    while(!bDone)
+    {
+        std::vector<std::string> batch;
+        while(batch.size() < BUILD_BATCH_SIZE)
+        {
+            if(!reader.get(record))
+            {
+                bDone = true;
+                break;
+            }
+            batch.push_back(record.seq.toString());
+        }
+
+        std::vector<MinimizerVector> batchMinimizers(batch.size());
+        uint32_t firstIdx = m_targetLengths.size();
+        #pragma omp parallel for schedule(dynamic, 16)
+        for(size_t i = 0; i < batch.size(); ++i)
+            computeMinimizers(batch[i], firstIdx + i, batchMinimizers[i]);
+
+        for(size_t i = 0; i < batch.size(); ++i)
+        {
+            m_targetLengths.push_back(batch[i].length());
+            m_index.insert(m_index.end(), batchMinimizers[i].begin(), batchMinimizers[i].end());
+        }
+    }
+    std::sort(m_index.begin(), m_index.end());
+
+    // The occurrence cutoff is the count of the most frequent minimizer kept
+    std::vector<size_t> occs;
+    for(size_t i = 0; i < m_index.size(); )
+    {
+        size_t j = i + 1;
+        while(j < m_index.size() && m_index[j].hash == m_index[i].hash)
+            ++j;
+        occs.push_back(j - i);
+        i = j;
+    }
+
+    if(!occs.empty())
+    {
+        size_t n = occs.size() - 1 - (size_t)(MAX_OCC_FRACTION * occs.size());
+        std::nth_element(occs.begin(), occs.begin() + n, occs.end());
+        m_maxOcc = occs[n];
+    }
+
+    // About one distinct hash per bucket, the hashes have 2k bits
+    int bucketBits = 1;
+    while(bucketBits < 2 * m_k && (1ULL << bucketBits) < occs.size())
+        bucketBits++;
+    m_bucketShift = 2 * m_k - bucketBits;
+
+    m_bucketStarts.resize((1ULL << bucketBits) + 1);
+    size_t entryIdx = 0;
+    for(size_t bucket = 0; bucket < m_bucketStarts.size(); ++bucket)
+    {
+        while(entryIdx < m_index.size() && (m_index[entryIdx].hash >> m_bucketShift) < bucket)
+            ++entryIdx;
+        m_bucketStarts[bucket] = entryIdx;
+    }
+}
+
+//
+int MinimizerFilter::getSearches(const std::string& seq, int64_t readIdx) const
+{
+    MinimizerVector query;
+    computeMinimizers(seq, 0, query);
+
+    // Add the targets sharing each minimizer to the candidates, skipping the repeats.
+    // The searches only grow with the hits of a candidate, so the lookup stops once
+    // all of them are selected.
+    CandidateMap candidates;
+    int searches = 0;
+    for(size_t i = 0; i < query.size() && searches != OS_ALL; ++i)
+    {
+        uint64_t hash = query[i].hash;
+        size_t first = getBucketStart(hash);
+        while(first < m_index.size() && m_index[first].hash < hash)
+            ++first;
+        size_t last = first;
+        while(last < m_index.size() && m_index[last].hash == hash)
+            ++last;
+        if(last - first > m_maxOcc)
+            continue;
+
+        int64_t queryPos = query[i].posStrand >> 1;
+        for(; first != last; ++first)
+        {
+            const Minimizer& target = m_index[first];
+            if(m_isSelf && target.readIdx == readIdx)
+                continue;
+
+            bool isRC = (target.posStrand & 1) != (query[i].posStrand & 1);
+            int64_t targetLen = m_targetLengths[target.readIdx];
+            int64_t targetPos = target.posStrand >> 1;
+            if(isRC)
+                targetPos = targetLen - targetPos - m_k;
+            int64_t diagonal = queryPos - targetPos;
+
+            Candidate& candidate = candidates[((uint64_t)target.readIdx << 1) | (isRC ? 1 : 0)];
+            if(candidate.numHits++ == 0)
+                candidate.minDiag = candidate.maxDiag = diagonal;
+            candidate.minDiag = std::min(candidate.minDiag, diagonal);
+            candidate.maxDiag = std::max(candidate.maxDiag, diagonal);
+
+            if(candidate.numHits >= m_minHits)
+                searches |= getTargetSearches(seq.length(), targetLen, isRC, candidate.minDiag, candidate.maxDiag);
+        }
+    }
+    return searches;
+}
+
+//
+void MinimizerFilter::computeMinimizers(const std::string& seq, uint32_t readIdx, MinimizerVector& out) const
+{
+    if(seq.length() < (size_t)m_k)
+        return;
+
+    // Hash the canonical form of every k-mer, the k-mers with an ambiguous
+    // base or equal to their reverse complement are not minimizers
+    const uint64_t mask = (1ULL << (2 * m_k)) - 1;
+    const int shift = 2 * (m_k - 1);
+    size_t numKmers = seq.length() - m_k + 1;
+    std::vector<uint64_t> hashes(numKmers, UINT64_MAX);
+    std::vector<bool> isRCCanonical(numKmers, false);
+
+    uint64_t fwd = 0;
+    uint64_t rc = 0;
+    int validLen = 0;
+    for(size_t i = 0; i < seq.length(); ++i)
+    {
+        int code;
+        switch(seq[i])
+        {
+            case 'A': code = 0; break;
+            case 'C': code = 1; break;
+            case 'G': code = 2; break;
+            case 'T': code = 3; break;
+            default: code = -1; break;
+        }
+
+        if(code < 0)
+        {
+            validLen = 0;
+            continue;
+        }
+
+        fwd = ((fwd << 2) | code) & mask;
+        rc = (rc >> 2) | ((uint64_t)(3 - code) << shift);
+        if(++validLen < m_k || fwd == rc)
+            continue;
+
+        size_t kmerIdx = i + 1 - m_k;
+        hashes[kmerIdx] = hashKmer(std::min(fwd, rc), mask);
+        isRCCanonical[kmerIdx] = rc < fwd;
+    }
+
+    // Keep the smallest hash of every window of w k-mers, once
+    size_t windowLen = std::min((size_t)m_w, numKmers);
+    size_t lastIdx = numKmers;
+    for(size_t start = 0; start + windowLen <= numKmers; ++start)
+    {
+        size_t bestIdx = start;
+        for(size_t idx = start + 1; idx < start + windowLen; ++idx)
+        {
+            if(hashes[idx] < hashes[bestIdx])
+                bestIdx = idx;
+        }
+
+        if(hashes[bestIdx] == UINT64_MAX || bestIdx == lastIdx)
+            continue;
+
+        Minimizer m;
+        m.hash = hashes[bestIdx];
+        m.readIdx = readIdx;
+        m.posStrand = (bestIdx << 1) | (isRCCanonical[bestIdx] ? 1 : 0);
+        out.push_back(m);
+        lastIdx = bestIdx;
+    }
+}
+
+//
+int MinimizerFilter::getTargetSearches(int64_t queryLen, int64_t targetLen, bool isRC, int64_t minDiag, int64_t maxDiag) const
+{
+    // Indels shift the diagonal along the overlap
+    int64_t slack = m_k + (int64_t)(m_errorRate * std::min(queryLen, targetLen));
+    int64_t lo = minDiag - slack;
+    int64_t hi = maxDiag + slack;
+
+    int suffixSearch = isRC ? OS_SUFFIX_RC : OS_SUFFIX_FWD;
+    int prefixSearch = isRC ? OS_PREFIX_RC : OS_PREFIX_FWD;
+    int searches = 0;
+
+    // The target starts within the query and runs past its end
+    if(isIntersecting(lo, hi, std::max<int64_t>(0, queryLen - targetLen), queryLen - m_minOverlap))
+        searches |= suffixSearch;
+
+    // The target ends within the query and starts before it
+    if(isIntersecting(lo, hi, m_minOverlap - targetLen, std::min<int64_t>(0, queryLen - targetLen)))
+        searches |= prefixSearch;
+
+    // The query is contained in the target
+    if(targetLen >= queryLen && isIntersecting(lo, hi, queryLen - targetLen, 0))
+        searches |= suffixSearch | prefixSearch;
+
+    return searches;
+}
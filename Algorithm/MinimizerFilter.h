@@ -0,0 +1,128 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// MinimizerFilter - Select the FM-index overlap searches of a read
+// from the minimizers it shares with the target reads. The (w,k)
+// minimizers of all targets are indexed in memory; a target sharing
+// at least minHits minimizers with the read is a candidate, and the
+// diagonals of the shared minimizers give its strand and the end of
+// the read it can overlap by minOverlap bases. Only the searches some
+// candidate needs are run, a read without candidates is not searched.
+// The searches that do run still compute the exact overlaps. A read is
+// only found to be a substring by the searches that run, so the filter
+// gates the substring detection as well.
+//
+#ifndef MINIMIZERFILTER_H
+#define MINIMIZERFILTER_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "HashMap.h"
+#include "OverlapAlgorithm.h"
+
+// Counts of an overlap computation gated by a MinimizerFilter
+struct MinimizerFilterStats
+{
+    MinimizerFilterStats() : numReads(0), numSkippedReads(0), numSearches(0), numEdges(0), numKeptEdges(0),
+                             numSubstrings(0), numMissedSubstrings(0) {}
+
+    void add(const MinimizerFilterStats& other);
+
+    size_t numReads;
+    // Reads without any candidate
+    size_t numSkippedReads;
+    // Searches selected, out of four per read
+    size_t numSearches;
+    // Edges written and the edges found by a selected search
+    size_t numEdges;
+    size_t numKeptEdges;
+    // Substring reads of the unfiltered search and those the selected searches
+    // do not detect, only counted when all the searches are run
+    size_t numSubstrings;
+    size_t numMissedSubstrings;
+};
+
+class MinimizerFilter
+{
+    public:
+
+        // Index the reads of targetFile. If isSelf is set the targets are the
+        // queries as well and a read is never its own candidate.
+        MinimizerFilter(const std::string& targetFile, int k, int w, int minHits,
+                        int minOverlap, double errorRate, bool isSelf);
+
+        // The OverlapSearch flags to run for the query readIdx with sequence seq
+        int getSearches(const std::string& seq, int64_t readIdx) const;
+
+        size_t getNumTargets() const { return m_targetLengths.size(); }
+        size_t getNumMinimizers() const { return m_index.size(); }
+
+        // Minimizers occurring more often than this in the targets are ignored
+        size_t getMaxOcc() const { return m_maxOcc; }
+
+    private:
+
+        // A minimizer of a read. posStrand is the position of the k-mer shifted
+        // left by one, bit 0 is set if its reverse complement is the canonical k-mer.
+        struct Minimizer
+        {
+            uint64_t hash;
+            uint32_t readIdx;
+            uint32_t posStrand;
+
+            bool operator<(const Minimizer& other) const
+            {
+                if(hash != other.hash)
+                    return hash < other.hash;
+                if(readIdx != other.readIdx)
+                    return readIdx < other.readIdx;
+                return posStrand < other.posStrand;
+            }
+        };
+        typedef std::vector<Minimizer> MinimizerVector;
+
+        // The minimizers a target strand shares with the query so far. The
+        // diagonal of a minimizer is the start of the target, oriented like
+        // the query, in query coordinates.
+        struct Candidate
+        {
+            Candidate() : numHits(0), minDiag(0), maxDiag(0) {}
+
+            int numHits;
+            int64_t minDiag;
+            int64_t maxDiag;
+        };
+
+        // Candidates keyed by the index of the target shifted left by one, bit 0 set for its reverse strand
+        typedef HashMap<uint64_t, Candidate> CandidateMap;
+
+        // Append the minimizers of seq to out
+        void computeMinimizers(const std::string& seq, uint32_t readIdx, MinimizerVector& out) const;
+
+        // The first entry of m_index in the bucket of hash
+        size_t getBucketStart(uint64_t hash) const { return m_bucketStarts[hash >> m_bucketShift]; }
+
+        // The searches that find an overlap of the query with a target
+        // placed anywhere between the diagonals minDiag and maxDiag
+        int getTargetSearches(int64_t queryLen, int64_t targetLen, bool isRC, int64_t minDiag, int64_t maxDiag) const;
+
+        int m_k;
+        int m_w;
+        int m_minHits;
+        int m_minOverlap;
+        double m_errorRate;
+        bool m_isSelf;
+        size_t m_maxOcc;
+
+        // The minimizers of all targets sorted by hash, with the start of
+        // every bucket of hashes sharing their top bits
+        MinimizerVector m_index;
+        std::vector<size_t> m_bucketStarts;
+        int m_bucketShift;
+        std::vector<uint32_t> m_targetLengths;
+};
+
+#endif
@@ -19,19 +19,19 @@ static const AlignFlags preSufAF(true, true, false);
 //#define DEBUGOVERLAP 1
 
 // Perform the overlap
-OverlapResult OverlapAlgorithm::overlapRead(const SeqRecord& read, int minOverlap, OverlapBlockList* pOutList) const
+OverlapResult OverlapAlgorithm::overlapRead(const SeqRecord& read, int minOverlap, OverlapBlockList* pOutList, int searches) const
 {
 
 	OverlapResult r;
-	if(static_cast<int>(read.seq.length()) < minOverlap)
+	if(static_cast<int>(read.seq.length()) < minOverlap || searches == 0)
 	return r;
 
 	if(!m_exactModeOverlap)
 	{
 		if(m_algorithm=="LSSF")
-			r = overlapReadInexactFMWalk(read, minOverlap, pOutList);
+			r = overlapReadInexactFMWalk(read, minOverlap, pOutList, searches);
 		else if(m_algorithm=="ADPF")
-			r = overlapReadInexact(read, minOverlap, pOutList);
+			r = overlapReadInexact(read, minOverlap, pOutList, searches);
 		else
 		{
 			std::cout << "Unknown algorithm!!\n";
@@ -39,12 +39,21 @@ OverlapResult OverlapAlgorithm::overlapRead(const SeqRecord& read, int minOverla
 		}
 	}
 	else
-		r = overlapReadExact(read, minOverlap, pOutList);
+		r = overlapReadExact(read, minOverlap, pOutList, searches);
 	return r;
 }
 
 //
-OverlapResult OverlapAlgorithm::overlapReadInexact(const SeqRecord& read, int minOverlap, OverlapBlockList* pOBOut) const
+int OverlapAlgorithm::getOverlapSearch(const AlignFlags& af)
+{
+	if(!af.isQueryRev())
+		return af.isTargetRev() ? OS_SUFFIX_RC : OS_SUFFIX_FWD;
+	else
+		return af.isTargetRev() ? OS_PREFIX_FWD : OS_PREFIX_RC;
+}
+
+//
+OverlapResult OverlapAlgorithm::overlapReadInexact(const SeqRecord& read, int minOverlap, OverlapBlockList* pOBOut, int searches) const
 {
 	OverlapResult result;
 	// The complete set of overlap blocks are collected in obWorkingList
@@ -66,23 +75,27 @@ OverlapResult OverlapAlgorithm::overlapReadInexact(const SeqRecord& read, int mi
 	// std::cout << read.id << "\n"; 
 	
 	// Match the suffix of seq to prefixes
-	findOverlapBlocksInexact(seq, m_pBWT, m_pRevBWT, sufPreAF, minOverlap, &oblSuffixFwd, &oblFwdContain, result);
+	if(searches & OS_SUFFIX_FWD)
+		findOverlapBlocksInexact(seq, m_pBWT, m_pRevBWT, sufPreAF, minOverlap, &oblSuffixFwd, &oblFwdContain, result);
 	if(result.isSubstring) return result;
 	
 	// getchar();
 	// std::cout << complement(seq) << "\n";
-	findOverlapBlocksInexact(complement(seq), m_pRevBWT, m_pBWT, prePreAF, minOverlap, &oblSuffixRev, &oblRevContain, result);
+	if(searches & OS_SUFFIX_RC)
+		findOverlapBlocksInexact(complement(seq), m_pRevBWT, m_pBWT, prePreAF, minOverlap, &oblSuffixRev, &oblRevContain, result);
 	if(result.isSubstring) return result;
 	
 	// Match the prefix of seq to suffixes
 	// getchar();
 	// std::cout << reverseComplement(seq) << "\n";
-	findOverlapBlocksInexact(reverseComplement(seq), m_pBWT, m_pRevBWT, sufSufAF, minOverlap, &oblPrefixFwd, &oblFwdContain, result);
+	if(searches & OS_PREFIX_RC)
+		findOverlapBlocksInexact(reverseComplement(seq), m_pBWT, m_pRevBWT, sufSufAF, minOverlap, &oblPrefixFwd, &oblFwdContain, result);
 	if(result.isSubstring) return result;
 	
 	// getchar();
 	// std::cout << reverse(seq) << "\n";
-	findOverlapBlocksInexact(reverse(seq), m_pRevBWT, m_pBWT, preSufAF, minOverlap, &oblPrefixRev, &oblRevContain, result);
+	if(searches & OS_PREFIX_FWD)
+		findOverlapBlocksInexact(reverse(seq), m_pRevBWT, m_pBWT, preSufAF, minOverlap, &oblPrefixRev, &oblRevContain, result);
 	if(result.isSubstring) return result;
 	
 	// Remove submaximal blocks for each block list including fully contained blocks
@@ -146,7 +159,7 @@ OverlapResult OverlapAlgorithm::overlapReadInexact(const SeqRecord& read, int mi
 	return result;
 }
 
-OverlapResult OverlapAlgorithm::overlapReadInexactFMWalk(const SeqRecord& read, int minOverlap, OverlapBlockList* pOBOut) const
+OverlapResult OverlapAlgorithm::overlapReadInexactFMWalk(const SeqRecord& read, int minOverlap, OverlapBlockList* pOBOut, int searches) const
 {
 	OverlapResult result;
 	// The complete set of overlap blocks are collected in obWorkingList
@@ -172,12 +185,14 @@ OverlapResult OverlapAlgorithm::overlapReadInexactFMWalk(const SeqRecord& read,
 		return result;
 	
 	// Match the suffix of seq to prefixes
-	findOverlapBlocksInexactFMIndexWalk(seq, m_pBWT, m_pRevBWT, sufPreAF, minOverlap, &oblSuffixFwd, &oblFwdContain, result, m_errorRate);
+	if(searches & OS_SUFFIX_FWD)
+		findOverlapBlocksInexactFMIndexWalk(seq, m_pBWT, m_pRevBWT, sufPreAF, minOverlap, &oblSuffixFwd, &oblFwdContain, result, m_errorRate);
 	if(result.isSubstring) return result;
 	
 	// getchar();
 	// std::cout << "complement(seq)" << "\n";
-	findOverlapBlocksInexactFMIndexWalk(complement(seq), m_pRevBWT, m_pBWT, prePreAF, minOverlap, &oblSuffixRev, &oblRevContain, result, m_errorRate);
+	if(searches & OS_SUFFIX_RC)
+		findOverlapBlocksInexactFMIndexWalk(complement(seq), m_pRevBWT, m_pBWT, prePreAF, minOverlap, &oblSuffixRev, &oblRevContain, result, m_errorRate);
 	if(result.isSubstring) return result;
 
 /*
@@ -192,12 +207,14 @@ OverlapResult OverlapAlgorithm::overlapReadInexactFMWalk(const SeqRecord& read,
 	// Match the prefix of seq to suffixes
 	// getchar();
 	// std::cout << "reverseComplement(seq)" << "\n";
-	findOverlapBlocksInexactFMIndexWalk(reverseComplement(seq), m_pBWT, m_pRevBWT, sufSufAF, minOverlap, &oblPrefixFwd, &oblFwdContain, result, m_errorRate);
+	if(searches & OS_PREFIX_RC)
+		findOverlapBlocksInexactFMIndexWalk(reverseComplement(seq), m_pBWT, m_pRevBWT, sufSufAF, minOverlap, &oblPrefixFwd, &oblFwdContain, result, m_errorRate);
 	if(result.isSubstring) return result;
 	
 	// getchar();
 	// std::cout << reverse(seq) << "\n";
-	findOverlapBlocksInexactFMIndexWalk(reverse(seq), m_pRevBWT, m_pBWT, preSufAF, minOverlap, &oblPrefixRev, &oblRevContain, result, m_errorRate);
+	if(searches & OS_PREFIX_FWD)
+		findOverlapBlocksInexactFMIndexWalk(reverse(seq), m_pRevBWT, m_pBWT, preSufAF, minOverlap, &oblPrefixRev, &oblRevContain, result, m_errorRate);
 	if(result.isSubstring) return result;
 /*
 	if(oblPrefixFwd.empty() && oblPrefixRev.empty())
@@ -267,7 +284,7 @@ OverlapResult OverlapAlgorithm::alignReadDuplicate(const SeqRecord& read, Overla
 
 // Construct the set of blocks describing irreducible overlaps with READ
 // and write the blocks to pOBOut
-OverlapResult OverlapAlgorithm::overlapReadExact(const SeqRecord& read, int minOverlap, OverlapBlockList* pOBOut) const
+OverlapResult OverlapAlgorithm::overlapReadExact(const SeqRecord& read, int minOverlap, OverlapBlockList* pOBOut, int searches) const
 {	
 	OverlapResult result;
 	// The complete set of overlap blocks are collected in obWorkingList
@@ -287,12 +304,16 @@ OverlapResult OverlapAlgorithm::overlapReadExact(const SeqRecord& read, int minO
 	OverlapBlockList oblPrefixRev;
 
 	// Match the suffix of seq to prefixes
-	findOverlapBlocksExact(seq, m_pBWT, m_pRevBWT, sufPreAF, minOverlap, &oblSuffixFwd, &oblFwdContain, result);
-	findOverlapBlocksExact(complement(seq), m_pRevBWT, m_pBWT, prePreAF, minOverlap, &oblSuffixRev, &oblRevContain, result);
+	if(searches & OS_SUFFIX_FWD)
+		findOverlapBlocksExact(seq, m_pBWT, m_pRevBWT, sufPreAF, minOverlap, &oblSuffixFwd, &oblFwdContain, result);
+	if(searches & OS_SUFFIX_RC)
+		findOverlapBlocksExact(complement(seq), m_pRevBWT, m_pBWT, prePreAF, minOverlap, &oblSuffixRev, &oblRevContain, result);
 
 	// Match the prefix of seq to suffixes
-	findOverlapBlocksExact(reverseComplement(seq), m_pBWT, m_pRevBWT, sufSufAF, minOverlap, &oblPrefixFwd, &oblFwdContain, result);
-	findOverlapBlocksExact(reverse(seq), m_pRevBWT, m_pBWT, preSufAF, minOverlap, &oblPrefixRev, &oblRevContain, result);
+	if(searches & OS_PREFIX_RC)
+		findOverlapBlocksExact(reverseComplement(seq), m_pBWT, m_pRevBWT, sufSufAF, minOverlap, &oblPrefixFwd, &oblFwdContain, result);
+	if(searches & OS_PREFIX_FWD)
+		findOverlapBlocksExact(reverse(seq), m_pRevBWT, m_pBWT, preSufAF, minOverlap, &oblPrefixRev, &oblRevContain, result);
 
 	//Trim the OB list
 	TrimOBLInterval(&oblSuffixFwd, seq.length());
@@ -1085,14 +1106,20 @@ OverlapBlockList* pOBFinal) const
 			OverlapBlockList& currList = *groupIter;
 			bool bEraseGroup = false;
 
+			// Rank all the blocks of the group in one batch
+			BlockOccVector occs;
+			getBlockOccs(pBWT, pRevBWT, currList, occs);
+
 			// Count the extensions in the top level (longest overlap) blocks first
 			int topLen = currList.front().overlapLen;
 			AlphaCount64 ext_count;
 			OBLIter blockIter = currList.begin();
+			size_t blockIdx = 0;
 			while(blockIter != currList.end() && blockIter->overlapLen == topLen)
 			{
-				ext_count += blockIter->getCanonicalExtCount(pBWT, pRevBWT);
+				ext_count += occs[blockIdx].getCanonicalExtCount(*blockIter);
 				++blockIter;
+				++blockIdx;
 			}
 			
 			// Three cases:
@@ -1110,9 +1137,10 @@ OverlapBlockList* pOBFinal) const
 				// contains the other at this point, we output hits to both. Under a fixed 
 				// length string assumption one will be contained within the other and removed later.
 				OBLIter tlbIter = currList.begin();
+				size_t tlbIdx = 0;
 				while(tlbIter != currList.end() && tlbIter->overlapLen == topLen)
 				{
-					AlphaCount64 test_count = tlbIter->getCanonicalExtCount(pBWT, pRevBWT);
+					AlphaCount64 test_count = occs[tlbIdx].getCanonicalExtCount(*tlbIter);
 					// One of the topLen block does not terminate with $, 
 					// implying the other topLen blocks with $ are substring
 					if(test_count.get('$') == 0)
@@ -1132,13 +1160,15 @@ OverlapBlockList* pOBFinal) const
 					
 					// Perform the final right-update to make the block terminal
 					OverlapBlock branched = *tlbIter;
-					BWTAlgorithms::updateBothR(branched.ranges, '$', branched.getExtensionBWT(pBWT, pRevBWT));
+					BWTAlgorithms::updateBothR(branched.ranges, '$', branched.getExtensionBWT(pBWT, pRevBWT),
+					                           occs[tlbIdx].lower, occs[tlbIdx].upper);
 					pOBFinal->push_back(branched);
 #ifdef DEBUGOVERLAP
 					std::cout << "[IE] TLB of length " << branched.overlapLen << " has ended\n";
 					std::cout << "[IE]\tBlock data: " << branched << "\n";
 #endif             
 					++tlbIter;
+					++tlbIdx;
 				} 
 
 				// Set the flag to erase this group, it is finished
@@ -1150,8 +1180,9 @@ SARightExtension:
 				// Count the extension for the rest of the blocks
 				while(blockIter != currList.end())
 				{
-					ext_count += blockIter->getCanonicalExtCount(pBWT, pRevBWT);
+					ext_count += occs[blockIdx].getCanonicalExtCount(*blockIter);
 					++blockIter;
+					++blockIdx;
 				}
 
 				if(ext_count.hasUniqueDNAChar())
@@ -1159,7 +1190,7 @@ SARightExtension:
 					// Update all the blocks using the unique extension character
 					// This character is in the canonical representation wrt to the query
 					char b = ext_count.getUniqueDNAChar();
-					updateOverlapBlockRangesRight(pBWT, pRevBWT, currList, b);
+					updateOverlapBlockRangesRight(pBWT, pRevBWT, currList, b, occs);
 					numExtensions++;
 					bEraseGroup = false;
 				}
@@ -1173,7 +1204,7 @@ SARightExtension:
 						{
 							numBranches++;
 							OverlapBlockList branched = currList;
-							updateOverlapBlockRangesRight(pBWT, pRevBWT, branched, b);
+							updateOverlapBlockRangesRight(pBWT, pRevBWT, branched, b, occs);
 							incomingGroups.push_back(branched);
 							bEraseGroup = true;
 						}
@@ -1293,15 +1324,20 @@ OverlapBlockList& activeList,
 OverlapBlockList& terminalList,
 OverlapBlockList& /*containedList*/) const
 {
+	// Rank all the active blocks in one batch
+	BlockOccVector occs;
+	getBlockOccs(pBWT, pRevBWT, activeList, occs);
+
 	OverlapBlockList::iterator iter = activeList.begin();
 	OverlapBlockList::iterator next;
-	while(iter != activeList.end())
+	for(size_t blockIdx = 0; iter != activeList.end(); ++blockIdx)
 	{
 		next = iter;
 		++next;
+		BlockOcc& occ = occs[blockIdx];
 
 		// Check if block is terminal
-		AlphaCount64 ext_count = iter->getCanonicalExtCount(pBWT, pRevBWT);
+		AlphaCount64 ext_count = occ.getCanonicalExtCount(*iter);
 		if(ext_count.get('$') > 0)
 		{
 			// Only consider this block to be terminal irreducible if it has at least one extension
@@ -1309,7 +1345,7 @@ OverlapBlockList& /*containedList*/) const
 			if(iter->forwardHistory.size() > 0)
 			{
 				OverlapBlock branched = *iter;
-				BWTAlgorithms::updateBothR(branched.ranges, '$', branched.getExtensionBWT(pBWT, pRevBWT));
+				BWTAlgorithms::updateBothR(branched.ranges, '$', branched.getExtensionBWT(pBWT, pRevBWT), occ.lower, occ.upper);
 				terminalList.push_back(branched);
 #ifdef DEBUGOVERLAP_2            
 				std::cout << "Block of length " << iter->overlapLen << " moved to terminal\n";
@@ -1333,7 +1369,7 @@ OverlapBlockList& /*containedList*/) const
 			char block_base = iter->flags.isQueryComp() ? complement(canonical_base) : canonical_base;
 
 			// Update the block using the base in its frame of reference
-			BWTAlgorithms::updateBothR(iter->ranges, block_base, iter->getExtensionBWT(pBWT, pRevBWT));
+			BWTAlgorithms::updateBothR(iter->ranges, block_base, iter->getExtensionBWT(pBWT, pRevBWT), occ.lower, occ.upper);
 
 			// Add the base to the history in the frame of reference of the query read
 			// This is so the history is consistent when comparing between blocks from different strands
@@ -1352,7 +1388,7 @@ OverlapBlockList& /*containedList*/) const
 				// if the input sequences are very long. This could be avoided by using the SearchHistoyNode/Link
 				// structure but branches are infrequent enough to not have a large impact
 				OverlapBlock branched = *iter;
-				BWTAlgorithms::updateBothR(branched.ranges, block_base, branched.getExtensionBWT(pBWT, pRevBWT));
+				BWTAlgorithms::updateBothR(branched.ranges, block_base, branched.getExtensionBWT(pBWT, pRevBWT), occ.lower, occ.upper);
 				assert(branched.ranges.isValid());
 
 				// Add the base in the canonical frame
@@ -1370,6 +1406,31 @@ OverlapBlockList& /*containedList*/) const
 	}
 } 
 
+//
+AlphaCount64 OverlapAlgorithm::BlockOcc::getCanonicalExtCount(const OverlapBlock& block) const
+{
+	AlphaCount64 out = upper - lower;
+	if(block.flags.isQueryComp())
+		out.complement();
+	return out;
+}
+
+//
+void OverlapAlgorithm::getBlockOccs(const BWT* pBWT, const BWT* pRevBWT, const OverlapBlockList& obList, BlockOccVector& occs) const
+{
+	for(OverlapBlockList::const_iterator iter = obList.begin(); iter != obList.end(); ++iter)
+		BWTAlgorithms::prefetchInterval(iter->ranges.interval[1], iter->getExtensionBWT(pBWT, pRevBWT));
+
+	occs.resize(obList.size());
+	size_t blockIdx = 0;
+	for(OverlapBlockList::const_iterator iter = obList.begin(); iter != obList.end(); ++iter, ++blockIdx)
+	{
+		const BWT* pExtBWT = iter->getExtensionBWT(pBWT, pRevBWT);
+		occs[blockIdx].lower = pExtBWT->getFullOcc(iter->ranges.interval[1].lower - 1);
+		occs[blockIdx].upper = pExtBWT->getFullOcc(iter->ranges.interval[1].upper);
+	}
+}
+
 // Return true if the terminalBlock is a substring of any member of blockList
 bool OverlapAlgorithm::isBlockSubstring(OverlapBlock& terminalBlock, const OverlapBlockList& blockList, double maxER) const
 {
@@ -1421,13 +1482,14 @@ double OverlapAlgorithm::calculateBlockErrorRate(const OverlapBlock& terminalBlo
 
 // Update the overlap block list with a righthand extension to b, removing ranges that become invalid
 void OverlapAlgorithm::updateOverlapBlockRangesRight(const BWT* pBWT, const BWT* pRevBWT, 
-OverlapBlockList& obList, char canonical_base) const
+OverlapBlockList& obList, char canonical_base, BlockOccVector& occs) const
 {
 	OverlapBlockList::iterator iter = obList.begin(); 
-	while(iter != obList.end())
+	for(size_t blockIdx = 0; iter != obList.end(); ++blockIdx)
 	{
 		char relative_base = iter->flags.isQueryComp() ? complement(canonical_base) : canonical_base;
-		BWTAlgorithms::updateBothR(iter->ranges, relative_base, iter->getExtensionBWT(pBWT, pRevBWT));
+		BWTAlgorithms::updateBothR(iter->ranges, relative_base, iter->getExtensionBWT(pBWT, pRevBWT),
+		                           occs[blockIdx].lower, occs[blockIdx].upper);
 		// remove the block from the list if its no longer valid
 		if(!iter->ranges.isValid())
 		{
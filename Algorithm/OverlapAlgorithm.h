@@ -22,6 +22,17 @@ enum OverlapMode
 	OM_FULLREAD
 };
 
+// The four FM-index searches of a read, named by the end of the read
+// they overlap and the strand of the targets they find
+enum OverlapSearch
+{
+	OS_SUFFIX_FWD = 1,
+	OS_SUFFIX_RC = 2,
+	OS_PREFIX_RC = 4,
+	OS_PREFIX_FWD = 8,
+	OS_ALL = 15
+};
+
 struct OverlapResult
 {
 	OverlapResult() : isSubstring(false), searchAborted(false) {}
@@ -235,19 +246,23 @@ public:
 	
 	// Perform the overlap
 	// This function is threaded so everything must be const
-	OverlapResult overlapRead(const SeqRecord& read, int minOverlap, OverlapBlockList* pOutList) const;
+	// Only the OverlapSearch flags set in searches are run
+	OverlapResult overlapRead(const SeqRecord& read, int minOverlap, OverlapBlockList* pOutList, int searches = OS_ALL) const;
 	
 	// Perform an irreducible overlap
-	OverlapResult overlapReadExact(const SeqRecord& read, int minOverlap, OverlapBlockList* pOBOut) const;
+	OverlapResult overlapReadExact(const SeqRecord& read, int minOverlap, OverlapBlockList* pOBOut, int searches = OS_ALL) const;
 
 	// Perform an inexact overlap using FM-index walk
-    OverlapResult overlapReadInexactFMWalk(const SeqRecord& read, int minOverlap, OverlapBlockList* pOBOut) const;
+    OverlapResult overlapReadInexactFMWalk(const SeqRecord& read, int minOverlap, OverlapBlockList* pOBOut, int searches = OS_ALL) const;
 
 	// Find duplicate blocks for this read
 	OverlapResult alignReadDuplicate(const SeqRecord& read, OverlapBlockList* pOBOut) const;
 
 	// Perform an inexact overlap
-	OverlapResult overlapReadInexact(const SeqRecord& read, int minOverlap, OverlapBlockList* pOBOut) const;
+	OverlapResult overlapReadInexact(const SeqRecord& read, int minOverlap, OverlapBlockList* pOBOut, int searches = OS_ALL) const;
+
+	// The OverlapSearch that finds blocks with the flags af
+	static int getOverlapSearch(const AlignFlags& af);
 
 	// Write the result of an overlap to an ASQG file
 	void writeResultASQG(std::ostream& writer, const SeqRecord& read, const OverlapResult& result) const;
@@ -331,9 +346,27 @@ private:
 	void _processIrreducibleBlocksInexact(const BWT* pBWT, const BWT* pRevBWT, 
 	OverlapBlockList& obList, OverlapBlockList* pOBFinal) const;
 
-	// Update the overlap block list with a righthand extension to b, removing ranges that become invalid
+	// The full occurrence counts at the ends of the extension interval of a block.
+	// Both the extension counts and the right update of the block derive from
+	// them, so a block is ranked once per extension round instead of twice.
+	struct BlockOcc
+	{
+		AlphaCount64 lower;
+		AlphaCount64 upper;
+
+		// The extension counts in the frame of the query
+		AlphaCount64 getCanonicalExtCount(const OverlapBlock& block) const;
+	};
+	typedef std::vector<BlockOcc> BlockOccVector;
+
+	// Compute the counts of every block of obList, in list order. The markers of
+	// all blocks are prefetched first so that their cache misses overlap.
+	void getBlockOccs(const BWT* pBWT, const BWT* pRevBWT, const OverlapBlockList& obList, BlockOccVector& occs) const;
+
+	// Update the overlap block list with a righthand extension to b, removing ranges that become invalid.
+	// occs are the counts of the blocks of obList before the update.
 	void updateOverlapBlockRangesRight(const BWT* pBWT, const BWT* pRevBWT, 
-	OverlapBlockList& obList, char b) const;
+	OverlapBlockList& obList, char b, BlockOccVector& occs) const;
 	
 	//                                  
 	void extendActiveBlocksRight(const BWT* pBWT, const BWT* pRevBWT, 
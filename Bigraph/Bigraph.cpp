@@ -12,6 +12,7 @@
 #include <iostream>
 #include <map>
 #include "Bigraph.h"
+#include "UnipathCompactor.h"
 #include "Timer.h"
 #include "ASQG.h"
 
@@ -162,11 +163,17 @@ void Bigraph::mergeVertices(VertexID id1, VertexID id2)
 void Bigraph::merge(Vertex* pV1, Edge* pEdge)
 {
 
-	Vertex* pV2 = pEdge->getEnd();
-	//std::cout << "Merging " << pV1->getID() << " with " << pV2->getID() << "\n";
+	//std::cout << "Merging " << pV1->getID() << " with " << pEdge->getEnd()->getID() << "\n";
 
 	// Merge the data
 	pV1->merge(pEdge);
+	spliceMergedVertex(pV1, pEdge);
+}
+
+//
+void Bigraph::spliceMergedVertex(Vertex* pV1, Edge* pEdge)
+{
+	Vertex* pV2 = pEdge->getEnd();
 
 	// Get the twin edge (the edge in v2 that points to v1)
 	Edge* pTwin = pEdge->getTwin();
@@ -449,27 +456,133 @@ int Bigraph::sweepEdges(GraphColor c)
 }
 
 //    Simplify the graph by compacting singular edges
-void Bigraph::simplify()
+void Bigraph::simplify(VertexIDVec* pMergedIDs, const VertexIDVec* pChangedIDs)
 {
 	assert(!hasContainment());
 	size_t mergeCount = 0 ;
 	
-	//Linear time implementation by YTH
-	VertexPtrMapIter iter = m_vertices.begin();
+	if(pChangedIDs == NULL)
+	{
+		// The unipaths are found and their sequences built with all threads,
+		// then merged in the order of the vertices as before
+		UnipathCompactor compactor(getAllVertices());
 
-	while(iter != m_vertices.end())
+		//Linear time implementation by YTH
+		VertexPtrMapIter iter = m_vertices.begin();
+
+		while(iter != m_vertices.end())
+		{
+			mergeCount += simplify(iter->second, compactor, pMergedIDs);
+			++iter;
+		}
+	}
+	else
 	{
-		mergeCount += simplify(iter->second, ED_SENSE);
-		mergeCount += simplify(iter->second, ED_ANTISENSE);
-		++iter;
+		VertexPtrVec vertices = getUnipathVertices(*pChangedIDs);
+		if(!vertices.empty())
+		{
+			UnipathCompactor compactor(vertices);
+
+			// Vertices merged into an earlier one are gone from the graph
+			VertexIDVec ids(vertices.size());
+			for(size_t i = 0; i < vertices.size(); ++i)
+				ids[i] = vertices[i]->getID();
+
+			for(size_t i = 0; i < ids.size(); ++i)
+			{
+				Vertex* pV = getVertex(ids[i]);
+				if(pV != NULL)
+					mergeCount += simplify(pV, compactor, pMergedIDs);
+			}
+		}
 	}
 	
 	if(mergeCount>0)
 		std::cout << "<Simplify> Merge Vertices : "  <<  mergeCount << std::endl;
 }
 
+// Merge the unipaths of pV in both directions, with the sequence from
+// the compactor if it found the unipath pV starts
+size_t Bigraph::simplify(Vertex* pV, UnipathCompactor& compactor, VertexIDVec* pMergedIDs)
+{
+	DNAEncodedString seq;
+	size_t numMerges = compactor.takeUnipath(pV, seq);
+	if(numMerges > 0)
+	{
+		// Merge the edges only and set the sequence built by the compactor
+		size_t seqLen = pV->getSeqLen();
+		size_t pathMerges = simplify(pV, ED_SENSE, &seqLen);
+		pathMerges += simplify(pV, ED_ANTISENSE, &seqLen);
+		assert(pathMerges == numMerges && seqLen == seq.length());
+		pV->swapSeq(seq);
+		numMerges = pathMerges;
+	}
+	else
+	{
+		numMerges = simplify(pV, ED_SENSE);
+		numMerges += simplify(pV, ED_ANTISENSE);
+	}
+
+	if(numMerges > 0 && pMergedIDs != NULL)
+		pMergedIDs->push_back(pV->getID());
+	return numMerges;
+}
+
+// The vertices of the unipaths through the changed vertices and the
+// neighbours of those, in the order of the graph. Merging only moves the
+// links onto the vertex merged into, except that removing its self edges
+// may link it to one of its neighbours.
+VertexPtrVec Bigraph::getUnipathVertices(const VertexIDVec& changedIDs)
+{
+	HashSet<const Vertex*> linked;
+	VertexPtrVec stack;
+	for(size_t i = 0; i < changedIDs.size(); ++i)
+	{
+		Vertex* pVertex = getVertex(changedIDs[i]);
+		if(pVertex != NULL && !linked.count(pVertex) &&
+		   (UnipathCompactor::getLink(pVertex, ED_SENSE) != NULL ||
+		    UnipathCompactor::getLink(pVertex, ED_ANTISENSE) != NULL))
+		{
+			linked.insert(pVertex);
+			stack.push_back(pVertex);
+		}
+	}
+
+	// Follow the links to the ends of the unipaths
+	while(!stack.empty())
+	{
+		Vertex* pVertex = stack.back();
+		stack.pop_back();
+		for(size_t idx = 0; idx < ED_COUNT; idx++)
+		{
+			Edge* pLink = UnipathCompactor::getLink(pVertex, EDGE_DIRECTIONS[idx]);
+			if(pLink != NULL && linked.insert(pLink->getEnd()).second)
+				stack.push_back(pLink->getEnd());
+		}
+	}
+
+	VertexPtrVec out;
+	if(linked.empty())
+		return out;
+
+	HashSet<const Vertex*> selected(linked);
+	for(HashSet<const Vertex*>::iterator iter = linked.begin(); iter != linked.end(); ++iter)
+	{
+		EdgePtrVec edges = (*iter)->getEdges();
+		for(size_t i = 0; i < edges.size(); ++i)
+			selected.insert(edges[i]->getEnd());
+	}
+
+	for(VertexPtrMapIter iter = m_vertices.begin(); iter != m_vertices.end(); ++iter)
+	{
+		if(selected.count(iter->second))
+			out.push_back(iter->second);
+	}
+	return out;
+}
+
 //merge unipaths from pV to pW in EdgeDir
-size_t Bigraph::simplify(Vertex* pV, EdgeDir dir)
+size_t Bigraph::simplify(Vertex* pV, EdgeDir dir, size_t* pSeqLen)
 {
 	size_t mergeCount = 0 ;
 	
@@ -494,7 +607,13 @@ size_t Bigraph::simplify(Vertex* pV, EdgeDir dir)
 			//statsOverlapRatio(pV, pSingle); 
 			
 			//merge pW seq into pV and move its transitive edges to pV
-			merge(pV, pSingle);
+			if(pSeqLen == NULL)
+				merge(pV, pSingle);
+			else
+			{
+				*pSeqLen = pV->mergeEdges(pSingle, *pSeqLen);
+				spliceMergedVertex(pV, pSingle);
+			}
 			mergeCount++ ;
 			
 			//remove self edges produced by V->W->V=V<->V
@@ -1046,29 +1165,27 @@ void Bigraph::printMemSize() const
 //
 void Bigraph::writeDot(const std::string& filename, int dotFlags) const
 {
-	std::ofstream out(filename.c_str());
+	BlockWriter writer(filename);
 
 	std::string graphType = (dotFlags & DF_UNDIRECTED) ? "graph" : "digraph";
 
-	out << graphType << " G\n{\n";
-	VertexPtrMapConstIter iter = m_vertices.begin();
-	for(; iter != m_vertices.end(); ++iter)
+	writer.write(graphType + " G\n{\n");
+	writeVertexRecords(writer, [dotFlags](const Vertex* pVertex, std::ostream& out)
 	{
-		VertexID id = iter->second->getID();
+		VertexID id = pVertex->getID();
 
 		std::stringstream ss;
-		ss << iter->second->getSeqLen();
+		ss << pVertex->getSeqLen();
 		std::string len = ss.str();
 		std::string label = (dotFlags & DF_NOID) ? "" : id+":"+len;
 
 		out << "\"" << id << "\" [ label=\"" << label << "\" ";
 		if(dotFlags & DF_COLORED)
-		out << " style=\"filled\" fillcolor=\"" << getColorString(iter->second->getColor()) << "\" ";
+		out << " style=\"filled\" fillcolor=\"" << getColorString(pVertex->getColor()) << "\" ";
 		out << "];\n";
-		iter->second->writeEdges(out, dotFlags);
-	}
-	out << "}\n";
-	out.close();
+		pVertex->writeEdges(out, dotFlags);
+	});
+	writer.write("}\n");
 }
 
 //
@@ -1076,7 +1193,7 @@ void Bigraph::writeDot(const std::string& filename, int dotFlags) const
 //
 void Bigraph::writeASQG(const std::string& filename) const
 {
-	std::ostream* pWriter = createWriter(filename);
+	BlockWriter writer(filename);
 
 	// Header
 	ASQG::HeaderRecord headerRecord;
@@ -1084,22 +1201,21 @@ void Bigraph::writeASQG(const std::string& filename) const
 	headerRecord.setErrorRateTag(m_errorRate);
 	headerRecord.setTransitiveTag(m_hasTransitive);
 	headerRecord.setContainmentTag(m_hasContainment);
-	headerRecord.write(*pWriter);
-
-
-	VertexPtrMapConstIter iter;
+	std::stringstream header;
+	headerRecord.write(header);
+	writer.write(header.str());
 
 	// Vertices
-	for(iter = m_vertices.begin(); iter != m_vertices.end(); ++iter)
+	writeVertexRecords(writer, [](const Vertex* pVertex, std::ostream& out)
 	{
-		ASQG::VertexRecord vertexRecord(iter->second->getID(), iter->second->getSeq().toString());
-		vertexRecord.write(*pWriter);
-	}
+		ASQG::VertexRecord vertexRecord(pVertex->getID(), pVertex->getSeq().toString());
+		vertexRecord.write(out);
+	});
 
 	// Edges
-	for(iter = m_vertices.begin(); iter != m_vertices.end(); ++iter)
+	writeVertexRecords(writer, [](const Vertex* pVertex, std::ostream& out)
 	{
-		EdgePtrVec edges = iter->second->getEdges();
+		EdgePtrVec edges = pVertex->getEdges();
 		for(EdgePtrVecIter edgeIter = edges.begin(); edgeIter != edges.end(); ++edgeIter)
 		{
 			// We write one record for every bidirectional edge so only write edges
@@ -1112,12 +1228,35 @@ void Bigraph::writeASQG(const std::string& filename) const
 				if(!ovr.isContainment() || ((*edgeIter)->getDir() == ED_SENSE))
 				{
 					ASQG::EdgeRecord edgeRecord(ovr);
-					edgeRecord.write(*pWriter);
+					edgeRecord.write(out);
 				}
 			}
 		}
+	});
+}
+
+//
+// Cut the vertices into blocks of about 1 MB of sequence and edges
+//
+std::vector<size_t> Bigraph::getOutputBlocks(const VertexPtrVec& vertices)
+{
+	static const size_t BLOCK_SIZE = 1 << 20;
+	static const size_t EDGE_SIZE = 64;
+
+	std::vector<size_t> blockStarts(1, 0);
+	size_t size = 0;
+	for(size_t i = 0; i < vertices.size(); ++i)
+	{
+		size += vertices[i]->getSeqLen() + EDGE_SIZE * (vertices[i]->countEdges() + 1);
+		if(size >= BLOCK_SIZE)
+		{
+			blockStarts.push_back(i + 1);
+			size = 0;
+		}
 	}
-	delete pWriter;
+	if(blockStarts.back() != vertices.size())
+		blockStarts.push_back(vertices.size());
+	return blockStarts;
 }
 
 //
@@ -17,6 +17,7 @@
 #include "Vertex.h"
 #include "Edge.h"
 #include "HashMap.h"
+#include "BlockWriter.h"
 #include <omp.h>
 
 
@@ -32,6 +33,7 @@ typedef VertexPtrMap::iterator VertexPtrMapIter;
 typedef VertexPtrMap::const_iterator VertexPtrMapConstIter;
 
 class Bigraph;
+class UnipathCompactor;
 typedef bool(*VertexVisitFunction)(Bigraph*, Vertex*);
 
 typedef EdgePtrVec Path; // alias
@@ -94,8 +96,12 @@ class Bigraph
         // Rename all the vertices in the graph
         void renameVertices(const std::string& prefix = "");
 
-        // Simplify the graph by removing transitive edges
-        void simplify();
+        // Simplify the graph by removing transitive edges.
+        // The IDs of the vertices other vertices were merged into are added to pMergedIDs.
+        // With pChangedIDs only the unipaths through those vertices are compacted,
+        // for a graph simplified before whose other vertices have not changed since.
+        // The vertices merged into and their neighbours count as changed next time.
+        void simplify(VertexIDVec* pMergedIDs = NULL, const VertexIDVec* pChangedIDs = NULL);
 
         // Validate that the graph is sane
         void validate();
@@ -285,6 +291,16 @@ class Bigraph
         void writeDot(const std::string& filename, int dotFlags = 0) const;
         void writeASQG(const std::string& filename) const;
 
+        // Write a record for every vertex in the order of visit. The records
+        // are formatted by format(pVertex, out) in blocks with all threads.
+        template<typename Formatter>
+        void writeVertexRecords(BlockWriter& writer, Formatter format) const
+        {
+            VertexPtrVec vertices = getAllVertices();
+            writer.writeBlocks(getOutputBlocks(vertices),
+                               [&](size_t i, std::ostream& out) { format(vertices[i], out); });
+        }
+
         // Returns an allocator for the edges of the graph
         SimpleAllocator<Edge>* getEdgeAllocator() { return m_pEdgeAllocator; }
 
@@ -305,11 +321,26 @@ class Bigraph
 
     private:
         
-        // Simplify the graph by compacting edges in the given direction
-        size_t simplify(Vertex* pV, EdgeDir dir);
+        // Simplify the graph by compacting edges in the given direction.
+        // If pSeqLen is given the sequence of pV is left alone and
+        // *pSeqLen, its length, is updated instead.
+        size_t simplify(Vertex* pV, EdgeDir dir, size_t* pSeqLen = NULL);
+
+        // Simplify pV in both directions, see simplify(VertexIDVec*, const VertexIDVec*)
+        size_t simplify(Vertex* pV, UnipathCompactor& compactor, VertexIDVec* pMergedIDs);
+
+        // The vertices simplify has to visit when only changedIDs changed
+        VertexPtrVec getUnipathVertices(const VertexIDVec& changedIDs);
+
+        // Move the edges of the end of pEdge to pV1 and remove the end,
+        // the second half of merge
+        void spliceMergedVertex(Vertex* pV1, Edge* pEdge);
 
         void followLinear(VertexID id, EdgeDir dir, Path& outPath);
 
+        // Cut vertices into blocks of about the same output size for writeVertexRecords
+        static std::vector<size_t> getOutputBlocks(const VertexPtrVec& vertices);
+
         //
         // data
         //
@@ -0,0 +1,219 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// UnipathCompactor - Find the unipaths of a graph and build
+// their merged sequences with all threads
+//
+#include <omp.h>
+#include <algorithm>
+#include "UnipathCompactor.h"
+
+UnipathCompactor::UnipathCompactor(const VertexPtrVec& vertices) : m_vertices(vertices)
+{
+    size_t numVertices = m_vertices.size();
+    m_index.resize(numVertices);
+    m_links.resize(2 * numVertices);
+    m_pathOf.assign(numVertices, -1);
+
+    #pragma omp parallel for schedule(static)
+    for(size_t i = 0; i < numVertices; ++i)
+        m_index[i] = std::make_pair(m_vertices[i], (VertexIdx)i);
+    std::sort(m_index.begin(), m_index.end());
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for(size_t i = 0; i < numVertices; ++i)
+    {
+        for(size_t idx = 0; idx < ED_COUNT; idx++)
+            m_links[2 * i + idx] = getLink(m_vertices[i], EDGE_DIRECTIONS[idx]);
+    }
+
+    // Walk every path from both of its ends, the end first in order keeps it
+    std::vector<std::vector<Unipath> > threadPaths(omp_get_max_threads());
+    #pragma omp parallel
+    {
+        std::vector<Unipath>& paths = threadPaths[omp_get_thread_num()];
+
+        #pragma omp for schedule(dynamic, 1024)
+        for(size_t i = 0; i < numVertices; ++i)
+        {
+            // An end has a link in one direction only
+            if((getLinkAt(i, ED_SENSE) == NULL) == (getLinkAt(i, ED_ANTISENSE) == NULL))
+                continue;
+
+            Unipath path;
+            if(walk(i, path) && path.members.front() < path.members.back())
+                paths.push_back(path);
+        }
+    }
+
+    for(size_t t = 0; t < threadPaths.size(); ++t)
+        m_paths.insert(m_paths.end(), threadPaths[t].begin(), threadPaths[t].end());
+    threadPaths.clear();
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for(size_t p = 0; p < m_paths.size(); ++p)
+    {
+        for(size_t i = 0; i < m_paths[p].members.size(); ++i)
+            m_pathOf[m_paths[p].members[i]] = p;
+    }
+
+    // Build the sequences of the simple paths
+    std::vector<char> isSimplePath(m_paths.size(), 0);
+    m_seqs.resize(m_paths.size());
+    #pragma omp parallel for schedule(dynamic, 1)
+    for(size_t p = 0; p < m_paths.size(); ++p)
+    {
+        isSimplePath[p] = isSimple(p);
+        if(isSimplePath[p])
+            buildSequence(m_paths[p], m_seqs[p]);
+    }
+
+    for(size_t p = 0; p < m_paths.size(); ++p)
+    {
+        const std::vector<VertexIdx>& members = m_paths[p].members;
+        if(isSimplePath[p])
+            m_heads.push_back(std::make_pair(m_vertices[*std::min_element(members.begin(), members.end())], p));
+    }
+    std::sort(m_heads.begin(), m_heads.end());
+}
+
+//
+size_t UnipathCompactor::takeUnipath(const Vertex* pVertex, DNAEncodedString& seq)
+{
+    std::vector<std::pair<const Vertex*, size_t> >::const_iterator iter =
+        std::lower_bound(m_heads.begin(), m_heads.end(), std::make_pair(pVertex, (size_t)0));
+    if(iter == m_heads.end() || iter->first != pVertex)
+        return 0;
+
+    const Unipath& path = m_paths[iter->second];
+    DNAEncodedString pathSeq;
+    pathSeq.swap(m_seqs[iter->second]);
+
+    // Merges before this one may have linked an end to another vertex,
+    // the path then is longer than found and merged as usual
+    if(getLink(m_vertices[path.members.front()], path.endDir[0]) != NULL ||
+       getLink(m_vertices[path.members.back()], path.endDir[1]) != NULL)
+        return 0;
+
+    seq.swap(pathSeq);
+    return path.members.size() - 1;
+}
+
+//
+Edge* UnipathCompactor::getLink(Vertex* pVertex, EdgeDir dir)
+{
+    if(pVertex->countEdges(dir) != 1)
+        return NULL;
+
+    Edge* pEdge = pVertex->getEdges(dir).front();
+    if(pEdge->isSelf() || pEdge->getEnd()->countEdges(pEdge->getTwin()->getDir()) != 1)
+        return NULL;
+    return pEdge;
+}
+
+//
+UnipathCompactor::VertexIdx UnipathCompactor::getIndex(const Vertex* pVertex) const
+{
+    std::vector<std::pair<const Vertex*, VertexIdx> >::const_iterator iter =
+        std::lower_bound(m_index.begin(), m_index.end(), std::make_pair(pVertex, (VertexIdx)0));
+    assert(iter != m_index.end() && iter->first == pVertex);
+    return iter->second;
+}
+
+//
+bool UnipathCompactor::walk(VertexIdx v, Unipath& path) const
+{
+    EdgeDir dir = getLinkAt(v, ED_SENSE) != NULL ? ED_SENSE : ED_ANTISENSE;
+    path.members.assign(1, v);
+    path.endDir[0] = !dir;
+
+    while(path.members.size() <= m_vertices.size())
+    {
+        Edge* pLink = getLinkAt(v, dir);
+        v = getIndex(pLink->getEnd());
+        dir = !pLink->getTwin()->getDir();
+        path.members.push_back(v);
+
+        if(getLinkAt(v, dir) == NULL)
+        {
+            path.endDir[1] = dir;
+            return true;
+        }
+    }
+    return false;
+}
+
+//
+bool UnipathCompactor::isSimple(size_t pathIdx) const
+{
+    const std::vector<VertexIdx>& members = m_paths[pathIdx].members;
+    for(size_t i = 0; i < members.size(); ++i)
+    {
+        VertexIdx v = members[i];
+        EdgePtrVec edges = m_vertices[v]->getEdges();
+        for(size_t j = 0; j < edges.size(); ++j)
+        {
+            if(edges[j] == getLinkAt(v, ED_SENSE) || edges[j] == getLinkAt(v, ED_ANTISENSE))
+                continue;
+            if(m_pathOf[getIndex(edges[j]->getEnd())] == (int64_t)pathIdx)
+                return false;
+        }
+    }
+    return true;
+}
+
+//
+void UnipathCompactor::buildSequence(const Unipath& path, DNAEncodedString& pathSeq) const
+{
+    VertexIdx head = *std::min_element(path.members.begin(), path.members.end());
+    std::string headSeq = m_vertices[head]->getStr();
+
+    // Length of the labels on both sides of the head
+    size_t labelLen[ED_COUNT] = { 0, 0 };
+    for(size_t idx = 0; idx < ED_COUNT; idx++)
+    {
+        VertexIdx v = head;
+        EdgeDir dir = EDGE_DIRECTIONS[idx];
+        while(Edge* pLink = getLinkAt(v, dir))
+        {
+            labelLen[idx] += pLink->getSeqLen();
+            v = getIndex(pLink->getEnd());
+            dir = !pLink->getTwin()->getDir();
+        }
+    }
+
+    // The sense labels are appended after the head, the antisense ones prepended
+    std::string seq(labelLen[ED_ANTISENSE] + headSeq.length() + labelLen[ED_SENSE], 'A');
+    seq.replace(labelLen[ED_ANTISENSE], headSeq.length(), headSeq);
+    for(size_t idx = 0; idx < ED_COUNT; idx++)
+    {
+        size_t pos = idx == ED_SENSE ? labelLen[ED_ANTISENSE] + headSeq.length() : labelLen[ED_ANTISENSE];
+        VertexIdx v = head;
+        EdgeDir dir = EDGE_DIRECTIONS[idx];
+        EdgeComp comp = EC_SAME;
+        while(Edge* pLink = getLinkAt(v, dir))
+        {
+            std::string label = pLink->getLabel();
+            if(comp == EC_REVERSE)
+                label = reverseComplement(label);
+            if(pLink->getComp() == EC_REVERSE)
+                comp = !comp;
+
+            if(idx == ED_SENSE)
+            {
+                seq.replace(pos, label.length(), label);
+                pos += label.length();
+            }
+            else
+            {
+                pos -= label.length();
+                seq.replace(pos, label.length(), label);
+            }
+            v = getIndex(pLink->getEnd());
+            dir = !pLink->getTwin()->getDir();
+        }
+    }
+    pathSeq = seq;
+}
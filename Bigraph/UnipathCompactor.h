@@ -0,0 +1,85 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// UnipathCompactor - Find the unipaths of a graph and build
+// their merged sequences with all threads, for Bigraph::simplify.
+// Two vertices are linked when the edge between them is the only
+// edge of both in its direction, the merge condition of simplify.
+// A chain of links with two ends is a unipath; it is merged into
+// its first vertex in the order of the graph, the vertex simplify
+// would start from, so the result is the same as the serial merge.
+//
+// Cycles and unipaths with other edges between their own vertices
+// are not handled here, simplify merges them one vertex at a time.
+//
+#ifndef UNIPATHCOMPACTOR_H
+#define UNIPATHCOMPACTOR_H
+
+#include <vector>
+#include <stdint.h>
+#include "Bigraph.h"
+
+class UnipathCompactor
+{
+    public:
+
+        // vertices must be in the order simplify visits them
+        UnipathCompactor(const VertexPtrVec& vertices);
+
+        // If pVertex is the first vertex of a unipath that is still as found,
+        // swap its merged sequence into seq and return the number of vertices
+        // to merge into pVertex. Returns 0 otherwise.
+        size_t takeUnipath(const Vertex* pVertex, DNAEncodedString& seq);
+
+        // The edge of pVertex in direction dir if it is a link, NULL otherwise
+        static Edge* getLink(Vertex* pVertex, EdgeDir dir);
+
+    private:
+
+        typedef uint32_t VertexIdx;
+
+        struct Unipath
+        {
+            // The vertices from one end to the other
+            std::vector<VertexIdx> members;
+
+            // The unlinked directions of the two ends
+            EdgeDir endDir[2];
+        };
+
+        VertexIdx getIndex(const Vertex* pVertex) const;
+        Edge* getLinkAt(VertexIdx v, EdgeDir dir) const { return m_links[2 * v + dir]; }
+
+        // Follow the links from the end v, returns false for a cycle
+        bool walk(VertexIdx v, Unipath& path) const;
+
+        // True if the only edges between the vertices of the path are its links
+        bool isSimple(size_t pathIdx) const;
+
+        // Merged sequence of the path starting from its first vertex in order
+        void buildSequence(const Unipath& path, DNAEncodedString& pathSeq) const;
+
+        VertexPtrVec m_vertices;
+
+        // Vertices sorted by address with their position in m_vertices
+        std::vector<std::pair<const Vertex*, VertexIdx> > m_index;
+
+        // The link of every vertex in both directions
+        std::vector<Edge*> m_links;
+
+        std::vector<Unipath> m_paths;
+
+        // The merged sequences of the paths, kept apart since an empty
+        // DNAEncodedString can not be copied when m_paths grows
+        std::vector<DNAEncodedString> m_seqs;
+
+        // Path of every vertex, -1 if it is in none
+        std::vector<int64_t> m_pathOf;
+
+        // The first vertex of every simple path with its path, sorted by address
+        std::vector<std::pair<const Vertex*, size_t> > m_heads;
+};
+
+#endif
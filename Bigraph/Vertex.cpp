@@ -29,14 +29,12 @@ Vertex::~Vertex()
 // must be updated to contain the extension of the vertex
 void Vertex::merge(Edge* pEdge)
 {
-    Edge* pTwin = pEdge->getTwin();
     //std::cout << "Adding label to " << getID() << " str: " << pSE->getLabel() << "\n";
 
     // Merge the sequence
     DNAEncodedString label = pEdge->getLabel();
     size_t label_len = label.length();
-    pEdge->updateSeqLen(m_seq.length() + label_len);
-    bool prepend = false;
+    size_t oldLen = m_seq.length();
 
     if(pEdge->getDir() == ED_SENSE)
     {
@@ -46,19 +44,44 @@ void Vertex::merge(Edge* pEdge)
     {
         label.append(m_seq);
         std::swap(m_seq, label);
-        prepend = true;
     }
 
     // Update the coverage value of the vertex
     m_coverage += pEdge->getEnd()->getCoverage();
 
+    updateMergedEdges(pEdge, oldLen, label_len);
+
+#ifdef VALIDATE
+    VALIDATION_WARNING("Vertex::merge")
+    validate();
+#endif
+
+}
+
+//
+size_t Vertex::mergeEdges(Edge* pEdge, size_t seqLen)
+{
+    // The label is the part of the end vertex outside of the twin's match
+    size_t label_len = pEdge->getSeqLen();
+    m_coverage += pEdge->getEnd()->getCoverage();
+    updateMergedEdges(pEdge, seqLen, label_len);
+    return seqLen + label_len;
+}
+
+//
+void Vertex::updateMergedEdges(Edge* pEdge, size_t oldLen, size_t label_len)
+{
+    Edge* pTwin = pEdge->getTwin();
+    size_t newLen = oldLen + label_len;
+    bool prepend = pEdge->getDir() != ED_SENSE;
+
+    pEdge->updateSeqLen(newLen);
     pEdge->extendMatch(label_len);
     pTwin->extendMatchFullLength();
 
     // All the SeqCoords for the edges must have their seqlen field updated
     // Also, if we prepended sequence to this edge, all the matches in the
     // SENSE direction must have their coordinates offset
-    size_t newLen = m_seq.length();
     for(EdgePtrVecIter iter = m_edges.begin(); iter != m_edges.end(); ++iter)
     {
         Edge* pUpdateEdge = *iter;
@@ -66,12 +89,6 @@ void Vertex::merge(Edge* pEdge)
         if(prepend && pUpdateEdge->getDir() == ED_SENSE && pEdge != pUpdateEdge)
             pUpdateEdge->offsetMatch(label_len);
     }
-
-#ifdef VALIDATE
-    VALIDATION_WARNING("Vertex::merge")
-    validate();
-#endif
-
 }
 
 // Merging ARBRC: R and B into RBR
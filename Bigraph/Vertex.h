@@ -84,6 +84,12 @@ class Vertex
         // Merge another vertex into this vertex, as specified by pEdge
         void merge(Edge* pEdge);
 
+        // Merge the edges and coverage of the vertex at the end of pEdge like merge,
+        // leaving the sequence alone. seqLen is the length the sequence would have
+        // before the merge, the length after it is returned. Used to merge a unipath
+        // whose sequence is built beforehand and set with swapSeq.
+        size_t mergeEdges(Edge* pEdge, size_t seqLen);
+
         // For merging ARBRC: R and B will be merged into RBR
 		void mergeTipVertex(Edge* pEdge);
 
@@ -136,9 +142,11 @@ class Vertex
         void setID(VertexID id) { m_id = id; }
         void setEdgeColors(GraphColor c);
         void setSeq(const std::string& s) { m_seq = s; }
+        void swapSeq(DNAEncodedString& s) { m_seq.swap(s); }
         void setColor(GraphColor c) { m_color = c; }
         void setContained(bool c) { m_isContained = c; }
         void setSuperRepeat(bool b) { m_isSuperRepeat = b; }
+        void setCoverage(uint16_t c) { m_coverage = c; }
 		void setOriginLength (size_t l,EdgeDir dir){ m_originLength[dir] = l;}
 
         // getters
@@ -205,6 +213,10 @@ class Vertex
             return malloc(size);
         }
 
+        // Update the edges after label_len bases were added to the sequence,
+        // of oldLen bases, on the side of pEdge
+        void updateMergedEdges(Edge* pEdge, size_t oldLen, size_t label_len);
+
         // Ensure all the edges in DIR are unique
         bool markDuplicateEdges(EdgeDir dir, GraphColor dupColor);
 
@@ -0,0 +1,194 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// BoundedQueue - Fixed capacity queue shared by any number of
+// producer and consumer threads without locks. Every cell
+// carries a sequence number telling whether it is ready to be
+// written or read in the current lap around the ring, so a
+// thread only claims a position with a compare-and-swap and
+// never waits on another thread inside the queue. A full or
+// empty queue is reported to the caller instead of blocking.
+//
+// QueueSignal lets the callers of several queues sleep until
+// one of them changes. A queue given a signal notifies it after
+// every push and pop, which costs a load of the number of
+// sleeping threads as long as there are none.
+//
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <sched.h>
+#include <stdint.h>
+#include <assert.h>
+
+class QueueSignal
+{
+    public:
+        QueueSignal() : m_epoch(0), m_numWaiting(0) {}
+
+        // Call tryOnce until it returns true. After SPIN_LIMIT failed tries with a
+        // yield in between, the thread sleeps until a queue changes, looking at
+        // the queues once more after announcing the sleep so no change is missed.
+        template<class F>
+        void retry(F tryOnce)
+        {
+            size_t numFailed = 0;
+            while(!tryOnce())
+            {
+                if(++numFailed < SPIN_LIMIT)
+                {
+                    sched_yield();
+                    continue;
+                }
+
+                m_numWaiting.fetch_add(1);
+                uint64_t epoch = m_epoch.load();
+                if(tryOnce())
+                {
+                    m_numWaiting.fetch_sub(1);
+                    return;
+                }
+
+                std::unique_lock<std::mutex> lock(m_mutex);
+                while(m_epoch.load() == epoch)
+                    m_cond.wait(lock);
+                m_numWaiting.fetch_sub(1);
+            }
+        }
+
+        // Wake the sleeping threads, if any. The fence orders the caller's
+        // queue update before the load of m_numWaiting.
+        void notify()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(m_numWaiting.load() > 0)
+                notifyAll();
+        }
+
+        void notifyAll()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_epoch.fetch_add(1);
+            }
+            m_cond.notify_all();
+        }
+
+    private:
+        static const size_t SPIN_LIMIT = 64;
+
+        std::atomic<uint64_t> m_epoch;
+        std::atomic<size_t> m_numWaiting;
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+};
+
+template<class T>
+class BoundedQueue
+{
+    public:
+        // The capacity is rounded up to a power of two. pSignal, if given,
+        // is notified of every push and pop.
+        BoundedQueue(size_t capacity, QueueSignal* pSignal = NULL) : m_pSignal(pSignal), m_enqueuePos(0), m_dequeuePos(0)
+        {
+            assert(capacity > 0);
+            size_t size = 1;
+            while(size < capacity)
+                size <<= 1;
+
+            m_mask = size - 1;
+            m_pCells.reset(new Cell[size]);
+            for(size_t i = 0; i < size; ++i)
+                m_pCells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        // Append item, false if the queue is full
+        bool tryPush(const T& item)
+        {
+            size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+            while(true)
+            {
+                Cell& cell = m_pCells[pos & m_mask];
+                size_t seq = cell.sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+                if(diff == 0)
+                {
+                    if(m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        cell.data = item;
+                        cell.sequence.store(pos + 1, std::memory_order_release);
+                        if(m_pSignal != NULL)
+                            m_pSignal->notify();
+                        return true;
+                    }
+                }
+                else if(diff < 0)
+                    return false;
+                else
+                    pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        // Remove the oldest item, false if the queue is empty
+        bool tryPop(T& item)
+        {
+            size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+            while(true)
+            {
+                Cell& cell = m_pCells[pos & m_mask];
+                size_t seq = cell.sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+                if(diff == 0)
+                {
+                    if(m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        item = cell.data;
+                        cell.sequence.store(pos + m_mask + 1, std::memory_order_release);
+                        if(m_pSignal != NULL)
+                            m_pSignal->notify();
+                        return true;
+                    }
+                }
+                else if(diff < 0)
+                    return false;
+                else
+                    pos = m_dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        // Number of items, only exact when no other thread is using the queue
+        size_t sizeApprox() const
+        {
+            size_t enqueued = m_enqueuePos.load(std::memory_order_relaxed);
+            size_t dequeued = m_dequeuePos.load(std::memory_order_relaxed);
+            return enqueued > dequeued ? enqueued - dequeued : 0;
+        }
+
+        size_t capacity() const { return m_mask + 1; }
+
+    private:
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            T data;
+        };
+
+        std::unique_ptr<Cell[]> m_pCells;
+        size_t m_mask;
+        QueueSignal* m_pSignal;
+
+        // The positions are written by different threads, keep them on separate cache lines
+        alignas(64) std::atomic<size_t> m_enqueuePos;
+        alignas(64) std::atomic<size_t> m_dequeuePos;
+};
+
+#endif
@@ -16,27 +16,62 @@
 //
 OverlapProcess::OverlapProcess(const std::string& outFile, 
                                const OverlapAlgorithm* pOverlapper, 
-                               int minOverlap) : m_pOverlapper(pOverlapper), 
-                                                 m_minOverlap(minOverlap)
+                               int minOverlap,
+                               bool isBinary,
+                               const MinimizerFilter* pFilter,
+                               bool isFilterReport) : m_pWriter(NULL),
+                                                      m_pHitWriter(NULL),
+                                                      m_pOverlapper(pOverlapper), 
+                                                      m_minOverlap(minOverlap),
+                                                      m_pFilter(pFilter),
+                                                      m_isFilterReport(isFilterReport)
 {
-    m_pWriter = createWriter(outFile);
+    if(isBinary)
+        m_pHitWriter = new OverlapHitFile::Writer(outFile);
+    else
+        m_pWriter = createWriter(outFile);
 }
 
 //
 OverlapProcess::~OverlapProcess()
 {
     delete m_pWriter;
+    delete m_pHitWriter;
 }
 
 //
 OverlapResult OverlapProcess::process(const SequenceWorkItem& workItem)
 {
+	// Select the searches supported by the minimizers shared with other reads
+	int searches = OS_ALL;
+	if(m_pFilter != NULL)
+	{
+		searches = m_pFilter->getSearches(workItem.read.seq.toString(), workItem.idx);
+		m_filterStats.numReads++;
+		for(int s = OS_SUFFIX_FWD; s <= OS_PREFIX_FWD; s <<= 1)
+			m_filterStats.numSearches += (searches & s) ? 1 : 0;
+		if(searches == 0)
+			m_filterStats.numSkippedReads++;
+	}
+
 	//compute overlap of workItem.read with results stored in m_blockList, where each block stores SA intervals of overlapping reads
-    OverlapResult result = m_pOverlapper->overlapRead(workItem.read, m_minOverlap, &m_blockList);
+    OverlapResult result = m_pOverlapper->overlapRead(workItem.read, m_minOverlap, &m_blockList, m_isFilterReport ? OS_ALL : searches);
 	
 	// Give up substring overlap
 	if(result.isSubstring) 
 	{	
+		// Count the substrings the selected searches alone would not have detected
+		if(m_pFilter != NULL && m_isFilterReport)
+		{
+			m_filterStats.numSubstrings++;
+			if(searches != OS_ALL)
+			{
+				OverlapBlockList selectedBlocks;
+				if(searches == 0 || !m_pOverlapper->overlapRead(workItem.read, m_minOverlap, &selectedBlocks, searches).isSubstring)
+					m_filterStats.numMissedSubstrings++;
+			}
+		}
+
 		// std::cout << "substring after submaximal removal\n";
 		return result;
 	}
@@ -50,6 +85,8 @@ OverlapResult OverlapProcess::process(const SequenceWorkItem& workItem)
 		
 		// skip target substr
 		if(record.isTargetSubstring) continue;
+
+		bool isSelected = (searches & OverlapAlgorithm::getOverlapSearch(record.flags)) != 0;
 			
         // Iterate through the SA interval range and write the overlaps
         for(int64_t j = record.ranges.interval[0].lower; j <= record.ranges.interval[0].upper; ++j)
@@ -81,7 +118,16 @@ OverlapResult OverlapProcess::process(const SequenceWorkItem& workItem)
 				if(o.id[0] < o.id[1])continue;
 								
 				//assert(isQuerySuperRepeat || o.id[0] > o.id[1]);
+
+				m_filterStats.numEdges++;
+				m_filterStats.numKeptEdges += isSelected ? 1 : 0;
 				
+				if(m_pHitWriter != NULL)
+				{
+					m_pHitWriter->write(o);
+					continue;
+				}
+
                 ASQG::EdgeRecord edgeRecord( o );
 				edgeRecord.write( *m_pWriter );
             }
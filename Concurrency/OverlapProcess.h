@@ -11,25 +11,39 @@
 
 #include "Util.h"
 #include "OverlapAlgorithm.h"
+#include "MinimizerFilter.h"
 #include "SequenceProcessFramework.h"
+#include "../SQG/OverlapHitFile.h"
 
 // Compute the overlap blocks for reads
+// The edges are written as ASQG edge records, or as binary hits if isBinary is set
+// If pFilter is given only the searches it selects are run; with isFilterReport
+// all searches are run and the edges the selected ones find are only counted
 class OverlapProcess
 {
     public:
         OverlapProcess(const std::string& outFile, 
                        const OverlapAlgorithm* pOverlapper, 
-                       int minOverlap);
+                       int minOverlap,
+                       bool isBinary = false,
+                       const MinimizerFilter* pFilter = NULL,
+                       bool isFilterReport = false);
 
         ~OverlapProcess();
 
         OverlapResult process(const SequenceWorkItem& item);
+
+        const MinimizerFilterStats& getFilterStats() const { return m_filterStats; }
     
     private:
         std::ostream* m_pWriter;
+        OverlapHitFile::Writer* m_pHitWriter;
         OverlapBlockList m_blockList;
         const OverlapAlgorithm* m_pOverlapper;
         const int m_minOverlap;
+        const MinimizerFilter* m_pFilter;
+        const bool m_isFilterReport;
+        MinimizerFilterStats m_filterStats;
 };
 
 // Write the results from the overlap step to an ASQG file
@@ -8,7 +8,11 @@
 // some operations on input data produced by a generator,
 // serially or in parallel.
 //
+#include <atomic>
+#include <map>
+#include <sched.h>
 #include "ThreadWorker.h"
+#include "BoundedQueue.h"
 #include "Timer.h"
 #include "SequenceWorkItem.h"
 #include "config.h"
@@ -356,6 +360,332 @@ size_t processSequencesParallelOpenMP(const std::string& readsFile, std::vector<
                                       PostProcessor>(generator, pProcessorVec, pPostProcessor);
 }
 
+// Process the work items in batches rather than one at a time. Every batch
+// holds batchSize items per processor and is split into slices of batchSize
+// items, each slice is handed to a processor through
+//
+//     void processBatch(const std::vector<Input>&, std::vector<Output>&)
+//
+// so the processor can schedule the work of many items together. The outputs
+// are post-processed in input order. Without OpenMP the slices are processed
+// serially by the first processor.
+template<class Input, class Output, class Generator, class Processor, class PostProcessor>
+size_t processWorkBatched(Generator& generator,
+                          std::vector<Processor*>& pProcessorVec,
+                          PostProcessor* pPostProcessor,
+                          size_t batchSize,
+                          size_t n = -1)
+{
+    Timer timer("SequenceProcess", true);
+    assert(!pProcessorVec.empty() && batchSize > 0);
+
+    size_t numThreads = pProcessorVec.size();
+    std::vector<std::vector<Input> > inputSlices;
+    std::vector<std::vector<Output> > outputSlices;
+
+    bool done = false;
+    while(!done)
+    {
+        // Fill up to one slice per processor
+        inputSlices.assign(1, std::vector<Input>());
+        while(true)
+        {
+            Input workItem;
+            done = generator.getNumConsumed() == n || !generator.generate(workItem);
+            if(done)
+                break;
+
+            if(inputSlices.back().size() == batchSize)
+                inputSlices.push_back(std::vector<Input>());
+            inputSlices.back().push_back(workItem);
+
+            if(inputSlices.size() == numThreads && inputSlices.back().size() == batchSize)
+                break;
+        }
+
+        outputSlices.resize(inputSlices.size());
+#if HAVE_OPENMP
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(numThreads)
+#endif
+        for(int i = 0; i < (int)inputSlices.size(); ++i)
+        {
+#if HAVE_OPENMP
+            size_t tid = omp_get_thread_num();
+#else
+            size_t tid = 0;
+#endif
+            pProcessorVec[tid]->processBatch(inputSlices[i], outputSlices[i]);
+        }
+
+        // Process the output with a single thread
+        for(size_t i = 0; i < inputSlices.size(); ++i)
+        {
+            assert(inputSlices[i].size() == outputSlices[i].size());
+            for(size_t j = 0; j < inputSlices[i].size(); ++j)
+                pPostProcessor->process(inputSlices[i][j], outputSlices[i][j]);
+        }
+    }
+
+    assert(n == (size_t)-1 || generator.getNumConsumed() == n);
+
+    double proc_time_secs = timer.getElapsedWallTime();
+    fprintf(stderr, "Processed %zu sequences in %lfs (%lf sequences/s)\n",
+            generator.getNumConsumed(), proc_time_secs, (double)generator.getNumConsumed() / proc_time_secs);
+
+    return generator.getNumConsumed();
+}
+
+// Wrapper function for processing a file of sequences in batches
+template<class Input, class Output, class Processor, class PostProcessor>
+size_t processSequencesBatched(const std::string& readsFile, std::vector<Processor*>& pProcessorVec, PostProcessor* pPostProcessor, size_t batchSize)
+{
+    SeqReader reader(readsFile);
+    WorkItemGenerator<Input> generator(&reader);
+    return processWorkBatched<Input,
+                              Output,
+                              WorkItemGenerator<Input>,
+                              Processor,
+                              PostProcessor>(generator, pProcessorVec, pPostProcessor, batchSize);
+}
+
+// Process the work items in three stages connected by BoundedQueues. The items
+// are seeded in batches of batchSize, the gap tasks of every item of a batch are
+// spread over all threads, and once the last gap of a batch is filled its items
+// are stitched. The processor provides
+//
+//     typedef ... PipelineState;   // the state of an item, holds std::vector<GapTask> gapTasks
+//     typedef ... GapTask;
+//     void seed(const Input&, PipelineState&)
+//     void fillGap(const PipelineState&, GapTask&)
+//     Output stitch(const Input&, PipelineState&)
+//
+// The first numSeedThreads threads prefer seeding and the others gap filling, a
+// thread takes work from the other stage when its own stage has none. With
+// numSeedThreads of 0 the stages are balanced by the gap queue: every thread
+// seeds until the queue is half full. Stitching a finished batch goes before
+// either stage. The first thread also reads the input and post-processes the
+// outputs in input order. Without OpenMP the first thread runs every stage.
+template<class Input, class Output, class Generator, class Processor, class PostProcessor>
+size_t processWorkPipelined(Generator& generator,
+                            std::vector<Processor*>& pProcessorVec,
+                            PostProcessor* pPostProcessor,
+                            size_t batchSize,
+                            size_t numSeedThreads,
+                            size_t n = -1)
+{
+    Timer timer("SequenceProcess", true);
+    assert(!pProcessorVec.empty() && batchSize > 0);
+
+    typedef typename Processor::PipelineState State;
+    typedef typename Processor::GapTask GapTask;
+
+    struct Batch
+    {
+        size_t index;
+        std::vector<Input> inputs;
+        std::vector<State> states;
+        std::vector<Output> outputs;
+
+        // Gap tasks not filled yet, plus one until all of them are queued
+        std::atomic<size_t> numPending;
+    };
+
+    struct GapRef
+    {
+        Batch* pBatch;
+        const State* pState;
+        GapTask* pTask;
+    };
+
+    const size_t GAP_QUEUE_SIZE = 4096;
+    size_t numThreads = pProcessorVec.size();
+    size_t maxInFlight = 2 * numThreads + 2;
+
+    // Batches are only read while fewer than maxInFlight are unfinished,
+    // so pushing to the batch queues never fails. A thread without work
+    // sleeps on the signal of the queues after a few tries.
+    QueueSignal signal;
+    BoundedQueue<Batch*> seedQueue(maxInFlight, &signal);
+    BoundedQueue<Batch*> stitchQueue(maxInFlight, &signal);
+    BoundedQueue<Batch*> doneQueue(maxInFlight, &signal);
+    BoundedQueue<GapRef> gapQueue(GAP_QUEUE_SIZE, &signal);
+    std::atomic<bool> isFinished(false);
+
+    auto finishGap = [&](Batch* pBatch)
+    {
+        if(pBatch->numPending.fetch_sub(1) == 1)
+            signal.retry([&]() { return stitchQueue.tryPush(pBatch); });
+    };
+
+    auto fillGap = [&](Processor* pProcessor) -> bool
+    {
+        GapRef ref;
+        if(!gapQueue.tryPop(ref))
+            return false;
+        pProcessor->fillGap(*ref.pState, *ref.pTask);
+        finishGap(ref.pBatch);
+        return true;
+    };
+
+    auto seedBatch = [&](Processor* pProcessor) -> bool
+    {
+        Batch* pBatch;
+        if(!seedQueue.tryPop(pBatch))
+            return false;
+
+        size_t numTasks = 0;
+        for(size_t i = 0; i < pBatch->inputs.size(); ++i)
+        {
+            pProcessor->seed(pBatch->inputs[i], pBatch->states[i]);
+            numTasks += pBatch->states[i].gapTasks.size();
+        }
+
+        // A full gap queue is drained by this thread as well
+        pBatch->numPending.store(numTasks + 1);
+        for(auto& state : pBatch->states)
+        {
+            for(auto& task : state.gapTasks)
+            {
+                GapRef ref = {pBatch, &state, &task};
+                signal.retry([&]() { return gapQueue.tryPush(ref) || (fillGap(pProcessor) && gapQueue.tryPush(ref)); });
+            }
+        }
+        finishGap(pBatch);
+        return true;
+    };
+
+    auto stitchBatch = [&](Processor* pProcessor) -> bool
+    {
+        Batch* pBatch;
+        if(!stitchQueue.tryPop(pBatch))
+            return false;
+
+        for(size_t i = 0; i < pBatch->inputs.size(); ++i)
+            pBatch->outputs[i] = pProcessor->stitch(pBatch->inputs[i], pBatch->states[i]);
+        pBatch->states.clear();
+        signal.retry([&]() { return doneQueue.tryPush(pBatch); });
+        return true;
+    };
+
+    // Do one unit of work, false if there was none
+    auto work = [&](size_t tid) -> bool
+    {
+        Processor* pProcessor = pProcessorVec[tid];
+        if(stitchBatch(pProcessor))
+            return true;
+
+        bool preferSeed = numSeedThreads > 0 ? tid < numSeedThreads : gapQueue.sizeApprox() < gapQueue.capacity() / 2;
+        if(preferSeed)
+            return seedBatch(pProcessor) || fillGap(pProcessor);
+        return fillGap(pProcessor) || seedBatch(pProcessor);
+    };
+
+    auto runMaster = [&]()
+    {
+        std::map<size_t, Batch*> finishedBatches;
+        size_t numBatches = 0;
+        size_t nextBatch = 0;
+        size_t numInFlight = 0;
+        bool isInputDone = false;
+
+        // Do one round of the master's work, false if there was none
+        auto step = [&]() -> bool
+        {
+            bool isBusy = false;
+
+            // Post-process the finished batches in input order
+            Batch* pBatch;
+            while(doneQueue.tryPop(pBatch))
+                finishedBatches[pBatch->index] = pBatch;
+            while(!finishedBatches.empty() && finishedBatches.begin()->first == nextBatch)
+            {
+                pBatch = finishedBatches.begin()->second;
+                for(size_t i = 0; i < pBatch->inputs.size(); ++i)
+                    pPostProcessor->process(pBatch->inputs[i], pBatch->outputs[i]);
+                finishedBatches.erase(finishedBatches.begin());
+                delete pBatch;
+                ++nextBatch;
+                --numInFlight;
+                isBusy = true;
+            }
+
+            if(!isInputDone && numInFlight < maxInFlight)
+            {
+                pBatch = new Batch;
+                pBatch->index = numBatches;
+                pBatch->inputs.reserve(batchSize);
+                while(pBatch->inputs.size() < batchSize)
+                {
+                    Input workItem;
+                    if(generator.getNumConsumed() == n || !generator.generate(workItem))
+                    {
+                        isInputDone = true;
+                        break;
+                    }
+                    pBatch->inputs.push_back(workItem);
+                }
+
+                if(pBatch->inputs.empty())
+                    delete pBatch;
+                else
+                {
+                    pBatch->states.resize(pBatch->inputs.size());
+                    pBatch->outputs.resize(pBatch->inputs.size());
+                    signal.retry([&]() { return seedQueue.tryPush(pBatch); });
+                    ++numBatches;
+                    ++numInFlight;
+                }
+                isBusy = true;
+            }
+
+            return work(0) || isBusy;
+        };
+
+        while(!isInputDone || numInFlight > 0)
+            signal.retry([&]() { return step() || (isInputDone && numInFlight == 0); });
+        isFinished.store(true);
+        signal.notifyAll();
+    };
+
+#if HAVE_OPENMP
+    #pragma omp parallel num_threads(numThreads)
+    {
+        size_t tid = omp_get_thread_num();
+        if(tid == 0)
+            runMaster();
+        else
+        {
+            while(!isFinished.load())
+                signal.retry([&]() { return work(tid) || isFinished.load(); });
+        }
+    }
+#else
+    runMaster();
+#endif
+
+    assert(n == (size_t)-1 || generator.getNumConsumed() == n);
+
+    double proc_time_secs = timer.getElapsedWallTime();
+    fprintf(stderr, "Processed %zu sequences in %lfs (%lf sequences/s)\n",
+            generator.getNumConsumed(), proc_time_secs, (double)generator.getNumConsumed() / proc_time_secs);
+
+    return generator.getNumConsumed();
+}
+
+// Wrapper function for processing a file of sequences in pipelined stages
+template<class Input, class Output, class Processor, class PostProcessor>
+size_t processSequencesPipelined(const std::string& readsFile, std::vector<Processor*>& pProcessorVec, PostProcessor* pPostProcessor,
+                                 size_t batchSize, size_t numSeedThreads)
+{
+    SeqReader reader(readsFile);
+    WorkItemGenerator<Input> generator(&reader);
+    return processWorkPipelined<Input,
+                                Output,
+                                WorkItemGenerator<Input>,
+                                Processor,
+                                PostProcessor>(generator, pProcessorVec, pPostProcessor, batchSize, numSeedThreads);
+}
+
 //Wrapper function to operate on single/multi threads.
 //Processor & PostProcessor should only accept Parameter as single argument
 //Noted by KuanWeiLee. 2018/4/30
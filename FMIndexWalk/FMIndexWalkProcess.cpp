@@ -10,11 +10,151 @@
 #include "CorrectionThresholds.h"
 #include "HashMap.h"
 #include <iomanip>
+#include <limits>
+#include <algorithm>
 #include "SAIntervalTree.h"
 
 
 //#define KMER_TESTING 1
 
+// Count the occurrences of every k-mer of s, on the strand of s or summed over both strands.
+// A k-mer is searched from its last base towards its first. The frequency
+// can only drop as the searched string grows, so once it falls below the
+// threshold at base q it bounds every k-mer starting in [i, q] as well.
+// Without a threshold this happens when the string is absent (frequency 0).
+// With a threshold, the interval of a solid k-mer is extended to the right.
+// The frequency of the longer string is a lower bound for the k-mer ending
+// at the same base, and that k-mer is only searched again once the bound
+// falls below the threshold.
+static void computeKmerFrequencies(const std::string& s, size_t k, size_t threshold, const BWTIndexSet& index, bool bothStrands, size_t* freqs)
+{
+	size_t numKmer = s.length() - k + 1;
+	bool extend = threshold != std::numeric_limits<size_t>::max() && index.pRBWT != NULL;
+	bool usePairs = extend || bothStrands;
+	size_t minFreq = extend ? threshold : 1;
+
+	// The reverse complement is searched in the opposite direction
+	BWTIntervalPair same, revc;
+	bool hasWindow = false;
+	size_t windowStart = 0;
+	size_t i = 0;
+	while(i < numKmer)
+	{
+		size_t freq;
+		if(!hasWindow)
+		{
+			size_t q = i + k - 1;
+			if(usePairs)
+			{
+				BWTAlgorithms::initIntervalPair(same, s[q], index.pBWT, index.pRBWT);
+				if(bothStrands)
+					BWTAlgorithms::initIntervalPair(revc, complement(s[q]), index.pBWT, index.pRBWT);
+			}
+			else
+			{
+				BWTAlgorithms::initInterval(same.interval[0], s[q], index.pBWT);
+			}
+
+			freq = same.interval[0].getFreq() + (bothStrands ? revc.interval[0].getFreq() : 0);
+			while(freq >= minFreq && q > i)
+			{
+				--q;
+				if(usePairs)
+				{
+					BWTAlgorithms::updateBothL(same, s[q], index.pBWT);
+					if(bothStrands)
+						BWTAlgorithms::updateBothR(revc, complement(s[q]), index.pRBWT);
+				}
+				else
+				{
+					BWTAlgorithms::updateInterval(same.interval[0], s[q], index.pBWT);
+				}
+				freq = same.interval[0].getFreq() + (bothStrands ? revc.interval[0].getFreq() : 0);
+			}
+
+			if(freq < minFreq)
+			{
+				for(; i <= q && i < numKmer; ++i)
+					freqs[i] = freq;
+				continue;
+			}
+			windowStart = i;
+			hasWindow = true;
+		}
+
+		freq = same.interval[0].getFreq() + (bothStrands ? revc.interval[0].getFreq() : 0);
+		if(windowStart < i && freq < threshold)
+		{
+			// The bound is inconclusive, count the k-mer itself
+			hasWindow = false;
+			continue;
+		}
+
+		freqs[i] = freq;
+		if(!extend || i + 1 == numKmer)
+		{
+			hasWindow = false;
+		}
+		else
+		{
+			BWTAlgorithms::updateBothR(same, s[i + k], index.pRBWT);
+			if(bothStrands)
+				BWTAlgorithms::updateBothL(revc, complement(s[i + k]), index.pBWT);
+		}
+		++i;
+	}
+}
+
+//
+KmerContext::KmerContext(const std::string& seq, size_t kl, const BWTIndexSet& index) : kmerLength(0), readLength(0), numKmer(0)
+{
+	if(seq.length() >= kl)
+	{
+		readSeq = seq;
+		kmerLength = kl;
+		computeFrequencies(index, std::numeric_limits<size_t>::max());
+	}
+}
+
+//
+KmerContext::KmerContext(const std::string& seq, size_t kl, const BWTIndexSet& index, size_t threshold) : kmerLength(0), readLength(0), numKmer(0)
+{
+	if(seq.length() >= kl)
+	{
+		readSeq = seq;
+		kmerLength = kl;
+		computeFrequencies(index, threshold);
+	}
+}
+
+//
+KmerContext::KmerContext(const KmerContext& origin, int head, int tail)
+{
+	assert (head>=0 && tail>=0 && head<=tail) ;
+	kmerLength = origin.kmerLength;
+	readSeq= origin.readSeq.substr(head,tail-head+kmerLength);
+	readLength = readSeq.length();
+	kmerFreqs_same.assign (origin.kmerFreqs_same.begin()+head , origin.kmerFreqs_same.begin()+tail+1);
+	kmerFreqs_revc.assign (origin.kmerFreqs_revc.begin()+head , origin.kmerFreqs_revc.begin()+tail+1);
+
+	assert (kmerFreqs_same.size() == kmerFreqs_revc.size());
+	assert (readLength-kmerLength+1 == kmerFreqs_same.size());
+	numKmer = kmerFreqs_same.size();
+}
+
+// K-mer i of the read is k-mer numKmer-1-i of its reverse complement
+void KmerContext::computeFrequencies(const BWTIndexSet& index, size_t threshold)
+{
+	readLength = readSeq.length();
+	numKmer = readLength - kmerLength + 1;
+	kmerFreqs_same.resize(numKmer);
+	kmerFreqs_revc.resize(numKmer);
+
+	computeKmerFrequencies(readSeq, kmerLength, threshold, index, false, &kmerFreqs_same[0]);
+	computeKmerFrequencies(reverseComplement(readSeq), kmerLength, threshold, index, false, &kmerFreqs_revc[0]);
+	std::reverse(kmerFreqs_revc.begin(), kmerFreqs_revc.end());
+}
+
 
 FMIndexWalkProcess::FMIndexWalkProcess(const FMIndexWalkParameters params) : m_params(params)
 {
@@ -106,8 +246,8 @@ FMIndexWalkResult FMIndexWalkProcess::MergeAndKmerize(const SequenceWorkItemPair
 	
 	/** Case 3: kmerize the remaining reads **/
 	//Compute kmer freq of each kmer
-	KmerContext seqFirstKC(seqFirst, kmerLength, m_params.indices);
-	KmerContext seqSecondKC(seqSecond, kmerLength, m_params.indices);
+	KmerContext seqFirstKC(seqFirst, kmerLength, m_params.indices, threshold);
+	KmerContext seqSecondKC(seqSecond, kmerLength, m_params.indices, threshold);
 
 	std::vector<std::string> firstKR ;
 	std::vector<std::string> secondKR ;
@@ -241,7 +381,7 @@ FMIndexWalkResult FMIndexWalkProcess::KmerizeReads(const SequenceWorkItem& workI
 	// seqFirst = trimRead(seqFirst, m_params.kmerLength, threshold, m_params.indices);
 	
 	//Compute kmer freq of each kmer
-	KmerContext seqFirstKC(seqFirst, kmerLength, m_params.indices);
+	KmerContext seqFirstKC(seqFirst, kmerLength, m_params.indices, threshold);
 
 	std::vector<std::string> firstKR ;
 	int firstMainIdx=-1;
@@ -575,7 +715,7 @@ int FMIndexWalkProcess::splitRead (KmerContext& seq, std::vector<std::string> &
 		if (countQualified[p-1]==2 && countQualified[p]==2) continue;
 		
 		//kmerize read at pos p if the path is not simple
-		if ( !isSimple(seq.kmers[p-1], seq.kmers[p], index, 1) )
+		if ( !isSimple(seq.getKmer(p-1), seq.getKmer(p), index, 1) )
 		{
 			intervals.push_back(std::make_pair (start,p-1));
 			start =p;
@@ -614,74 +754,14 @@ int FMIndexWalkProcess::splitRead (std::string& seq, std::vector<std::string> &
 {
 	if ((int)seq.length()<m_params.kmerLength) return -1 ;
 
-	std::vector<size_t> countQualified (seq.length()-m_params.kmerLength+1,0);
-	std::string startingKmer=seq.substr(0,m_params.kmerLength);
-	BWTInterval fwdInterval = BWTAlgorithms::findInterval(index.pRBWT, reverse(startingKmer));
-	BWTInterval rvcInterval = BWTAlgorithms::findInterval(index.pBWT, reverseComplement(startingKmer));
-	
-	size_t currKmerSize=m_params.kmerLength;
-	size_t currKmerFreq=0;
-	currKmerFreq += fwdInterval.isValid()?fwdInterval.size():0;
-	currKmerFreq += rvcInterval.isValid()?rvcInterval.size():0;
+	// A kmer qualifies if it is seen at least threshold times on both strands together
+	size_t numKmer = seq.length()-m_params.kmerLength+1;
+	std::vector<size_t> kmerFreqs (numKmer);
+	computeKmerFrequencies(seq, m_params.kmerLength, threshold, index, true, &kmerFreqs[0]);
 
-	for (size_t i=0 ;i<=seq.length()-m_params.kmerLength;i++)
-	{
-		if(currKmerFreq >= threshold)
-		{
-			countQualified[i]++;
-			
-			if(i<seq.length()-m_params.kmerLength)
-			{
-				char b = seq.at(i+m_params.kmerLength);
-				if(fwdInterval.isValid())
-					BWTAlgorithms::updateInterval(fwdInterval, b, index.pRBWT);
-					
-				if(rvcInterval.isValid())
-					BWTAlgorithms::updateInterval(rvcInterval, complement(b), index.pBWT);
-
-				currKmerSize++;
-				currKmerFreq = 0;
-				currKmerFreq += fwdInterval.isValid()?fwdInterval.size():0;
-				currKmerFreq += rvcInterval.isValid()?rvcInterval.size():0;
-			}
-			continue;
-		}
-		// unsatisfied due to too large kmer
-		else if((int)currKmerSize > m_params.kmerLength && currKmerFreq<threshold) 
-		{
-			// Recompute BWTInterval
-			std::string newKmer = seq.substr(i, m_params.kmerLength);
-			fwdInterval = BWTAlgorithms::findInterval(index.pRBWT, reverse(newKmer));
-			rvcInterval = BWTAlgorithms::findInterval(index.pBWT, reverseComplement(newKmer));
-
-			currKmerSize = m_params.kmerLength;
-			currKmerFreq = 0;
-			currKmerFreq += fwdInterval.isValid()?fwdInterval.size():0;
-			currKmerFreq += rvcInterval.isValid()?rvcInterval.size():0;
-			
-			// Rerun this iteration using the new kmer
-			i--;
-			continue;
-		}
-		// Bad kmer at i, continue to i++
-		else if((int)currKmerSize == m_params.kmerLength && currKmerFreq<threshold)
-		{
-			if(i<seq.length()-m_params.kmerLength) 
-			{
-				// Recompute BWTInterval for next i
-				std::string newKmer = seq.substr(i+1, m_params.kmerLength);
-				fwdInterval = BWTAlgorithms::findInterval(index.pRBWT, reverse(newKmer));
-				rvcInterval = BWTAlgorithms::findInterval(index.pBWT, reverseComplement(newKmer));
-
-				currKmerSize = m_params.kmerLength;
-				currKmerFreq = 0;
-				currKmerFreq += fwdInterval.isValid()?fwdInterval.size():0;
-				currKmerFreq += rvcInterval.isValid()?rvcInterval.size():0;			
-			}
-		}
-		else
-			assert(false);
-	}
+	std::vector<size_t> countQualified (numKmer,0);
+	for (size_t i=0 ;i<numKmer;i++)
+		if (kmerFreqs[i] >= threshold) countQualified[i]++;
 	
 
 	//Split the reads into intervals
@@ -852,28 +932,68 @@ std::string FMIndexWalkProcess::trimRead( std::string readSeq, size_t kmerLength
 
 
 
-size_t FMIndexWalkProcess::numNextKmer(std::string kmer , NextKmerDir dir ,BWTIndexSet & index, size_t threshold)
+// Count the bases b for which the k-mer shifted by one base, b + kmer[0, k-1) or kmer[1, k) + b,
+// occurs at least threshold times on both strands
+size_t FMIndexWalkProcess::numNextKmer(const std::string& kmer , NextKmerDir dir ,BWTIndexSet & index, size_t threshold)
 {
-	size_t num = 0 ;
-	char nBases[4] = {'A','T','C','G'} ;
 	int kmerLength = kmer.length() ;
+	assert(kmerLength >= 2);
+
+	size_t numLeft = 0, numRight = 0;
+	if (dir == NK_START)
+		countNextBases(kmer.substr(0,kmerLength-1), index, threshold, numLeft, numRight);
+	else if (dir == NK_END)
+		countNextBases(kmer.substr(1,kmerLength-1), index, threshold, numLeft, numRight);
+	return dir == NK_START ? numLeft : numRight ;
+}
 
+// Count the bases b for which b + w (numLeft) and w + b (numRight) occur at least threshold
+// times on both strands. The counts of all eight extensions are read from the interval pairs
+// of w and its reverse complement instead of searching each extended string.
+void FMIndexWalkProcess::countNextBases(const std::string& w, BWTIndexSet & index, size_t threshold, size_t& numLeft, size_t& numRight)
+{
+	AlphaCount64 sameLeft, sameRight, revcLeft, revcRight;
+	BWTIntervalPair same = BWTAlgorithms::findIntervalPair(index.pBWT, index.pRBWT, w);
+	if (same.isValid())
+	{
+		sameLeft = BWTAlgorithms::getExtCount(same.interval[0], index.pBWT);
+		sameRight = BWTAlgorithms::getExtCount(same.interval[1], index.pRBWT);
+	}
+
+	BWTIntervalPair revc = BWTAlgorithms::findIntervalPair(index.pBWT, index.pRBWT, reverseComplement(w));
+	if (revc.isValid())
+	{
+		revcLeft = BWTAlgorithms::getExtCount(revc.interval[0], index.pBWT);
+		revcRight = BWTAlgorithms::getExtCount(revc.interval[1], index.pRBWT);
+	}
+
+	// The reverse complement of b + w is rc(w) + comp(b), and that of w + b is comp(b) + rc(w)
+	numLeft = numRight = 0;
+	char nBases[4] = {'A','T','C','G'} ;
 	for (size_t i = 0 ; i < 4 ; i++)
 	{
-		std::string next_mer;
-		if (dir == NK_START) next_mer = nBases[i] + kmer.substr(0,kmerLength-1);
-		else if  (dir == NK_END) next_mer = kmer.substr(1,kmerLength-1) + nBases[i];
-
-		if ( BWTAlgorithms::countSequenceOccurrences(next_mer,index) >= threshold) num++;
+		char b = nBases[i];
+		if (sameLeft.get(b) + revcRight.get(complement(b)) >= threshold) numLeft++;
+		if (sameRight.get(b) + revcLeft.get(complement(b)) >= threshold) numRight++;
 	}
-	return num ;
 }
 
 
-bool FMIndexWalkProcess::isSimple (std::string Lkmer, std::string Rkmer, BWTIndexSet & index, size_t threshold)
+bool FMIndexWalkProcess::isSimple (const std::string& Lkmer, const std::string& Rkmer, BWTIndexSet & index, size_t threshold)
 {
-	size_t LKmerPathCount = numNextKmer(Lkmer, NK_END, index, threshold);
-	size_t RKmerPathCount = numNextKmer(Rkmer, NK_START, index, threshold);
+	size_t LKmerPathCount, RKmerPathCount;
+
+	// Adjacent kmers of a read share k-1 bases, whose intervals give the paths of both kmers
+	size_t k = Lkmer.length();
+	if (k >= 2 && Rkmer.length() == k && Lkmer.compare(1, k-1, Rkmer, 0, k-1) == 0)
+	{
+		countNextBases(Rkmer.substr(0, k-1), index, threshold, RKmerPathCount, LKmerPathCount);
+	}
+	else
+	{
+		LKmerPathCount = numNextKmer(Lkmer, NK_END, index, threshold);
+		RKmerPathCount = numNextKmer(Rkmer, NK_START, index, threshold);
+	}
 
 	if ( LKmerPathCount == 1 &&   RKmerPathCount == 1 )  
 		return true;
@@ -58,6 +58,9 @@ struct FMIndexWalkParameters
 };
 
 
+// KmerContext - The frequency of every k-mer of a read on both strands.
+// Only the read and the frequencies are stored, k-mer i is the substring
+// of readSeq starting at i and can be materialized with getKmer(i).
 struct KmerContext
 {
 public:
@@ -70,63 +73,33 @@ public:
 		numKmer=0;
 	}
 
-	//originalSeq
-	KmerContext(std::string seq,size_t kl, BWTIndexSet & index)
-	{
-		if( seq.length() >= kl)
-		{
-			readSeq = seq ;
-			readLength = readSeq.length();
-			kmerLength = kl ;
-			numKmer = readLength-kmerLength+1 ;
-			kmers.resize(numKmer);
-			kmerFreqs_same.resize(numKmer);
-			kmerFreqs_revc.resize(numKmer);
-
-			for (size_t i = 0 ; i < numKmer  ; i++)
-			{
-				kmers[i] = readSeq.substr (i,kmerLength);
-				kmerFreqs_same[i] = BWTAlgorithms::countSequenceOccurrencesSingleStrand(kmers[i], index) ;
-				kmerFreqs_revc[i] = BWTAlgorithms::countSequenceOccurrencesSingleStrand(reverseComplement(kmers[i]), index) ;
-			}
-		}
-		else
-		{
-			kmerLength=0;
-			readLength=0;
-			numKmer=0;
-		}
-	}
+	//originalSeq, the frequencies are exact
+	KmerContext(const std::string& seq, size_t kl, const BWTIndexSet& index);
+
+	//originalSeq, the frequencies are bounds on the correct side of threshold:
+	//lower bounds for solid k-mers and upper bounds for the others, so only a
+	//comparison with threshold is exact. Solid stretches of the read are counted
+	//by extending a single interval and weak stretches are skipped as soon as a
+	//weak substring is found, instead of searching every k-mer
+	KmerContext(const std::string& seq, size_t kl, const BWTIndexSet& index, size_t threshold);
 
 	//subSeq
-	KmerContext( KmerContext origin , int head , int tail)
-	{
-		assert (head>=0 && tail>=0 && head<=tail) ;
-		kmerLength = origin.kmerLength;
-		readSeq= origin.readSeq.substr(head,tail-head+kmerLength);
-		readLength = readSeq.length();
-		kmers.assign (origin.kmers.begin()+head,origin.kmers.begin()+tail+1);
-		kmerFreqs_same.assign (origin.kmerFreqs_same.begin()+head , origin.kmerFreqs_same.begin()+tail+1);
-		kmerFreqs_revc.assign (origin.kmerFreqs_revc.begin()+head , origin.kmerFreqs_revc.begin()+tail+1);
-
-		assert (kmers.size() == kmerFreqs_same.size());
-		assert (kmers.size() == kmerFreqs_revc.size());
-		assert (readLength-kmerLength+1 == kmers.size());
-		numKmer = kmers.size();
-	}
+	KmerContext(const KmerContext& origin, int head, int tail);
 
+	std::string getKmer(size_t i) const { return readSeq.substr(i, kmerLength); }
 
 	std::string readSeq;
 	size_t kmerLength;
 
 	size_t readLength;
 	size_t numKmer ;
-	std::vector<std::string> kmers;
 	std::vector<size_t> kmerFreqs_same;
 	std::vector<size_t> kmerFreqs_revc;
 
 	bool empty(){ return readSeq.empty() ;}
 
+private:
+	void computeFrequencies(const BWTIndexSet& index, size_t threshold);
 };
 
 class FMIndexWalkResult
@@ -223,8 +196,9 @@ private:
 	
 	std::string getReliableInterval(std::string& seq, KmerContext& kc);
 
-	size_t numNextKmer(std::string kmer , NextKmerDir dir ,BWTIndexSet & index, size_t threshold);
-	bool isSimple (std::string Lkmer, std::string Rkmer, BWTIndexSet & index, size_t threshold) ;
+	size_t numNextKmer(const std::string& kmer , NextKmerDir dir ,BWTIndexSet & index, size_t threshold);
+	void countNextBases(const std::string& w, BWTIndexSet & index, size_t threshold, size_t& numLeft, size_t& numRight);
+	bool isSimple (const std::string& Lkmer, const std::string& Rkmer, BWTIndexSet & index, size_t threshold) ;
 
 	bool existStrongLink (std::string Lkmer,std::string Rkmer,BWTIndexSet & index,size_t threshold) ;
 	bool existNextStrongKmer(std::string kmer , NextKmerDir dir ,BWTIndexSet & index,size_t threshold) ;
@@ -244,9 +218,9 @@ private:
 	// , size_t firstK , size_t secondK);
 
 
-	int getMainSeed (KmerContext seq, std::vector<KmerContext> & kmerReads ,size_t threshold,BWTIndexSet & index);
+	int getMainSeed (const KmerContext& seq, std::vector<KmerContext> & kmerReads ,size_t threshold,BWTIndexSet & index);
 	//split read to kmers
-	std::vector<size_t> splitRead( KmerContext seq ,size_t threshold ,BWTIndexSet & index ,size_t singleThreshld =0 );
+	std::vector<size_t> splitRead( const KmerContext& seq ,size_t threshold ,BWTIndexSet & index ,size_t singleThreshld =0 );
 
 	bool  isLowComplexity (std::string seq , float & GCratio);
 	size_t maxCon (std::string s);
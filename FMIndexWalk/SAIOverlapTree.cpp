@@ -147,10 +147,19 @@ void SAIOverlapTree::printAll()
 
 void SAIOverlapTree::attempToExtend(SONodePtrList &newLeaves)
 {
+    // The rank queries of the leaves are independent, prefetch all of them first
+    for(SONodePtrList::iterator iter = m_leaves.begin(); iter != m_leaves.end(); ++iter)
+        BWTAlgorithms::prefetchInterval((*iter)->currIntervalPair.interval[0], m_pBWT);
+
     for(SONodePtrList::iterator iter = m_leaves.begin(); iter != m_leaves.end(); ++iter)
     {
+        // The counts at the ends of the interval serve all four extensions
+        const BWTInterval& interval = (*iter)->currIntervalPair.interval[0];
+        AlphaCount64 l = m_pBWT->getFullOcc(interval.lower - 1);
+        AlphaCount64 u = m_pBWT->getFullOcc(interval.upper);
+
         std::vector< std::pair<std::string, BWTIntervalPair> > extensions;
-        extensions = getLeftFMIndexExtensions(*iter);
+        extensions = getLeftFMIndexExtensions(*iter, l, u);
 
         // Either extend the current node or branch it
         // If no extension, do nothing and this node
@@ -392,7 +401,7 @@ double SAIOverlapTree::computeErrorRate(SAIOverlapNode* currNode)
 }
 			
 //update SA intervals of each leaf, which corresponds to one-base extension
-std::vector<std::pair<std::string, BWTIntervalPair> > SAIOverlapTree::getLeftFMIndexExtensions(SAIOverlapNode* pNode)
+std::vector<std::pair<std::string, BWTIntervalPair> > SAIOverlapTree::getLeftFMIndexExtensions(SAIOverlapNode* pNode, AlphaCount64& l, AlphaCount64& u)
 {
     std::vector<std::pair<std::string, BWTIntervalPair> > out;
 
@@ -402,7 +411,7 @@ std::vector<std::pair<std::string, BWTIntervalPair> > SAIOverlapTree::getLeftFMI
 
         //update IntervalPair using extension b
         BWTIntervalPair probe=pNode->currIntervalPair;
-        BWTAlgorithms::updateBothL(probe, b, m_pBWT);
+        BWTAlgorithms::updateBothL(probe, b, m_pBWT, l, u);
 			
 		//min freq at fwd and rvc bwt
         if(probe.isValid())
@@ -448,6 +457,11 @@ bool SAIOverlapTree::isTerminated(std::vector<OverlapBlock>& results)
 {
 	bool found=false;
 	SONodePtrList newLeaves;
+
+	// Prefetch the rank queries of all leaves before the first one is read
+	for(SONodePtrList::iterator iter = m_leaves.begin(); iter != m_leaves.end(); ++iter)
+		BWTAlgorithms::prefetchInterval((*iter)->currIntervalPair.interval[0], m_pBWT);
+
     for(SONodePtrList::iterator iter = m_leaves.begin(); iter != m_leaves.end(); ++iter)
     {
 		// Calculate which of the prefixes that match w[i, l] are terminal
@@ -66,7 +66,8 @@ class SAIOverlapTree
 
         void attempToExtend(SONodePtrList &newLeaves);
 
-        std::vector<std::pair<std::string, BWTIntervalPair> > getLeftFMIndexExtensions(SAIOverlapNode* pNode);
+        // l and u are the full occurrence counts at the ends of the interval of pNode
+        std::vector<std::pair<std::string, BWTIntervalPair> > getLeftFMIndexExtensions(SAIOverlapNode* pNode, AlphaCount64& l, AlphaCount64& u);
         std::vector<std::pair<std::string, BWTIntervalPair> > getRightFMIndexExtensions(SAIOverlapNode* pNode);
 
 		// prone the leaves without seeds in proximity
@@ -0,0 +1,82 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// GapDifficultyPredictor - Decide up front whether the gap between
+// two seeds is worth an FM-index walk
+//
+#include <iostream>
+#include <algorithm>
+#include "GapDifficultyPredictor.h"
+
+GapDifficultyPredictor::GapDifficultyPredictor(int PBcoverage, double minSuccessRate, size_t minSamples, size_t explorePeriod)
+:	m_PBcoverage(std::max(PBcoverage, 1)),
+	m_minSuccessRate(minSuccessRate),
+	m_minSamples(minSamples),
+	m_explorePeriod(std::max(explorePeriod, (size_t)1)),
+	m_pClasses(new GapClass[NUM_CLASSES]){ }
+
+bool GapDifficultyPredictor::isFailing(const SeedFeature& source, const SeedFeature& target) const
+{
+	const GapClass& c = m_pClasses[getClass(source, target)];
+	uint32_t numTried = c.numTried.load(std::memory_order_relaxed);
+	uint32_t numBridged = c.numBridged.load(std::memory_order_relaxed);
+	return numTried >= m_minSamples && numBridged < m_minSuccessRate * numTried;
+}
+
+// Walk a few gaps of a failing class anyway, its rate may recover
+bool GapDifficultyPredictor::isExploring(const SeedFeature& source, const SeedFeature& target) const
+{
+	const GapClass& c = m_pClasses[getClass(source, target)];
+	return (c.numFailing.load(std::memory_order_relaxed) + 1) % m_explorePeriod == 0;
+}
+
+void GapDifficultyPredictor::record(const SeedFeature& source, const SeedFeature& target, bool isSuccess)
+{
+	GapClass& c = m_pClasses[getClass(source, target)];
+	c.numTried.fetch_add(1, std::memory_order_relaxed);
+	if(isSuccess)
+		c.numBridged.fetch_add(1, std::memory_order_relaxed);
+}
+
+void GapDifficultyPredictor::recordFailing(const SeedFeature& source, const SeedFeature& target)
+{
+	m_pClasses[getClass(source, target)].numFailing.fetch_add(1, std::memory_order_relaxed);
+}
+
+//Gap length in bins doubling from 50bp, repeat flags of the two seeds, the lower frequency of the
+//two flanking kmers and the higher fixed-mer frequency of the two seeds, both relative to the coverage
+size_t GapDifficultyPredictor::getClass(const SeedFeature& source, const SeedFeature& target) const
+{
+	int interval = target.seedStartPos - source.seedEndPos - 1;
+	size_t lengthBin = 0;
+	for(int bound = 50; lengthBin + 1 < NUM_LENGTH_BINS && interval >= bound; bound <<= 1)
+		lengthBin++;
+
+	size_t repeatBin = (size_t)source.isRepeat + (size_t)target.isRepeat;
+
+	double flankFreq = (double)std::min(source.endKmerFreq, target.startKmerFreq)/m_PBcoverage;
+	size_t flankBin = flankFreq < 0.1 ? 0 : flankFreq < 0.2 ? 1 : flankFreq < 0.4 ? 2 : 3;
+
+	double fixedMerFreq = (double)std::max(source.maxFixedMerFreq, target.maxFixedMerFreq)/m_PBcoverage;
+	size_t fixedMerBin = fixedMerFreq < 0.5 ? 0 : fixedMerFreq < 1.5 ? 1 : 2;
+
+	return ((lengthBin * NUM_REPEAT_BINS + repeatBin) * NUM_FLANK_BINS + flankBin) * NUM_FIXEDMER_BINS + fixedMerBin;
+}
+
+void GapDifficultyPredictor::printInfo() const
+{
+	uint64_t numTried = 0, numBridged = 0, numSkipped = 0, numFailing = 0;
+	for(size_t i = 0; i < NUM_CLASSES; i++)
+	{
+		const GapClass& c = m_pClasses[i];
+		uint32_t tried = c.numTried.load(), bridged = c.numBridged.load();
+		numTried += tried;
+		numBridged += bridged;
+		numSkipped += c.numFailing.load() - c.numFailing.load()/m_explorePeriod;
+		numFailing += tried >= m_minSamples && bridged < m_minSuccessRate * tried;
+	}
+	std::cout << "Gap predictor: " << numBridged << " of " << numTried << " FM walks bridged, "
+	          << numSkipped << " gaps sent to DP, " << numFailing << " of " << NUM_CLASSES << " classes failing\n";
+}
@@ -0,0 +1,70 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// GapDifficultyPredictor - Decide up front whether the gap between
+// two seeds is worth an FM-index walk or should go straight to the
+// multiple alignment. Gaps are classified by their length, the
+// repeat flags of the flanking seeds, the frequency of the flanking
+// k-mers and the fixed-mer frequency of the seeds. The success rate
+// of the walk in every class is learned from the walks tried so far,
+// a class whose rate falls below the minimum is predicted to fail.
+// The queries do not change the predictor, the outcomes of a gap are
+// recorded only once the correction uses it.
+//
+#ifndef GAPDIFFICULTYPREDICTOR_H
+#define GAPDIFFICULTYPREDICTOR_H
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include "SeedFeature.h"
+
+class GapDifficultyPredictor
+{
+	public:
+		// A class is judged after minSamples walks; one in explorePeriod
+		// gaps of a failing class is still walked to follow its rate
+		GapDifficultyPredictor(int PBcoverage, double minSuccessRate = 0.2, size_t minSamples = 32, size_t explorePeriod = 16);
+
+		// Whether the FM-index walks of the class of the gap from source to target mostly fail
+		bool isFailing(const SeedFeature& source, const SeedFeature& target) const;
+
+		// Whether the next failing gap of the class is walked anyway
+		bool isExploring(const SeedFeature& source, const SeedFeature& target) const;
+
+		// Learn the outcome of a walk from source to target
+		void record(const SeedFeature& source, const SeedFeature& target, bool isSuccess);
+
+		// Count a gap of a failing class, walked or not
+		void recordFailing(const SeedFeature& source, const SeedFeature& target);
+
+		void printInfo() const;
+
+	private:
+		size_t getClass(const SeedFeature& source, const SeedFeature& target) const;
+
+		static const size_t NUM_LENGTH_BINS = 6;
+		static const size_t NUM_REPEAT_BINS = 3;
+		static const size_t NUM_FLANK_BINS = 4;
+		static const size_t NUM_FIXEDMER_BINS = 3;
+		static const size_t NUM_CLASSES = NUM_LENGTH_BINS * NUM_REPEAT_BINS * NUM_FLANK_BINS * NUM_FIXEDMER_BINS;
+
+		// The counters are shared by all threads
+		struct GapClass
+		{
+			GapClass() : numTried(0), numBridged(0), numFailing(0) { }
+			std::atomic<uint32_t> numTried;
+			std::atomic<uint32_t> numBridged;
+			std::atomic<uint32_t> numFailing;
+		};
+
+		int m_PBcoverage;
+		double m_minSuccessRate;
+		size_t m_minSamples;
+		size_t m_explorePeriod;
+		std::unique_ptr<GapClass[]> m_pClasses;
+};
+
+#endif
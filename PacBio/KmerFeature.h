@@ -21,12 +21,6 @@ ex: On position 14, 4-mer is established first, and 6-mer is established on 4-me
 class KmerFeature
 {
 	public:
-		inline static std::map<int ,std::unique_ptr<KmerFeature[]> >& Log()
-		{
-			static thread_local std::map<int, std::unique_ptr<KmerFeature[]> > log;
-			return log;
-		}
-	
 		KmerFeature(void) = default;
 		~KmerFeature(void) = default;
 		
@@ -115,17 +109,30 @@ class KmerFeature
 		
 		inline bool isLowComplexity(float m = 0.7, float d = 0.9) const
 		{
-			const int* orig = this->count.get();
-			int* copy = new int[4];
+			return isLowComplexity(this->count.get(), this->size, m, d);
+		}
+		
+		//Same test for the (at most) len bases of seq from pos, without building the kmer.
+		inline static bool isLowComplexity(const std::string& seq, size_t pos, int len, float m = 0.7, float d = 0.9)
+		{
+			int count[DNA_ALPHABET::size] = {0};
+			int size = std::min((size_t)len, seq.length() - pos);
+			for(int i = 0; i < size; i++)
+				count[DNA_ALPHABET::getBaseRank(seq[pos + i])]++;
+			return isLowComplexity(count, size, m, d);
+		}
+
+	private:
+		inline static bool isLowComplexity(const int* orig, int size, float m, float d)
+		{
+			int copy[4];
 			std::copy(orig, (orig + 4), copy);
 			std::sort(copy, (copy + 4));
-			bool isMonmer = (float)copy[3]/this->size >= m;
-			bool isDimer  = (float)(copy[2] + copy[3])/this->size >= d;
-			delete[] copy;
+			bool isMonmer = (float)copy[3]/size >= m;
+			bool isDimer  = (float)(copy[2] + copy[3])/size >= d;
 			return isMonmer || isDimer;
 		}
-
-	private:
+		
 		std::unique_ptr<int[]> count;
 		BWTIndexSet indices;
 		std::string word;
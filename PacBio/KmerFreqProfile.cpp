@@ -0,0 +1,132 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// KmerFreqProfile - Frequencies of the k-mers starting at every
+// position of a read, for every k-mer size in [minK, maxK]
+//
+#include <limits>
+#include <algorithm>
+#include "KmerFreqProfile.h"
+#include "BWTAlgorithms.h"
+#include "BWTIntervalCache.h"
+
+static inline uint32_t clampFreq(int64_t freq)
+{
+	return freq < (int64_t)std::numeric_limits<uint32_t>::max() ? (uint32_t)freq : std::numeric_limits<uint32_t>::max();
+}
+
+// Look up the interval pairs of the string w ending before seq[end], of at most
+// maxLen bases, and of its reverse complement in the interval caches of the indices.
+// Returns the length of w, which is 0 if the indices have no caches or w holds
+// a base the caches do not cover.
+static size_t lookupCachedPairs(const BWTIndexSet& indices, const std::string& seq, size_t end, size_t maxLen,
+                                BWTIntervalPair& same, BWTIntervalPair& revc)
+{
+	const BWTIntervalCache* pFwdCache = indices.pBWT->getIntervalCache();
+	const BWTIntervalCache* pRevCache = indices.pRBWT->getIntervalCache();
+	if(pFwdCache == nullptr || pRevCache == nullptr || pFwdCache->getCachedLength() != pRevCache->getCachedLength())
+		return 0;
+
+	const size_t MAX_CACHED = 32;
+	size_t len = std::min(std::min(maxLen, pFwdCache->getCachedLength()), MAX_CACHED);
+	size_t start = end - len;
+
+	// The pair of a string holds the intervals of the string and of its reverse.
+	// The reverse complement of w is searched from its first base, which is the
+	// complement of the last base of w.
+	char w[MAX_CACHED], r_w[MAX_CACHED], rc_w[MAX_CACHED], c_w[MAX_CACHED];
+	for(size_t i = 0; i < len; ++i)
+	{
+		w[i] = seq[start + i];
+		r_w[len - i - 1] = w[i];
+		c_w[i] = complement(w[i]);
+		rc_w[len - i - 1] = c_w[i];
+	}
+
+	bool hit = pFwdCache->lookup(w, len, same.interval[0]) && pRevCache->lookup(r_w, len, same.interval[1]) &&
+	           pFwdCache->lookup(rc_w, len, revc.interval[0]) && pRevCache->lookup(c_w, len, revc.interval[1]);
+	pFwdCache->recordLookup(hit);
+	pRevCache->recordLookup(hit);
+	return hit ? len : 0;
+}
+
+// The shortest k-mer at a position is searched from its last base towards
+// its first. Its frequency can only drop as the searched string grows, so
+// if it falls below the minimum at base q, none of the k-mers starting in
+// [pos, q] can be counted and the search resumes at q + 1. The longer k-mers
+// at a position are counted by extending the interval pairs to the right.
+void KmerFreqProfile::compute(const BWTIndexSet& indices, const std::string& seq, size_t minK, size_t maxK,
+                              const std::vector<size_t>& minFreqs)
+{
+	assert(minK >= 1 && minK <= maxK && maxK - minK < std::numeric_limits<uint16_t>::max());
+	assert(minFreqs.empty() || minFreqs.size() == maxK - minK + 1);
+	assert(indices.pBWT != nullptr && indices.pRBWT != nullptr);
+
+	m_minK = minK;
+	m_maxK = maxK;
+	m_seqLen = seq.length();
+	m_numPos = m_seqLen >= minK ? m_seqLen - minK + 1 : 0;
+
+	size_t width = maxK - minK + 1;
+	m_fwdFreqs.assign(m_numPos * width, 0);
+	m_rvcFreqs.assign(m_numPos * width, 0);
+	m_numCounted.assign(m_numPos, 0);
+
+	size_t minFreq = minFreqs.empty() ? 1 : minFreqs[0];
+	size_t pos = 0;
+	while(pos < m_numPos)
+	{
+		BWTIntervalPair same, revc;
+		size_t q = pos + minK;
+		size_t numCached = lookupCachedPairs(indices, seq, q, minK, same, revc);
+		if(numCached > 0)
+		{
+			// The lookup covers the last bases of the k-mer
+			q -= numCached;
+		}
+		else
+		{
+			--q;
+			BWTAlgorithms::initIntervalPair(same, seq[q], indices.pBWT, indices.pRBWT);
+			BWTAlgorithms::initIntervalPair(revc, complement(seq[q]), indices.pBWT, indices.pRBWT);
+		}
+
+		size_t freq = same.interval[0].getFreq() + revc.interval[0].getFreq();
+		while(freq >= minFreq && q > pos)
+		{
+			--q;
+			BWTAlgorithms::updateBothL(same, seq[q], indices.pBWT);
+			BWTAlgorithms::updateBothR(revc, complement(seq[q]), indices.pRBWT);
+			freq = same.interval[0].getFreq() + revc.interval[0].getFreq();
+		}
+
+		if(freq < minFreq)
+		{
+			pos = q + 1;
+			continue;
+		}
+
+		// Count the longer k-mers at pos
+		size_t row = pos * width;
+		size_t k = minK;
+		while(true)
+		{
+			m_fwdFreqs[row + k - minK] = clampFreq(same.interval[0].getFreq());
+			m_rvcFreqs[row + k - minK] = clampFreq(revc.interval[0].getFreq());
+			m_numCounted[pos]++;
+			if(k == maxK || pos + k == m_seqLen)
+				break;
+
+			char b = seq[pos + k];
+			BWTAlgorithms::updateBothR(same, b, indices.pRBWT);
+			BWTAlgorithms::updateBothL(revc, complement(b), indices.pBWT);
+			++k;
+			freq = same.interval[0].getFreq() + revc.interval[0].getFreq();
+			if(freq < (minFreqs.empty() ? 1 : minFreqs[k - minK]))
+				break;
+		}
+		++pos;
+	}
+}
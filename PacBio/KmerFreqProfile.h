@@ -0,0 +1,71 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// KmerFreqProfile - Frequencies of the k-mers starting at every
+// position of a read, for every k-mer size in [minK, maxK], counted
+// on both strands of an FM-index. The profile is a flat array with
+// one row per position, so a read is profiled without allocating
+// per position or per k-mer.
+//
+#ifndef KMERFREQPROFILE_H
+#define KMERFREQPROFILE_H
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "BWTIndexSet.h"
+
+class KmerFreqProfile
+{
+	public:
+		KmerFreqProfile(void) : m_minK(0), m_maxK(0), m_seqLen(0), m_numPos(0) { }
+		~KmerFreqProfile(void) = default;
+
+		// Profile the k-mers of seq of sizes minK to maxK. The k-mers at a position
+		// are counted from the shortest one up while the frequency of each size k
+		// is at least minFreqs[k - minK]; by default only absent k-mers stop the count.
+		void compute(const BWTIndexSet& indices, const std::string& seq, size_t minK, size_t maxK,
+		             const std::vector<size_t>& minFreqs = std::vector<size_t>());
+
+		// Number of k-mer sizes, from minK up, counted at pos. The count stops at the
+		// first size below its minimum frequency or running past the end of the read.
+		inline size_t getNumCounted(size_t pos) const { return pos < m_numPos ? m_numCounted[pos] : 0; }
+
+		// Occurrences of the k-mer of size k at pos and of its reverse complement,
+		// 0 for sizes that were not counted
+		inline uint32_t getFwdFreq(size_t pos, size_t k) const { return m_fwdFreqs[index(pos, k)]; }
+		inline uint32_t getRvcFreq(size_t pos, size_t k) const { return m_rvcFreqs[index(pos, k)]; }
+		inline size_t getFreq(size_t pos, size_t k) const { return (size_t)getFwdFreq(pos, k) + getRvcFreq(pos, k); }
+
+		// Frequency of the longest counted k-mer at pos, 0 if none was counted
+		inline size_t getLastFreq(size_t pos) const
+		{
+			size_t numCounted = getNumCounted(pos);
+			return numCounted > 0 ? getFreq(pos, m_minK + numCounted - 1) : 0;
+		}
+
+		// Whether the k-mer of size k at pos can be profiled, i.e. it lies within the read
+		inline bool isInRead(size_t pos, size_t k) const { return k >= m_minK && k <= m_maxK && pos + k <= m_seqLen; }
+
+		inline size_t getMinK() const { return m_minK; }
+		inline size_t getMaxK() const { return m_maxK; }
+
+	private:
+		inline size_t index(size_t pos, size_t k) const
+		{
+			assert(pos < m_numPos && k >= m_minK && k <= m_maxK);
+			return pos * (m_maxK - m_minK + 1) + (k - m_minK);
+		}
+
+		size_t m_minK;
+		size_t m_maxK;
+		size_t m_seqLen;
+		size_t m_numPos;
+		std::vector<uint32_t> m_fwdFreqs;
+		std::vector<uint32_t> m_rvcFreqs;
+		std::vector<uint16_t> m_numCounted;
+};
+
+#endif
@@ -8,6 +8,7 @@
 //
 //
 #include <iomanip>
+#include <algorithm>
 #include "LongReadCorrectByOverlap.h"
 #include "BWTAlgorithms.h"
 #include "stdaln.h"
@@ -46,7 +47,8 @@ LongReadSelfCorrectByOverlap::LongReadSelfCorrectByOverlap
 					m_repeatFreq(repeatFreq),
 					m_localSimilarlykmerSize(localSimilarlykmerSize),
 					m_PacBioErrorRate(params.ErrorRate),
-					m_Debug(debug)
+					m_Debug(debug),
+					m_earlyStopErrorRate(params.earlyStopErrorRate)
 {
 	std::string beginningkmer = m_sourceSeed.substr(m_sourceSeed.length()-m_initkmersize);
 		m_Debug.sourceReduceSize(m_sourceSeed.length()-m_initkmersize);
@@ -57,6 +59,14 @@ LongReadSelfCorrectByOverlap::LongReadSelfCorrectByOverlap
 		else
 			m_maxIndelSize  =  20;
 
+	//leaf budget in proportion to the distance
+		if (params.leavesPerBase > 0)
+		{
+			const size_t MIN_LEAVES = 8;
+			size_t budget = params.leavesPerBase * std::max(m_disBetweenSrcTarget, 0);
+			m_maxLeaves = std::min(std::max(budget, MIN_LEAVES), 4 * m_maxLeaves);
+		}
+
 	//initialRootNode
 		initialRootNode(beginningkmer);
 
@@ -83,9 +93,13 @@ LongReadSelfCorrectByOverlap::LongReadSelfCorrectByOverlap
 		{
 			std::string endingkmer = m_targetSeed.substr(i, m_minOverlap);
 
-			m_fwdTerminatedInterval.push_back(BWTAlgorithms::findInterval(m_pRBWT, reverse(endingkmer)));
-			m_rvcTerminatedInterval.push_back(BWTAlgorithms::findInterval(m_pBWT, reverseComplement(endingkmer)));
+			addTerminalInterval(m_fwdTerminals, BWTAlgorithms::findInterval(m_pRBWT, reverse(endingkmer)), i);
+			addTerminalInterval(m_rvcTerminals, BWTAlgorithms::findInterval(m_pBWT, reverseComplement(endingkmer)), i);
 		}
+		auto byLowerBound = [](const TerminalInterval& a, const TerminalInterval& b)
+			{ return a.lower < b.lower || (a.lower == b.lower && a.index < b.index); };
+		std::sort(m_fwdTerminals.begin(), m_fwdTerminals.end(), byLowerBound);
+		std::sort(m_rvcTerminals.begin(), m_rvcTerminals.end(), byLowerBound);
     // build overlap tree
 		m_query = beginningkmer + m_strBetweenSrcTarget + m_targetSeed;
 		// build overlap tree to determine the error rate
@@ -186,8 +200,8 @@ int LongReadSelfCorrectByOverlap::extendOverlap(FMWalkResult2& FMWResult)
 		if(m_Debug.isDebug)
 			std::cout << "----" << std::endl;
 */
-		if(m_currentLength >= m_minLength)
-			isTerminated(results);
+		if(m_currentLength >= m_minLength && isTerminated(results) && isBestPathFinal(results))
+			break;
 
 		m_step_number++;
 	}
@@ -836,43 +850,81 @@ bool LongReadSelfCorrectByOverlap::isTerminated(SAIntervalNodeResultVector& resu
 
 		//The current SA interval stands for a string >= terminating kmer
 		//If terminating kmer is a substr, the current SA interval is a sub-interval of the terminating interval
-		bool isFwdTerminated = false;
-		bool isRvcTerminated = false;
-		for(size_t i = std::max(leaf -> resultindex.second,0);i <= m_targetSeed.length()-(int)m_minOverlap; i++)
-		{
-			isFwdTerminated=currfwd.isValid() && currfwd.lower >= m_fwdTerminatedInterval.at(i).lower
-							&& currfwd.upper <= m_fwdTerminatedInterval.at(i).upper;
-			isRvcTerminated=currrvc.isValid() && currrvc.lower >= m_rvcTerminatedInterval.at(i).lower
-							&& currrvc.upper <= m_rvcTerminatedInterval.at(i).upper;
+		//The leaf ends at the last such kmer of the target
+		int minIndex = std::max(leaf -> resultindex.second,0);
+		int i = std::max(findTerminalIndex(m_fwdTerminals, currfwd, minIndex), findTerminalIndex(m_rvcTerminals, currrvc, minIndex));
+		if(i < 0)
+			continue;
 
-			if(isFwdTerminated || isRvcTerminated)
-			{
-				std::string STNodeStr = leaf->getFullString();
-				if (m_targetSeed.length() > m_minOverlap)
-					STNodeStr += m_targetSeed.substr(i+m_minOverlap);
-
-				SAIntervalNodeResult STresult;
-				STresult.thread=STNodeStr;
-				STresult.SAICoverage = leaf->getKmerCount();
-				STresult.errorRate   = leaf->GlobalErrorRateRecord.back();
-				STresult.SAIntervalSize = (currfwd.upper-currfwd.lower+1);
-
-				if( leaf->resultindex.first == -1 )
-				{
-					results.push_back(STresult);
-					leaf->resultindex = std::make_pair(results.size(),i);
-				}
-				else
-				{
-					results.at( leaf->resultindex.first-1 ) = STresult;
-					leaf->resultindex = std::make_pair(leaf->resultindex.first,i);
-				}
+		std::string STNodeStr = leaf->getFullString();
+		if (m_targetSeed.length() > m_minOverlap)
+			STNodeStr += m_targetSeed.substr(i+m_minOverlap);
 
-				found =  true;
-			}
+		SAIntervalNodeResult STresult;
+		STresult.thread=STNodeStr;
+		STresult.SAICoverage = leaf->getKmerCount();
+		STresult.errorRate   = leaf->GlobalErrorRateRecord.back();
+		STresult.SAIntervalSize = (currfwd.upper-currfwd.lower+1);
+
+		if( leaf->resultindex.first == -1 )
+		{
+			results.push_back(STresult);
+			leaf->resultindex = std::make_pair(results.size(),i);
+		}
+		else
+		{
+			results.at( leaf->resultindex.first-1 ) = STresult;
+			leaf->resultindex = std::make_pair(leaf->resultindex.first,i);
 		}
 
+		found =  true;
 	}
 
 	return found;
-}
\ No newline at end of file
+}
+
+// The walk can stop when the best path reaching $ is accurate enough
+// and none of the leaves is currently more accurate than it
+bool LongReadSelfCorrectByOverlap::isBestPathFinal(const SAIntervalNodeResultVector& results)
+{
+	if(m_earlyStopErrorRate <= 0 || results.empty())
+		return false;
+
+	double minErrorRate = 1;
+	for(const auto& result : results)
+		minErrorRate = std::min(minErrorRate, result.errorRate);
+	if(minErrorRate > m_earlyStopErrorRate)
+		return false;
+
+	for(const auto& leaf : m_leaves)
+	{
+		if(leaf.leafNodePtr->GlobalErrorRateRecord.back() < minErrorRate)
+			return false;
+	}
+	return true;
+}
+
+void LongReadSelfCorrectByOverlap::addTerminalInterval(std::vector<TerminalInterval>& terminals, const BWTInterval& interval, int index)
+{
+	if(interval.isValid())
+		terminals.push_back(TerminalInterval{interval.lower, interval.upper, index});
+}
+
+// Return the last position, not before minIndex, of a terminating kmer whose SA interval holds interval, -1 if none.
+// The intervals of distinct kmers of one size are disjoint, so only the kmer with the last lower bound
+// not after interval.lower can hold it; a kmer found at several positions has one entry per position.
+int LongReadSelfCorrectByOverlap::findTerminalIndex(const std::vector<TerminalInterval>& terminals, const BWTInterval& interval, int minIndex) const
+{
+	if(!interval.isValid())
+		return -1;
+
+	auto iter = std::upper_bound(terminals.begin(), terminals.end(), interval.lower,
+		[](int64_t lower, const TerminalInterval& t) { return lower < t.lower; });
+	if(iter == terminals.begin())
+		return -1;
+
+	--iter;
+	if(interval.upper > iter->upper || iter->index < minIndex)
+		return -1;
+	return iter->index;
+}
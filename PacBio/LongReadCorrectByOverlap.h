@@ -28,15 +28,18 @@ struct FMWalkResult2
 struct FMextendParameters
 {
 	public:
-		FMextendParameters(BWTIndexSet indices, int idmerLength, int maxLeaves,int minKmerLength,size_t PBcoverage, double ErrorRate):
+		FMextendParameters(BWTIndexSet indices, int idmerLength, int maxLeaves,int minKmerLength,size_t PBcoverage, double ErrorRate,
+		                   double earlyStopErrorRate = 0, double leavesPerBase = 0):
 			indices(indices),
 			idmerLength(idmerLength),
 			maxLeaves(maxLeaves),
 			minKmerLength(minKmerLength),
 			PBcoverage(PBcoverage),
-			ErrorRate(ErrorRate){};
+			ErrorRate(ErrorRate),
+			earlyStopErrorRate(earlyStopErrorRate),
+			leavesPerBase(leavesPerBase){};
 
-		FMextendParameters(){};
+		FMextendParameters():earlyStopErrorRate(0),leavesPerBase(0){};
 		BWTIndexSet indices;
 		int idmerLength;
 		int maxLeaves;
@@ -44,6 +47,14 @@ struct FMextendParameters
 		size_t PBcoverage;
 		double ErrorRate;
 
+		// Stop the walk once a path reaching the target has an error rate of at most
+		// earlyStopErrorRate and no leaf has a lower one, 0 to walk until the search ends
+		double earlyStopErrorRate;
+
+		// Allow leavesPerBase leaves per base of the gap instead of maxLeaves,
+		// at least MIN_LEAVES and at most 4*maxLeaves, 0 for maxLeaves on every gap
+		double leavesPerBase;
+
 };
 
 struct debugExtInfo
@@ -284,12 +295,24 @@ class LongReadSelfCorrectByOverlap
 
 			// Check if the leaves reach $
 				bool isTerminated(SAIntervalNodeResultVector& results);
+			// Check if the best path reaching $ is good enough to stop the walk
+				bool isBestPathFinal(const SAIntervalNodeResultVector& results);
 
 			bool isOverlapAcceptable(SAIOverlapNode3* currNode);
 			bool isSupportedByNewSeed(SAIOverlapNode3* currNode, size_t smallSeedIdx, size_t largeSeedIdx);
 			bool ismatchedbykmer(BWTInterval currFwdInterval,BWTInterval currRvcInterval);
 			double computeErrorRate(SAIOverlapNode3* currNode);
 
+		// SA interval of a terminating kmer and its position in the target seed
+			struct TerminalInterval
+			{
+				int64_t lower;
+				int64_t upper;
+				int index;
+			};
+			void addTerminalInterval(std::vector<TerminalInterval>& terminals, const BWTInterval& interval, int index);
+			int findTerminalIndex(const std::vector<TerminalInterval>& terminals, const BWTInterval& interval, int minIndex) const;
+
 		//
 		// Data
 		//
@@ -305,7 +328,7 @@ class LongReadSelfCorrectByOverlap
 			const size_t m_PBcoverage;
 			size_t m_min_SA_threshold;
 			double m_errorRate;
-			const size_t m_maxLeaves;
+			size_t m_maxLeaves;
 			const size_t m_seedSize;
 			size_t m_repeatFreq;
 			size_t m_localSimilarlykmerSize;
@@ -324,8 +347,9 @@ class LongReadSelfCorrectByOverlap
 		std::string m_query;
 		size_t m_maxLength;
 		size_t m_minLength;
-		std::vector<BWTInterval> m_fwdTerminatedInterval;   //in rBWT
-		std::vector<BWTInterval> m_rvcTerminatedInterval;   //in BWT
+		std::vector<TerminalInterval> m_fwdTerminals;   //in rBWT, sorted by lower bound
+		std::vector<TerminalInterval> m_rvcTerminals;   //in BWT, sorted by lower bound
+		double m_earlyStopErrorRate;
 
 		leafList m_leaves;
 		SAIOverlapNode3* m_pRootNode;
@@ -4,6 +4,7 @@
 #include "Util.h"
 #include "KmerFeature.h"
 #include "KmerThreshold.h"
+#include "KmerFreqProfile.h"
 
 
 ProbeParameters::ProbeParameters(
@@ -30,6 +31,12 @@ ProbeParameters LongReadProbe::m_params;
 
 thread_local std::string LongReadProbe::readid;
 
+//Frequency of the kmer of size ksize at pos as reported by KmerFeature, -1 if it runs past the end of the sequence.
+static inline int getKmerFreq(const KmerFreqProfile& profile, size_t pos, int ksize)
+{
+	return profile.isInRead(pos, ksize) ? (int)profile.getFreq(pos, ksize) : -1;
+}
+
 // Search seeds with [static/dynamic] kmers. Noted by KuanWeiLee 20171027
 void LongReadProbe::searchSeedsWithHybridKmers(const std::string& readSeq, SeedFeature::SeedVector& seedVec)
 {
@@ -37,8 +44,12 @@ void LongReadProbe::searchSeedsWithHybridKmers(const std::string& readSeq, SeedF
 	int staticSize = m_params.startKmerLen;
 	if((int)readSeqLen < staticSize) return;
 	
+	//Profile the kmers of all sizes in the pool at every position in one pass.
+	KmerFreqProfile profile;
+	profile.compute(m_params.indices, readSeq, *m_params.pool.begin(), *m_params.pool.rbegin());
+	
 	int* attribute = new int[readSeqLen];
-	getSeqAttribute(readSeq, attribute);
+	getSeqAttribute(readSeq, profile, attribute);
 	if(m_params.Manual) std::fill_n(attribute, readSeqLen, m_params.mode);
 	
 	//Search seeds; slide through the sequence with hybrid-kmers. Noted by KuanWeiLee
@@ -47,41 +58,48 @@ void LongReadProbe::searchSeedsWithHybridKmers(const std::string& readSeq, SeedF
 	{
 		int dynamicMode = attribute[initPos];
 		staticSize += m_params.offset[dynamicMode];
-		KmerFeature dynamicKmer = KmerFeature::Log()[staticSize][initPos];
+		//The dynamic-kmer begins as the static-kmer on initPos; it is only searched once it becomes a seed.
+		KmerFeature dynamicKmer;
+		int dynamicSize = staticSize;
+		int dynamicFreq = getKmerFreq(profile, initPos, staticSize);
+		bool isDynamicValid = dynamicFreq >= 0 && profile.getFwdFreq(initPos, staticSize) > 0 && profile.getRvcFreq(initPos, staticSize) > 0;
 		bool isSeed = false, isRepeat = false;
-		int maxFixedMerFreq = dynamicKmer.getFreq();
+		int maxFixedMerFreq = dynamicFreq;
 		size_t seedPos = initPos;
 		for(size_t currPos = initPos; currPos < readSeqLen; currPos++)
 		{
 			int staticMode = attribute[currPos];
-			const KmerFeature& staticKmer = KmerFeature::Log()[staticSize][currPos];
-			if(staticKmer.isFake()) break;
+			int staticFreq = getKmerFreq(profile, currPos, staticSize);
+			if(staticFreq < 0) break;
 			if(isSeed)
 			{
 				char b = readSeq[(currPos + staticSize - 1)];
 				dynamicKmer.expand(b);
+				dynamicSize = dynamicKmer.getSize();
+				dynamicFreq = dynamicKmer.getFreq();
+				isDynamicValid = dynamicKmer.isValid();
 			}
-			float dynamicThreshold = KmerThreshold::Instance().get(dynamicMode, dynamicKmer.getSize());
-			float staticThreshold  = KmerThreshold::Instance().get(staticMode, staticKmer.getSize());
+			float dynamicThreshold = KmerThreshold::Instance().get(dynamicMode, dynamicSize);
+			float staticThreshold  = KmerThreshold::Instance().get(staticMode, staticSize);
 			float repeatThreshold  = (5 - ((staticMode >> 1) << 2))*staticThreshold;
 			//Gerneral seed extension strategy.
 			if	(
-				   staticKmer.getFreq() < staticThreshold						//1.static frequency
-				|| dynamicKmer.getFreq() < dynamicThreshold						//2.dynamic frequency(1)
-				|| !dynamicKmer.isValid()										//2.dynamic frequency(2)
-				|| dynamicKmer.getSize() > m_params.kmerLenUpBound				//3.over length
+				   staticFreq < staticThreshold									//1.static frequency
+				|| dynamicFreq < dynamicThreshold								//2.dynamic frequency(1)
+				|| !isDynamicValid												//2.dynamic frequency(2)
+				|| dynamicSize > m_params.kmerLenUpBound						//3.over length
 				)
 			{
 				if(isSeed) dynamicKmer.shrink(1);
 				break;
 			}
 			//Kmer Hitchhike strategy.
-			float freqDiff = (float)staticKmer.getFreq()/maxFixedMerFreq;
+			float freqDiff = (float)staticFreq/maxFixedMerFreq;
 			int isGiantRepeat = ((dynamicMode >> 1) & (staticMode >> 1)) + 1;
 			if(freqDiff < (m_params.hhRatio/isGiantRepeat))						//4.hitchhiking kmer(1) (HIGH-->LOW)
 			{
 				initPos++;
-				dynamicKmer.shrink(1);
+				if(isSeed) dynamicKmer.shrink(1);
 				break;
 			}
 			else if(freqDiff > (isGiantRepeat/m_params.hhRatio))				//4.hitchhiking kmer(2) (LOW-->HIGH)
@@ -90,16 +108,17 @@ void LongReadProbe::searchSeedsWithHybridKmers(const std::string& readSeq, SeedF
 				isSeed = false;
 				break;
 			}
-			initPos = seedPos + dynamicKmer.getSize() - 1;
+			if(!isSeed)
+				dynamicKmer = KmerFeature(m_params.indices, readSeq, seedPos, dynamicSize);
+			initPos = seedPos + dynamicSize - 1;
 			isSeed = true;
-			isRepeat |= (staticKmer.getFreq() >= repeatThreshold);
-			maxFixedMerFreq = std::max(maxFixedMerFreq, staticKmer.getFreq());
+			isRepeat |= (staticFreq >= repeatThreshold);
+			maxFixedMerFreq = std::max(maxFixedMerFreq, staticFreq);
 		}
 		//Low Complexity strategy.
 		if(isSeed && !dynamicKmer.isLowComplexity())
 		{
 			seedVec.push_back(SeedFeature(dynamicKmer.getWord(), seedPos, maxFixedMerFreq, isRepeat, staticSize, m_params.PBcoverage));
-			seedVec.back().estimateBestKmerSize(m_params.indices);
 		}
 		staticSize -= m_params.offset[dynamicMode];
 	}
@@ -107,6 +126,9 @@ void LongReadProbe::searchSeedsWithHybridKmers(const std::string& readSeq, SeedF
 	//Seed Hitchhike strategy.
 	seedVec = removeHitchhikingSeeds(seedVec, attribute);
 	
+	//The best kmer sizes are only needed by the remaining seeds, estimate them together.
+	SeedFeature::estimateBestKmerSize(seedVec, m_params.indices);
+	
 	if(m_params.DebugSeed)
 	{
 		std::ostream* pSeedWriter = createWriter(m_params.directory + "seed/" + readid + ".seed");
@@ -118,7 +140,7 @@ void LongReadProbe::searchSeedsWithHybridKmers(const std::string& readSeq, SeedF
 }
 //Sequence attribute is set dynamically using a sliding fixed-mer on each position of the sequence.
 //Noted by KuanWeiLee 20180118
-void LongReadProbe::getSeqAttribute(const std::string& seq, int* const attribute)
+void LongReadProbe::getSeqAttribute(const std::string& seq, const KmerFreqProfile& profile, int* const attribute)
 {
 	std::ostream* pAutoWriter = nullptr;
 	if(m_params.DebugSeed)
@@ -143,14 +165,7 @@ void LongReadProbe::getSeqAttribute(const std::string& seq, int* const attribute
 		while(fear < right)
 		{
 			fear++;
-			KmerFeature* prev = nullptr;
-			for(auto& iter : m_params.pool)
-			{
-				KmerFeature::Log()[iter][fear] = KmerFeature(m_params.indices, seq, fear, iter, prev);
-				prev = KmerFeature::Log()[iter].get() + fear;
-			}
-			const KmerFeature& inKmer = KmerFeature::Log()[ksize][fear];
-			int freq = inKmer.isLowComplexity() ? -1 : inKmer.getFreq();
+			int freq = KmerFeature::isLowComplexity(seq, fear, ksize) ? -1 : getKmerFreq(profile, fear, ksize);
 			int mode;
 			if(freq < 0) mode = -1;
 			else if(freq >= repeatValue) mode = 2;
@@ -159,9 +174,8 @@ void LongReadProbe::getSeqAttribute(const std::string& seq, int* const attribute
 		}
 		while(front < left)
 		{
-			const KmerFeature& outKmer = KmerFeature::Log()[ksize][front];
+			int freq = KmerFeature::isLowComplexity(seq, front, ksize) ? -1 : getKmerFreq(profile, front, ksize);
 			front++;
-			int freq = outKmer.isLowComplexity() ? -1 : outKmer.getFreq();
 			int mode;
 			if(freq <= 0) mode = -1;
 			else if(freq >= repeatValue) mode = 2;
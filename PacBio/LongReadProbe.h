@@ -4,6 +4,8 @@
 
 #include "SeedFeature.h"
 
+class KmerFreqProfile;
+
 struct ProbeParameters
 {
 	ProbeParameters(
@@ -45,7 +47,7 @@ namespace LongReadProbe
 	extern thread_local std::string readid;
 	
 	void searchSeedsWithHybridKmers(const std::string& readSeq, SeedFeature::SeedVector& seedVec);
-	void getSeqAttribute(const std::string& seq, int* const type);
+	void getSeqAttribute(const std::string& seq, const KmerFreqProfile& profile, int* const type);
 	SeedFeature::SeedVector removeHitchhikingSeeds(SeedFeature::SeedVector initSeedVec, int const *type);
 };
 #endif
@@ -13,6 +13,7 @@
 #include <iomanip>
 #include "SAIPBHybridCTree.h"
 #include "SAIPBSelfCTree.h"
+#include "RollingPBSelfCTree.h"
 #include "Timer.h"
 #include "multiple_alignment.h"
 #include "LongReadOverlap.h"
@@ -32,166 +33,177 @@ PacBioHybridCorrectionProcess::~PacBioHybridCorrectionProcess()
 // PacBio Hybrid Correction by Ya, v20160216.
 PacBioHybridCorrectionResult PacBioHybridCorrectionProcess::PBHybridCorrection(const SequenceWorkItem& workItem)
 {
-	PacBioHybridCorrectionResult result;
-	
-	// std::cout << workItem.read.id <<"\n";
-	std::vector<SeedFeature> seedVec, pacbioCorrectedStrs;
-	std::string readSeq = workItem.read.seq.toString();
-	// seedVec = seedingByDynamicKmer(readSeq);
-	// seedVec = seedingByDynamicKmer_v2(readSeq);
-	seedVec = seedingByDynamicKmer_v3(readSeq);
-	
-	if(seedVec.size() >= 2)
-	{
-		result.correctedLen += seedVec.at(0).seedLen;
-		pacbioCorrectedStrs.push_back(seedVec.at(0));
-	}
-	else
+	std::vector<SequenceWorkItem> workItems(1, workItem);
+	std::vector<PacBioHybridCorrectionResult> results;
+	processBatch(workItems, results);
+	return results.front();
+}
+
+// A read being corrected by processBatch. The gap in progress lies between
+// seedVec[targetSeed-1] and seedVec[targetSeed].
+struct HybridCorrectionRead
+{
+	HybridCorrectionRead(size_t idx, const std::string& seq, std::vector<SeedFeature>& seeds):
+		itemIdx(idx),
+		readSeq(seq),
+		seedVec(std::move(seeds)),
+		targetSeed(1),
+		correctedSeq(seedVec.front().seedStr),
+		source(seedVec.front()),
+		disBetweenSrcTarget(0),
+		FMWalkReturnType(0),
+		isSequencingGap(false){}
+
+	size_t itemIdx;
+	std::string readSeq;
+	std::vector<SeedFeature> seedVec;
+	size_t targetSeed;
+
+	// The corrected fragment is an append-only buffer growing by the gain of each gap.
+	// The source seed of the next gap only holds the flank of the fragment that the
+	// extensions can reach, so the work per gap does not depend on the fragment length.
+	std::string correctedSeq;
+	SeedFeature source;
+
+	std::string strBetweenSrcTarget;
+	int disBetweenSrcTarget;
+	int FMWalkReturnType;
+	bool isSequencingGap;
+	FMWalkResult FMWResult;
+};
+
+// The gaps of a read depend on each other through the corrected flank, so the batch
+// is corrected in rounds of one gap per read. Each round walks the short-read index
+// for every gap first and the PacBio index for the remaining failures afterwards.
+void PacBioHybridCorrectionProcess::processBatch(const std::vector<SequenceWorkItem>& workItems, std::vector<PacBioHybridCorrectionResult>& results)
+{
+	results.assign(workItems.size(), PacBioHybridCorrectionResult());
+
+	Timer seedingTimer("seeding", true);
+	std::vector<HybridCorrectionRead> reads;
+	reads.reserve(workItems.size());
+	for(size_t i = 0 ; i < workItems.size() ; i++)
 	{
-		result.merge = false;
-		return result;
+		// std::cout << workItems[i].read.id <<"\n";
+		std::string readSeq = workItems[i].read.seq.toString();
+		// std::vector<SeedFeature> seedVec = seedingByDynamicKmer(readSeq);
+		// std::vector<SeedFeature> seedVec = seedingByDynamicKmer_v2(readSeq);
+		std::vector<SeedFeature> seedVec = seedingByDynamicKmer_v3(readSeq);
+
+		PacBioHybridCorrectionResult& result = results[i];
+		result.totalSeedNum = seedVec.size();
+		result.totalReadsLen = readSeq.length();
+		if(seedVec.size() < 2)
+			continue;
+
+		result.merge = true;
+		result.correctedLen += seedVec.front().seedLen;
+		reads.emplace_back(i, readSeq, seedVec);
 	}
-	
-	// int success=0, noWalk=0, errorSeed=0, exLeaves=0;
-	// FMWalk for each pair of seeds
-	for(size_t targetSeed = 1 ; targetSeed < seedVec.size() ; targetSeed++)
+	m_stats.numReads += workItems.size();
+	m_stats.seedingTime += seedingTimer.getElapsedWallTime();
+
+	std::vector<HybridCorrectionRead*> activeReads;
+	for(size_t i = 0 ; i < reads.size() ; i++)
+		activeReads.push_back(&reads[i]);
+
+	while(!activeReads.empty())
 	{
-		SeedFeature preTarget = seedVec.at(targetSeed-1);
-		SeedFeature source = pacbioCorrectedStrs.back();
-		SeedFeature target = seedVec.at(targetSeed);
-		int dis_between_src_target = target.seedStartPos - preTarget.seedEndPos - 1;
-		// we need raw pacbio string between source and target seed and 10 bp around
-		// to do global alignmet with fmwalk result.
-		string strBetweenSrcTarget = readSeq.substr(preTarget.seedEndPos+1-10, dis_between_src_target+20);
-		int FMWalkReturnType;
-		FMWalkResult FMWResult;
-		FMWalkReturnType = extendBetweenSeeds(source, target, strBetweenSrcTarget, dis_between_src_target, &FMWResult, targetSeed);
-
-		// debug
-		// if(targetSeed <= seedVec.size())
-		// {if(seedVec.at(targetSeed-1).isPBSeed)cout << "1\n"; else cout << "2\n";}
-		// {
-			// string kmer = seedVec.at(targetSeed-1).seedStr;
-			// int fwdKmerFreqs = BWTAlgorithms::countSequenceOccurrencesSingleStrand(kmer, m_params.indices);
-			// int rvcKmerFreqs = BWTAlgorithms::countSequenceOccurrencesSingleStrand(reverseComplement(kmer), m_params.indices);
-			// int kmerFreqs = fwdKmerFreqs+rvcKmerFreqs;
-			// std::cout << ">" << seedVec.at(targetSeed-1).seedStartPos << "."
-			// << kmerFreqs << endl
-			// << seedVec.at(targetSeed-1).seedStr << endl;
-			// kmer = seedVec.at(targetSeed).seedStr;
-			// fwdKmerFreqs = BWTAlgorithms::countSequenceOccurrencesSingleStrand(kmer, m_params.indices);
-			// rvcKmerFreqs = BWTAlgorithms::countSequenceOccurrencesSingleStrand(reverseComplement(kmer), m_params.indices);
-			// kmerFreqs = fwdKmerFreqs+rvcKmerFreqs;
-			// std::cout << ">" << seedVec.at(targetSeed).seedStartPos << "."
-			// << kmerFreqs << endl
-			// << seedVec.at(targetSeed).seedStr << endl;
-			// cout << FMWalkReturnType << "----\n";
-
-			// switch (FMWalkReturnType)
-			// {
-				// case 1:
-					// success++;
-					// break;
-				// case -1:
-					// noWalk++;
-					// break;
-				// case -2:
-					// errorSeed++;
-					// break;
-				// case -3:
-					// exLeaves++;
-					// break;
-				// default:
-					// break;
-			// }
-		// }
-		
-		// debug
-		// std::cout << targetSeed << " " << preTarget.seedStartPos << " " << FMWalkReturnType << "\n";
-		
-		// debug
-		// if(FMWResult.mergedSeq.length() != 0)
-		//	if(targetSeed == 34)
-		//		std::cout << ">" << targetSeed << "." << seedVec.at(targetSeed-1).seedStartPos << "." << FMWResult.mergedSeq.substr(source.seedLen - seedVec.at(targetSeed-1).seedLen).length() << "\n" << FMWResult.mergedSeq.substr(source.seedLen - seedVec.at(targetSeed-1).seedLen) << "\n";
-		
-		// debug
-		// if(targetSeed == 4)
-		// {
-			// std::cout << ">" << targetSeed << "." << seedVec.at(targetSeed-1).seedStartPos << "." << readSeq.substr(seedVec.at(targetSeed-1).seedStartPos,seedVec.at(targetSeed).seedEndPos-seedVec.at(targetSeed-1).seedStartPos+1).length() << "\n" << readSeq.substr(seedVec.at(targetSeed-1).seedStartPos,seedVec.at(targetSeed).seedEndPos-seedVec.at(targetSeed-1).seedStartPos+1) << "\n";
-			// std::cout << ">" << targetSeed << "." << seedVec.at(targetSeed-1).seedStartPos << "." << mergedseq.substr(source.seedLen - seedVec.at(targetSeed-1).seedLen).length() << "\n" << mergedseq.substr(source.seedLen - seedVec.at(targetSeed-1).seedLen) << "\n";
-			// std::cout << seedVec.at(targetSeed-1).seedStr << "\n";
-			// std::cout << target.seedStr << "\n";
-		// }
-		
-		// debug
-		// if(targetSeed == 10 || targetSeed == 9)
-		// {
-			// for(int i=0;i<=(target.seedLen-21);i++)
-			// {
-				// string kmer = "GAAAGCAGCGCAGCAACCCAGAT";//target.seedStr.substr(i, 21);
-				// int fwdKmerFreqs = BWTAlgorithms::countSequenceOccurrencesSingleStrand(kmer, m_params.indices);
-				// int rvcKmerFreqs = BWTAlgorithms::countSequenceOccurrencesSingleStrand(reverseComplement(kmer), m_params.indices);
-				// int kmerFreqs = fwdKmerFreqs+rvcKmerFreqs;
-				// std::cout << kmer << " " << kmerFreqs << ".21" << endl;
-			// }
-		// }
-		
-		// record corrected pacbio reads string
-		// FMWalk success
-		if(FMWalkReturnType == 1)
+		// FMWalk on the short-read index for the next gap of every read
+		Timer shortReadTimer("short-read walk", true);
+		for(size_t i = 0 ; i < activeReads.size() ; i++)
 		{
-			size_t gainPos = source.seedLen;
-			// have gain ground
-			if(FMWResult.mergedSeq.length() > gainPos)
-			{
-				string gainStr = FMWResult.mergedSeq.substr(gainPos);
-				// cout << gainStr << endl << endl;
-				pacbioCorrectedStrs.back().append(gainStr);
-				pacbioCorrectedStrs.back().isRepeat = target.isRepeat;
-				pacbioCorrectedStrs.back().isPBSeed = target.isPBSeed;
-				pacbioCorrectedStrs.back().isNextRepeat = target.isNextRepeat;
-				pacbioCorrectedStrs.back().startBestKmerSize = target.startBestKmerSize;
-				pacbioCorrectedStrs.back().endBestKmerSize = target.endBestKmerSize;
-				pacbioCorrectedStrs.back().seedEndPos = target.seedEndPos;
-				pacbioCorrectedStrs.back().seedStartPos = target.seedStartPos;
-
-				result.correctedLen += gainStr.length();
-			}
+			HybridCorrectionRead& read = *activeReads[i];
+			const SeedFeature& preTarget = read.seedVec.at(read.targetSeed-1);
+			const SeedFeature& target = read.seedVec.at(read.targetSeed);
+			read.source.seedStr = getSourceFlank(read.correctedSeq, read.source.endBestKmerSize);
+			read.source.seedLen = read.source.seedStr.length();
+			read.disBetweenSrcTarget = target.seedStartPos - preTarget.seedEndPos - 1;
+			// we need raw pacbio string between source and target seed and 10 bp around
+			// to do global alignmet with fmwalk result.
+			read.strBetweenSrcTarget = read.readSeq.substr(preTarget.seedEndPos+1-10, read.disBetweenSrcTarget+20);
+			read.FMWResult = FMWalkResult();
+			read.FMWalkReturnType = extendByShortReads(read.source, target, read.strBetweenSrcTarget, read.disBetweenSrcTarget, &read.FMWResult, read.isSequencingGap);
+		}
+		m_stats.numShortReadWalks += activeReads.size();
+		m_stats.shortReadWalkTime += shortReadTimer.getElapsedWallTime();
+
+		// MSA on the PacBio index for the gaps the short reads cannot bridge
+		Timer PBTimer("PacBio walk", true);
+		for(size_t i = 0 ; i < activeReads.size() ; i++)
+		{
+			HybridCorrectionRead& read = *activeReads[i];
+			const SeedFeature& target = read.seedVec.at(read.targetSeed);
+			if(!isSelfCorrectable(read.source, target, read.FMWalkReturnType, read.isSequencingGap))
+				continue;
+
+			read.FMWalkReturnType = correctByPacBioReads(read.source, target, read.strBetweenSrcTarget, read.disBetweenSrcTarget, read.FMWalkReturnType, &read.FMWResult);
+			m_stats.numPBWalks++;
 		}
-		// FMWalk failure: 
-		// 1. high error 
-		// 2. exceed leaves
-		// 3. exceed depth
-		else
+		m_stats.PBWalkTime += PBTimer.getElapsedWallTime();
+
+		// record corrected pacbio reads string and move on to the next gap
+		size_t numActive = 0;
+		for(size_t i = 0 ; i < activeReads.size() ; i++)
 		{
-			//std::cout << FMWalkReturnType << ":\t" << source.seedStr << "\t" << target.seedStr << "\t" << dis_between_src_target << "\n";	
-			pacbioCorrectedStrs.push_back(target);
-			result.correctedLen += target.seedLen;
+			HybridCorrectionRead& read = *activeReads[i];
+			PacBioHybridCorrectionResult& result = results[read.itemIdx];
+			const SeedFeature& target = read.seedVec.at(read.targetSeed);
+
+			// FMWalk success
+			if(read.FMWalkReturnType == 1)
+			{
+				size_t gainPos = read.source.seedLen;
+				// have gain ground
+				if(read.FMWResult.mergedSeq.length() > gainPos)
+				{
+					size_t gainLen = read.FMWResult.mergedSeq.length() - gainPos;
+					read.correctedSeq.append(read.FMWResult.mergedSeq, gainPos, gainLen);
+					read.source.isRepeat = target.isRepeat;
+					read.source.isPBSeed = target.isPBSeed;
+					read.source.isNextRepeat = target.isNextRepeat;
+					read.source.startBestKmerSize = target.startBestKmerSize;
+					read.source.endBestKmerSize = target.endBestKmerSize;
+					read.source.seedEndPos = target.seedEndPos;
+					read.source.seedStartPos = target.seedStartPos;
+
+					result.correctedLen += gainLen;
+				}
+				result.correctedNum++;
+			}
+			// FMWalk failure: 
+			// 1. high error 
+			// 2. exceed leaves
+			// 3. exceed depth
+			else
+			{
+				result.correctedPacbioStrs.push_back(read.correctedSeq);
+				read.correctedSeq = target.seedStr;
+				read.source = target;
+				result.correctedLen += target.seedLen;
+			}
+
+			// output information
+			result.totalWalkNum++;
+			result.seedDis += read.disBetweenSrcTarget;
+
+			if(++read.targetSeed < read.seedVec.size())
+				activeReads[numActive++] = &read;
+			else
+				result.correctedPacbioStrs.push_back(read.correctedSeq);
 		}
-		
-		// output information
-		result.totalWalkNum++;			
-		result.seedDis += dis_between_src_target;
-		if(FMWalkReturnType == 1)
-			result.correctedNum++;
-		// else if(FMWalkReturnType == -1)
-			// result.highErrorNum++;
-		// else if(FMWalkReturnType == -2)
-			// result.exceedDepthNum++;
-		// else if(FMWalkReturnType == -3)
-			// result.exceedLeaveNum++;
+		activeReads.resize(numActive);
 	}
-	// cout << "success: " << success << endl
-	// << "-1: " << noWalk << endl
-	// << "-2: " << errorSeed << endl
-	// << "-3: " << exLeaves << endl;
-	result.totalSeedNum = seedVec.size();
-	result.totalReadsLen = readSeq.length();
-	result.merge = true;
-	for(size_t result_count = 0 ; result_count < pacbioCorrectedStrs.size() ; result_count++)
-		result.correctedPacbioStrs.push_back(pacbioCorrectedStrs[result_count].seedStr);
-	
-	return result;
+}
+
+// The extensions between two seeds start from the last minOverlap bases of the source,
+// at most maxOverlap, and the MSA correction starts from its last endBestKmerSize bases.
+std::string PacBioHybridCorrectionProcess::getSourceFlank(const std::string& correctedSeq, size_t endBestKmerSize) const
+{
+	size_t flankLen = std::max((size_t)m_params.maxOverlap, endBestKmerSize);
+	if(correctedSeq.length() <= flankLen)
+		return correctedSeq;
+	return correctedSeq.substr(correctedSeq.length() - flankLen);
 }
 
 // PacBio Hybrid Correction Seeding By Dynamic Kmer, v20160217 by Ya.
@@ -324,7 +336,7 @@ std::vector<SeedFeature> PacBioHybridCorrectionProcess::seedingByDynamicKmer(con
 // where repeat regions require large kmers and error-prone regions require small kmers.
 std::vector<SeedFeature> PacBioHybridCorrectionProcess::seedingByDynamicKmer_v2(const string& readSeq)
 {
-	std::vector<std::vector<size_t> > PBKmerFreqsVec;
+	KmerFreqProfile profile;
 	std::vector<SeedFeature> seedVec;
 	std::vector<int> seedEndPosVec;
 	size_t maxKmerSize = m_params.kmerLength;
@@ -340,13 +352,16 @@ std::vector<SeedFeature> PacBioHybridCorrectionProcess::seedingByDynamicKmer_v2(
 	for(size_t i = 0 ; i <= maxKmerSize ; i++)
 		maxSeedInterval.push_back(2*3.8649*pow(2.7183,0.1239*i));
 	
-	int numValidPos = calculateKmerFreqsEachPBPos(readSeq, PBKmerFreqsVec);
+	int numValidPos = calculateKmerFreqsEachPBPos(readSeq, profile);
 	// only 24% of pacbio reads have more than two seeds
 	// if number of valid pos (high kmer freqs in the pacbio read) is smaller than two
 	// we end the seeding function as early as possible
 	if(numValidPos < 2)
 		return seedVec;
 	
+	// as counted by calculateKmerFreqsEachPBPos, only positions followed by a kmer of the largest size are used
+	auto numProfiledKmers = [&](size_t pos) -> size_t { return pos+maxKmerSize <= readSeq.length() ? profile.getNumCounted(pos) : 0; };
+	
 	// set dynamic kmer as largest kmer initially, 
 	// which will reduce size when no seeds can be found within a maximum interval.
 	size_t dynamicKmerSize = maxKmerSize;
@@ -356,21 +371,21 @@ std::vector<SeedFeature> PacBioHybridCorrectionProcess::seedingByDynamicKmer_v2(
 	// reduce kmer size if no seeds can be found within maxSeedInterval
 	for(size_t i = 0 ; i+dynamicKmerSize <= readSeq.length() ; i++)
 	{
-		size_t PBKmerSize = minKmerSize+PBKmerFreqsVec.at(i).size()-1;
+		size_t PBKmerSize = minKmerSize+numProfiledKmers(i)-1;
 		if(PBKmerSize >= dynamicKmerSize)
 		{
 			size_t seedStartPos = i;
-			size_t maxKmerFreq = PBKmerFreqsVec.at(i).back();
+			size_t maxKmerFreq = profile.getLastFreq(i);
 
 			// group consecutive solid kmers into one seed if possible
 			for(i++ ; i+dynamicKmerSize <= readSeq.length() ; i++)
 			{
-				PBKmerSize = minKmerSize+PBKmerFreqsVec.at(i).size()-1;
+				PBKmerSize = minKmerSize+numProfiledKmers(i)-1;
 				if(PBKmerSize >= dynamicKmerSize)
-					maxKmerFreq = std::max(maxKmerFreq, PBKmerFreqsVec.at(i).back());
+					maxKmerFreq = std::max(maxKmerFreq, profile.getLastFreq(i));
 				else
 				{
-					PBKmerSize = minKmerSize+PBKmerFreqsVec.at(i-1).size()-1;
+					PBKmerSize = minKmerSize+numProfiledKmers(i-1)-1;
 					break;
 				}
 			}
@@ -442,51 +457,25 @@ std::vector<SeedFeature> PacBioHybridCorrectionProcess::seedingByDynamicKmer_v2(
 	return seedVec;
 }
 
-int PacBioHybridCorrectionProcess::calculateKmerFreqsEachPBPos(const std::string& readSeq, std::vector<std::vector<size_t> >& PBKmerFreqsVec)
+// Profile the kmers of sizes minKmerLength to kmerLength at each position, as long as the
+// kmer frequency is at least seedKmerThreshold for the smallest size and 2 less for each larger size.
+// Returns the number of positions followed by a kmer of the largest size whose smallest kmer is solid.
+int PacBioHybridCorrectionProcess::calculateKmerFreqsEachPBPos(const std::string& readSeq, KmerFreqProfile& profile)
 {
 	size_t maxKmerSize = m_params.kmerLength;
 	size_t minKmerSize = m_params.minKmerLength;
 	size_t kmerThreshold = m_params.seedKmerThreshold;
 	assert(kmerThreshold - 2*(maxKmerSize-minKmerSize) > 0);
 	
-	PBKmerFreqsVec.clear();
-	PBKmerFreqsVec.resize(readSeq.length());
+	std::vector<size_t> minFreqs;
+	for(size_t kmerSize = minKmerSize ; kmerSize <= maxKmerSize ; kmerSize++)
+		minFreqs.push_back(kmerThreshold - 2*(kmerSize-minKmerSize));
+	profile.compute(m_params.indices, readSeq, minKmerSize, maxKmerSize, minFreqs);
 	
 	int numValidPos = 0;
 	for(size_t pos = 0 ; pos+maxKmerSize<=readSeq.length() ; pos++)
-	{
-		string kmer = readSeq.substr(pos, minKmerSize);
-		BWTInterval fwdInterval = BWTAlgorithms::findInterval(m_params.indices.pRBWT, reverse(kmer));
-		BWTInterval rvcInterval = BWTAlgorithms::findInterval(m_params.indices.pBWT, reverseComplement(kmer));
-		size_t kmerFreqs = fwdInterval.size() + rvcInterval.size();
-		size_t dynamicKmerThreshold = kmerThreshold;
-		
-		if(kmerFreqs < dynamicKmerThreshold)
-			continue;
-	
-		PBKmerFreqsVec.at(pos).push_back(kmerFreqs);
-		numValidPos++;
-		for(size_t extendPos=pos+minKmerSize; extendPos<pos+maxKmerSize && extendPos<readSeq.length() ; extendPos++)
-		{
-			char b = readSeq.at(extendPos);
-			char rcb;
-			switch(b)
-			{
-				case 'A': rcb='T'; break;
-				case 'T': rcb='A'; break;
-				case 'C': rcb='G'; break;
-				case 'G': rcb='C'; break;
-			}
-			BWTAlgorithms::updateInterval(fwdInterval, b, m_params.indices.pRBWT);
-			BWTAlgorithms::updateInterval(rvcInterval, rcb, m_params.indices.pBWT);
-			kmerFreqs = fwdInterval.size() + rvcInterval.size();
-			dynamicKmerThreshold -= 2;
-			if(kmerFreqs >= dynamicKmerThreshold)
-				PBKmerFreqsVec.at(pos).push_back(kmerFreqs);
-			else
-				break;
-		}
-	}
+		if(profile.getNumCounted(pos) > 0)
+			numValidPos++;
 	
 	return numValidPos;
 }
@@ -530,17 +519,18 @@ std::vector<SeedFeature> PacBioHybridCorrectionProcess::seedingByDynamicKmer_v3(
 		kmerThreshold.at(kmerSize)+=kmerThresholdValue;
 	}
 	
+	// find the solid kmers of minKmerSize in one pass, 
+	// the profile skips all kmers sharing an infrequent substring at once
+	KmerFreqProfile profile;
+	profile.compute(m_params.indices, readSeq, minKmerSize, minKmerSize, std::vector<size_t>(1, kmerThreshold.at(minKmerSize)));
+	
 	// search for solid kmers as seeds
 	for(size_t pos=0 ; pos+minKmerSize<readSeq.length() ; pos++)
 	{
-		string kmer=readSeq.substr(pos,minKmerSize);
-		BWTInterval fwdInterval=BWTAlgorithms::findInterval(m_params.indices.pRBWT, reverse(kmer));
-		BWTInterval rvcInterval=BWTAlgorithms::findInterval(m_params.indices.pBWT, reverseComplement(kmer));
-		size_t kmerFreqs=fwdInterval.size()+rvcInterval.size();
 		size_t dynamicKmerSize=minKmerSize;
 		size_t dynamicKmerThreshold=kmerThreshold.at(minKmerSize);
 
-		if(kmerFreqs<dynamicKmerThreshold)
+		if(profile.getNumCounted(pos)==0)
 		{
 			// In large sequencing gaps (>7kb), no seeds can be found in Illumina index
 			// If no seed is found within PBSearchDepth, 
@@ -564,23 +554,16 @@ std::vector<SeedFeature> PacBioHybridCorrectionProcess::seedingByDynamicKmer_v3(
 		}
 		
 		size_t seedStartPos=pos;
-		size_t maxKmerFreq=kmerFreqs;
+		size_t maxKmerFreq=profile.getFreq(pos,minKmerSize);
+		BiBWTInterval biInterval=BWTAlgorithms::findBiInterval(m_params.indices, readSeq.substr(pos,minKmerSize));
 		
 		// search for longest solid kmer as one seed if possible
 		for(pos=pos+minKmerSize ; pos<readSeq.length() ; pos++)
 		{
-			char b=readSeq.at(pos);
-			char rcb;
-			switch(b)
-			{
-				case 'A': rcb='T'; break;
-				case 'T': rcb='A'; break;
-				case 'C': rcb='G'; break;
-				case 'G': rcb='C'; break;
-			}
-			BWTAlgorithms::updateInterval(fwdInterval,b,m_params.indices.pRBWT);
-			BWTAlgorithms::updateInterval(rvcInterval,rcb,m_params.indices.pBWT);
-			kmerFreqs = fwdInterval.isValid()?fwdInterval.size():0 + rvcInterval.isValid()?rvcInterval.size():0;
+			BWTAlgorithms::updateBiInterval(biInterval,readSeq.at(pos),m_params.indices);
+			// the forward strand alone is counted once the kmer is present on it
+			const BWTInterval& countedInterval=biInterval.fwdInterval.isValid()?biInterval.fwdInterval:biInterval.rvcInterval;
+			size_t kmerFreqs=countedInterval.getFreq();
 			
 			dynamicKmerSize++;			
 			assert(dynamicKmerSize<=kmerThreshold.size());
@@ -869,7 +852,9 @@ bool PacBioHybridCorrectionProcess::isLowComplexity(std::string& seq ,const floa
 	return false;
 }
 
-int PacBioHybridCorrectionProcess::extendBetweenSeeds(SeedFeature& source, SeedFeature& target, string& strBetweenSrcTarget, int dis_between_src_target, FMWalkResult* FMWResult, int debugTargetSeed)
+// Correction by FM-index extension on the short-read index, isSequencingGap tells whether
+// the failures are more likely caused by a sequencing gap than by erroneous seeds
+int PacBioHybridCorrectionProcess::extendByShortReads(const SeedFeature& source, const SeedFeature& target, const string& strBetweenSrcTarget, int dis_between_src_target, FMWalkResult* FMWResult, bool& isSequencingGap)
 {	
 	int FMWalkReturnType = -2;
 	int PrevFMWalkReturnType = 0;	
@@ -894,7 +879,7 @@ int PacBioHybridCorrectionProcess::extendBetweenSeeds(SeedFeature& source, SeedF
 		// std::cout << "\nfmwalk id: " << debugTargetSeed << ", dis_between_src_target length: " << dis_between_src_target << "\t"<< minOverlap << ".----\n";
 	// }
 
-	bool isSequencingGap = false;
+	isSequencingGap = false;
 	bool isSeedfromPB = source.isPBSeed || target.isPBSeed || source.isNextRepeat;
 
 	// Correction by FM-index extension from source to target with iterative minOverlap reduction
@@ -1037,99 +1022,6 @@ int PacBioHybridCorrectionProcess::extendBetweenSeeds(SeedFeature& source, SeedF
 
 	// std::cout << FMWalkReturnType << "\t" << target.seedStr << "\t" << source.isNextRepeat << target.isRepeat << source.isPBSeed << target.isPBSeed << "\n";
 	
-	// try correction by MSA using FM-index of low quality long reads for sequencing gaps
-	if( (FMWalkReturnType == -2 || FMWalkReturnType == -1) && !source.isRepeat && !target.isRepeat 
-		&& (isSequencingGap || isSeedfromPB) )
-	{
-		// mimic the overlap correction process
-		// const std::string query = source.seedStr.substr(source.seedLen - m_params.PBKmerLength)+strBetweenSrcTarget.substr(10, dis_between_src_target)+target.seedStr;
-
-		// switch to best kmer in PB index
-		const std::string query = source.seedStr.substr(source.seedLen - source.endBestKmerSize)+strBetweenSrcTarget.substr(10, dis_between_src_target)+target.seedStr;
-		size_t sourceKmerLength = source.endBestKmerSize;
-		size_t targetKmerLength = target.endBestKmerSize;
-
-		// std::cout << minOverlap << "\t" << query.length() << "\n" << query << "\n";
-		
-		// Self correction by aligning all reads having seeds with query
-		MultipleAlignment maquery = LongReadOverlap::buildMultipleAlignment(query,
-													sourceKmerLength, //m_params.PBKmerLength, 
-													targetKmerLength, //m_params.PBKmerLength,
-													query.length()/10, 
-													0.73,	// alignment identity < 0.7 are often false positive repeats
-													m_params.PBcoverage,
-													m_params.PBindices);
-
-		// skip insufficient number of overlapping reads for correction
-		if(maquery.getNumRows() <= 3)
-			return FMWalkReturnType;
-		
-		// maquery.print(120);
-		std::string consensus = maquery.calculateBaseConsensus(100000, -1);
-		FMWResult->mergedSeq = source.seedStr + consensus.substr(m_params.PBKmerLength);
-		// std::cout << ">" << consensus.length() <<"\n" << consensus << "\n";
-		
-		return 1;
-		
-		/* Self-correction by FM-index extenion is suitable for high-coverage PB sequencing
-		
-		FMWParams.lowCoverageHighErrorMode = true;
-		FMWParams.minOverlap = m_params.minKmerLength;
-		FMWParams.maxOverlap = m_params.kmerLength;
-		FMWParams.sourceSeed = source.seedStr;
-		FMWParams.targetSeed = target.seedStr;
-		SAIntervalPBHybridCTree SAITree(FMWParams);
-
-		const double maxRatio = 1.1;
-		const double minRatio = 0.9;
-		const int minOffSet = 30;	//PB159615_16774.fa contains large indels > 30bp
-		const size_t extendKmerSize = 15;
-		const size_t srcKmerSize = 17;
-		
-		SAIPBSelfCorrectTree SAITree(m_params.PBindices.pBWT, m_params.PBindices.pRBWT, strBetweenSrcTarget, 2);
-			
-		// this occurs when one end is repeat requiring larger extendKmerSize while the other requires small extendKmerSize
-		// the source str should be the longest one
-		// const int srcMaxLength = maxRatio*(dis_between_src_target+minOffSet) + source.seedLen + extendKmerSize;
-		// size_t sourceFreq = SAITree.addHashBySingleSeed(source.seedStr, source.endBestKmerSize, extendKmerSize, srcMaxLength, m_params.isFirst);
-		
-		std::string srcStr = source.seedStr.substr(source.seedStr.length()-srcKmerSize);
-		size_t srcMaxLength = maxRatio*(dis_between_src_target+minOffSet) + srcStr.length() + extendKmerSize;
-		// size_t sourceFreq = SAITree.addHashBySingleSeed(srcStr, srcKmerSize, extendKmerSize, srcMaxLength, true);
-
-		// srcStr = source.seedStr.substr(source.seedStr.length()-srcKmerSize*3.5, srcKmerSize);
-		// SAITree.addHashBySingleSeed(srcStr, srcKmerSize, extendKmerSize, srcMaxLength, true);		
-		srcStr = source.seedStr.substr(source.seedStr.length()-srcKmerSize*2, srcKmerSize);
-		SAITree.addHashBySingleSeed(srcStr, srcKmerSize, extendKmerSize, srcMaxLength, true);
-		srcStr = source.seedStr.substr(source.seedStr.length()-srcKmerSize*3, srcKmerSize);
-		SAITree.addHashBySingleSeed(srcStr, srcKmerSize, extendKmerSize, srcMaxLength, true);
-		srcStr = source.seedStr.substr(source.seedStr.length()-srcKmerSize*1.5, srcKmerSize);
-		SAITree.addHashBySingleSeed(srcStr, srcKmerSize, extendKmerSize, srcMaxLength, true);		
-		
-		srcStr = source.seedStr.substr(source.seedStr.length()-srcKmerSize);
-		
-		// Collect local kmer frequency from target upto targetMaxLength
-		std::string rvcTargetStr = reverseComplement(target.seedStr);
-		const int targetMaxLength = maxRatio*(dis_between_src_target+minOffSet) + rvcTargetStr.length() + srcKmerSize;
-		size_t expectedLength = dis_between_src_target + rvcTargetStr.length();
-		assert(rvcTargetStr.length()>=extendKmerSize);
-		size_t targetFreq = SAITree.addHashBySingleSeed(rvcTargetStr, srcKmerSize, extendKmerSize, targetMaxLength, true, expectedLength);
-
-		int srcMinLength = minRatio*(dis_between_src_target-minOffSet) + srcStr.length() + extendKmerSize;
-		if(srcMinLength < 0) srcMinLength = 0;
-		expectedLength = srcStr.length() + dis_between_src_target + target.seedLen;
-		
-		std::string pbseq;
-		FMWalkReturnType = SAITree.mergeTwoSeedsUsingHash(srcStr, target.seedStr, pbseq, extendKmerSize, m_params.maxLeaves,
-														  srcMinLength, srcMaxLength, expectedLength);	
-
-		// debug
-		// std::cout << dis_between_src_target << "\t" << FMWalkReturnType << "\t"<< source.seedStartPos << "\t" << target.seedStr << "\n";
-		if(!pbseq.empty())
-			*mergedseq = source.seedStr+pbseq.substr(srcKmerSize);
-		*/
-	}
-	
 	// if(FMWalkReturnType==-2)
 	// {
 		// if(debugTargetSeed == 3){
@@ -1156,6 +1048,124 @@ int PacBioHybridCorrectionProcess::extendBetweenSeeds(SeedFeature& source, SeedF
 	return FMWalkReturnType;
 }
 
+// The gaps the short reads cannot bridge are corrected on the PacBio index if they look like
+// sequencing gaps or lie next to a seed found in the PacBio reads, and no flanking seed is a repeat
+bool PacBioHybridCorrectionProcess::isSelfCorrectable(const SeedFeature& source, const SeedFeature& target, int FMWalkReturnType, bool isSequencingGap) const
+{
+	bool isSeedfromPB = source.isPBSeed || target.isPBSeed || source.isNextRepeat;
+	return (FMWalkReturnType == -2 || FMWalkReturnType == -1) && !source.isRepeat && !target.isRepeat 
+		&& (isSequencingGap || isSeedfromPB);
+}
+
+// try correction by MSA using FM-index of low quality long reads for sequencing gaps
+int PacBioHybridCorrectionProcess::correctByPacBioReads(const SeedFeature& source, const SeedFeature& target, const string& strBetweenSrcTarget, int dis_between_src_target, int FMWalkReturnType, FMWalkResult* FMWResult)
+{
+	// bridge the gap by rolling-hash extension over the PacBio reads first
+	if(m_params.rollingHash)
+	{
+		size_t rollingKmerSize = std::min(m_params.PBKmerLength, (size_t)32);
+		size_t min_SA_threshold = m_params.PBcoverage > 60 ? (m_params.PBcoverage/60)*3 : 3;
+		std::string pbseq;
+		if(source.seedStr.length() >= rollingKmerSize && target.seedStr.length() >= rollingKmerSize)
+		{
+			RollingPBSelfCTree rollingTree(m_params.PBindices.pBWT, m_params.PBindices.pRBWT, rollingKmerSize, min_SA_threshold, m_params.maxLeaves);
+			if(rollingTree.mergeTwoSeeds(source.seedStr, target.seedStr, dis_between_src_target, pbseq) > 0)
+			{
+				FMWResult->mergedSeq = source.seedStr + pbseq.substr(rollingKmerSize);
+				return 1;
+			}
+		}
+	}
+
+	// mimic the overlap correction process
+	// const std::string query = source.seedStr.substr(source.seedLen - m_params.PBKmerLength)+strBetweenSrcTarget.substr(10, dis_between_src_target)+target.seedStr;
+
+	// switch to best kmer in PB index
+	const std::string query = source.seedStr.substr(source.seedLen - source.endBestKmerSize)+strBetweenSrcTarget.substr(10, dis_between_src_target)+target.seedStr;
+	size_t sourceKmerLength = source.endBestKmerSize;
+	size_t targetKmerLength = target.endBestKmerSize;
+
+	// std::cout << minOverlap << "\t" << query.length() << "\n" << query << "\n";
+	
+	// Self correction by aligning all reads having seeds with query
+	MultipleAlignment maquery = LongReadOverlap::buildMultipleAlignment(query,
+												sourceKmerLength, //m_params.PBKmerLength, 
+												targetKmerLength, //m_params.PBKmerLength,
+												query.length()/10, 
+												0.73,	// alignment identity < 0.7 are often false positive repeats
+												m_params.PBcoverage,
+												m_params.PBindices);
+
+	// skip insufficient number of overlapping reads for correction
+	if(maquery.getNumRows() <= 3)
+		return FMWalkReturnType;
+	
+	// maquery.print(120);
+	std::string consensus = maquery.calculateBaseConsensus(100000, -1);
+	FMWResult->mergedSeq = source.seedStr + consensus.substr(m_params.PBKmerLength);
+	// std::cout << ">" << consensus.length() <<"\n" << consensus << "\n";
+	
+	return 1;
+	
+	/* Self-correction by FM-index extenion is suitable for high-coverage PB sequencing
+	
+	FMWParams.lowCoverageHighErrorMode = true;
+	FMWParams.minOverlap = m_params.minKmerLength;
+	FMWParams.maxOverlap = m_params.kmerLength;
+	FMWParams.sourceSeed = source.seedStr;
+	FMWParams.targetSeed = target.seedStr;
+	SAIntervalPBHybridCTree SAITree(FMWParams);
+
+	const double maxRatio = 1.1;
+	const double minRatio = 0.9;
+	const int minOffSet = 30;	//PB159615_16774.fa contains large indels > 30bp
+	const size_t extendKmerSize = 15;
+	const size_t srcKmerSize = 17;
+	
+	SAIPBSelfCorrectTree SAITree(m_params.PBindices.pBWT, m_params.PBindices.pRBWT, strBetweenSrcTarget, 2);
+		
+	// this occurs when one end is repeat requiring larger extendKmerSize while the other requires small extendKmerSize
+	// the source str should be the longest one
+	// const int srcMaxLength = maxRatio*(dis_between_src_target+minOffSet) + source.seedLen + extendKmerSize;
+	// size_t sourceFreq = SAITree.addHashBySingleSeed(source.seedStr, source.endBestKmerSize, extendKmerSize, srcMaxLength, m_params.isFirst);
+	
+	std::string srcStr = source.seedStr.substr(source.seedStr.length()-srcKmerSize);
+	size_t srcMaxLength = maxRatio*(dis_between_src_target+minOffSet) + srcStr.length() + extendKmerSize;
+	// size_t sourceFreq = SAITree.addHashBySingleSeed(srcStr, srcKmerSize, extendKmerSize, srcMaxLength, true);
+
+	// srcStr = source.seedStr.substr(source.seedStr.length()-srcKmerSize*3.5, srcKmerSize);
+	// SAITree.addHashBySingleSeed(srcStr, srcKmerSize, extendKmerSize, srcMaxLength, true);		
+	srcStr = source.seedStr.substr(source.seedStr.length()-srcKmerSize*2, srcKmerSize);
+	SAITree.addHashBySingleSeed(srcStr, srcKmerSize, extendKmerSize, srcMaxLength, true);
+	srcStr = source.seedStr.substr(source.seedStr.length()-srcKmerSize*3, srcKmerSize);
+	SAITree.addHashBySingleSeed(srcStr, srcKmerSize, extendKmerSize, srcMaxLength, true);
+	srcStr = source.seedStr.substr(source.seedStr.length()-srcKmerSize*1.5, srcKmerSize);
+	SAITree.addHashBySingleSeed(srcStr, srcKmerSize, extendKmerSize, srcMaxLength, true);		
+	
+	srcStr = source.seedStr.substr(source.seedStr.length()-srcKmerSize);
+	
+	// Collect local kmer frequency from target upto targetMaxLength
+	std::string rvcTargetStr = reverseComplement(target.seedStr);
+	const int targetMaxLength = maxRatio*(dis_between_src_target+minOffSet) + rvcTargetStr.length() + srcKmerSize;
+	size_t expectedLength = dis_between_src_target + rvcTargetStr.length();
+	assert(rvcTargetStr.length()>=extendKmerSize);
+	size_t targetFreq = SAITree.addHashBySingleSeed(rvcTargetStr, srcKmerSize, extendKmerSize, targetMaxLength, true, expectedLength);
+
+	int srcMinLength = minRatio*(dis_between_src_target-minOffSet) + srcStr.length() + extendKmerSize;
+	if(srcMinLength < 0) srcMinLength = 0;
+	expectedLength = srcStr.length() + dis_between_src_target + target.seedLen;
+	
+	std::string pbseq;
+	FMWalkReturnType = SAITree.mergeTwoSeedsUsingHash(srcStr, target.seedStr, pbseq, extendKmerSize, m_params.maxLeaves,
+													  srcMinLength, srcMaxLength, expectedLength);	
+
+	// debug
+	// std::cout << dis_between_src_target << "\t" << FMWalkReturnType << "\t"<< source.seedStartPos << "\t" << target.seedStr << "\n";
+	if(!pbseq.empty())
+		*mergedseq = source.seedStr+pbseq.substr(srcKmerSize);
+	*/
+}
+
 
 // boundary of repeat seeds are less reliable
 // trim the base with lower frequency in comparison with others
@@ -1276,6 +1286,29 @@ void PacBioHybridCorrectionProcess::trimRepeatSeed(const string& readSeq, size_t
 	return;
 }
 
+//
+void PacBioHybridCorrectionStats::add(const PacBioHybridCorrectionStats& other)
+{
+	numReads += other.numReads;
+	numShortReadWalks += other.numShortReadWalks;
+	numPBWalks += other.numPBWalks;
+	seedingTime += other.seedingTime;
+	shortReadWalkTime += other.shortReadWalkTime;
+	PBWalkTime += other.PBWalkTime;
+}
+
+// Report the throughput of each phase, the times are summed over the threads
+void PacBioHybridCorrectionStats::print() const
+{
+	std::cout << std::endl;
+	std::cout << "seeding: " << numReads << " reads in " << seedingTime << "s, "
+		<< (seedingTime > 0 ? numReads/seedingTime : 0) << " reads/s." << std::endl;
+	std::cout << "short-read index walk: " << numShortReadWalks << " gaps in " << shortReadWalkTime << "s, "
+		<< (shortReadWalkTime > 0 ? numShortReadWalks/shortReadWalkTime : 0) << " gaps/s." << std::endl;
+	std::cout << "PacBio index walk: " << numPBWalks << " gaps in " << PBWalkTime << "s, "
+		<< (PBWalkTime > 0 ? numPBWalks/PBWalkTime : 0) << " gaps/s." << std::endl;
+}
+
 //
 //
 PacBioHybridCorrectionPostProcess::PacBioHybridCorrectionPostProcess(std::ostream* pCorrectedWriter, std::ostream* pDiscardWriter, const PacBioHybridCorrectionParameters params):
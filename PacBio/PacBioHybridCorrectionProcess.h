@@ -21,6 +21,7 @@
 #include "KmerDistribution.h"
 #include "SAIPBHybridCTree.h"
 #include "SeedFeature.h"
+#include "KmerFreqProfile.h"
 
 // Parameter object for the error corrector
 struct PacBioHybridCorrectionParameters
@@ -48,6 +49,7 @@ struct PacBioHybridCorrectionParameters
 	size_t PBKmerLength;	// kmer length used in PBself correction
 	size_t PBcoverage;	// coverage of low-quality short reads	
 	size_t PBSearchDepth;
+	bool rollingHash;	// bridge gaps on the PacBio index by RollingPBSelfCTree before MSA
 	// KmerDistribution kd;
 };
 
@@ -86,6 +88,28 @@ public:
 	int64_t seedDis;
 };
 
+// Time spent and work done by each phase of the batched correction
+struct PacBioHybridCorrectionStats
+{
+	PacBioHybridCorrectionStats():
+	numReads(0),
+	numShortReadWalks(0),
+	numPBWalks(0),
+	seedingTime(0),
+	shortReadWalkTime(0),
+	PBWalkTime(0){}
+
+	void add(const PacBioHybridCorrectionStats& other);
+	void print() const;
+
+	int64_t numReads;
+	int64_t numShortReadWalks;
+	int64_t numPBWalks;
+	double seedingTime;
+	double shortReadWalkTime;
+	double PBWalkTime;
+};
+
 //
 class PacBioHybridCorrectionProcess
 {
@@ -96,6 +120,11 @@ public:
 	// PacBio correction by Ya, v20150305.
 	PacBioHybridCorrectionResult PBSelfCorrection(const SequenceWorkItem& workItem);
 	PacBioHybridCorrectionResult PBHybridCorrection(const SequenceWorkItem& workItem);
+
+	// Correct a batch of reads together, gaps are extended on the short-read index
+	// in one pass and the failures are corrected on the PacBio index in another
+	void processBatch(const std::vector<SequenceWorkItem>& workItems, std::vector<PacBioHybridCorrectionResult>& results);
+	const PacBioHybridCorrectionStats& getStats() const { return m_stats; }
 	
 	PacBioHybridCorrectionResult process(const SequenceWorkItem& workItem)
 	{
@@ -109,13 +138,17 @@ private:
 	std::vector<SeedFeature> seedingByDynamicKmer(const std::string& readSeq);
 	std::vector<SeedFeature> seedingByDynamicKmer_v2(const std::string& readSeq);
 	std::vector<SeedFeature> seedingByDynamicKmer_v3(const std::string& readSeq);
-	int calculateKmerFreqsEachPBPos(const std::string& readSeq, std::vector<std::vector<size_t> >& PBKmerFreqsVec);
-	int extendBetweenSeeds(SeedFeature& source, SeedFeature& target, std::string& strBetweenSrcTarget, int dis_between_src_target, FMWalkResult* FMWResult, int debugTargetSeed);
+	int calculateKmerFreqsEachPBPos(const std::string& readSeq, KmerFreqProfile& profile);
+	std::string getSourceFlank(const std::string& correctedSeq, size_t endBestKmerSize) const;
+	int extendByShortReads(const SeedFeature& source, const SeedFeature& target, const std::string& strBetweenSrcTarget, int dis_between_src_target, FMWalkResult* FMWResult, bool& isSequencingGap);
+	bool isSelfCorrectable(const SeedFeature& source, const SeedFeature& target, int FMWalkReturnType, bool isSequencingGap) const;
+	int correctByPacBioReads(const SeedFeature& source, const SeedFeature& target, const std::string& strBetweenSrcTarget, int dis_between_src_target, int FMWalkReturnType, FMWalkResult* FMWResult);
 	void trimRepeatSeed(const std::string& readSeq, size_t coverage, size_t& seedStartPos, size_t& seedEndPos);
 	bool seedingByPacBio(const std::string& readSeq, std::vector<SeedFeature>& seedVec, 	std::vector<int>& seedEndPosVec, size_t prevEndPos);
 	bool seedingByPacBio_v2(const std::string& readSeq, std::vector<SeedFeature>& seedVec, 	std::vector<int>& seedEndPosVec, size_t prevEndPos);
 	bool isLowComplexity(std::string& seq ,const float& ratioThreshold);
 	PacBioHybridCorrectionParameters m_params;
+	PacBioHybridCorrectionStats m_stats;
 };
 
 // Write the results from the overlap step to an ASQG file
@@ -14,8 +14,8 @@
 #include "LongReadOverlap.h"
 #include "Util.h"
 #include "Timer.h"
-#include "KmerFeature.h"
 #include "BCode.h"
+#include "RollingPBSelfCTree.h"
 
 // PacBio Self Correction by Ya and YTH, v20151202.
 // 1. Identify highly-accurate seeds within PacBio reads
@@ -25,13 +25,8 @@ PacBioSelfCorrectionResult PacBioSelfCorrectionProcess::process(const SequenceWo
 	PacBioSelfCorrectionResult result;
     result.readid = workItem.read.id;
 	std::string readSeq = workItem.read.seq.toString();
-	const size_t readSeqLen = readSeq.length();
 	SeedFeature::SeedVector seedVec, pieceVec;
 	
-	//allocate space for kmers on the sequence
-	for(auto& iter : m_params.pool)
-		KmerFeature::Log()[iter] = std::unique_ptr<KmerFeature[]>(new KmerFeature[readSeqLen]);
-	
 	//Part 1: start searching seeds
     Timer* seedTimer = new Timer("Seed Time", true);
 	LongReadProbe::readid = result.readid;
@@ -43,17 +38,68 @@ PacBioSelfCorrectionResult PacBioSelfCorrectionProcess::process(const SequenceWo
 	//Part 2:start correcting sequence
     initCorrect(readSeq, seedVec, pieceVec, result);
 	
-	//free space for kmers on the sequence
-	KmerFeature::Log().clear();
-	
 	result.merge = !pieceVec.empty();
 	result.totalReadsLen = readSeq.length();
 	for(const auto& iter : pieceVec)
 		result.correctedStrs.push_back(iter.seedStr);
 	return result;
 }
+
+//Pipelined version of process: seed reads the seeds and lists a gap task from each seed to the next one,
+//the gap tasks are filled by any thread, and stitch runs initCorrect on the filled tasks.
+void PacBioSelfCorrectionProcess::seed(const SequenceWorkItem& workItem, PipelineState& state)
+{
+	state.result.readid = workItem.read.id;
+	state.readSeq = workItem.read.seq.toString();
+	
+    Timer* seedTimer = new Timer("Seed Time", true);
+	LongReadProbe::readid = state.result.readid;
+	LongReadProbe::searchSeedsWithHybridKmers(state.readSeq, state.seedVec);
+	state.result.totalSeedNum = state.seedVec.size();
+	state.result.Timer_Seed = seedTimer->getElapsedWallTime(); 
+	delete seedTimer;
+	
+	if(m_params.OnlySeed || state.seedVec.size() < 2) return;
+	state.gapTasks.reserve(state.seedVec.size() - 1);
+	for(size_t i = 0; i + 1 < state.seedVec.size(); i++)
+		state.gapTasks.push_back(PacBioSelfCorrectionStep(i));
+}
+
+void PacBioSelfCorrectionProcess::fillGap(const PipelineState& state, GapTask& task)
+{
+	SeedFeature::SeedVector::const_iterator iterTarget = state.seedVec.begin() + task.source + 1;
+	correctStep(state.seedVec[task.source], iterTarget, state.seedVec.end(), state.readSeq, task);
+}
+
+PacBioSelfCorrectionResult PacBioSelfCorrectionProcess::stitch(const SequenceWorkItem& workItem, PipelineState& state)
+{
+	(void)workItem;
+	PacBioSelfCorrectionResult& result = state.result;
+	SeedFeature::SeedVector pieceVec;
+    initCorrect(state.readSeq, state.seedVec, pieceVec, result, &state.gapTasks);
+	
+	result.merge = !pieceVec.empty();
+	result.totalReadsLen = state.readSeq.length();
+	for(const auto& iter : pieceVec)
+		result.correctedStrs.push_back(iter.seedStr);
+	return result;
+}
+
+//Counters of a correction step, see correctByFMExtension and correctByMSAlignment
+static void addStepCounters(PacBioSelfCorrectionResult& result, const PacBioSelfCorrectionResult& step)
+{
+	result.correctedLen += step.correctedLen;
+	result.seedDis += step.seedDis;
+	result.FMNum += step.FMNum;
+	result.DPNum += step.DPNum;
+	result.Timer_FM += step.Timer_FM;
+	result.Timer_DP += step.Timer_DP;
+}
+
 //Correct sequence by FMWalk & MSAlignment; it's a workflow control module. Noted by KuanWeiLee 18/3/12
-void PacBioSelfCorrectionProcess::initCorrect(std::string& readSeq, const SeedFeature::SeedVector& seedVec, SeedFeature::SeedVector& pieceVec, PacBioSelfCorrectionResult& result)
+//The steps in pGapTasks, if given, are used instead of correcting again when their source piece matches.
+void PacBioSelfCorrectionProcess::initCorrect(std::string& readSeq, const SeedFeature::SeedVector& seedVec, SeedFeature::SeedVector& pieceVec, PacBioSelfCorrectionResult& result,
+                                              const std::vector<PacBioSelfCorrectionStep>* pGapTasks)
 {
 	if(m_params.OnlySeed)
 	{
@@ -63,7 +109,6 @@ void PacBioSelfCorrectionProcess::initCorrect(std::string& readSeq, const SeedFe
 	if(seedVec.size() < 2) return;
 	std::ostream* pExtWriter = nullptr;
 	std::ostream* pDpWriter  = nullptr;
-	std::ostream* pExtDebugFile = nullptr;
 	
 	//push first seed into vector and reserve space for fast expansion
 	pieceVec.push_back(seedVec[0]);
@@ -72,88 +117,133 @@ void PacBioSelfCorrectionProcess::initCorrect(std::string& readSeq, const SeedFe
 	{
 		pExtWriter    = createWriter(m_params.directory + "extend/" + result.readid + ".ext");
 		pDpWriter     = createWriter(m_params.directory + "extend/" + result.readid + ".dp");
-	//	pExtDebugFile = createWriter(m_params.directory + "extend/" + result.readid + ".fa");
 	}
 	
-	int case_number = 1;
-	for(SeedFeature::SeedVector::const_iterator iterTarget = seedVec.begin() + 1; iterTarget != seedVec.end(); iterTarget++, case_number++)
+	for(SeedFeature::SeedVector::const_iterator iterTarget = seedVec.begin() + 1; iterTarget != seedVec.end(); iterTarget++)
 	{
-		int isFMExtensionSuccess = 0, firstFMExtensionType = 0;
 		SeedFeature& source = pieceVec.back();
-		std::string mergedSeq;
-
-		for(int next = 0; next < m_params.nextTarget && (iterTarget + next) != seedVec.end() ; next++)
+		size_t sourceIdx = iterTarget - seedVec.begin() - 1;
+		PacBioSelfCorrectionStep localStep(sourceIdx);
+		const PacBioSelfCorrectionStep* pStep = &localStep;
+		if(pGapTasks != nullptr && sourceIdx < pGapTasks->size() && isStepReusable(source, seedVec[sourceIdx]))
+			pStep = &(*pGapTasks)[sourceIdx];
+		else
+			correctStep(source, iterTarget, seedVec.end(), readSeq, localStep);
+		addStepCounters(result, pStep->result);
+		learnStep(source, iterTarget, *pStep);
+		
+		if(pStep->next >= 0)
 		{
-			const SeedFeature& target = *(iterTarget + next);
-/*
-			debugExtInfo debug(
-								m_params.DebugExtend, pExtDebugFile, result.readid, case_number,
-								source.seedEndPos - source.seedLen+1, source.seedEndPos,
-								(*iterTarget).seedStartPos,(*iterTarget).seedEndPos, true
-							);
-			isFMExtensionSuccess = correctByFMExtension(source, target, readSeq, mergedSeq, result, debug);
-/*/
-			debugExtInfo debug;
-			isFMExtensionSuccess = correctByFMExtension(source, target, readSeq, mergedSeq, result, debug);
-//*/
-			firstFMExtensionType = (next == 0 ? isFMExtensionSuccess : firstFMExtensionType);
-			if(isFMExtensionSuccess > 0)
-			{
-				result.totalWalkNum++;
-				source.append(mergedSeq, target);
-				iterTarget += next;
-				case_number+= next;
+			result.totalWalkNum++;
+			iterTarget += pStep->next;
+			source.append(pStep->mergedSeq, *iterTarget);
+			continue;
+		}
+		
+		const SeedFeature& target = *iterTarget;
+		switch(pStep->isFMSkipped ? 0 : pStep->firstFMExtensionType)
+		{
+			case 0:
+				result.skippedFMNum++;
 				break;
-			}
-
+			case -1:
+				result.highErrorNum++;
+				break;
+			case -2:
+				result.exceedDepthNum++;
+				break;
+			case -3:
+				result.exceedLeaveNum++;
+				break;
+			default:
+				std::cerr << "Does it really happen?\n";
+				exit(EXIT_FAILURE);
 		}
-
-		if(isFMExtensionSuccess <= 0)
+		
+		if(m_params.DebugSeed)
+			*pExtWriter << source.seedStartPos << "\t" << target.seedStartPos << "\t" << (pStep->firstFMExtensionType + 4) << "\n";
+		
+		result.totalWalkNum++;
+		if(pStep->isMSAlignmentSuccess)
+			source.append(pStep->mergedSeq, target);
+		else
 		{
-			const SeedFeature& target = *iterTarget;
-			switch(firstFMExtensionType)
-			{
-				case -1:
-					result.highErrorNum++;
-					break;
-				case -2:
-					result.exceedDepthNum++;
-					break;
-				case -3:
-					result.exceedLeaveNum++;
-					break;
-				default:
-					std::cerr << "Does it really happen?\n";
-					exit(EXIT_FAILURE);
-			}
-			
 			if(m_params.DebugSeed)
-				*pExtWriter << source.seedStartPos << "\t" << target.seedStartPos << "\t" << (firstFMExtensionType + 4) << "\n";
+				*pDpWriter << source.seedStartPos << "\t" << target.seedStartPos << "\n";
 			
-			result.totalWalkNum++;
-			bool isMSAlignmentSuccess = correctByMSAlignment(source, target, readSeq, mergedSeq, result);
-			if(isMSAlignmentSuccess)
-				source.append(mergedSeq, target);
+			if(m_params.Split)
+				pieceVec.push_back(target);
 			else
 			{
-				if(m_params.DebugSeed)
-					*pDpWriter << source.seedStartPos << "\t" << target.seedStartPos << "\n";
-				
-				if(m_params.Split)
-					pieceVec.push_back(target);
-				else
-				{
-					mergedSeq = readSeq.substr((source.seedEndPos + 1), (target.seedEndPos - source.seedEndPos));
-					source.append(mergedSeq, target);
-				}
-				result.correctedLen += target.seedStr.length();
+				std::string mergedSeq = readSeq.substr((source.seedEndPos + 1), (target.seedEndPos - source.seedEndPos));
+				source.append(mergedSeq, target);
 			}
+			result.correctedLen += target.seedStr.length();
 		}
 	}
 
 	delete pExtWriter;
 	delete pDpWriter;
-	delete pExtDebugFile;
+}
+
+//Bridge source to the first of the next targets reachable by FM extension, or to the first target by MSAlignment.
+//The pieces are left untouched, the outcome is applied by initCorrect.
+void PacBioSelfCorrectionProcess::correctStep(const SeedFeature& source, SeedFeature::SeedVector::const_iterator iterTarget, SeedFeature::SeedVector::const_iterator iterEnd,
+                                              const std::string& readSeq, PacBioSelfCorrectionStep& step)
+{
+	int isFMExtensionSuccess = 0;
+	std::string mergedSeq;
+	const GapDifficultyPredictor* pPredictor = m_params.NoDp ? nullptr : m_params.pGapPredictor;
+	step.isFMFailing = pPredictor != nullptr && pPredictor->isFailing(source, *iterTarget);
+	step.isFMSkipped = step.isFMFailing && !pPredictor->isExploring(source, *iterTarget);
+	for(int next = 0; !step.isFMSkipped && next < m_params.nextTarget && (iterTarget + next) != iterEnd ; next++)
+	{
+		const SeedFeature& target = *(iterTarget + next);
+/*
+		debugExtInfo debug(
+							m_params.DebugExtend, pExtDebugFile, result.readid, step.source + next + 1,
+							source.seedEndPos - source.seedLen+1, source.seedEndPos,
+							(*iterTarget).seedStartPos,(*iterTarget).seedEndPos, true
+						);
+		isFMExtensionSuccess = correctByFMExtension(source, target, readSeq, mergedSeq, step.result, debug);
+/*/
+		debugExtInfo debug;
+		isFMExtensionSuccess = correctByFMExtension(source, target, readSeq, mergedSeq, step.result, debug);
+//*/
+		step.firstFMExtensionType = (next == 0 ? isFMExtensionSuccess : step.firstFMExtensionType);
+		step.numFMWalks++;
+		if(isFMExtensionSuccess > 0)
+		{
+			step.next = next;
+			step.mergedSeq = mergedSeq;
+			return;
+		}
+	}
+	step.isMSAlignmentSuccess = correctByMSAlignment(source, *iterTarget, readSeq, mergedSeq, step.result);
+	if(step.isMSAlignmentSuccess)
+		step.mergedSeq = mergedSeq;
+}
+
+//Teach the gap predictor the walks of a step the correction uses. The piece ends with the seed a reused gap task
+//was computed from and takes its features in append, so both are in the same class of the predictor.
+//The gap tasks computed ahead and not reused are never learned from.
+void PacBioSelfCorrectionProcess::learnStep(const SeedFeature& source, SeedFeature::SeedVector::const_iterator iterTarget, const PacBioSelfCorrectionStep& step) const
+{
+	GapDifficultyPredictor* pPredictor = m_params.NoDp ? nullptr : m_params.pGapPredictor;
+	if(pPredictor == nullptr) return;
+	if(step.isFMFailing)
+		pPredictor->recordFailing(source, *iterTarget);
+	for(int next = 0; next < step.numFMWalks; next++)
+		pPredictor->record(source, *(iterTarget + next), next == step.next);
+}
+
+//A step computed from seed applies to piece if the piece ends with the seed and takes the same
+//extension kmer size, which depends on the piece length for repeats when the seed is short.
+bool PacBioSelfCorrectionProcess::isStepReusable(const SeedFeature& piece, const SeedFeature& seed) const
+{
+	if(piece.seedLen < seed.seedLen || piece.seedStr.compare(piece.seedLen - seed.seedLen, seed.seedLen, seed.seedStr) != 0)
+		return false;
+	return piece.seedLen == seed.seedLen || seed.seedLen >= m_params.startKmerLen + 2;
 }
 
 int PacBioSelfCorrectionProcess::correctByFMExtension
@@ -185,9 +275,22 @@ int PacBioSelfCorrectionProcess::correctByFMExtension
 
 	Timer* FMTimer = new Timer("FM Time",true);
 	FMWalkResult2 fmwalkresult;
-	LongReadSelfCorrectByOverlap OverlapTree
-	(src, path, trg, interval, extendKmerSize, extendKmerSize + 2, m_params.FM_params, min_SA_threshold, debug);
-	isFMExtensionSuccess = OverlapTree.extendOverlap(fmwalkresult);
+	if(m_params.RollingHash)
+	{
+		// packed kmers hold at most 32 bases, the rest of the source is kept in front
+		size_t rollingKmerSize = std::min(extendKmerSize, 32);
+		RollingPBSelfCTree rollingTree
+		(m_params.indices.pBWT, m_params.indices.pRBWT, rollingKmerSize, min_SA_threshold, m_params.maxLeaves);
+		isFMExtensionSuccess = rollingTree.mergeTwoSeeds(src, trg, interval, fmwalkresult.mergedSeq);
+		if(isFMExtensionSuccess > 0)
+			fmwalkresult.mergedSeq.insert(0, src, src.length() - extendKmerSize, extendKmerSize - rollingKmerSize);
+	}
+	else
+	{
+		LongReadSelfCorrectByOverlap OverlapTree
+		(src, path, trg, interval, extendKmerSize, extendKmerSize + 2, m_params.FM_params, min_SA_threshold, debug);
+		isFMExtensionSuccess = OverlapTree.extendOverlap(fmwalkresult);
+	}
 	result.Timer_FM += FMTimer->getElapsedWallTime();
 	delete FMTimer;
 
@@ -258,6 +361,7 @@ PacBioSelfCorrectionPostProcess::PacBioSelfCorrectionPostProcess(const PacBioSel
 	m_highErrorNum(0),
 	m_exceedDepthNum(0),
 	m_exceedLeaveNum(0),
+	m_skippedFMNum(0),
 	m_FMNum(0),
 	m_DPNum(0),
 	m_OutcastNum(0),
@@ -299,6 +403,7 @@ PacBioSelfCorrectionPostProcess::~PacBioSelfCorrectionPostProcess()
 		<< "HighErrorNum: " << m_highErrorNum   << ", ratio: " << (float)(m_highErrorNum  *100)/(m_DPNum + m_OutcastNum) << "%\n"
 		<< "ExceedDepthNum: " << m_exceedDepthNum << ", ratio: " << (float)(m_exceedDepthNum*100)/(m_DPNum + m_OutcastNum) << "%\n"
 		<< "ExceedLeaveNum: " << m_exceedLeaveNum << ", ratio: " << (float)(m_exceedLeaveNum*100)/(m_DPNum + m_OutcastNum) << "%\n"
+		<< "SkippedFMNum: " << m_skippedFMNum << ", ratio: " << (float)(m_skippedFMNum*100)/(m_DPNum + m_OutcastNum) << "%\n"
 		<< "DisBetweenSeeds: " << m_seedDis/m_totalWalkNum << "\n"
         << "Time of searching Seeds: " << m_Timer_Seed << "\n"
         << "Time of searching FM: " << m_Timer_FM << "\n"
@@ -342,6 +447,7 @@ void PacBioSelfCorrectionPostProcess::process(const SequenceWorkItem& workItem,
 		m_highErrorNum += result.highErrorNum;
 		m_exceedDepthNum += result.exceedDepthNum;
 		m_exceedLeaveNum += result.exceedLeaveNum;
+		m_skippedFMNum += result.skippedFMNum;
 		m_FMNum += result.FMNum;
         m_DPNum += result.DPNum;
 		m_seedDis += result.seedDis;
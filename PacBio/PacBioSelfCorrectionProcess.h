@@ -19,6 +19,7 @@
 #include "BWTAlgorithms.h"
 #include "SeedFeature.h"
 #include "LongReadCorrectByOverlap.h"
+#include "GapDifficultyPredictor.h"
 
 // Parameter object for the error corrector
 struct PacBioSelfCorrectionParameters
@@ -39,14 +40,14 @@ struct PacBioSelfCorrectionParameters
 	int maxLeaves;
     int idmerLen;
 	int minKmerLen;
-	
-	std::set<int> pool;
     
 	bool Split;
     bool DebugExtend;
     bool DebugSeed;
 	bool OnlySeed;
 	bool NoDp;
+	bool RollingHash;	// bridge seeds by RollingPBSelfCTree instead of the overlap tree
+	GapDifficultyPredictor* pGapPredictor;	// send gaps predicted to fail FM extension straight to DP, nullptr to always walk first
 	
 	FMextendParameters FM_params;
 
@@ -66,6 +67,7 @@ struct PacBioSelfCorrectionResult
 		highErrorNum(0),
 		exceedDepthNum(0),
 		exceedLeaveNum(0),
+		skippedFMNum(0),
 		FMNum(0),
 		DPNum(0),
 		seedDis(0),
@@ -85,6 +87,7 @@ struct PacBioSelfCorrectionResult
 	int64_t highErrorNum;
 	int64_t exceedDepthNum;
 	int64_t exceedLeaveNum;
+	int64_t skippedFMNum;
 	int64_t FMNum;
     int64_t DPNum;
 	int64_t seedDis;
@@ -93,6 +96,41 @@ struct PacBioSelfCorrectionResult
     double Timer_DP;
 };
 
+// Outcome of one correction step, from a source piece ending with seed source
+// to the target seeds that follow it
+struct PacBioSelfCorrectionStep
+{
+	PacBioSelfCorrectionStep(size_t source = 0)
+	:	source(source),
+		next(-1),
+		firstFMExtensionType(0),
+		numFMWalks(0),
+		isFMFailing(false),
+		isFMSkipped(false),
+		isMSAlignmentSuccess(false){ }
+	
+	size_t source;
+	int next;	// offset of the target bridged by FM extension, -1 if none was
+	int firstFMExtensionType;
+	int numFMWalks;	// FM extensions tried, to the targets at offsets 0 to numFMWalks - 1
+	bool isFMFailing;	// the gap is of a class predicted to fail, see GapDifficultyPredictor
+	bool isFMSkipped;	// FM extension was not tried
+	bool isMSAlignmentSuccess;
+	std::string mergedSeq;
+	PacBioSelfCorrectionResult result;	// counters of the step
+};
+
+// State of a read between the stages of the pipelined correction. The gap tasks
+// are the steps from every seed to the next one, computed as if the source piece
+// were the seed itself; stitching reuses a step whenever its piece ends the same way.
+struct PacBioSelfCorrectionState
+{
+	std::string readSeq;
+	SeedFeature::SeedVector seedVec;
+	PacBioSelfCorrectionResult result;
+	std::vector<PacBioSelfCorrectionStep> gapTasks;
+};
+
 //
 class PacBioSelfCorrectionProcess
 {
@@ -101,12 +139,24 @@ class PacBioSelfCorrectionProcess
 		PacBioSelfCorrectionProcess(const PacBioSelfCorrectionParameters& params):m_params(params){ }
 		~PacBioSelfCorrectionProcess(){ }
 		PacBioSelfCorrectionResult process(const SequenceWorkItem& workItem);
+		
+		// Stages of SequenceProcessFramework::processWorkPipelined, same result as process
+		typedef PacBioSelfCorrectionState PipelineState;
+		typedef PacBioSelfCorrectionStep GapTask;
+		void seed(const SequenceWorkItem& workItem, PipelineState& state);
+		void fillGap(const PipelineState& state, GapTask& task);
+		PacBioSelfCorrectionResult stitch(const SequenceWorkItem& workItem, PipelineState& state);
 
 	private:
 		const PacBioSelfCorrectionParameters m_params;
 	
 		//correct sequence
-		void initCorrect(std::string& readSeq, const SeedFeature::SeedVector& seedVec, SeedFeature::SeedVector& pieceVec, PacBioSelfCorrectionResult& result);
+		void initCorrect(std::string& readSeq, const SeedFeature::SeedVector& seedVec, SeedFeature::SeedVector& pieceVec, PacBioSelfCorrectionResult& result,
+		                 const std::vector<PacBioSelfCorrectionStep>* pGapTasks = nullptr);
+		void correctStep(const SeedFeature& source, SeedFeature::SeedVector::const_iterator iterTarget, SeedFeature::SeedVector::const_iterator iterEnd,
+		                 const std::string& readSeq, PacBioSelfCorrectionStep& step);
+		bool isStepReusable(const SeedFeature& piece, const SeedFeature& seed) const;
+		void learnStep(const SeedFeature& source, SeedFeature::SeedVector::const_iterator iterTarget, const PacBioSelfCorrectionStep& step) const;
 		int correctByFMExtension(const SeedFeature& source, const SeedFeature& target, const std::string& in, std::string& out, PacBioSelfCorrectionResult& result, debugExtInfo& debug);
 		bool correctByMSAlignment(const SeedFeature& source, const SeedFeature& target, const std::string& in, std::string& out, PacBioSelfCorrectionResult& result);
 };
@@ -132,6 +182,7 @@ class PacBioSelfCorrectionPostProcess
 		int64_t m_highErrorNum;
 		int64_t m_exceedDepthNum;
 		int64_t m_exceedLeaveNum;
+		int64_t m_skippedFMNum;
 		int64_t m_FMNum;
 		int64_t m_DPNum;
 		int64_t m_OutcastNum;
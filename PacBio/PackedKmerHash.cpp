@@ -0,0 +1,103 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// PackedKmerHash - Open-addressing hash table of k-mers packed
+// two bits per base, with a position histogram per k-mer
+//
+#include <iostream>
+#include "PackedKmerHash.h"
+
+static const size_t MIN_CAPACITY = 64;
+
+PackedKmerHash::PackedKmerHash(size_t intervalSize) : m_intervalSize(intervalSize), m_k(0), m_numEntries(0)
+{
+	assert(intervalSize > 0);
+	grow(MIN_CAPACITY);
+}
+
+void PackedKmerHash::reserve(size_t n)
+{
+	size_t capacity = m_slots.size();
+	while(capacity < 2*n)
+		capacity *= 2;
+	if(capacity > m_slots.size())
+		grow(capacity);
+}
+
+// Linear probing from the hashed slot, returns the slot of key or the empty slot ending its run
+size_t PackedKmerHash::findSlot(uint64_t key) const
+{
+	size_t mask = m_slots.size() - 1;
+	size_t slot = hash(key) & mask;
+	while(m_slots[slot].numBins != 0 && m_slots[slot].key != key)
+		slot = (slot + 1) & mask;
+	return slot;
+}
+
+size_t PackedKmerHash::find(uint64_t key, size_t k) const
+{
+	if(k != m_k)
+		return npos;
+	size_t slot = findSlot(key);
+	return m_slots[slot].numBins != 0 ? slot : npos;
+}
+
+void PackedKmerHash::add(uint64_t key, size_t k, int64_t pos, size_t maxIntervalSize)
+{
+	if(m_numEntries == 0)
+		m_k = k;
+	assert(k == m_k);
+
+	size_t slot = findSlot(key);
+	if(m_slots[slot].numBins == 0)
+	{
+		// Keep the table at most half full so probe runs stay short
+		if(2*(m_numEntries + 1) > m_slots.size())
+		{
+			grow(2*m_slots.size());
+			slot = findSlot(key);
+		}
+
+		Slot& s = m_slots[slot];
+		s.key = key;
+		s.numBins = maxIntervalSize/m_intervalSize + 1;
+		s.binOffset = m_arena.size();
+		s.totalFreq = 0;
+		s.totalSum = 0;
+		s.maxAvgFreq = 0;
+		m_arena.resize(m_arena.size() + 2*s.numBins, 0);
+		m_numEntries++;
+	}
+
+	Slot& s = m_slots[slot];
+	s.totalFreq++;
+	s.totalSum += pos;
+
+	// extension may exceed the expected length
+	int index = clampBin(s, pos);
+	m_arena[s.binOffset + 2*index]++;
+	m_arena[s.binOffset + 2*index + 1] += pos;
+}
+
+// Rehash the slots into a table of the given power-of-two capacity, the bins stay in place
+void PackedKmerHash::grow(size_t capacity)
+{
+	assert((capacity & (capacity - 1)) == 0);
+	std::vector<Slot> oldSlots(capacity);
+	oldSlots.swap(m_slots);
+
+	for(size_t i = 0; i < oldSlots.size(); i++)
+	{
+		if(oldSlots[i].numBins != 0)
+			m_slots[findSlot(oldSlots[i].key)] = oldSlots[i];
+	}
+}
+
+void PackedKmerHash::printFreq(size_t slot) const
+{
+	const Slot& s = m_slots[slot];
+	for(size_t i = 0; i < s.numBins; i++)
+		std::cout << i << ":" << m_arena[s.binOffset + 2*i] << "\t" << m_arena[s.binOffset + 2*i + 1] << "\n";
+}
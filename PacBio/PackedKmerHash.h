@@ -0,0 +1,206 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// PackedKmerHash - Open-addressing hash table of k-mers packed
+// two bits per base (k <= 32). Every k-mer keeps the histogram
+// of the positions it was collected at, in bins of a fixed width.
+// The bins of all k-mers live in one arena, so an insertion never
+// allocates on its own and growing the table only moves the slots.
+//
+#ifndef PACKEDKMERHASH_H
+#define PACKEDKMERHASH_H
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <assert.h>
+
+// A k-mer packed two bits per base, updated one base at a time.
+// Bases other than ACGT are tracked so a k-mer holding one is invalid.
+class PackedKmer
+{
+	public:
+		PackedKmer(size_t k) : m_k(k), m_key(0), m_invalid(0)
+		{
+			assert(k >= 1 && k <= 32);
+			m_keyMask = k == 32 ? ~(uint64_t)0 : ((uint64_t)1 << 2*k) - 1;
+			m_baseMask = ((uint64_t)1 << k) - 1;
+		}
+
+		// Pack the k bases of seq starting at pos
+		inline void set(const std::string& seq, size_t pos)
+		{
+			assert(pos + m_k <= seq.length());
+			m_key = m_invalid = 0;
+			for(size_t i = pos; i < pos + m_k; i++)
+				pushBack(seq[i]);
+		}
+
+		// Shift b in at the end and drop the first base
+		inline void pushBack(char b)
+		{
+			int code = getCode(b);
+			m_key = ((m_key << 2) | (code < 0 ? 0 : code)) & m_keyMask;
+			m_invalid = ((m_invalid << 1) | (code < 0)) & m_baseMask;
+		}
+
+		// Shift b in at the front and drop the last base
+		inline void pushFront(char b)
+		{
+			int code = getCode(b);
+			m_key = (m_key >> 2) | ((uint64_t)(code < 0 ? 0 : code) << 2*(m_k-1));
+			m_invalid = (m_invalid >> 1) | ((uint64_t)(code < 0) << (m_k-1));
+		}
+
+		inline bool isValid() const { return m_invalid == 0; }
+		inline uint64_t getKey() const { return m_key; }
+		inline size_t getK() const { return m_k; }
+
+		// 2-bit code of an ACGT base, -1 for other bases
+		static inline int getCode(char b)
+		{
+			switch(b)
+			{
+				case 'A': return 0;
+				case 'C': return 1;
+				case 'G': return 2;
+				case 'T': return 3;
+				default: return -1;
+			}
+		}
+
+		// Pack a string of at most 32 bases, returns false if it holds a base other than ACGT
+		static inline bool pack(const std::string& seq, uint64_t& key)
+		{
+			assert(seq.length() <= 32);
+			key = 0;
+			for(size_t i = 0; i < seq.length(); i++)
+			{
+				int code = getCode(seq[i]);
+				if(code < 0)
+					return false;
+				key = (key << 2) | code;
+			}
+			return true;
+		}
+
+		// Pack the reverse complement of seq
+		static inline bool packReverseComplement(const std::string& seq, uint64_t& key)
+		{
+			assert(seq.length() <= 32);
+			key = 0;
+			for(size_t i = seq.length(); i > 0; i--)
+			{
+				int code = getCode(seq[i-1]);
+				if(code < 0)
+					return false;
+				key = (key << 2) | (3 - code);
+			}
+			return true;
+		}
+
+	private:
+		size_t m_k;
+		uint64_t m_keyMask;
+		uint64_t m_baseMask;
+		uint64_t m_key;
+		uint64_t m_invalid;
+};
+
+class PackedKmerHash
+{
+	public:
+		static const size_t npos = (size_t)-1;
+
+		// Positions are binned by intervalSize
+		PackedKmerHash(size_t intervalSize = 35);
+
+		// Make room for n k-mers without growing
+		void reserve(size_t n);
+
+		// Record an occurrence of the k-mer at pos. A new k-mer gets
+		// maxIntervalSize/intervalSize + 1 bins, later positions past
+		// the last bin are counted in it.
+		void add(uint64_t key, size_t k, int64_t pos, size_t maxIntervalSize);
+		inline void add(const PackedKmer& kmer, int64_t pos, size_t maxIntervalSize)
+		{
+			if(kmer.isValid())
+				add(kmer.getKey(), kmer.getK(), pos, maxIntervalSize);
+		}
+
+		// Slot of the k-mer, npos if absent. The table holds a single k-mer size
+		// fixed by the first add. Slots stay valid until the next add.
+		size_t find(uint64_t key, size_t k) const;
+
+		inline size_t size() const { return m_numEntries; }
+
+		inline int64_t getTotalFreq(size_t slot) const { return m_slots[slot].totalFreq; }
+		inline int64_t getTotalSum(size_t slot) const { return m_slots[slot].totalSum; }
+
+		// Sum of the bin of pos and its two neighbours, positions out of
+		// range fall in the first or last bin
+		inline int64_t getSumOfFreq(size_t slot, int64_t pos) const { return sumOfBins(slot, pos, 0); }
+		inline int64_t getSumOfPos(size_t slot, int64_t pos) const { return sumOfBins(slot, pos, 1); }
+
+		inline double getMaxAvgFreq(size_t slot) const { return m_slots[slot].maxAvgFreq; }
+		inline void setMaxAvgFreq(size_t slot, double avgFreq) { m_slots[slot].maxAvgFreq = avgFreq; }
+
+		void printFreq(size_t slot) const;
+
+	private:
+		struct Slot
+		{
+			uint64_t key;
+			size_t binOffset;
+			uint32_t numBins;	// 0 for empty slots
+			int64_t totalFreq;
+			int64_t totalSum;
+			double maxAvgFreq;
+		};
+
+		static inline size_t hash(uint64_t key)
+		{
+			key ^= key >> 33;
+			key *= 0xff51afd7ed558ccdULL;
+			key ^= key >> 33;
+			key *= 0xc4ceb9fe1a85ec53ULL;
+			key ^= key >> 33;
+			return key;
+		}
+
+		inline int clampBin(const Slot& s, int64_t pos) const
+		{
+			int index = pos/m_intervalSize;
+			if(index < 0)
+				return 0;
+			return index > (int)s.numBins-1 ? s.numBins-1 : index;
+		}
+
+		size_t findSlot(uint64_t key) const;
+		void grow(size_t capacity);
+
+		inline int64_t sumOfBins(size_t slot, int64_t pos, size_t field) const
+		{
+			const Slot& s = m_slots[slot];
+			int index = clampBin(s, pos);
+			const int64_t* pBins = &m_arena[s.binOffset];
+			int64_t sum = pBins[2*index + field];
+			if(index > 0)
+				sum += pBins[2*(index-1) + field];
+			if(index < (int)s.numBins-1)
+				sum += pBins[2*(index+1) + field];
+			return sum;
+		}
+
+		int64_t m_intervalSize;
+		size_t m_k;
+		size_t m_numEntries;
+		std::vector<Slot> m_slots;
+
+		// Interleaved frequency and position sums of the bins of every k-mer
+		std::vector<int64_t> m_arena;
+};
+
+#endif
@@ -14,44 +14,17 @@
 #include "RollingNode.h"
 #include "BWTAlgorithms.h"
 
-CircularKmer::CircularKmer(std::string kmer){
-	MAX_SIZE = kmer.length();	
-	item = new char[MAX_SIZE];
-	strncpy(item, kmer.c_str(), MAX_SIZE);
-	
-	head = 0;
-    tail = MAX_SIZE-1;
-}
- 
-void CircularKmer::shiftRight(char c)
-{
-	head = (head+1) % MAX_SIZE;
-	tail = (tail+1) % MAX_SIZE;
-	item[tail] = c;
-	
-}
-
-void CircularKmer::shiftLeft(char c)
-{
-	tail = tail-1;
-	if(tail < 0) tail = MAX_SIZE-1;
-	
-	head = head-1;
-	if(head < 0) head = MAX_SIZE-1;
-	item[head] = c;
-	
-}
-
 // Create a new child node with the given label. Returns a pointer to the new node.
 RollingNode* RollingNode::createChild(const std::string& label)
 {
-    RollingNode* pAdded = new RollingNode(m_pQuery, this);
+    RollingNode* pAdded = new RollingNode(m_pQuery, this, currFwdKmer, currRvcKmer);
     pAdded->extend(label);	
 	
-	pAdded->currFwdKmer = new CircularKmer(*(this->currFwdKmer));
-	pAdded->currRvcKmer = new CircularKmer(*(this->currRvcKmer));
-	pAdded->currFwdHashValue = this->currFwdHashValue;
-	pAdded->currRvcHashValue = this->currRvcHashValue;
+	for(size_t i = 0; i < label.length(); i++)
+	{
+		pAdded->currFwdKmer.pushBack(label[i]);
+		pAdded->currRvcKmer.pushFront(complement(label[i]));
+	}
 	
 	m_children.push_back(pAdded);
     
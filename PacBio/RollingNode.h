@@ -7,71 +7,35 @@
 // 
 // The search tree represents a traversal through implicit FM-index graph
 //
-#ifndef ROLLINGODE_H
-#define ROLLINGODE_H
+#ifndef ROLLINGNODE_H
+#define ROLLINGNODE_H
 
 #include <list>
 #include "BWT.h"
 #include "SAINode.h"
-#include "cyclichash.h"
-
-// Simulate circular queue for a kmer containing head and tail chars
-class CircularKmer{
-    private:
-        char *item;
-        int head;
-        int tail;
-		int MAX_SIZE;
-    public:
-        CircularKmer(std::string kmer);
-		//need copy constructor
-		
-		CircularKmer(const CircularKmer& c)
-		{
-			head = c.head;
-			tail = c.tail;
-			MAX_SIZE = c.MAX_SIZE;
-			item = new char[MAX_SIZE];
-			strncpy(c.item, item, MAX_SIZE);
-		}
-		~CircularKmer(){
-			delete item;
-		}
-        void shiftRight(char c);
-		void shiftLeft(char c);
-        inline char getFirstChar(){return item[head];};
-        inline char getLastChar(){return item[tail];};
-};
- 
+#include "PackedKmerHash.h"
 
 //
 // RollingNode for implementation of FM-index extension using rolling hash
+// The packed kmers ending at the node and their reverse complements are
+// rolled from the parent by one base, so a node owns no heap buffer.
 //
 class RollingNode : public SAINode
 {
     public:
-        RollingNode(const std::string* pQuery, RollingNode* parent):SAINode(pQuery,parent)
+        RollingNode(const std::string* pQuery, RollingNode* parent, const PackedKmer& fwdKmer, const PackedKmer& rvcKmer)
+		:	SAINode(pQuery,parent), currFwdKmer(fwdKmer), currRvcKmer(rvcKmer)
 		{
-			currFwdKmer=currRvcKmer=NULL;
 		}
 		
-        ~RollingNode()
-		{
-			if(currFwdKmer!=NULL)
-				delete currFwdKmer;
-			
-			if(currRvcKmer!=NULL)
-				delete currRvcKmer;
-		};
+        ~RollingNode(){};
 
 		// Add a child node to this node with the given label
-        // Returns a pointer to the created node
+        // Returns a pointer to the created node, whose kmers are rolled over the label
         RollingNode* createChild(const std::string& label);
 
-        CircularKmer* currFwdKmer;
-		CircularKmer* currRvcKmer;
-		size_t currFwdHashValue;
-		size_t currRvcHashValue;
+        PackedKmer currFwdKmer;
+		PackedKmer currRvcKmer;
 };
 
 // leaves of SAIOverlapNode
@@ -6,7 +6,6 @@
 
 #include "RollingPBSelfCTree.h"
 #include "BWTAlgorithms.h"
-#include "cyclichash.h"
 
 using namespace std;
 
@@ -20,21 +19,11 @@ RollingPBSelfCTree::RollingPBSelfCTree(
 					int maxLeavesAllowed) :
                     m_pBWT(pBWT), m_pRBWT(pRBWT), m_smallKmerSize(smallKmerSize), 
 					m_min_SA_threshold(min_SA_threshold), m_maxLeavesAllowed(maxLeavesAllowed),
-					m_expectedLength(0), m_currentLength(0), m_pRootNode(NULL)
+					m_expectedLength(0), m_currentLength(0), m_seedLength(0), m_pRootNode(NULL),
+					m_terminalKey(0), m_isTerminalValid(false)
 {	
-	// L=smallKmerLength*2 bit hash values for all possible kmers of length smallKmerLength:
-	m_rollinghasher = new CyclicHash<size_t, unsigned char>(m_smallKmerSize, 63);
-	assert(m_smallKmerSize<=32);
-	
-	// google dense hashmap requiring set empty key
-	// size_t n = -1;
-	// With the default value of -1, n becomes the largest value representable for size_t 
-	// this special value won't be reported by rollinghasher iff L < 64
-	// kmerHash.set_empty_key(n);
-	
-	// Estimate of largest possible hashtable size for reduce collison
-	// kmerHash.resize(6000);
-
+	// kmers are packed 2 bits per base into 64-bit keys
+	assert(m_smallKmerSize>=1 && m_smallKmerSize<=32);
 }
 
 //
@@ -43,76 +32,86 @@ RollingPBSelfCTree::~RollingPBSelfCTree()
     // Recursively destroy the tree
 	if(m_pRootNode!=NULL)
 		delete m_pRootNode;
-	
-	kmerHashiter hashiter = kmerHash.begin();
-	for(; hashiter != kmerHash.end(); ++hashiter)
-	{
-		delete hashiter->second;
-		hashiter->second = NULL;
-	}
-
-	if(m_rollinghasher!=NULL)
-		delete m_rollinghasher;
 }
 
 // create root node using src
-void RollingPBSelfCTree::initializeSearchTree(std::string src, size_t hashKmerSize)
+void RollingPBSelfCTree::initializeSearchTree(const std::string& src)
 {
 	m_leaves.clear();
+	if(m_pRootNode!=NULL)
+		delete m_pRootNode;
+
+	// extract suffix of length smallKmerSize
+	PackedKmer fwdKmer(m_smallKmerSize), rvcKmer(m_smallKmerSize);
+	fwdKmer.set(src, src.length() - m_smallKmerSize);
+	rvcKmer.set(reverseComplement(src.substr(src.length() - m_smallKmerSize)), 0);
 
 	// Create the root node containing the seed string
-    RollingNode *pRootNode = new RollingNode(&src, NULL);	
+    RollingNode *pRootNode = new RollingNode(&src, NULL, fwdKmer, rvcKmer);	
 	// store initial str of root
     pRootNode->computeInitial(src);
 	
-	// extract suffix of length minOverlap
-    std::string beginningkmer=src.substr(src.length() - hashKmerSize);
-	// std::cout << beginningkmer << "\n";
-
-	// Compute initial SA intervals in both forward and reverse BWT
-    pRootNode->currFwdKmer = new CircularKmer(beginningkmer);
-    pRootNode->currFwdHashValue = m_rollinghasher->hashString(beginningkmer);
-	
-	std::string rvckmer = reverseComplement(beginningkmer);
-	pRootNode->currRvcKmer = new CircularKmer(rvckmer);
-	pRootNode->currRvcHashValue = m_rollinghasher->hashString(rvckmer);
-	
 	m_leaves.push_back(pRootNode);
 	
 	m_pRootNode = pRootNode;	
 	m_seedLength = src.length();
 	m_currentLength = src.length();
-	
-	// std::cout << beginningkmer << "\t" << pRootNode->fwdInterval.size() << "\t" << pRootNode->rvcInterval.size() << "\n";
-	
 }
 
-void RollingPBSelfCTree::initializeTerminalHashValues(std::string dest, size_t hashKmerSize)
+void RollingPBSelfCTree::initializeTerminalKmer(const std::string& dest)
 {
 	//ending kmer is a prefix of dest
-    //initialize the ending SA intervals with kmer length=m_minOverlap	
-	std::string endingkmer = dest.substr(0, hashKmerSize);
-	m_fwdTerminatedValue = m_rollinghasher->hashString(endingkmer);
-	endingkmer = reverseComplement(endingkmer);
-	m_rvcTerminatedValue = m_rollinghasher->hashString(endingkmer); 
+	m_isTerminalValid = PackedKmer::pack(dest.substr(0, m_smallKmerSize), m_terminalKey);
+}
+
+// Collect kmers from both seeds and extend from the source to the target
+int RollingPBSelfCTree::mergeTwoSeeds(const std::string& src, const std::string& dest, int disBetweenSrcTarget, std::string& mergedseq)
+{
+	assert(src.length() >= m_smallKmerSize && dest.length() >= m_smallKmerSize);
+	
+	// PacBio reads are longer or shorter than the real length due to indels
+	const double maxRatio = 1.1;
+	const double minRatio = 0.9;
+	const int minOffSet = 30;	//PB159615_16774.fa contains large indels > 30bp
+	const size_t k = m_smallKmerSize;
+	
+	// Collect local kmer frequency from source upto srcMaxLength
+	std::string srcStr = src.substr(src.length() - k);
+	size_t srcMaxLength = maxRatio*(disBetweenSrcTarget+minOffSet) + srcStr.length() + k;
+	bool isSrcCollected = addHashBySingleSeed(srcStr, k, srcMaxLength);
+
+	// Collect local kmer frequency from target upto targetMaxLength
+	std::string rvcTargetStr = reverseComplement(dest.substr(0, k));
+	size_t targetMaxLength = maxRatio*(disBetweenSrcTarget+minOffSet) + rvcTargetStr.length() + k;
+	size_t expectedLength = disBetweenSrcTarget + rvcTargetStr.length();
+	bool isTargetCollected = addHashBySingleSeed(rvcTargetStr, k, targetMaxLength, expectedLength);
+
+	// both seeds are simple repeats
+	if(!isSrcCollected && !isTargetCollected)
+		return -3;
+
+	int srcMinLength = minRatio*(disBetweenSrcTarget-minOffSet) + srcStr.length() + k;
+	if(srcMinLength < 0) srcMinLength = 0;
+	expectedLength = srcStr.length() + disBetweenSrcTarget + dest.length();
+	
+	return mergeTwoSeedsUsingHash(srcStr, dest, mergedseq, srcMinLength, srcMaxLength, expectedLength);
 }
 
-// find feasible extension using kmers collected by addHashFromSingleSeed or addHashFromPairedSeed
+// find feasible extension using kmers collected by addHashBySingleSeed
 int RollingPBSelfCTree::mergeTwoSeedsUsingHash(const std::string &src, const std::string &dest, std::string &mergedseq, 
 											size_t minLength, size_t maxLength, size_t expectedLength)
 {	
-	initializeSearchTree(src, m_smallKmerSize);
-	initializeTerminalHashValues(dest, m_smallKmerSize);
+	initializeSearchTree(src);
+	initializeTerminalKmer(dest);
 	m_expectedLength = expectedLength;
 	
 	SAIntervalNodeResultVector results;
 	while(!m_leaves.empty() && m_leaves.size() <= m_maxLeavesAllowed &&  (size_t)m_currentLength <= maxLength)
 	{
-		// std::cout << m_leaves.size() << "\t" << currentLength << "\t" << expectedLength << "\t" << maxLength << "\n";		
 		RollingNodePtrList newLeaves;
 	
 		// attempt to extend one base for each leave
-		attempToExtendUsingRollingHash(newLeaves, m_smallKmerSize);
+		attempToExtendUsingRollingHash(newLeaves);
 
 		// extension succeed
 		if(!newLeaves.empty())
@@ -124,12 +123,6 @@ int RollingPBSelfCTree::mergeTwoSeedsUsingHash(const std::string &src, const std
 		// see if terminating string is reached
 		if( (size_t) m_currentLength >= minLength)
 			isTerminated(results);
-
-		// if(src.length() == 2216 || src.length() == 2190 || src.length() == 1112){
-			// std::cout << src << "\n";
-			// getchar();
-			// printLeaves(m_smallKmerSize);
-		// }
 	}
 	
 	string ans;
@@ -148,8 +141,6 @@ int RollingPBSelfCTree::mergeTwoSeedsUsingHash(const std::string &src, const std
 			else
 				tmpseq=results[i].thread;
 				
-			//if(debug == true) cout << ">" << i << endl << tmpseq << endl;
-			
 			size_t cov = results[i].SAICoverage;
 			int ansDiff = tmpseq.length() - m_expectedLength;
 			
@@ -169,188 +160,98 @@ int RollingPBSelfCTree::mergeTwoSeedsUsingHash(const std::string &src, const std
     }
 	
     // Did not reach the terminal kmer
-    if(m_leaves.empty() && m_currentLength >= (int)(expectedLength-m_seedLength)/2+m_seedLength)
+    if(m_leaves.empty())
         return -1;	// high error
-    else if( (size_t) m_currentLength > maxLength)
-        return -2;	// exceed search depth
     else if(m_leaves.size() > m_maxLeavesAllowed)
         return -3;	// too much repeats
-	else if(m_leaves.empty() && m_currentLength < (int)(expectedLength-m_seedLength)/2+m_seedLength)
-		return -4;
-	else
-		return -5;
+    else
+        return -2;	// exceed search depth
 }
 
 
 // LF-mapping of each SA index in the interval independently using loop instead of BFS tree expansion
 // Contaminated reads often are simple repeats C* or T* with large freq
-// Give up this read if the freq is way too large
-bool RollingPBSelfCTree::addHashBySingleSeed(std::string& seedStr, size_t largeKmerSize, size_t smallKmerSize, size_t maxLength, int expectedLength)
+// Give up this seed if the freq is way too large
+bool RollingPBSelfCTree::addHashBySingleSeed(const std::string& seedStr, size_t largeKmerSize, size_t maxLength, int expectedLength)
 {
 	// PacBio errors create repeat-like seeds with large interval
 	// limit the upper bound of interval for speedup
 	const int64_t maxIntervalSize = 25;
+	const size_t smallKmerSize = m_smallKmerSize;
 	
 	// LF-mapping of each fwd index
+	assert(seedStr.length() >= largeKmerSize && largeKmerSize >= smallKmerSize);
 	std::string initKmer = seedStr.substr(seedStr.length() - largeKmerSize);
     BWTInterval fwdInterval=BWTAlgorithms::findInterval(m_pRBWT, reverse(initKmer));
 	BWTInterval rvcInterval=BWTAlgorithms::findInterval(m_pBWT, reverseComplement(initKmer));
 
-	std::cout << largeKmerSize << "\t" << fwdInterval.size() << "\t" << rvcInterval.size() <<"\n";
+	size_t kmerFreq = 0;
+	kmerFreq += fwdInterval.isValid()?fwdInterval.size():0;
+	kmerFreq += rvcInterval.isValid()?rvcInterval.size():0;
+	if(kmerFreq > 128) return false;
+
+	// the kmer at currentLength is collected at pos currentLength - seed length from the source,
+	// or at the matching pos counted from the source when walking from the target
+	const int64_t seedLength = seedStr.length();
+	auto kmerPos = [=](int64_t currentLength)->int64_t
+	{
+		return expectedLength<0 ? currentLength - seedLength : expectedLength - currentLength + (int64_t)smallKmerSize;
+	};
+
+	// small hash kmers at the end of the seed, rolled along the extensions
+	PackedKmer seedFwdKmer(smallKmerSize), seedRvcKmer(smallKmerSize);
+	seedFwdKmer.set(seedStr, seedStr.length() - smallKmerSize);
+	seedRvcKmer.set(reverseComplement(seedStr.substr(seedStr.length() - smallKmerSize)), 0);
 	
 	for(int64_t fwdRootIndex = fwdInterval.lower; 
 		fwdInterval.isValid() && fwdRootIndex <= fwdInterval.upper &&  fwdRootIndex - fwdInterval.lower < maxIntervalSize; 
 		fwdRootIndex++)
 	{
-		// extract small hash Kmer
-		// std::string currentFwdKmer = seedStr.substr(seedStr.length() - smallKmerSize);
-		std::string initKmer = seedStr.substr(seedStr.length() - smallKmerSize);
-		CircularKmer currentFwdKmer(initKmer);
-		
-		// m_rollinghasher can be only one instance in each tree due to mapping by random number generator
-		m_rollinghasher->hashString(initKmer);
+		// the first and last kmers in the seeds must be added.
+		PackedKmer currentFwdKmer = seedFwdKmer;
+		insertKmerToHash(currentFwdKmer, kmerPos(seedLength), maxLength);
 		
 		int64_t fwdIndex = fwdRootIndex;
-		for(int64_t currentLength = (int64_t)seedStr.length(); currentLength <= (int64_t)maxLength; currentLength++)
+		for(int64_t currentLength = seedLength+1; currentLength <= (int64_t)maxLength; currentLength++)
 		{
 			char b = m_pRBWT->getChar(fwdIndex);
 			if(b == '$') break;
 			
 			// remove first char, append b to last char
-			m_rollinghasher->update(currentFwdKmer.getFirstChar(), b);
-			currentFwdKmer.shiftRight(b);
-			
-			// kmerHashiter hashiter = kmerHash.find(currentFwdKmer);
-			kmerHashiter hashiter = kmerHash.find(m_rollinghasher->hashvalue);
-			
-			if(hashiter == kmerHash.end())
-			{
-				KmerFeatures *newEntry;
-				if(expectedLength<0)
-					newEntry = new KmerFeatures(currentLength-seedStr.length(), maxLength);
-				else
-					newEntry = new KmerFeatures(expectedLength - currentLength + smallKmerSize, maxLength);
-					
-				// kmerHash.insert(std::make_pair<std::string, KmerFeatures*>(currentFwdKmer, newEntry));
-				kmerHash.insert(std::make_pair<size_t, KmerFeatures*>(m_rollinghasher->hashvalue, newEntry));
-			}
-			else
-			{
-				if(expectedLength<0)
-					hashiter->second->add(currentLength-seedStr.length());
-				else
-					hashiter->second->add(expectedLength - currentLength + smallKmerSize);
-			}
+			currentFwdKmer.pushBack(b);
+			insertKmerToHash(currentFwdKmer, kmerPos(currentLength), maxLength);
+
 			// LF mapping
             fwdIndex = m_pRBWT->getPC(b) + m_pRBWT->getOcc(b, fwdIndex - 1);			
 		}
 	}
 
-	std::cout << kmerHash.size() << "\n";
-
 	// LF-mapping of each rvc index	
 	for(int64_t rvcRootIndex=rvcInterval.lower; 
 		rvcRootIndex <= rvcInterval.upper && rvcInterval.isValid() && rvcRootIndex - rvcInterval.lower < maxIntervalSize; 
 		rvcRootIndex++)
 	{
-		std::string initKmer = reverseComplement( seedStr.substr(seedStr.length() - smallKmerSize) );
-		CircularKmer currentRvcKmer(initKmer);
-		
-		m_rollinghasher->hashString(initKmer);
+		PackedKmer currentRvcKmer = seedRvcKmer;
+		insertKmerToHash(currentRvcKmer, kmerPos(seedLength), maxLength);
 
 		int64_t rvcIndex = rvcRootIndex;
-		
-		for(int64_t currentLength = (int64_t)seedStr.length(); currentLength <= (int64_t)maxLength; currentLength++)
+		for(int64_t currentLength = seedLength+1; currentLength <= (int64_t)maxLength; currentLength++)
 		{
 			char b = m_pBWT->getChar(rvcIndex);
 			if(b == '$') break;
 			
 			// remove last char, prepend b to first char
-			m_rollinghasher->reverse_update(b, currentRvcKmer.getLastChar());
-			currentRvcKmer.shiftLeft(b);
+			currentRvcKmer.pushFront(b);
+			insertKmerToHash(currentRvcKmer, kmerPos(currentLength), maxLength);
 
-			kmerHashiter hashiter = kmerHash.find(m_rollinghasher->hashvalue);
-			if(hashiter == kmerHash.end())
-			{				
-				KmerFeatures *newEntry;
-				if(expectedLength<0)
-					newEntry = new KmerFeatures(currentLength - seedStr.length(), maxLength);
-				else
-					newEntry = new KmerFeatures(expectedLength - currentLength + smallKmerSize, maxLength);
-					
-				// kmerHash.insert(std::make_pair<std::string, KmerFeatures*>(currentRvcKmer, newEntry));
-				kmerHash.insert(std::make_pair<size_t, KmerFeatures*>(m_rollinghasher->hashvalue, newEntry));
-			}
-			else
-			{
-				if(expectedLength<0)
-					hashiter->second->add(currentLength-seedStr.length());
-				else
-					hashiter->second->add(expectedLength - currentLength + smallKmerSize);
-			}
 			// LF mapping
             rvcIndex = m_pBWT->getPC(b) + m_pBWT->getOcc(b, rvcIndex - 1);
 		}
 	}
 	
-	std::cout << kmerHash.size() << "\n";
 	return true;
 }
 
-// void RollingPBSelfCTree::printLeaves(size_t hashKmerSize)
-// {
-	// std::cout << m_leaves.size() << ":" << m_currentLength << "\n";
-	//Bamboo.PB.45195.gap.fa
-	//cout << "CGCCAGCTGAGCTGGCGGTGTGAAATCAGGCAGTCAGGCGGCTCGCGTCTTGCGCGATAACCAGTTCTTCGTTGGTTGGGATAACCACCGCAGGACGGGTACCTTCTTTGTTGATGAAACCAGATTTGCCGAAACGTGCAGCCAGGTTGCGTTCATGATCAACTTCAAAGCCCAGCACGCCCAGTTTGCCCAGAGACAGTTCACGA\n";
-
-	//PB248_9895	
-	// cout << "GCGAGACGGTATTACCCGGCCCCTGGTCGCGCGGCAGGTTATGAATATTCTGTTCATGCAGGGAAAAACTCCCCGCCAGTGTAGCGATTTCACGCTCAGCAACATGGCGCGGCACACCAGCTAATAGAACTTCTCCACGCATCTGCACAATGTTCCCGCGCTCGCCAAGTTGCAAGGTGTTAAACGATGCCACGGGCGAGACTTCCGTTGCCAC\n";
-	// for(STNodePtrList::iterator iter = m_leaves.begin(); iter != m_leaves.end(); ++iter)
-	// {
-		// std::string STNodeStr = (*iter)->getFullString();
-		// std::string fwdrepeatunit = (*iter)->getSuffix(hashKmerSize);
-		// kmerHashiter hashiter = kmerHash.find(fwdrepeatunit);
-		
-		// if(hashiter!=kmerHash.end() 
-			// // && kmerHash[fwdrepeatunit]->getTotalFreq() > 0 
-			// // && kmerHash[fwdrepeatunit]->getSumOfFreq(m_currentLength-m_seedLength)>0 
-		  // )
-		// {
-			// std::cout << STNodeStr.substr(m_seedLength-hashKmerSize) << " " << fwdrepeatunit 
-			// << ":" << kmerHash[fwdrepeatunit]->getTotalFreq() 
-			// << ":" << kmerHash[fwdrepeatunit]->getSumOfFreq(m_currentLength-m_seedLength) 
-			// // << ":" << kmerHash[fwdrepeatunit]->getTotalSum()/kmerHash[fwdrepeatunit]->getTotalFreq() + src.length()
-			// // << ":" << kmerHash[fwdrepeatunit]->getSumOfPos(m_currentLength-m_seedLength)/ kmerHash[fwdrepeatunit]->getSumOfFreq(m_currentLength-m_seedLength)+m_seedLength
-			// ;
-		// }
-		
-		// std::string rvcrepeatunit = reverseComplement(fwdrepeatunit);
-		// kmerHashiter hashiter2 = kmerHash.find(rvcrepeatunit);
-		
-		
-		// if(hashiter2!=kmerHash.end() 
-			// // && kmerHash[rvcrepeatunit]->getTotalFreq() > 0 
-			// // && kmerHash[rvcrepeatunit]->getSumOfFreq(m_currentLength-m_seedLength)>0 
-			// )
-		// {
-			// std::cout << "-"  << " " << rvcrepeatunit
-			// << ":" << kmerHash[rvcrepeatunit]->getTotalFreq() 
-			// << ":" << kmerHash[rvcrepeatunit]->getSumOfFreq(m_currentLength-m_seedLength) 
-			// // << ":" << kmerHash[rvcrepeatunit]->getTotalSum()/kmerHash[rvcrepeatunit]->getTotalFreq() + m_seedLength
-			// // << ":" << kmerHash[rvcrepeatunit]->getSumOfPos(m_currentLength-m_seedLength)/ kmerHash[rvcrepeatunit]->getSumOfFreq(m_currentLength-m_seedLength)+m_seedLength
-			// ;
-		// }
-		
-		// if(hashiter!=kmerHash.end() || hashiter2!=kmerHash.end())
-		// {
-			// std::cout << "--" << (double)(*iter)->getKmerCount()/m_currentLength;
-			// std::cout << "\n"; 
-		// }
-		
-		// // assert(hashiter!=kmerHash.end() || hashiter2!=kmerHash.end());
-	// }
-// }
-
 // Print the string represented by every node
 void RollingPBSelfCTree::printAll()
 {
@@ -359,75 +260,47 @@ void RollingPBSelfCTree::printAll()
 }
 
 // Extend each leaf node
-void RollingPBSelfCTree::attempToExtendUsingRollingHash(RollingNodePtrList &newLeaves, size_t hashKmerSize)
+void RollingPBSelfCTree::attempToExtendUsingRollingHash(RollingNodePtrList &newLeaves)
 {
+	const int64_t pos = m_currentLength - m_seedLength;
+	
     for(RollingNodePtrList::iterator iter = m_leaves.begin(); iter != m_leaves.end(); ++iter)
     {
 		for(int i = 1; i < BWT_ALPHABET::size; ++i) //i=A,C,G,T
 		{
-			size_t kmerFreq = 0;
-
-			// compute new forward hash value using rollinghasher
 			char b = BWT_ALPHABET::getChar(i);
-			size_t newFwdHashValue;
+
+			// roll the forward and reverse complement kmers of the leaf over b
+			PackedKmer newFwdKmer = (*iter)->currFwdKmer;
+			newFwdKmer.pushBack(b);
+			PackedKmer newRvcKmer = (*iter)->currRvcKmer;
+			newRvcKmer.pushFront(complement(b));
+			if(!newFwdKmer.isValid())
+				continue;
 			
-			if((*iter)->currFwdHashValue == (size_t) -1)
-			{
-				std::string newKmer = (*iter)->getSuffix(hashKmerSize-1);
-				newKmer = newKmer + b;
-				newFwdHashValue = m_rollinghasher->hashString(newKmer);				
-			}
-			else 
-				newFwdHashValue = m_rollinghasher->update((*iter)->currFwdHashValue, 
-													 (*iter)->currFwdKmer->getFirstChar(),
-													 b);
-													 
-			// query frequency using dense hashmap
-			kmerHashiter fwditer = kmerHash.find(newFwdHashValue);
+			size_t fwdSlot = kmerHash.find(newFwdKmer.getKey(), m_smallKmerSize);
+			size_t rvcSlot = kmerHash.find(newRvcKmer.getKey(), m_smallKmerSize);
 			
 			// bubble removal by greedily keeping the path with larger avg frequency
+			// Bubble removal produces false removal, perform only when leaves are getting larger than 8
 			double currAvgFreq = (double)(*iter)->getKmerCount()/m_currentLength;					
-			if( fwditer!=kmerHash.end() && currAvgFreq < fwditer->second->getMaxAvgFreq())
+			if( fwdSlot!=PackedKmerHash::npos && m_leaves.size()>8 && currAvgFreq < kmerHash.getMaxAvgFreq(fwdSlot))
 				continue;
-			else if(fwditer!=kmerHash.end() && currAvgFreq > fwditer->second->getMaxAvgFreq())
-				fwditer->second->setMaxAvgFreq( currAvgFreq );
+			else if(fwdSlot!=PackedKmerHash::npos && currAvgFreq > kmerHash.getMaxAvgFreq(fwdSlot))
+				kmerHash.setMaxAvgFreq(fwdSlot, currAvgFreq);
 				
-			if(fwditer!=kmerHash.end())
-				kmerFreq += fwditer->second->getSumOfFreq(m_currentLength - m_seedLength);
-			else
-				newFwdHashValue = (size_t)-1;
-
-			// compute new rvc hash value using rollinghasher
-			char rvcb = BWT_ALPHABET::getChar(5-i);
-			size_t newRvcHashValue;
-
-			if((*iter)->currRvcHashValue == (size_t) -1)
-			{
-				std::string newKmer = (*iter)->getSuffix(hashKmerSize-1);
-				newKmer = reverseComplement(newKmer);
-				newKmer = b + newKmer;
-				newRvcHashValue = m_rollinghasher->hashString(newKmer);				
-			}
-			else 
-				newRvcHashValue= m_rollinghasher->reverse_update((*iter)->currRvcHashValue, 
-															rvcb,
-														   (*iter)->currRvcKmer->getLastChar());
-																	
-			kmerHashiter rvciter = kmerHash.find(newRvcHashValue);
-			if(rvciter!=kmerHash.end())
-				kmerFreq += rvciter->second->getSumOfFreq(m_currentLength - m_seedLength);
-			else
-				newRvcHashValue = -1;
+			// Restricted to local kmer frequency
+			size_t kmerFreq = 0;
+			if(fwdSlot!=PackedKmerHash::npos)
+				kmerFreq += kmerHash.getSumOfFreq(fwdSlot, pos);
+			if(rvcSlot!=PackedKmerHash::npos)
+				kmerFreq += kmerHash.getSumOfFreq(rvcSlot, pos);
 				
 			if(kmerFreq > m_min_SA_threshold)
 			{
 				std::string bstr;
 				bstr.push_back(b);
 				RollingNode* pChildNode = (*iter)->createChild(bstr);
-				pChildNode->currFwdHashValue = newFwdHashValue;
-				pChildNode->currRvcHashValue = newRvcHashValue;				
-				pChildNode->currFwdKmer->shiftRight(b);
-				pChildNode->currRvcKmer->shiftLeft(rvcb);
 								
 				// inherit kmer freq from parents
 				pChildNode->addKmerCount((*iter)->getKmerCount());
@@ -438,38 +311,22 @@ void RollingPBSelfCTree::attempToExtendUsingRollingHash(RollingNodePtrList &newL
 	}
 }
 
-
-// Check for leaves whose extension has terminated. If the leaf has
-// terminated, the walked string and coverage is pushed to the result vector
-
 // Check for leaves whose extension has terminated. If the leaf has
 // terminated, the walked string and coverage is pushed to the result vector
 bool RollingPBSelfCTree::isTerminated(SAIntervalNodeResultVector& results)
 {
 	bool found = false;
+	if(!m_isTerminalValid)
+		return found;
 
     for(RollingNodePtrList::iterator iter = m_leaves.begin(); iter != m_leaves.end(); ++iter)
     {
-        size_t currFwdHashvalue=(*iter)->currFwdHashValue;
-        size_t currRvcHashvalue=(*iter)->currRvcHashValue;
-
-
-		//The current SA interval stands for a string >= terminating kmer
-		//If terminating kmer is a substr, the current SA interval is a sub-interval of the terminating interval
-        bool isFwdTerminated= currFwdHashvalue == m_fwdTerminatedValue;
-        bool isRvcTerminated= currRvcHashvalue == m_rvcTerminatedValue;
-
-        if(isFwdTerminated || isRvcTerminated)
+		// the leaf ends with the prefix kmer of dest
+        if((*iter)->currFwdKmer.isValid() && (*iter)->currFwdKmer.getKey() == m_terminalKey)
         {
-            std::string STNodeStr = (*iter)->getFullString();
-			// std::cout << "Terminated: " << STNodeStr << "\n";
-			
             SAIntervalNodeResult STresult;
-            STresult.thread=STNodeStr;
+            STresult.thread=(*iter)->getFullString();
 			STresult.SAICoverage=(*iter)->getKmerCount();
-
-            //compute the merged pos right next to the kmer on 2nd read.
-            //STresult.index = m_minOverlap ;
             results.push_back(STresult);
             found =  true;
         }
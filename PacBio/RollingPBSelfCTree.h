@@ -10,19 +10,17 @@
 #include <list>
 #include "BWT.h"
 #include "BWTAlgorithms.h"
-#include "SAIPBSelfCTree.h"
+#include "SAINode.h"
 #include "RollingNode.h"
-#include "HashMap.h"
-
-
-// Return a hash key for a Kmer
-// The real hash function is implemented using rolling hash
-struct RollingHasher
-{
-    size_t operator()(const size_t& key) const { return key; }
-};
-
-
+#include "PackedKmerHash.h"
+
+//
+// RollingPBSelfCTree - Bridge two seeds by extending the source one base at a time,
+// guided by the local frequency of the kmers on the reads overlapping both seeds.
+// The kmers are collected by LF-mapping from the seeds and looked up by rolling
+// their packed forward and reverse complement keys, which costs no rank query
+// per extension in contrast to the SA-interval trees.
+//
 class RollingPBSelfCTree
 {
     public: 
@@ -31,25 +29,24 @@ class RollingPBSelfCTree
 		
         ~RollingPBSelfCTree();
 
-		// Collect kmers from overlapping reads via right extension of single seed
-		// void addHashFromSingleSeedUsingFMExtension(std::string& seedStr, size_t hashKmerSize, size_t maxLength);
-		
+		// Collect the kmers of both seeds and bridge the disBetweenSrcTarget bases between them.
+		// src ends with and dest starts with at least smallKmerSize bases. The merged sequence
+		// starts with the last smallKmerSize bases of src and ends with dest.
+		// Return 1 on success, -1 for high error, -2 when exceeding the search depth,
+		// -3 for too many leaves.
+		int mergeTwoSeeds(const std::string& src, const std::string& dest, int disBetweenSrcTarget, std::string& mergedseq);
+
 		// LF-mapping of each SA index in the interval independently using loop instead of BFS tree expansion
 		// Contaminated reads often are simple repeats C* or T* with large freq
 		// Return false if the freq is way too large
-		bool addHashBySingleSeed(std::string& seedStr, size_t largeKmerSize, size_t smallKmerSize, size_t maxLength, int expectedLength=-1);
+		bool addHashBySingleSeed(const std::string& seedStr, size_t largeKmerSize, size_t maxLength, int expectedLength=-1);
 
-		// Collect kmers from overlapping reads via FM-index walk between two seeds
-		// int addHashFromPairedSeed(std::string seedStr, std::vector<std::pair<int, std::string> >  &targets, size_t hashKmerSize);
-		
-        // find feasible extension using kmers collected by addHashFromSingleSeed or addHashFromPairedSeed
+        // find feasible extension using kmers collected by addHashBySingleSeed
 		int mergeTwoSeedsUsingHash(const std::string &src, const std::string &dest, std::string &mergedseq, 
 								size_t minLength, size_t maxLength, size_t expectedLength);
 		
-		
         // Print all the strings represented by the tree
         void printAll();
-		void printLeaves(size_t hashKmerSize);
 
     private:
 
@@ -57,10 +54,16 @@ class RollingPBSelfCTree
         // Functions
         //
 		// create root node using src
-		void initializeSearchTree(std::string src, size_t hashKmerSize);
-		void initializeTerminalHashValues(std::string dest, size_t hashKmerSize);
+		void initializeSearchTree(const std::string& src);
+		void initializeTerminalKmer(const std::string& dest);
 
-		void attempToExtendUsingRollingHash(RollingNodePtrList &newLeaves, size_t hashKmerSize);
+		void attempToExtendUsingRollingHash(RollingNodePtrList &newLeaves);
+		
+		// insert kmer at pos into kmerHash
+		inline void insertKmerToHash(const PackedKmer& kmer, int64_t pos, size_t maxLength)
+		{
+			kmerHash.add(kmer, pos, maxLength);
+		}
 		
         // Check if the leaves can be extended no further
 		bool isTerminated(SAIntervalNodeResultVector& results);
@@ -80,23 +83,15 @@ class RollingPBSelfCTree
 		int m_currentLength;
 		int m_seedLength;
 		
-		// std::vector<END> ENDs;
-
         RollingNode* m_pRootNode;
         RollingNodePtrList m_leaves;
 
-        size_t m_fwdTerminatedValue;   //in rBWT
-        size_t m_rvcTerminatedValue;   //in BWT
-
-		
-		// DenseHashMap<size_t, KmerFeatures*, RollingHasher> kmerHash;
-		// typedef DenseHashMap<size_t, KmerFeatures*>::iterator kmerHashiter;
-
-		HashMap<size_t, KmerFeatures*, RollingHasher> kmerHash;
-		typedef HashMap<size_t, KmerFeatures*>::iterator kmerHashiter;
+		// key of the prefix kmer of dest
+		uint64_t m_terminalKey;
+		bool m_isTerminalValid;
 
-		// m_rollinghasher can be only one instance in each tree due to mapping by random number generator
-		CyclicHash<size_t, unsigned char> *m_rollinghasher;
+		// kmers of both strands collected from the source and target share one table
+		PackedKmerHash kmerHash;
 };
 
 
@@ -12,7 +12,7 @@ using namespace std;
 
 //
 // Class: SAIntervalTree
-SAIntervalPBHybridCTree::SAIntervalPBHybridCTree(FMWalkParameters parameters):
+SAIntervalPBHybridCTree::SAIntervalPBHybridCTree(const FMWalkParameters& parameters):
 	m_pSourceSeed(&parameters.sourceSeed), 
 	m_strBetweenSrcTarget(parameters.strBetweenSrcTarget),
 	m_targetSeed(parameters.targetSeed),
@@ -43,7 +43,7 @@ struct FMWalkResult
 class SAIntervalPBHybridCTree
 {
     public:
-        SAIntervalPBHybridCTree(FMWalkParameters parameters);
+        SAIntervalPBHybridCTree(const FMWalkParameters& parameters);
 
         ~SAIntervalPBHybridCTree();
 
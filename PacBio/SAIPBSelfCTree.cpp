@@ -25,9 +25,7 @@ SAIPBSelfCorrectTree::SAIPBSelfCorrectTree(
 					m_expectedLength(0), m_currentLength(0), m_pRootNode(NULL), m_isSourceRepeat(false), 
 					m_isTargetRepeat(false), m_isLargeLeaveRemoved(false), m_prevExtPos(0),m_rawSeq(rawSeq),m_maxLength(srcmaxLength)
 {
-	// initialize google dense hashmap
-	kmerHash.set_empty_key("");
-	kmerHash.resize(6000);
+	kmerHash.reserve(6000);
 }
 
 //
@@ -36,17 +34,6 @@ SAIPBSelfCorrectTree::~SAIPBSelfCorrectTree()
     // Recursively destroy the tree
 	if(m_pRootNode!=NULL)
 		delete m_pRootNode;
-		
-	kmerHashiter hashiter = kmerHash.begin();
-	for(; hashiter != kmerHash.end(); ++hashiter)
-	{
-		if(hashiter->second!=NULL)
-		{
-			delete hashiter->second;
-			hashiter->second = NULL;
-		}
-	}
-
 }
 
 // create root node using src
@@ -723,13 +710,18 @@ size_t SAIPBSelfCorrectTree::addHashBySingleSeed(std::string& seedStr, size_t la
 	// skip repeat only in the 1st round
 	if(skipRepeat && kmerFreq > 128) return kmerFreq;
 	
+	// small hash kmers at the end of the seed, rolled along the extensions
+	PackedKmer seedFwdKmer(smallKmerSize), seedRvcKmer(smallKmerSize);
+	seedFwdKmer.set(seedStr, seedStr.length() - smallKmerSize);
+	seedRvcKmer.set(reverseComplement(seedStr.substr(seedStr.length() - smallKmerSize)), 0);
+
 	// extend each SA index and collect kmers of smallKmerSize along the extension
 	for(int64_t fwdRootIndex = fwdInterval.lower; 
 		fwdInterval.isValid() && fwdRootIndex <= fwdInterval.upper &&  fwdRootIndex - fwdInterval.lower < maxIntervalSize; 
 		fwdRootIndex++)
 	{
 		// extract small hash Kmer
-		std::string currentFwdKmer = seedStr.substr(seedStr.length() - smallKmerSize);
+		PackedKmer currentFwdKmer = seedFwdKmer;
 
 		// Bug fix: the first and last kmers in the seeds must be added.
 		insertKmerToHash(currentFwdKmer, seedStr.length(), seedStr.length(), smallKmerSize, maxLength, expectedLength);		
@@ -743,7 +735,7 @@ size_t SAIPBSelfCorrectTree::addHashBySingleSeed(std::string& seedStr, size_t la
 			char b = m_pRBWT->getChar(fwdIndex);
 			if(b == '$') break;
 			
-			currentFwdKmer = currentFwdKmer.substr(1) + b;
+			currentFwdKmer.pushBack(b);
             // Fwdread = Fwdread +b ;
 			// std::cout << currentLength << ":" << currentFwdKmer << "\n";
 
@@ -761,7 +753,7 @@ size_t SAIPBSelfCorrectTree::addHashBySingleSeed(std::string& seedStr, size_t la
 		rvcRootIndex <= rvcInterval.upper && rvcInterval.isValid() && rvcRootIndex - rvcInterval.lower < maxIntervalSize; 
 		rvcRootIndex++)
 	{
-		std::string currentRvcKmer = reverseComplement( seedStr.substr(seedStr.length() - smallKmerSize) );
+		PackedKmer currentRvcKmer = seedRvcKmer;
 		insertKmerToHash(currentRvcKmer, seedStr.length(), seedStr.length(), smallKmerSize, maxLength, expectedLength);
 		// std::cout << seedStr.length() << ":" << currentRvcKmer << "\n";
 		int64_t rvcIndex = rvcRootIndex;
@@ -771,7 +763,7 @@ size_t SAIPBSelfCorrectTree::addHashBySingleSeed(std::string& seedStr, size_t la
 			char b = m_pBWT->getChar(rvcIndex);
 			if(b == '$') break;
 			
-			currentRvcKmer = b + currentRvcKmer.substr(0, smallKmerSize-1);
+			currentRvcKmer.pushFront(b);
             // Rvcread = b + Rvcread;
 			insertKmerToHash(currentRvcKmer, seedStr.length(), currentLength, smallKmerSize, maxLength, expectedLength);
 			// std::cout << currentLength << ":" << currentRvcKmer << "\n";
@@ -815,13 +807,18 @@ size_t SAIPBSelfCorrectTree::addHashByExtSeed(std::string& extStr, size_t srcLen
 	
 	// if(kmerFreq > 64 ) return kmerFreq;
 	
+	// small hash kmers at the end of the extension, rolled along the extensions
+	PackedKmer extFwdKmer(smallKmerSize), extRvcKmer(smallKmerSize);
+	extFwdKmer.set(extStr, extStr.length() - smallKmerSize);
+	extRvcKmer.set(reverseComplement(extStr.substr(extStr.length() - smallKmerSize)), 0);
+
 	// extend each SA index and collect kmers of smallKmerSize along the extension
 	for(int64_t fwdRootIndex = fwdInterval.lower; 
 		fwdInterval.isValid() && fwdRootIndex <= fwdInterval.upper &&  fwdRootIndex - fwdInterval.lower < maxIntervalSize; 
 		fwdRootIndex++)
 	{
 		// extract small hash Kmer
-		std::string currentFwdKmer = extStr.substr(extStr.length() - smallKmerSize);
+		PackedKmer currentFwdKmer = extFwdKmer;
 
 		// Bug fix: the first and last kmers in the seeds must be added.
 		insertKmerToHash(currentFwdKmer, srcLength, extStr.length(), smallKmerSize, maxLength, -1);
@@ -833,7 +830,7 @@ size_t SAIPBSelfCorrectTree::addHashByExtSeed(std::string& extStr, size_t srcLen
 			char b = m_pRBWT->getChar(fwdIndex);
 			if(b == '$') break;
 			
-			currentFwdKmer = currentFwdKmer.substr(1) + b;
+			currentFwdKmer.pushBack(b);
 			
 			// if(extStr.length()==105)
 				// std::cout << currentLength << ":" << currentFwdKmer << "\n";
@@ -851,7 +848,7 @@ size_t SAIPBSelfCorrectTree::addHashByExtSeed(std::string& extStr, size_t srcLen
 		rvcRootIndex <= rvcInterval.upper && rvcInterval.isValid() && rvcRootIndex - rvcInterval.lower < maxIntervalSize; 
 		rvcRootIndex++)
 	{
-		std::string currentRvcKmer = reverseComplement( extStr.substr(extStr.length() - smallKmerSize) );
+		PackedKmer currentRvcKmer = extRvcKmer;
 		insertKmerToHash(currentRvcKmer, srcLength, extStr.length(), smallKmerSize, maxLength, -1);
 		
 		int64_t rvcIndex = rvcRootIndex;
@@ -861,7 +858,7 @@ size_t SAIPBSelfCorrectTree::addHashByExtSeed(std::string& extStr, size_t srcLen
 			char b = m_pBWT->getChar(rvcIndex);
 			if(b == '$') break;
 			
-			currentRvcKmer = b + currentRvcKmer.substr(0, smallKmerSize-1);
+			currentRvcKmer.pushFront(b);
 			insertKmerToHash(currentRvcKmer, srcLength, currentLength+1, smallKmerSize, maxLength, -1);
 			// if(extStr.length()==105)
 				// std::cout << currentLength << ":" << currentRvcKmer << "\n";
@@ -873,14 +870,14 @@ size_t SAIPBSelfCorrectTree::addHashByExtSeed(std::string& extStr, size_t srcLen
 	
 	// if(extStr.length()==105)
 	// {
-		// kmerHashiter iter = kmerHash.find("CAGCGTGGTGT");/*GATGCGACGCTGTCG*/
-		// if(iter != kmerHash.end()){
-			// iter->second->printFreq();
+		// size_t fwdSlot, rvcSlot;
+		// findKmerSlots("CAGCGTGGTGT", fwdSlot, rvcSlot);/*GATGCGACGCTGTCG*/
+		// if(fwdSlot != PackedKmerHash::npos){
+			// kmerHash.printFreq(fwdSlot);
 		// }
 		// std::cout << "Reverse Complement\n";
-		// iter = kmerHash.find("ACACCACGCTG");/*CGACAGCGTCGCATC*/
-		// if(iter != kmerHash.end()){
-			// iter->second->printFreq();
+		// if(rvcSlot != PackedKmerHash::npos){
+			// kmerHash.printFreq(rvcSlot);
 		// }
 
 		// std::cout << kmerHash.size() << "\n";
@@ -888,29 +885,26 @@ size_t SAIPBSelfCorrectTree::addHashByExtSeed(std::string& extStr, size_t srcLen
 	return kmerFreq;
 }
 
-void SAIPBSelfCorrectTree::insertKmerToHash(std::string& insertedKmer, size_t seedStrLen, size_t currentLength, size_t smallKmerSize, size_t maxLength, int expectedLength)
+void SAIPBSelfCorrectTree::insertKmerToHash(const PackedKmer& insertedKmer, size_t seedStrLen, size_t currentLength, size_t smallKmerSize, size_t maxLength, int expectedLength)
 {
-	kmerHashiter hashiter = kmerHash.find(insertedKmer);
-	
-	if(hashiter == kmerHash.end())
-	{
-		KmerFeatures *newEntry;
-		// source to target
-		if(expectedLength<0)
-			newEntry = new KmerFeatures(currentLength - seedStrLen, maxLength);
-		// target to source
-		else
-			newEntry = new KmerFeatures(expectedLength - currentLength + smallKmerSize, maxLength);
-			
-		kmerHash.insert(std::make_pair(insertedKmer, newEntry));
-	}
+	// source to target
+	if(expectedLength<0)
+		kmerHash.add(insertedKmer, (int64_t)currentLength - (int64_t)seedStrLen, maxLength);
+	// target to source
 	else
-	{
-		if(expectedLength<0)
-			hashiter->second->add(currentLength - seedStrLen);
-		else
-			hashiter->second->add(expectedLength - currentLength + smallKmerSize);
-	}
+		kmerHash.add(insertedKmer, (int64_t)expectedLength - (int64_t)currentLength + (int64_t)smallKmerSize, maxLength);
+}
+
+// kmers holding bases other than ACGT are never inserted and not found
+void SAIPBSelfCorrectTree::findKmerSlots(const std::string& fwdkmer, size_t& fwdSlot, size_t& rvcSlot) const
+{
+	uint64_t fwdKey, rvcKey;
+	fwdSlot = rvcSlot = PackedKmerHash::npos;
+	if(fwdkmer.length() > 32 || !PackedKmer::pack(fwdkmer, fwdKey))
+		return;
+	PackedKmer::packReverseComplement(fwdkmer, rvcKey);
+	fwdSlot = kmerHash.find(fwdKey, fwdkmer.length());
+	rvcSlot = kmerHash.find(rvcKey, fwdkmer.length());
 }
 
 void SAIPBSelfCorrectTree::printLeaves(size_t hashKmerSize)
@@ -921,48 +915,45 @@ void SAIPBSelfCorrectTree::printLeaves(size_t hashKmerSize)
 	{
 		std::string STNodeStr = (*iter)->getFullString();
 		std::string fwdKmer = (*iter)->getSuffix(hashKmerSize);
-		kmerHashiter hashiter = kmerHash.find(fwdKmer);
+		size_t fwdSlot, rvcSlot;
+		findKmerSlots(fwdKmer, fwdSlot, rvcSlot);
 		std::cout << STNodeStr.substr(m_seedLength-hashKmerSize);
 		
-		if(hashiter!=kmerHash.end() 
-			// && kmerHash[fwdKmer]->getTotalFreq() > 0 
-			// && kmerHash[fwdKmer]->getSumOfFreq(m_currentLength-m_seedLength)>0 
+		if(fwdSlot!=PackedKmerHash::npos 
+			// && kmerHash.getTotalFreq(fwdSlot) > 0 
+			// && kmerHash.getSumOfFreq(fwdSlot, m_currentLength-m_seedLength)>0 
 		  )
 		{
 			std::cout << " " << fwdKmer 
-			// << ":" << kmerHash[fwdKmer]->getTotalFreq()
+			// << ":" << kmerHash.getTotalFreq(fwdSlot)
 			// local kmer frequency at m_currentLength-m_seedLength
-			<< ":" << kmerHash[fwdKmer]->getSumOfFreq(m_currentLength-m_seedLength);
-			// << ":" << kmerHash[fwdKmer]->getTotalSum()/kmerHash[fwdKmer]->getTotalFreq() + src.length()
+			<< ":" << kmerHash.getSumOfFreq(fwdSlot, m_currentLength-m_seedLength);
+			// << ":" << kmerHash.getTotalSum(fwdSlot)/kmerHash.getTotalFreq(fwdSlot) + src.length()
 
-			if(kmerHash[fwdKmer]->getSumOfFreq(m_currentLength-m_seedLength)>0)
-				std::cout << ":" << kmerHash[fwdKmer]->getSumOfPos(m_currentLength-m_seedLength)/kmerHash[fwdKmer]->getSumOfFreq(m_currentLength-m_seedLength)+m_seedLength;
+			if(kmerHash.getSumOfFreq(fwdSlot, m_currentLength-m_seedLength)>0)
+				std::cout << ":" << kmerHash.getSumOfPos(fwdSlot, m_currentLength-m_seedLength)/kmerHash.getSumOfFreq(fwdSlot, m_currentLength-m_seedLength)+m_seedLength;
 		}
 		
-		std::string rvcKmer = reverseComplement(fwdKmer);
-		kmerHashiter hashiter2 = kmerHash.find(rvcKmer);
-		
-		
-		if(hashiter2!=kmerHash.end() 
-			// && kmerHash[rvcKmer]->getTotalFreq() > 0 
-			// && kmerHash[rvcKmer]->getSumOfFreq(m_currentLength-m_seedLength)>0 
+		if(rvcSlot!=PackedKmerHash::npos 
+			// && kmerHash.getTotalFreq(rvcSlot) > 0 
+			// && kmerHash.getSumOfFreq(rvcSlot, m_currentLength-m_seedLength)>0 
 			)
 		{
-			std::cout << "-"  << " " << rvcKmer
-			// << ":" << kmerHash[rvcKmer]->getTotalFreq() 
-			<< ":" << kmerHash[rvcKmer]->getSumOfFreq(m_currentLength-m_seedLength);
-			// << ":" << kmerHash[rvcKmer]->getTotalSum()/kmerHash[rvcKmer]->getTotalFreq() + m_seedLength
-			if(kmerHash[rvcKmer]->getSumOfFreq(m_currentLength-m_seedLength)>0)
-				std::cout << ":" << kmerHash[rvcKmer]->getSumOfPos(m_currentLength-m_seedLength)/kmerHash[rvcKmer]->getSumOfFreq(m_currentLength-m_seedLength)+m_seedLength;
+			std::cout << "-"  << " " << reverseComplement(fwdKmer)
+			// << ":" << kmerHash.getTotalFreq(rvcSlot) 
+			<< ":" << kmerHash.getSumOfFreq(rvcSlot, m_currentLength-m_seedLength);
+			// << ":" << kmerHash.getTotalSum(rvcSlot)/kmerHash.getTotalFreq(rvcSlot) + m_seedLength
+			if(kmerHash.getSumOfFreq(rvcSlot, m_currentLength-m_seedLength)>0)
+				std::cout << ":" << kmerHash.getSumOfPos(rvcSlot, m_currentLength-m_seedLength)/kmerHash.getSumOfFreq(rvcSlot, m_currentLength-m_seedLength)+m_seedLength;
 		}
 		
-		if(hashiter!=kmerHash.end() || hashiter2!=kmerHash.end())
+		if(fwdSlot!=PackedKmerHash::npos || rvcSlot!=PackedKmerHash::npos)
 		{
 			std::cout << "--" << (double)(*iter)->getKmerCount()/m_currentLength;
 			
 		}
 		std::cout << "\n"; 
-		// assert(hashiter!=kmerHash.end() || hashiter2!=kmerHash.end());
+		// assert(fwdSlot!=PackedKmerHash::npos || rvcSlot!=PackedKmerHash::npos);
 	}
 }
 
@@ -1111,50 +1102,45 @@ void SAIPBSelfCorrectTree::attempToExtendUsingHash(STNodePtrList &newLeaves, siz
 }
 
 //return hash kmer freqs
-size_t SAIPBSelfCorrectTree::hashkmerfreqs(std::string fwdkmer,size_t kemrposition)
+size_t SAIPBSelfCorrectTree::hashkmerfreqs(const std::string& fwdkmer,size_t kemrposition)
 {
-    kmerHashiter iter1 = kmerHash.find(fwdkmer);	
-    
-    std::string rvckmer = reverseComplement(fwdkmer);
-    kmerHashiter iter2 = kmerHash.find(rvckmer);
+    size_t fwdSlot, rvcSlot;
+    findKmerSlots(fwdkmer, fwdSlot, rvcSlot);
    
     size_t hashkmerfreqs;
-    hashkmerfreqs = iter1==kmerHash.end()? 0 : iter1->second->getSumOfFreq(kemrposition);
-    // hashkmerfreqs = iter1==kmerHash.end()? 0 : iter1->second->getTotalFreq();
-    hashkmerfreqs += iter2==kmerHash.end()? 0 : iter2->second->getSumOfFreq(kemrposition);
-    // hashkmerfreqs += iter2==kmerHash.end()? 0 : iter2->second->getTotalFreq();
+    hashkmerfreqs = fwdSlot==PackedKmerHash::npos? 0 : kmerHash.getSumOfFreq(fwdSlot, kemrposition);
+    // hashkmerfreqs = fwdSlot==PackedKmerHash::npos? 0 : kmerHash.getTotalFreq(fwdSlot);
+    hashkmerfreqs += rvcSlot==PackedKmerHash::npos? 0 : kmerHash.getSumOfFreq(rvcSlot, kemrposition);
+    // hashkmerfreqs += rvcSlot==PackedKmerHash::npos? 0 : kmerHash.getTotalFreq(rvcSlot);
 
     return hashkmerfreqs;
     
 }
 // check if new extension satisfies frequency, position, ...
-bool SAIPBSelfCorrectTree::isExtensionValid(std::string fwdkmer, double& currAvgFreq, size_t& kmerFreq,size_t bcount)
+bool SAIPBSelfCorrectTree::isExtensionValid(const std::string& fwdkmer, double& currAvgFreq, size_t& kmerFreq,size_t bcount)
 {
 		// PB64756_11478, false low-complexity leaves
 		// if(isLowComplexity(fwdkmer, 0.8))
 			// return false;
 			
-		kmerHashiter iter1 = kmerHash.find(fwdkmer);			
+		size_t fwdSlot, rvcSlot;
+		findKmerSlots(fwdkmer, fwdSlot, rvcSlot);
 		
 		// bubble removal by removing kmer path with avg kmer freq less than previous one
-		// if( iter1!=kmerHash.end() && currAvgFreq < iter1->second->getMaxAvgFreq() ) 
+		// if( fwdSlot!=PackedKmerHash::npos && currAvgFreq < kmerHash.getMaxAvgFreq(fwdSlot) ) 
 		
 		// if(fwdkmer == "GCATCCGGCAA")
-			// std::cout << fwdkmer <<": " << currAvgFreq << "\t" << iter1->second->getMaxAvgFreq() << "\n";
+			// std::cout << fwdkmer <<": " << currAvgFreq << "\t" << kmerHash.getMaxAvgFreq(fwdSlot) << "\n";
 		
 		// Bubble removal preoduces false removal, perform only when leaves are getting larger than 8
-		if( iter1!=kmerHash.end() && m_leaves.size()>8 && currAvgFreq < iter1->second->getMaxAvgFreq() ) 
+		if( fwdSlot!=PackedKmerHash::npos && m_leaves.size()>8 && currAvgFreq < kmerHash.getMaxAvgFreq(fwdSlot) ) 
 			return false;
 					
-		if( iter1!=kmerHash.end() && currAvgFreq > iter1->second->getMaxAvgFreq() )
-			iter1->second->setMaxAvgFreq( currAvgFreq );
+		if( fwdSlot!=PackedKmerHash::npos && currAvgFreq > kmerHash.getMaxAvgFreq(fwdSlot) )
+			kmerHash.setMaxAvgFreq( fwdSlot, currAvgFreq );
 
-		// // do it again for reverse complement kmer
-		std::string rvckmer = reverseComplement(fwdkmer);
-		kmerHashiter iter2 = kmerHash.find(rvckmer);
-		
 		// Restricted to local kmer frequency
-		kmerFreq = iter1==kmerHash.end()? 0 : iter1->second->getSumOfFreq(m_currentLength - m_seedLength);
+		kmerFreq = fwdSlot==PackedKmerHash::npos? 0 : kmerHash.getSumOfFreq(fwdSlot, m_currentLength - m_seedLength);
 
 		// if(fwdkmer == "GCATCCGGCAA")
 		// {
@@ -1162,7 +1148,8 @@ bool SAIPBSelfCorrectTree::isExtensionValid(std::string fwdkmer, double& currAvg
 			// getchar();
 		// }
 		
-		kmerFreq += iter2==kmerHash.end()? 0 : iter2->second->getSumOfFreq(m_currentLength - m_seedLength);
+		// do it again for reverse complement kmer
+		kmerFreq += rvcSlot==PackedKmerHash::npos? 0 : kmerHash.getSumOfFreq(rvcSlot, m_currentLength - m_seedLength);
 		
 		cout<<kmerFreq<<"   kmerFreq\n";
 		if(kmerFreq >= m_min_SA_threshold ||( bcount >= 7 && kmerFreq >= 1) )
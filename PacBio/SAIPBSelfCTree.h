@@ -13,6 +13,7 @@
 #include "BWTAlgorithms.h"
 #include "SAINode.h"
 #include "HashMap.h"
+#include "PackedKmerHash.h"
 
 
 
@@ -26,117 +27,6 @@ struct END
     BWTInterval rvcTerminatedInterval;   //in BWT
 };
 
-// class for storing various features of each kmer in the hashtable, including pos, freq, ...
-class KmerFeatures{
-	private:
-		std::vector<long long int> m_sumOfFreq;
-		std::vector<long long int> m_sumOfPos;
-		long long int m_intervalSize;
-		long long int m_totalFreq;
-		long long int m_totalSum;
-		double m_maxAvgFreq;
-		bool m_isVisited;
-
-    public: 
-		// maxIntervalSize is overestimated to be the max length
-		KmerFeatures(long long int pos, size_t maxIntervalSize, size_t intervalSize=35):
-			m_intervalSize(intervalSize), 
-			m_totalFreq(0),m_totalSum(0), m_maxAvgFreq(0), m_isVisited(false)
-			{
-				m_sumOfFreq.resize(maxIntervalSize/intervalSize + 1);
-				m_sumOfPos.resize(maxIntervalSize/intervalSize + 1);
-				add(pos);
-			}
-			
-		~KmerFeatures(){
-		}
-
-		// increment frequence and compute approximate pos
-		void add(long long int pos)
-		{
-			m_totalFreq++;
-			m_totalSum+=pos;
-			
-			// compute sampled index
-			int index = pos/m_intervalSize;
-			// extension may exceed the expected length
-           
-			if(index < 0)
-				index = 0;
-			else if(index > (int) m_sumOfFreq.size()-1)
-				index = m_sumOfFreq.size()-1;
-
-			
-			m_sumOfFreq[index]++;
-			m_sumOfPos[index]+=pos;
-		}
-		
-		long long int getTotalFreq()
-		{
-			return m_totalFreq;
-		}
-
-		long long int getTotalSum()
-		{
-			return m_totalSum;
-		}
-
-		// convert pos into index in the m_sumOfPos
-		long long int getSumOfFreq(long long int pos)
-		{
-			int index = pos/m_intervalSize;
-           
-			long long int sumOfFreq = m_sumOfFreq[index];
-			if(index > 0)
-				sumOfFreq += m_sumOfFreq[index-1];
-			if(index < (int) m_sumOfFreq.size()-1)
-				sumOfFreq += m_sumOfFreq[index+1];
-				
-			return sumOfFreq;
-		}
-		
-		// convert pos into index in the m_sumOfPos
-		long long int getSumOfPos(long long int pos)
-		{
-			int index = pos/m_intervalSize;
-			long long int sumOfPos = m_sumOfPos[index];
-			if(index > 0)
-				sumOfPos += m_sumOfPos[index-1];
-			if(index < (int) m_sumOfPos.size()-1)
-				sumOfPos += m_sumOfPos[index+1];
-				
-			return sumOfPos;
-		}
-		
-		void printFreq()
-		{
-			for(size_t i=0; i<m_sumOfFreq.size(); i++)
-			{
-				std::cout << i <<":" << m_sumOfFreq[i] << "\t" << m_sumOfPos[i] <<"\n";
-			}
-		}
-		
-		inline void setVisited(bool visited)
-		{
-			m_isVisited = visited;
-		}
-		
-		inline bool isVisited()
-		{
-			return m_isVisited;
-		}
-		
-		inline void setMaxAvgFreq(double newAvgFreq)
-		{
-			m_maxAvgFreq = newAvgFreq;
-		}
-		
-		inline double getMaxAvgFreq()
-		{
-			return m_maxAvgFreq;
-		}
-};
-
 class SAIPBSelfCorrectTree
 {
     public: 
@@ -172,7 +62,7 @@ class SAIPBSelfCorrectTree
         // Print all the strings represented by the tree
         void printAll();
 		void printLeaves(size_t hashKmerSize);
-        size_t hashkmerfreqs(std::string fwdkmer,size_t kemrposition);
+        size_t hashkmerfreqs(const std::string& fwdkmer,size_t kemrposition);
     private:
 
         //
@@ -186,9 +76,12 @@ class SAIPBSelfCorrectTree
         void refineSAInterval(size_t newKmer);
 		std::vector<std::pair<std::string, BWTIntervalPair> > getFMIndexRightExtensions(SAIntervalNode* pNode, const size_t IntervalSizeCutoff);
 		
-		void insertKmerToHash(std::string& insertedKmer, size_t seedStrLen, size_t currentLength, size_t smallKmerSize, size_t maxLength, int expectedLength);
+		void insertKmerToHash(const PackedKmer& insertedKmer, size_t seedStrLen, size_t currentLength, size_t smallKmerSize, size_t maxLength, int expectedLength);
+
+		bool isExtensionValid(const std::string& fwdkmer, double& currAvgFreq, size_t& kmerFreq,size_t bcount);
 
-		bool isExtensionValid(std::string fwdkmer, double& currAvgFreq, size_t& kmerFreq,size_t bcount);
+		// slots of fwdkmer and its reverse complement in kmerHash
+		void findKmerSlots(const std::string& fwdkmer, size_t& fwdSlot, size_t& rvcSlot) const;
 		
 		void NewextendByNewSeeds(const std::string& src, const std::string& dest, size_t hashKmerSize, size_t maxLength,std::string currseq);
 		
@@ -273,8 +166,8 @@ class SAIPBSelfCorrectTree
         BWTInterval m_rvcTerminatedInterval;   //in BWT
 		
 		// multiple means for repeats leading to multinomial occurrences
-		DenseHashMap<std::string, KmerFeatures*, StringHasher> kmerHash;
-		typedef DenseHashMap<std::string, KmerFeatures*> :: iterator kmerHashiter;
+		// kmers are packed 2 bits per base, positions are binned in the hash
+		PackedKmerHash kmerHash;
 		
 		bool m_isSourceRepeat;
 		bool m_isTargetRepeat;
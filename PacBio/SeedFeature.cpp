@@ -1,5 +1,8 @@
 #include "SeedFeature.h"
+#include <algorithm>
+#include <unordered_map>
 #include "BWTAlgorithms.h"
+#include "BWTIntervalCache.h"
 #include "Util.h"
 
 std::map<std::string, SeedFeature::SeedVector>& SeedFeature::Log()
@@ -35,6 +38,7 @@ SeedFeature::SeedFeature(
 	isHitchhiked(false),
 	startBestKmerSize(kmerSize),
 	endBestKmerSize(kmerSize),
+	isPBSeed(false),
 	sizeUpperBound(seedLen),
 	sizeLowerBound(kmerSize),
 	freqUpperBound(PBcoverage >> 1),
@@ -77,6 +81,246 @@ void SeedFeature::modifyKmerSize(const BWTIndexSet& indices, bool pole)
 	}
 }
 
+// Search of one pole of a seed in the batched estimateBestKmerSize. The k-mers
+// are the suffixes of the pole string, counted on both strands by extending the
+// interval of the suffix in the selected index and the interval of its complement
+// in the other index one base at a time. Every size passed on the way is kept,
+// the decision steps are those of modifyKmerSize.
+struct SeedFeature::KmerSizeSearch
+{
+	enum State { INIT, LOOP, FINAL, DONE };
+	
+	// The intervals of a suffix counted by a search of the batch, keyed by the hash
+	// of the suffix. Neighbouring seeds in a repeat share their pole k-mers, a search
+	// reaching a suffix already counted takes its intervals instead of the rank queries.
+	struct SharedInterval
+	{
+		const KmerSizeSearch* pOwner;
+		int len;
+		BWTInterval same;
+		BWTInterval comp;
+	};
+	typedef std::unordered_map<uint64_t, SharedInterval> SharedIntervalMap;
+	
+	KmerSizeSearch(SeedFeature& seed, bool pole, const BWTIndexSet& indices)
+	:	pSeed(&seed),
+		pole(pole),
+		pSelBWT(pole ? indices.pRBWT : indices.pBWT),
+		pCompBWT(pole ? indices.pBWT : indices.pRBWT),
+		str(pole ? reverse(seed.seedStr) : seed.seedStr),
+		len(0),
+		freqs(seed.seedLen + 1, -1),
+		hash(14695981039346656037ULL ^ pole),
+		bit(0),
+		state(INIT){ }
+	
+	inline int& kmerSize() { return pole ? pSeed->startBestKmerSize : pSeed->endBestKmerSize; }
+	inline int& kmerFreq() { return pole ? pSeed->startKmerFreq : pSeed->endKmerFreq; }
+	inline char nextBase() const { return str[str.length() - len - 1]; }
+	
+	// Hash of the suffix one base longer, the same for equal suffixes of the same pole
+	static inline uint64_t extendHash(uint64_t h, char b) { return (h ^ (uint8_t)b) * 1099511628211ULL; }
+	
+	// Whether the suffix of size n of this search is the one of the shared intervals
+	inline bool isSharedSuffix(const SharedInterval& shared, int n) const
+	{
+		const KmerSizeSearch* pOwner = shared.pOwner;
+		return shared.len == n && pOwner->pole == pole &&
+			pOwner->str.compare(pOwner->str.length() - n, n, str, str.length() - n, n) == 0;
+	}
+	
+	// Start from the cached intervals of the last bases, up to the initial size
+	void lookupCache()
+	{
+		const BWTIntervalCache* pSelCache = pSelBWT->getIntervalCache();
+		const BWTIntervalCache* pCompCache = pCompBWT->getIntervalCache();
+		if(pSelCache == nullptr || pCompCache == nullptr)
+			return;
+		
+		const size_t MAX_CACHED = 32;
+		size_t c = std::min(std::min(pSelCache->getCachedLength(), pCompCache->getCachedLength()), MAX_CACHED);
+		c = std::min(c, (size_t)kmerSize());
+		char w[MAX_CACHED], c_w[MAX_CACHED];
+		for(size_t i = 0; i < c; i++)
+		{
+			w[i] = str[str.length() - c + i];
+			c_w[i] = complement(w[i]);
+		}
+		bool hit = c > 0 && pSelCache->lookup(w, c, same) && pCompCache->lookup(c_w, c, comp);
+		pSelCache->recordLookup(hit);
+		pCompCache->recordLookup(hit);
+		if(!hit)
+			return;
+		for(size_t i = 0; i < c; i++)
+			hash = extendHash(hash, str[str.length() - i - 1]);
+		len = c;
+		freqs[len] = same.getFreq() + comp.getFreq();
+	}
+	
+	// Frequency of the k-mer of size k, false if it needs more bases.
+	// Sizes below the cached start are counted directly.
+	bool getFreq(int k, int& freq)
+	{
+		if(k > len && (len == 0 || same.isValid() || comp.isValid()))
+			return false;
+		if(k > len)
+			freq = 0;
+		else
+		{
+			if(freqs[k] < 0)
+				freqs[k] = BWTAlgorithms::countSequenceOccurrences(str.substr(str.length() - k), pSelBWT);
+			freq = freqs[k];
+		}
+		return true;
+	}
+	
+	inline void prefetch() const
+	{
+		if(len == 0)
+			return;
+		if(same.isValid())
+		{
+			if(same.lower > 0)
+				pSelBWT->prefetchMarkers(same.lower - 1);
+			pSelBWT->prefetchMarkers(same.upper);
+		}
+		if(comp.isValid())
+		{
+			if(comp.lower > 0)
+				pCompBWT->prefetchMarkers(comp.lower - 1);
+			pCompBWT->prefetchMarkers(comp.upper);
+		}
+	}
+	
+	// Count the suffix one base longer
+	void extend(SharedIntervalMap& sharedIntervals)
+	{
+		char b = nextBase();
+		hash = extendHash(hash, b);
+		auto iter = sharedIntervals.find(hash);
+		if(iter != sharedIntervals.end() && isSharedSuffix(iter->second, len + 1))
+		{
+			same = iter->second.same;
+			comp = iter->second.comp;
+		}
+		else if(len == 0)
+		{
+			BWTAlgorithms::initInterval(same, b, pSelBWT);
+			BWTAlgorithms::initInterval(comp, complement(b), pCompBWT);
+		}
+		else
+		{
+			if(same.isValid())
+				BWTAlgorithms::updateInterval(same, b, pSelBWT);
+			if(comp.isValid())
+				BWTAlgorithms::updateInterval(comp, complement(b), pCompBWT);
+		}
+		if(iter == sharedIntervals.end())
+			sharedIntervals.emplace(hash, SharedInterval{this, len + 1, same, comp});
+		len++;
+		freqs[len] = same.getFreq() + comp.getFreq();
+	}
+	
+	// Run the steps of modifyKmerSize as far as the counted sizes allow,
+	// returns false once the size is settled
+	bool step()
+	{
+		const int freqUpperBound = pSeed->freqUpperBound;
+		const int freqLowerBound = pSeed->freqLowerBound;
+		int& kmerSize = this->kmerSize();
+		int& kmerFreq = this->kmerFreq();
+		while(state != DONE)
+		{
+			if(!getFreq(kmerSize, kmerFreq))
+				return true;
+			if(state == INIT)
+			{
+				if(kmerFreq > freqUpperBound)
+					bit = 1;
+				else if (kmerFreq < freqLowerBound)
+					bit = -1;
+				state = bit == 0 ? DONE : LOOP;
+				continue;
+			}
+			if(state == FINAL)
+			{
+				state = DONE;
+				continue;
+			}
+			const int freqBound     = bit > 0 ? freqUpperBound : freqLowerBound;
+			const int corsFreqBound = bit > 0 ? freqLowerBound : freqUpperBound;
+			const int sizeBound = bit > 0 ? pSeed->sizeUpperBound : pSeed->sizeLowerBound;
+			if((bit^kmerFreq) > (bit^freqBound) && (bit^kmerSize) < (bit^sizeBound))
+				kmerSize += bit;
+			else if((bit^kmerFreq) < (bit^corsFreqBound))
+			{
+				kmerSize -= bit;
+				state = FINAL;
+			}
+			else
+				state = DONE;
+		}
+		return false;
+	}
+	
+	SeedFeature* pSeed;
+	bool pole;
+	const BWT* pSelBWT;
+	const BWT* pCompBWT;
+	std::string str;
+	BWTInterval same;
+	BWTInterval comp;
+	int len;
+	std::vector<int> freqs;
+	uint64_t hash;
+	int bit;
+	State state;
+};
+
+void SeedFeature::estimateBestKmerSize(SeedVector& seedVec, const BWTIndexSet& indices)
+{
+	std::vector<KmerSizeSearch> searches;
+	searches.reserve(seedVec.size() << 1);
+	for(auto& seed : seedVec)
+	{
+		// The suffix searches need a plain ACGT seed and an initial size within it
+		bool isBatchable = seed.seedStr.find_first_not_of("ACGT") == std::string::npos;
+		for(int pole = 1; pole >= 0; pole--)
+		{
+			int kmerSize = pole ? seed.startBestKmerSize : seed.endBestKmerSize;
+			if(isBatchable && kmerSize >= 1 && kmerSize <= seed.seedLen)
+				searches.push_back(KmerSizeSearch(seed, pole, indices));
+			else
+				seed.modifyKmerSize(indices, pole);
+		}
+	}
+	
+	std::vector<KmerSizeSearch*> active;
+	active.reserve(searches.size());
+	KmerSizeSearch::SharedIntervalMap sharedIntervals;
+	for(auto& search : searches)
+	{
+		search.lookupCache();
+		if(search.step())
+			active.push_back(&search);
+	}
+	
+	while(!active.empty())
+	{
+		for(const auto pSearch : active)
+			pSearch->prefetch();
+		
+		size_t numActive = 0;
+		for(const auto pSearch : active)
+		{
+			pSearch->extend(sharedIntervals);
+			if(pSearch->step())
+				active[numActive++] = pSearch;
+		}
+		active.resize(numActive);
+	}
+}
+
 //Legacy part
 /***********/
 SeedFeature::SeedFeature(
@@ -91,6 +335,7 @@ SeedFeature::SeedFeature(
 	maxFixedMerFreq(maxFixedMerFreq),
 	isRepeat(repeat),
 	isHitchhiked(false),
+	isPBSeed(false),
 	minKmerSize(staticKmerSize),
 	freqUpperBound(repeatCutoff),
 	freqLowerBound(repeatCutoff>>1)
@@ -98,6 +343,8 @@ SeedFeature::SeedFeature(
 	seedLen = seedStr.length();
 	seedEndPos = seedStartPos + seedLen -1;
 	startBestKmerSize = endBestKmerSize = staticKmerSize;
+	sizeUpperBound = seedLen;
+	sizeLowerBound = staticKmerSize;
 }
 /***********/
 
@@ -18,6 +18,12 @@ class SeedFeature
 		// adjust start/end kmer for future FMWalk
 		void estimateBestKmerSize(const BWTIndexSet& indices);
 		
+		// adjust start/end kmer of every seed in seedVec, same result as estimateBestKmerSize
+		// on each seed. The searches of all seeds advance one base at a time together, so the
+		// rank queries of a round are independent and their markers are prefetched up front.
+		// A suffix shared by the poles of several seeds is counted once.
+		static void estimateBestKmerSize(SeedVector& seedVec, const BWTIndexSet& indices);
+		
 		// append current seed string with extendedStr
 		inline void append(std::string extendedStr, const SeedFeature& target)
 		{
@@ -26,6 +32,8 @@ class SeedFeature
 			//Upadate seed features of source into target
 			startBestKmerSize = target.startBestKmerSize;
 			endBestKmerSize = target.endBestKmerSize;
+			startKmerFreq = target.startKmerFreq;
+			endKmerFreq = target.endKmerFreq;
 			isRepeat = target.isRepeat;
 			maxFixedMerFreq = target.maxFixedMerFreq;
 			seedStartPos = target.seedStartPos;
@@ -71,6 +79,7 @@ class SeedFeature
 		int freqUpperBound;
 		int freqLowerBound;
 		void modifyKmerSize(const BWTIndexSet& indices, bool which);
+		struct KmerSizeSearch;
 };
 
 #endif
\ No newline at end of file
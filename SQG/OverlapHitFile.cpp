@@ -0,0 +1,280 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// OverlapHitFile - Binary files of overlap hits
+//
+#include <string.h>
+#include <sys/stat.h>
+#include "OverlapHitFile.h"
+
+namespace OverlapHitFile
+{
+
+static const char MAGIC[] = "SOVH";
+static const size_t MAGIC_SIZE = 4;
+
+// A record never comes close to this, a larger count means a corrupt file
+static const uint64_t MAX_RECORD_SIZE = 1 << 20;
+
+static inline void putVarint(std::string& out, uint64_t v)
+{
+    while(v >= 0x80)
+    {
+        out.push_back((char)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((char)v);
+}
+
+static inline void putInt(std::string& out, int64_t v)
+{
+    putVarint(out, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static inline void putString(std::string& out, const std::string& s)
+{
+    putVarint(out, s.length());
+    out.append(s);
+}
+
+// The get functions return false if the varint runs past end
+static inline bool getVarint(const char*& p, const char* end, uint64_t& v)
+{
+    v = 0;
+    for(size_t shift = 0; p < end && shift < 64; shift += 7)
+    {
+        uint8_t b = *p++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if(b < 0x80)
+            return true;
+    }
+    return false;
+}
+
+static inline bool getInt(const char*& p, const char* end, int& v)
+{
+    uint64_t u;
+    if(!getVarint(p, end, u))
+        return false;
+    v = (int)((int64_t)(u >> 1) ^ -(int64_t)(u & 1));
+    return true;
+}
+
+static inline bool getString(const char*& p, const char* end, std::string& s)
+{
+    uint64_t len;
+    if(!getVarint(p, end, len) || len > (uint64_t)(end - p))
+        return false;
+    s.assign(p, len);
+    p += len;
+    return true;
+}
+
+// Read a varint from a stream, returns the number of bytes read
+// or 0 at the end of the stream. A varint cut short sets isComplete to false.
+static inline size_t readVarint(std::istream& in, uint64_t& v, bool& isComplete)
+{
+    v = 0;
+    isComplete = false;
+    size_t numBytes = 0;
+    for(size_t shift = 0; shift < 64; shift += 7)
+    {
+        int b = in.get();
+        if(b == EOF)
+            break;
+        numBytes++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if(b < 0x80)
+        {
+            isComplete = true;
+            break;
+        }
+    }
+    return numBytes;
+}
+
+// Decode the fields of a record that spans [p, end)
+static bool parsePayload(const char* p, const char* end, Overlap& o)
+{
+    uint64_t flags = 0;
+    int start, endPlusOne, seqlen;
+    if(!getVarint(p, end, flags) || !getInt(p, end, o.match.numDiff))
+        return false;
+    o.match.isReverse = flags & 1;
+    for(size_t idx = 0; idx < 2; ++idx)
+    {
+        SeqCoord& c = o.match.coord[idx];
+        if(!getInt(p, end, start) || !getInt(p, end, endPlusOne) || !getInt(p, end, seqlen))
+            return false;
+        c.interval.start = start;
+        c.interval.end = endPlusOne - 1;
+        c.seqlen = seqlen;
+    }
+    return getString(p, end, o.id[0]) && getString(p, end, o.id[1]);
+}
+
+bool parseRecord(const char*& p, const char* end, Overlap& o)
+{
+    uint64_t size;
+    if(!getVarint(p, end, size) || size > (uint64_t)(end - p))
+        return false;
+    const char* recordEnd = p + size;
+    bool isValid = parsePayload(p, recordEnd, o);
+    p = recordEnd;
+    return isValid;
+}
+
+bool isHitFile(const std::string& filename)
+{
+    struct stat buffer;
+    if(stat(filename.c_str(), &buffer) != 0)
+        return false;
+
+    std::istream* pReader = createReader(filename, std::ios::in | std::ios::binary);
+    char magic[MAGIC_SIZE];
+    pReader->read(magic, MAGIC_SIZE);
+    bool isHit = pReader->gcount() == (std::streamsize)MAGIC_SIZE && memcmp(magic, MAGIC, MAGIC_SIZE) == 0;
+    delete pReader;
+    return isHit;
+}
+
+//
+// Writer
+//
+Writer::Writer(const std::string& filename)
+{
+    m_pWriter = createWriter(filename, std::ios::out | std::ios::binary);
+    m_pWriter->write(MAGIC, MAGIC_SIZE);
+
+    std::string version;
+    putVarint(version, FORMAT_VERSION);
+    m_pWriter->write(version.data(), version.size());
+}
+
+Writer::~Writer()
+{
+    delete m_pWriter;
+}
+
+void Writer::write(const Overlap& o)
+{
+    m_record.clear();
+    putVarint(m_record, o.match.isReverse ? 1 : 0);
+    putInt(m_record, o.match.numDiff);
+    for(size_t idx = 0; idx < 2; ++idx)
+    {
+        const SeqCoord& c = o.match.coord[idx];
+        putInt(m_record, c.interval.start);
+        putInt(m_record, c.interval.end + 1);
+        putInt(m_record, c.seqlen);
+    }
+    putString(m_record, o.id[0]);
+    putString(m_record, o.id[1]);
+
+    m_buffer.clear();
+    putVarint(m_buffer, m_record.size());
+    m_buffer.append(m_record);
+    m_pWriter->write(m_buffer.data(), m_buffer.size());
+}
+
+//
+// Reader
+//
+Reader::Reader(const std::string& filename) : m_filename(filename)
+{
+    m_pReader = createReader(filename, std::ios::in | std::ios::binary);
+
+    char magic[MAGIC_SIZE];
+    m_pReader->read(magic, MAGIC_SIZE);
+    if(m_pReader->gcount() != (std::streamsize)MAGIC_SIZE || memcmp(magic, MAGIC, MAGIC_SIZE) != 0)
+    {
+        std::cerr << "Error: " << filename << " is not an overlap hit file\n";
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t version;
+    bool isComplete;
+    readVarint(*m_pReader, version, isComplete);
+    if(!isComplete)
+        version = 0;
+
+    if(version == 0 || version > FORMAT_VERSION)
+    {
+        std::cerr << "Error: " << filename << " has hit format version " << version
+                  << ", this program reads up to version " << FORMAT_VERSION << "\n";
+        exit(EXIT_FAILURE);
+    }
+}
+
+Reader::~Reader()
+{
+    delete m_pReader;
+}
+
+bool Reader::read(Overlap& o)
+{
+    // Byte count of the record
+    uint64_t size;
+    bool isValid;
+    if(readVarint(*m_pReader, size, isValid) == 0)
+        return false;
+
+    isValid = isValid && size <= MAX_RECORD_SIZE;
+    if(isValid)
+    {
+        m_record.resize(size);
+        m_pReader->read(m_record.data(), size);
+        isValid = m_pReader->gcount() == (std::streamsize)size;
+    }
+
+    isValid = isValid && parsePayload(m_record.data(), m_record.data() + m_record.size(), o);
+
+    if(!isValid)
+    {
+        std::cerr << "Error: truncated or corrupt hit record in " << m_filename << "\n";
+        exit(EXIT_FAILURE);
+    }
+    return true;
+}
+
+bool Reader::readBlock(std::string& block, size_t blockSize)
+{
+    block.swap(m_pending);
+    size_t numPending = block.size();
+    block.resize(numPending + blockSize);
+    m_pReader->read(&block[numPending], blockSize);
+    block.resize(numPending + m_pReader->gcount());
+    if(block.empty())
+        return false;
+
+    // Cut the block after its last whole record
+    const char* begin = block.data();
+    const char* end = begin + block.size();
+    const char* p = begin;
+    while(p < end)
+    {
+        const char* q = p;
+        uint64_t size;
+        if(!getVarint(q, end, size) || size > (uint64_t)(end - q))
+            break;
+        p = q + size;
+    }
+
+    m_pending.assign(p, end);
+    block.resize(p - begin);
+    if(block.empty())
+    {
+        // A record larger than the block, or a file cut short
+        if(m_pReader->gcount() == 0 || m_pending.size() > MAX_RECORD_SIZE + 10)
+        {
+            std::cerr << "Error: truncated or corrupt hit record in " << m_filename << "\n";
+            exit(EXIT_FAILURE);
+        }
+        return readBlock(block, blockSize);
+    }
+    return true;
+}
+
+};
@@ -0,0 +1,81 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// OverlapHitFile - Binary files of overlap hits, an alternative
+// to the ED records of the ASQG edge files. The file starts with
+// a magic word and a format version. Every hit is stored as a
+// varint byte count followed by the fields of the overlap:
+//
+//   flags (bit 0: isReverse), numDiff,
+//   start, end + 1 and seqlen of coord[0] and coord[1],
+//   length and bytes of id[0] and id[1]
+//
+// The integers are zigzag-encoded LEB128 varints, so the file does
+// not depend on the byte order of the host. A reader skips the bytes
+// of a record it does not decode, which lets later versions append
+// fields to the records.
+//
+#ifndef OVERLAPHITFILE_H
+#define OVERLAPHITFILE_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <stdint.h>
+#include "Match.h"
+
+namespace OverlapHitFile
+{
+    const uint32_t FORMAT_VERSION = 1;
+
+    // Whether filename exists and starts with the magic word
+    bool isHitFile(const std::string& filename);
+
+    // Decode the hit starting at p, which must be the start of a record,
+    // and advance p past it. Returns false if the record runs past end or
+    // is corrupt.
+    bool parseRecord(const char*& p, const char* end, Overlap& o);
+
+    class Writer
+    {
+        public:
+            // Writes the file header
+            Writer(const std::string& filename);
+            ~Writer();
+
+            void write(const Overlap& o);
+
+        private:
+            std::ostream* m_pWriter;
+            std::string m_buffer;
+            std::string m_record;
+    };
+
+    class Reader
+    {
+        public:
+            // Checks the file header, exits if the file is not a hit file
+            // or was written by a newer version
+            Reader(const std::string& filename);
+            ~Reader();
+
+            // Read the next hit, returns false at the end of the file
+            bool read(Overlap& o);
+
+            // Read about blockSize bytes of whole records for parseRecord,
+            // returns false at the end of the file. Do not mix with read.
+            bool readBlock(std::string& block, size_t blockSize);
+
+        private:
+            std::istream* m_pReader;
+            std::string m_filename;
+            std::vector<char> m_record;
+
+            // Bytes of a record cut by the last readBlock
+            std::string m_pending;
+    };
+};
+
+#endif
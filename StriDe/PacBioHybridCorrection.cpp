@@ -56,6 +56,12 @@ static const char *CORRECT_USAGE_MESSAGE =
 "      -L, --max-leaves=N               Number of maximum leaves in the search tree. (default: 256)\n"
 "      -M, --max-overlap=N              the max overlap during extension (default: read length*0.9)\n"
 "      -m, --min-overlap=N              the min overlap during extension (default: read length*0.8)\n"
+"      --interval-cache=K               cache the BWT intervals of all K-mers, K is 10 to 13 or 0 to disable.\n"
+"                                       The tables are stored next to the index as PREFIX.bwt.kK.bic and\n"
+"                                       PREFIX.rbwt.kK.bic, 341 MB each for K=12 and 1.4 GB for K=13 (default: 0)\n"
+"      --batch-size=N                   correct N reads together in each thread, so the gaps of all N reads are\n"
+"                                       walked on the short-read index before the PacBio index (default: 64)\n"
+"      --rolling-hash                   bridge the gaps on the PacBio index by rolling-hash extension before MSA\n"
 "      -v, --verbose                    display verbose output\n"
 "      --help                           display this help and exit\n"
 
@@ -73,6 +79,8 @@ namespace opt
 	static std::string outFile;
 	static std::string discardFile;
 	static int sampleRate = BWT::DEFAULT_SAMPLE_RATE_SMALL;
+	static int cacheLength = 0;
+	static int batchSize = 64;
 	static int kmerLength = 31;
 	static int kmerThreshold = 3;	// FM-index extension threshold
 	static int maxLeaves = 256;
@@ -88,12 +96,13 @@ namespace opt
 	static size_t PBKmerLength = 17;	// seed size in PacBio index
 	static size_t PBcoverage = 60;		// coverage of PacBio
 	static size_t PBSearchDepth = 1000;	// PB seed searh depth
+	static bool rollingHash = false;	// rolling-hash extension on the PacBio index
 
 }
 
 static const char* shortopts = "p:t:o:K:x:L:m:k:M:f:r:c:C:v";
 
-enum { OPT_HELP = 1, OPT_VERSION };
+enum { OPT_HELP = 1, OPT_VERSION, OPT_INTERVAL_CACHE, OPT_BATCH_SIZE, OPT_ROLLING_HASH };
 
 static const struct option longopts[] = {
 	{ "threads",       required_argument, NULL, 't' },
@@ -109,6 +118,9 @@ static const struct option longopts[] = {
 	{ "coverage",      required_argument, NULL, 'c' },
 	{ "PBcoverage",    required_argument, NULL, 'C' },
 	{ "verbose",       no_argument,       NULL, 'v' },
+	{ "interval-cache",required_argument, NULL, OPT_INTERVAL_CACHE },
+	{ "batch-size",    required_argument, NULL, OPT_BATCH_SIZE },
+	{ "rolling-hash",  no_argument,       NULL, OPT_ROLLING_HASH },
 	{ "help",          no_argument,       NULL, OPT_HELP },
 	{ "version",       no_argument,       NULL, OPT_VERSION },
 
@@ -150,7 +162,7 @@ int PacBioHybridCorrectionMain(int argc, char** argv)
 		#pragma omp single nowait
 		{
 			std::cout << "Loading Sampled Suffix Array: " << opt::prefix + SAI_EXT << std::endl;
-			pSSA = new SampledSuffixArray(opt::prefix + SAI_EXT, SSA_FT_SAI);
+			pSSA = SampledSuffixArray::loadLexicoIndex(opt::prefix + BSAI_EXT, opt::prefix + SAI_EXT);
 		}
 
 		if(!opt::PBprefix.empty())
@@ -169,7 +181,7 @@ int PacBioHybridCorrectionMain(int argc, char** argv)
 			#pragma omp single nowait
 			{
 				std::cout << "Loading Sampled Suffix Array: " << opt::PBprefix + SAI_EXT << std::endl;
-				plqSSA = new SampledSuffixArray(opt::PBprefix + SAI_EXT, SSA_FT_SAI);
+				plqSSA = SampledSuffixArray::loadLexicoIndex(opt::PBprefix + BSAI_EXT, opt::PBprefix + SAI_EXT);
 			}
 		}
 	}
@@ -184,9 +196,24 @@ int PacBioHybridCorrectionMain(int argc, char** argv)
 				// <<"\t 95% kmer frequency: " << ecParams.kd.getCutoffForProportion(0.95)
 				// << "\t Repeat frequency cutoff: " << ecParams.kd.getRepeatKmerCutoff() << "\n";
 	
+	// Skip the first k steps of every backward search with tables of all k-mer intervals
+	BWTIntervalCache *pBWTCache = NULL, *pRBWTCache = NULL;
+	BWTIntervalCache *plqBWTCache = NULL, *plqRBWTCache = NULL;
+	if(opt::cacheLength > 0)
+	{
+		pBWTCache = BWTIntervalCache::attach(opt::cacheLength, pBWT, opt::prefix + BWT_EXT, opt::numThreads);
+		pRBWTCache = BWTIntervalCache::attach(opt::cacheLength, pRBWT, opt::prefix + RBWT_EXT, opt::numThreads);
+		if(!opt::PBprefix.empty())
+		{
+			plqBWTCache = BWTIntervalCache::attach(opt::cacheLength, plqBWT, opt::PBprefix + BWT_EXT, opt::numThreads);
+			plqRBWTCache = BWTIntervalCache::attach(opt::cacheLength, plqRBWT, opt::PBprefix + RBWT_EXT, opt::numThreads);
+		}
+	}
+
 	BWTIndexSet indexSet;
 	indexSet.pBWT = pBWT;
 	indexSet.pRBWT = pRBWT;
+	indexSet.pCache = pBWTCache;
 	indexSet.pSSA = pSSA;
 	ecParams.indices = indexSet;
 
@@ -194,6 +221,7 @@ int PacBioHybridCorrectionMain(int argc, char** argv)
 	BWTIndexSet lqindexSet;
 	lqindexSet.pBWT = plqBWT;
 	lqindexSet.pRBWT = plqRBWT;
+	lqindexSet.pCache = plqBWTCache;
 	lqindexSet.pSSA = plqSSA;
 	ecParams.PBindices = lqindexSet;
 
@@ -213,6 +241,7 @@ int PacBioHybridCorrectionMain(int argc, char** argv)
 	ecParams.PBKmerLength = opt::PBKmerLength;
 	ecParams.PBcoverage = opt::PBcoverage;
 	ecParams.PBSearchDepth = opt::PBSearchDepth;
+	ecParams.rollingHash = opt::rollingHash;
 
 	
 	std::cout << std::endl << "Correcting PacBio reads for " << opt::readsFile << " using--" << std::endl
@@ -228,43 +257,47 @@ int PacBioHybridCorrectionMain(int argc, char** argv)
 		<< "PB kmer length:\t" << ecParams.PBKmerLength << std::endl
 		<< "PB reads coverage:\t" << ecParams.PBcoverage << std::endl
 		<< "PB search depth:\t" << ecParams.PBSearchDepth << std::endl
+		<< "batch size:\t" << opt::batchSize << std::endl
+		<< "rolling hash:\t" << (ecParams.rollingHash ? "yes" : "no") << std::endl
 		<< std::endl;
 
 	// Setup post-processor
 	PacBioHybridCorrectionPostProcess postProcessor(pWriter, pDiscardWriter, ecParams);
 
-	if(opt::numThreads <= 1)
+	// The reads are corrected in batches, one batch per thread at a time
+	std::vector<PacBioHybridCorrectionProcess*> pProcessorVector;
+	for(int i = 0; i < opt::numThreads; ++i)
 	{
-		// Serial mode
-		PacBioHybridCorrectionProcess processor(ecParams);
-
-		SequenceProcessFramework::processSequencesSerial<SequenceWorkItem,
-		PacBioHybridCorrectionResult,
-		PacBioHybridCorrectionProcess,
-		PacBioHybridCorrectionPostProcess>(opt::readsFile, &processor, &postProcessor);
+		PacBioHybridCorrectionProcess* pProcessor = new PacBioHybridCorrectionProcess(ecParams);
+		pProcessorVector.push_back(pProcessor);
 	}
-	else
+
+	SequenceProcessFramework::processSequencesBatched<SequenceWorkItem,
+	PacBioHybridCorrectionResult,
+	PacBioHybridCorrectionProcess,
+	PacBioHybridCorrectionPostProcess>(opt::readsFile, pProcessorVector, &postProcessor, opt::batchSize);
+
+	PacBioHybridCorrectionStats stats;
+	for(int i = 0; i < opt::numThreads; ++i)
 	{
-		// Parallel mode
-		std::vector<PacBioHybridCorrectionProcess*> pProcessorVector;
-		for(int i = 0; i < opt::numThreads; ++i)
-		{
-			PacBioHybridCorrectionProcess* pProcessor = new PacBioHybridCorrectionProcess(ecParams);
-			pProcessorVector.push_back(pProcessor);
-		}
+		stats.add(pProcessorVector[i]->getStats());
+		delete pProcessorVector[i];
+	}
+	stats.print();
 
-		SequenceProcessFramework::processSequencesParallel<SequenceWorkItem,
-		PacBioHybridCorrectionResult,
-		PacBioHybridCorrectionProcess,
-		PacBioHybridCorrectionPostProcess>(opt::readsFile, pProcessorVector, &postProcessor);
-
-		// SequenceProcessFramework::processSequencesParallelOpenMP<SequenceWorkItem,
-		// PacBioCorrectionResult,
-		// PacBioCorrectionProcess,
-		// PacBioCorrectionPostProcess>(opt::readsFile, pProcessorVector, &postProcessor);
-		
-		for(int i = 0; i < opt::numThreads; ++i)
-			delete pProcessorVector[i];
+	if(pBWTCache != NULL)
+	{
+		pBWTCache->printInfo("BWT");
+		pRBWTCache->printInfo("RBWT");
+		delete pBWTCache;
+		delete pRBWTCache;
+	}
+	if(plqBWTCache != NULL)
+	{
+		plqBWTCache->printInfo("PacBio BWT");
+		plqRBWTCache->printInfo("PacBio RBWT");
+		delete plqBWTCache;
+		delete plqRBWTCache;
 	}
 
 	delete pBWT;
@@ -309,6 +342,9 @@ void parsePacBioHybridCorrectionOptions(int argc, char** argv)
 			case 'C': arg >> opt::PBcoverage; break;
 			case 'f': arg >> opt::PBprefix; break;
 			case 'r': arg >> opt::readLen; break;
+			case OPT_INTERVAL_CACHE: arg >> opt::cacheLength; break;
+			case OPT_BATCH_SIZE: arg >> opt::batchSize; break;
+			case OPT_ROLLING_HASH: opt::rollingHash = true; break;
 
 			case OPT_HELP:
 				std::cout << CORRECT_USAGE_MESSAGE;
@@ -348,6 +384,18 @@ void parsePacBioHybridCorrectionOptions(int argc, char** argv)
 		die = true;
 	}
 
+	if(opt::cacheLength != 0 && (opt::cacheLength < 10 || opt::cacheLength > 13))
+	{
+		std::cerr << SUBPROGRAM ": invalid interval cache length: " << opt::cacheLength << ", must be between 10 and 13 or 0\n";
+		die = true;
+	}
+
+	if(opt::batchSize <= 0)
+	{
+		std::cerr << SUBPROGRAM ": invalid batch size: " << opt::batchSize << ", must be greater than zero\n";
+		die = true;
+	}
+
 	if(opt::coverage <= 0)
 	{
 		std::cerr << "Warnning: coverage of high-quality short reads is invalid or not provided: " << opt::coverage << ", reset to 100 by default\n";
@@ -50,10 +50,17 @@ static const char *CORRECT_USAGE_MESSAGE =
 "      -k, --kmer-size=N                The start kmer length (default: 19 (PacBioS).)\n"
 "      -n, --next-target                The number of next FMWalk target seed(default: 1)\n"
 "      -l, --max-leaves=N               Number of maximum leaves in the search tree. (default: 32)\n"
+"      --leaves-per-base=R              Allow R leaves per base of the gap between seeds instead of the maximum,\n"
+"                                       from 8 up to 4 times --max-leaves, 0 to disable (default: 0)\n"
+"      --early-stop=E                   Stop the search once a path reaching the target seed has an error rate\n"
+"                                       of at most E and no leaf is more accurate, 0 to disable (default: 0)\n"
 "      -i, --idmer-length=N             The length of the kmer to identify similar reads.(default: 9)\n"
 "      -s, --min-kmer-size=N            The minimum length of the kmer to use. (default: 13.)\n"
 "      -g, --genome=(5/10/100)[m]       Genome size of the species (default: 10m)\n"
 "      -m, --mode=(0/1/2)               Mode in seed-searching (default: 1)\n"
+"      --interval-cache=K               Cache the BWT intervals of all K-mers, K is 10 to 13 or 0 to disable.\n"
+"                                       The tables are stored next to the index as PREFIX.bwt.kK.bic and\n"
+"                                       PREFIX.rbwt.kK.bic, 341 MB each for K=12 and 1.4 GB for K=13 (default: 0)\n"
 "      -v, --verbose                    Display verbose output\n"
 "      --help                           Display this help and exit\n"
 "      --version                        Display version and exit\n"
@@ -61,7 +68,15 @@ static const char *CORRECT_USAGE_MESSAGE =
 "      --debugextend                    Show extension information (default: false)\n"
 "      --onlyseed                       Only search seeds file for each reads (default: false)\n"
 "      --nodp                           Don't use dp (default: false)\n"
+"      --rolling-hash                   Bridge seeds by rolling-hash extension instead of the overlap tree (default: false)\n"
+"      --gap-predictor                  Learn which gaps FM-index walks fail to bridge and send them straight to dp\n"
+"                                       (default: false)\n"
 "      --split                          Split the uncorrected reads (default: false)\n"
+"      --pipeline                       Seed the reads in batches and fill the gaps between seeds of a whole batch\n"
+"                                       on all threads, instead of correcting one read per thread (default: false)\n"
+"      --batch-size=N                   Seed N reads together in the pipeline (default: 32)\n"
+"      --seed-threads=N                 Prefer seeding on N of the threads in the pipeline, N from 1 to the number\n"
+"                                       of threads (default: balance the threads by the number of waiting gaps)\n"
 
 "\nReport bugs to " PACKAGE_BUGREPORT "\n\n";
 
@@ -79,6 +94,7 @@ namespace opt
 	static std::string discardFile;
 	static BWTIndexSet indices;
 	static int sampleRate = BWT::DEFAULT_SAMPLE_RATE_SMALL;
+	static int cacheLength = 0;
 	
     static size_t PBcoverage = 90; // PB seed searh depth
     static double ErrorRate = 0.15;
@@ -86,6 +102,8 @@ namespace opt
 	static int startKmerLen = 19;
 	static int nextTarget = 1;
 	static int maxLeaves = 32;
+	static double leavesPerBase = 0;
+	static double earlyStopErrorRate = 0;
     static int idmerLen = 9;
 	static int minKmerLen = 13;
 	
@@ -98,8 +116,15 @@ namespace opt
     static bool DebugSeed = false;
 	static bool OnlySeed = false;
 	static bool NoDp = false;
+	static bool RollingHash = false;
+	static bool GapPredictor = false;
 	static bool Manual = false;
 	
+	static bool Pipeline = false;
+	static int batchSize = 32;
+	static int seedThreads = 0;
+	static bool FixedSeedThreads = false;
+	
 	//variables for auto set
 	static bool Adjust = false;
 	static std::map<int, int> order = {{5, 0}, {10, 1}, {100, 2}};
@@ -110,7 +135,7 @@ namespace opt
 
 static const char* shortopts = "t:p:o:b:c:e:k:u:r:n:l:i:s:g:m:v";
 
-enum { OPT_HELP = 1, OPT_VERSION, OPT_SPLIT, OPT_FIRST, OPT_DEBUGEXTEND, OPT_DEBUGSEED, OPT_ONLYSEED, OPT_NODP };
+enum { OPT_HELP = 1, OPT_VERSION, OPT_SPLIT, OPT_FIRST, OPT_DEBUGEXTEND, OPT_DEBUGSEED, OPT_ONLYSEED, OPT_NODP, OPT_ROLLING_HASH, OPT_GAP_PREDICTOR, OPT_LEAVES_PER_BASE, OPT_EARLY_STOP, OPT_INTERVAL_CACHE, OPT_PIPELINE, OPT_BATCH_SIZE, OPT_SEED_THREADS };
 
 static const struct option longopts[] = {
 	{ "thread",             required_argument, nullptr, 't' },
@@ -136,6 +161,14 @@ static const struct option longopts[] = {
     { "debugseed",          no_argument,       nullptr, OPT_DEBUGSEED },
 	{ "onlyseed",           no_argument,       nullptr, OPT_ONLYSEED },
 	{ "nodp",               no_argument,       nullptr, OPT_NODP },
+	{ "rolling-hash",       no_argument,       nullptr, OPT_ROLLING_HASH },
+	{ "gap-predictor",      no_argument,       nullptr, OPT_GAP_PREDICTOR },
+	{ "leaves-per-base",    required_argument, nullptr, OPT_LEAVES_PER_BASE },
+	{ "early-stop",         required_argument, nullptr, OPT_EARLY_STOP },
+	{ "interval-cache",     required_argument, nullptr, OPT_INTERVAL_CACHE },
+	{ "pipeline",           no_argument,       nullptr, OPT_PIPELINE },
+	{ "batch-size",         required_argument, nullptr, OPT_BATCH_SIZE },
+	{ "seed-threads",       required_argument, nullptr, OPT_SEED_THREADS },
 	{ nullptr, 0, nullptr, 0 }
 };
 
@@ -167,11 +200,19 @@ int PacBioSelfCorrectionMain(int argc, char** argv)
 		#pragma omp section
 		{
 			std::cerr << "Loading Sampled Suffix Array: " << opt::prefix + SAI_EXT << "\n";
-			pSSA = std::unique_ptr<SampledSuffixArray>(new SampledSuffixArray(opt::prefix + SAI_EXT, SSA_FT_SAI));
+			pSSA = std::unique_ptr<SampledSuffixArray>(SampledSuffixArray::loadLexicoIndex(opt::prefix + BSAI_EXT, opt::prefix + SAI_EXT));
 		}
 	}
+	// Skip the first k steps of every backward search with tables of all k-mer intervals
+	std::unique_ptr<BWTIntervalCache> pBWTCache, pRBWTCache;
+	if(opt::cacheLength > 0)
+	{
+		pBWTCache.reset(BWTIntervalCache::attach(opt::cacheLength, pBWT.get(), opt::prefix + BWT_EXT, opt::thread));
+		pRBWTCache.reset(BWTIntervalCache::attach(opt::cacheLength, pRBWT.get(), opt::prefix + RBWT_EXT, opt::thread));
+	}
 	opt::indices.pBWT  = pBWT.get();
 	opt::indices.pRBWT = pRBWT.get();
+	opt::indices.pCache = pBWTCache.get();
 	opt::indices.pSSA  = pSSA.get();
 	
 	ecParams.indices   = opt::indices;
@@ -191,6 +232,12 @@ int PacBioSelfCorrectionMain(int argc, char** argv)
 	if(opt::OnlySeed) BCode::load(opt::barcode);
 	ecParams.OnlySeed    = opt::OnlySeed;
 	ecParams.NoDp        = opt::NoDp;
+	ecParams.RollingHash = opt::RollingHash;
+	
+	std::unique_ptr<GapDifficultyPredictor> pGapPredictor;
+	if(opt::GapPredictor)
+		pGapPredictor.reset(new GapDifficultyPredictor(opt::PBcoverage));
+	ecParams.pGapPredictor = pGapPredictor.get();
 	
 	if(!opt::Adjust)
 	{
@@ -203,7 +250,6 @@ int PacBioSelfCorrectionMain(int argc, char** argv)
 	//Insert kmer sizes in pool for future usage. Noted by KuanWeiLee 18/3/12
 	for(auto& o : opt::offset)
 		opt::pool.insert(opt::startKmerLen + o);
-	ecParams.pool = opt::pool;
 	
 	FMextendParameters FM_params(
 			opt::indices,
@@ -211,7 +257,9 @@ int PacBioSelfCorrectionMain(int argc, char** argv)
 			opt::maxLeaves,
 			opt::minKmerLen,
 			opt::PBcoverage,
-			opt::ErrorRate);
+			opt::ErrorRate,
+			opt::earlyStopErrorRate,
+			opt::leavesPerBase);
 	ecParams.FM_params = FM_params;
 	
 	
@@ -245,12 +293,35 @@ int PacBioSelfCorrectionMain(int argc, char** argv)
 	Timer* pTimer = new Timer(PROGRAM_IDENT);
 	
 	//Start processing sequences
-	SequenceProcessFramework::processSequences<SequenceWorkItem,
-	PacBioSelfCorrectionResult,
-	PacBioSelfCorrectionProcess,
-	PacBioSelfCorrectionPostProcess,
-	PacBioSelfCorrectionParameters>(opt::thread, opt::readsFile, ecParams);
-	
+	if(opt::Pipeline)
+	{
+		PacBioSelfCorrectionPostProcess postProcessor(ecParams);
+		std::vector<PacBioSelfCorrectionProcess*> pProcessorVec;
+		for(int i = 0; i < opt::thread; i++)
+			pProcessorVec.push_back(new PacBioSelfCorrectionProcess(ecParams));
+		
+		SequenceProcessFramework::processSequencesPipelined<SequenceWorkItem,
+		PacBioSelfCorrectionResult,
+		PacBioSelfCorrectionProcess,
+		PacBioSelfCorrectionPostProcess>(opt::readsFile, pProcessorVec, &postProcessor, opt::batchSize, opt::seedThreads);
+		
+		for(auto& iter : pProcessorVec)
+			delete iter;
+	}
+	else
+		SequenceProcessFramework::processSequences<SequenceWorkItem,
+		PacBioSelfCorrectionResult,
+		PacBioSelfCorrectionProcess,
+		PacBioSelfCorrectionPostProcess,
+		PacBioSelfCorrectionParameters>(opt::thread, opt::readsFile, ecParams);
+	
+	if(pGapPredictor)
+		pGapPredictor->printInfo();
+	if(pBWTCache)
+	{
+		pBWTCache->printInfo("BWT");
+		pRBWTCache->printInfo("RBWT");
+	}
 	delete pTimer;
 	return 0;
 }
@@ -308,6 +379,17 @@ void parsePacBioSelfCorrectionOptions(int argc, char** argv)
 			case OPT_DEBUGEXTEND: opt::DebugExtend = true; break;
 			case OPT_DEBUGSEED:   opt::DebugSeed   = true; break;
 			case OPT_NODP:        opt::NoDp        = true; break;
+			case OPT_ROLLING_HASH: opt::RollingHash = true; break;
+			case OPT_GAP_PREDICTOR: opt::GapPredictor = true; break;
+			case OPT_LEAVES_PER_BASE: arg >> opt::leavesPerBase; break;
+			case OPT_EARLY_STOP:  arg >> opt::earlyStopErrorRate; break;
+			case OPT_INTERVAL_CACHE: arg >> opt::cacheLength; break;
+			case OPT_PIPELINE:    opt::Pipeline    = true; break;
+			case OPT_BATCH_SIZE:  arg >> opt::batchSize;   break;
+			case OPT_SEED_THREADS:
+				arg >> opt::seedThreads;
+				opt::FixedSeedThreads = true;
+				break;
 			case OPT_ONLYSEED:
 				opt::DebugSeed = true;
 				opt::OnlySeed = true;
@@ -332,6 +414,36 @@ void parsePacBioSelfCorrectionOptions(int argc, char** argv)
 		die = true;
 	}
 
+	if(opt::leavesPerBase < 0)
+	{
+		std::cerr << SUBPROGRAM ": invalid leaves per base: " << opt::leavesPerBase << "\n";
+		die = true;
+	}
+
+	if(opt::earlyStopErrorRate < 0 || opt::earlyStopErrorRate >= 1)
+	{
+		std::cerr << SUBPROGRAM ": invalid early stop error rate: " << opt::earlyStopErrorRate << ", must be in [0, 1)\n";
+		die = true;
+	}
+
+	if(opt::batchSize <= 0)
+	{
+		std::cerr << SUBPROGRAM ": invalid batch size: " << opt::batchSize << ", must be greater than zero\n";
+		die = true;
+	}
+
+	if(opt::FixedSeedThreads && (opt::seedThreads <= 0 || opt::seedThreads > opt::thread))
+	{
+		std::cerr << SUBPROGRAM ": invalid number of seed threads: " << opt::seedThreads << ", must be between 1 and the number of threads (" << opt::thread << ")\n";
+		die = true;
+	}
+
+	if(opt::cacheLength != 0 && (opt::cacheLength < 10 || opt::cacheLength > 13))
+	{
+		std::cerr << SUBPROGRAM ": invalid interval cache length: " << opt::cacheLength << ", must be between 10 and 13 or 0\n";
+		die = true;
+	}
+
 	if(opt::prefix.empty())
 	{
 		std::cerr << SUBPROGRAM << ": no prefix\n";
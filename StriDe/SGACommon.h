@@ -14,6 +14,7 @@
 // File extensions
 #define OVR_EXT ".ovr"
 #define HITS_EXT ".edges"
+#define BINHITS_EXT ".bedges"
 #define RMDUPHITS_EXT ".rmhits"
 #define GMAPHITS_EXT ".gmhits"
 #define CTN_EXT ".ctn"
@@ -24,6 +25,9 @@
 #define RBWT_EXT ".rbwt"
 #define SAI_EXT ".sai"
 #define RSAI_EXT ".rsai"
+#define BSAI_EXT ".bsai"
+#define RBSAI_EXT ".rbsai"
+#define PRS_EXT ".prs"
 #define SSA_EXT ".ssa"
 #define POPIDX_EXT ".popidx"
 
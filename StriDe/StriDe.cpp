@@ -25,6 +25,7 @@
 #include "PacBioHybridCorrection.h"
 #include "strideall.h"
 #include "asmlong.h"
+#include "hitconv.h"
 
 #define PROGRAM_BIN "stride"
 #define AUTHOR "Yao-Ting Huang"
@@ -57,6 +58,7 @@ static const char *STRIDE_USAGE_MESSAGE =
 "      kmerfreq    check static & dynamic kmer frequency\n"
 "\nOther Commands:\n"
 "      merge	merge multiple BWT/FM-index files into a single index\n"
+"      hitconv	convert overlap edge files between ASQG edge records and binary hits\n"
 "\nReport bugs to " PACKAGE_BUGREPORT "\n\n";
 
 int main(int argc, char** argv)
@@ -114,6 +116,8 @@ int main(int argc, char** argv)
             FMindexWalkMain(argc - 1, argv + 1);
         else if(command == "asmlong")
             asmlongMain(argc - 1, argv + 1);
+        else if(command == "hitconv")
+            hitconvMain(argc - 1, argv + 1);
 
         else
         {
@@ -16,8 +16,11 @@
 #include <map>
 #include "Util.h"
 #include "SGUtil.h"
+#include "CompactStringGraph.h"
 #include "SGAlgorithms.h"
 #include "SGVisitors.h"
+#include "SGReduction.h"
+#include "SGGraphCleaner.h"
 #include "Timer.h"
 #include "EncodedString.h"
 #include "SuffixArray.h"
@@ -52,6 +55,13 @@ static const char *ASSEMBLE_USAGE_MESSAGE =
 "      -m, --min-overlap=LEN            only use overlaps of at least LEN. This can be used to filter\n"
 "          --transitive-reduction       remove transitive edges from the graph. Off by default.\n"
 "          --max-edges=N                limit each vertex to a maximum of N edges. For highly repetitive regions\n"
+"          --compact-graph              load the graph into the compact CSR layout and remove the duplicate edges,\n"
+"                                       containments and transitive edges there, then convert what is left to the\n"
+"                                       usual graph for the other passes. Only the loading and reduction use less memory,\n"
+"                                       the peak holds both graphs while the reduced one is converted\n"
+"          --max-degree=N               keep only the N best edges of each vertex, by overlap length then by the\n"
+"                                       number of differences, and no duplicate edges while loading the graph\n"
+"          --memory-budget=MB           lower the degree cap until the loaded graph fits into MB megabytes\n"
 "\nReport bugs to " PACKAGE_BUGREPORT "\n\n";
 
 
@@ -76,6 +86,11 @@ namespace asmlongopt
 
 	//
 	static bool bExact = false;
+	static bool bCompactGraph = false;
+
+	// Edge selection while loading, 0 disables a limit
+	static size_t maxDegree = 0;
+	static size_t memoryBudget = 0;
 
 	//FM index files
 	BWTIndexSet indices;
@@ -93,7 +108,7 @@ namespace asmlongopt
 
 static const char* shortopts = "p:o:m:i:x:v";
 
-enum { OPT_HELP = 1, OPT_VERSION, OPT_EXACT, OPT_MAXINDEL,OPT_MAXEDGES};
+enum { OPT_HELP = 1, OPT_VERSION, OPT_EXACT, OPT_MAXINDEL,OPT_MAXEDGES, OPT_COMPACTGRAPH, OPT_MAXDEGREE, OPT_MEMORYBUDGET};
 
 static const struct option longopts[] = {
 	{ "verbose",               no_argument,       NULL, 'v' },
@@ -105,6 +120,9 @@ static const struct option longopts[] = {
 	{ "max-chimera",           required_argument, NULL, 'x' },
 	{ "insert-size",           required_argument, NULL, 'i' },
 	{ "exact",                 no_argument,       NULL, OPT_EXACT },
+	{ "compact-graph",         no_argument,       NULL, OPT_COMPACTGRAPH },
+	{ "max-degree",            required_argument, NULL, OPT_MAXDEGREE },
+	{ "memory-budget",         required_argument, NULL, OPT_MEMORYBUDGET },
 	{ "help",                  no_argument,       NULL, OPT_HELP },
 	{ "version",               no_argument,       NULL, OPT_VERSION },
 	{ NULL, 0, NULL, 0 }
@@ -131,12 +149,16 @@ int asmlongMain(int argc, char** argv)
 int asmlong()
 {
 	StringGraph* pGraph;
+	CompactStringGraph* pCompactGraph = NULL;
 	#pragma omp parallel
 	{
 		#pragma omp single nowait
 		{
 			std::cout << "\n[ Loading string graph: " << asmlongopt::asqgFile <<  " ]\n";
-			pGraph=SGUtil::loadASQGVertex(asmlongopt::asqgFile, asmlongopt::minOverlap, true, asmlongopt::maxEdges);
+			if(asmlongopt::bCompactGraph)
+				pCompactGraph=SGUtil::loadCompactASQG(asmlongopt::asqgFile, asmlongopt::minOverlap, true, asmlongopt::maxEdges);
+			else
+				pGraph=SGUtil::loadASQGVertex(asmlongopt::asqgFile, asmlongopt::minOverlap, true, asmlongopt::maxEdges);
 		}
 		#pragma omp single nowait
 		{
@@ -151,14 +173,40 @@ int asmlong()
 		#pragma omp single nowait
 		{
 			std::cout << "[ Loading SAI ]\n";
-			asmlongopt::pSSA = new SampledSuffixArray(asmlongopt::prefix + SAI_EXT, SSA_FT_SAI);
+			asmlongopt::pSSA = SampledSuffixArray::loadLexicoIndex(asmlongopt::prefix + BSAI_EXT, asmlongopt::prefix + SAI_EXT);
 		}
 	}
     asmlongopt::indices.pBWT = asmlongopt::pBWT;
     asmlongopt::indices.pRBWT = asmlongopt::pRBWT;
     asmlongopt::indices.pSSA = asmlongopt::pSSA;
 	
-	pGraph=SGUtil::loadASQGEdge(asmlongopt::asqgFile, asmlongopt::minOverlap, true, asmlongopt::maxEdges, pGraph);
+	// Reduce a compact graph in place and build the Bigraph from what is left,
+	// unless its containments can only be removed by remodelling
+	bool isReduced = false;
+	if(asmlongopt::bCompactGraph)
+	{
+		pCompactGraph->setExactMode(asmlongopt::bExact);
+		std::cout << "[Stats] Input graph (compact, " << pCompactGraph->getMemSize() / (1024 * 1024) << " MB):\n";
+		pCompactGraph->printStats();
+		if(!SGReduction::isRemodelNeeded(pCompactGraph))
+		{
+			std::cout << "Removing contained vertices from graph\n";
+			SGReduction::removeContainments(pCompactGraph);
+			std::cout << "Removing transitive edges\n";
+			SGReduction::removeTransitiveEdges(pCompactGraph);
+			isReduced = true;
+		}
+		pGraph=pCompactGraph->toBigraph();
+		delete pCompactGraph;
+	}
+	else if(asmlongopt::maxDegree > 0 || asmlongopt::memoryBudget > 0)
+	{
+		pGraph=SGUtil::loadASQGEdgeSelected(asmlongopt::asqgFile, asmlongopt::minOverlap, true, asmlongopt::maxEdges, asmlongopt::maxDegree, asmlongopt::memoryBudget, pGraph);
+	}
+	else
+	{
+		pGraph=SGUtil::loadASQGEdge(asmlongopt::asqgFile, asmlongopt::minOverlap, true, asmlongopt::maxEdges, pGraph);
+	}
 
 	// if(asmlongopt::bExact)
 	pGraph->setExactMode(asmlongopt::bExact);
@@ -166,21 +214,24 @@ int asmlong()
 
 	// // Pre-assembly graph stats
 	SGGraphStatsVisitor statsVisit;
-	std::cout << "[Stats] Input graph:\n";
-	pGraph->visitP(statsVisit);
+	if(!asmlongopt::bCompactGraph)
+	{
+		std::cout << "[Stats] Input graph:\n";
+		pGraph->visitP(statsVisit);
+	}
 	
 	int phase = 0 ;
 
-	// Remove containments from the graph
-	std::cout << "Removing contained vertices from graph\n";
-	SGContainRemoveVisitor containVisit;
-	while(pGraph->hasContainment())
-		pGraph->visit(containVisit);
+	if(!isReduced)
+	{
+		// Remove containments from the graph
+		std::cout << "Removing contained vertices from graph\n";
+		SGReduction::removeContainments(pGraph);
 
-	/*---Remove Transitive Edges---*/
-	std::cout << "Removing transitive edges\n";
-	SGTransitiveReductionVisitor trVisit;
-	pGraph->visit(trVisit);
+		/*---Remove Transitive Edges---*/
+		std::cout << "Removing transitive edges\n";
+		SGReduction::removeTransitiveEdges(pGraph);
+	}
 
 	// Compact together unbranched chains of vertices
 	std::cout << "Start to simplify unipaths ...\n";
@@ -215,7 +266,7 @@ int asmlong()
 	// Write the results
 	std::cout << "\n<Printing the contig file> : " << asmlongopt::outContigsFile << " \n" << std::endl;
 	SGFastaVisitor av(asmlongopt::outContigsFile);
-	pGraph->visit(av);
+	av.write(pGraph);
 	//std::cout << "<Printing the ASQG and dot files>\n" << std::endl;
 	pGraph->writeASQG(asmlongopt::outGraphFile);
     pGraph->writeDot("StriDe-graph.dot",0);
@@ -249,6 +300,9 @@ void parseAsmLongOptions(int argc, char** argv)
 		case OPT_MAXEDGES: arg >> asmlongopt::maxEdges; break;
 		case OPT_MAXINDEL: arg >> asmlongopt::maxIndelLength; break;
 		case OPT_EXACT: asmlongopt::bExact = true; break;
+		case OPT_COMPACTGRAPH: asmlongopt::bCompactGraph = true; break;
+		case OPT_MAXDEGREE: arg >> asmlongopt::maxDegree; break;
+		case OPT_MEMORYBUDGET: arg >> asmlongopt::memoryBudget; asmlongopt::memoryBudget *= 1024 * 1024; break;
 		case OPT_HELP:
 			std::cout << ASSEMBLE_USAGE_MESSAGE;
 			exit(EXIT_SUCCESS);
@@ -274,6 +328,12 @@ void parseAsmLongOptions(int argc, char** argv)
 	}
 
 
+	if (asmlongopt::bCompactGraph && (asmlongopt::maxDegree > 0 || asmlongopt::memoryBudget > 0))
+	{
+		std::cerr << SUBPROGRAM ": --max-degree and --memory-budget can not be used with --compact-graph\n";
+		die = true;
+	}
+
 	if (argc - optind < 1)
 	{
 		std::cerr << SUBPROGRAM ": missing arguments\n";
@@ -302,19 +362,19 @@ void parseAsmLongOptions(int argc, char** argv)
 
 void sequentialTrimAndSmooth (StringGraph* pGraph, size_t trimLength, bool bIsGapPrecent)
 {
-	pGraph->simplify();
-	SGTrimVisitor trimVisit("",trimLength);
-	SGSmoothingVisitor smoothingVisit(asmlongopt::maxIndelLength, asmlongopt::pBWT, bIsGapPrecent);
+	// After the first call, trim and simplify only look at the vertices changed by the calls since
+	SGGraphCleaner cleaner(pGraph, trimLength, asmlongopt::maxIndelLength, asmlongopt::pBWT, bIsGapPrecent);
+	cleaner.simplify();
 
-	if (pGraph->visit(trimVisit))
-		pGraph->simplify();
+	if (cleaner.trim())
+		cleaner.simplify();
 
 
-	if (pGraph->visit(smoothingVisit))
+	if (cleaner.smooth())
 	{
-		pGraph->simplify();
-		if (pGraph->visit(trimVisit))
-			pGraph->simplify();
+		cleaner.simplify();
+		if (cleaner.trim())
+			cleaner.simplify();
 
 	}	
 }
@@ -16,6 +16,8 @@
 #include "SGUtil.h"
 #include "SGAlgorithms.h"
 #include "SGVisitors.h"
+#include "SGReduction.h"
+#include "SGGraphCleaner.h"
 #include "Timer.h"
 #include "EncodedString.h"
 #include "SuffixArray.h"
@@ -170,7 +172,7 @@ int assemble()
 		#pragma omp single nowait
 		{
 			std::cout << "[ Loading SAI ]\n";
-			opt::pSSA = new SampledSuffixArray(opt::prefix + SAI_EXT, SSA_FT_SAI);
+			opt::pSSA = SampledSuffixArray::loadLexicoIndex(opt::prefix + BSAI_EXT, opt::prefix + SAI_EXT);
 		}
 	}
     opt::indices.pBWT = opt::pBWT;
@@ -192,14 +194,11 @@ int assemble()
 
 	// Remove containments from the graph
 	std::cout << "Removing contained vertices from graph\n";
-	SGContainRemoveVisitor containVisit;
-	while(pGraph->hasContainment())
-		pGraph->visit(containVisit);
+	SGReduction::removeContainments(pGraph);
 
 	/*---Remove Transitive Edges---*/
 	std::cout << "Removing transitive edges\n";
-	SGTransitiveReductionVisitor trVisit;
-	pGraph->visit(trVisit);
+	SGReduction::removeTransitiveEdges(pGraph);
 	/*---Remove Transitive Edges---*/
 	// getchar();
 
@@ -363,7 +362,7 @@ int assemble()
 	// Write the results
 	std::cout << "\n<Printing the contig file> : " << opt::outContigsFile << " \n" << std::endl;
 	SGFastaVisitor av(opt::outContigsFile);
-	pGraph->visit(av);
+	av.write(pGraph);
 	//std::cout << "<Printing the ASQG and dot files>\n" << std::endl;
 	pGraph->writeASQG(opt::outGraphFile);
     pGraph->writeDot("StriDe-graph.dot",0);
@@ -460,20 +459,20 @@ void parseAssembleOptions(int argc, char** argv)
 
 void graphTrimAndSmooth (StringGraph* pGraph, size_t trimLength, bool bIsGapPrecent)
 {
-	pGraph->simplify();
-	SGTrimVisitor trimVisit("",trimLength);
-	SGSmoothingVisitor smoothingVisit(opt::maxIndelLength, opt::pBWT, bIsGapPrecent);
+	// After the first call, trim and simplify only look at the vertices changed by the calls since
+	SGGraphCleaner cleaner(pGraph, trimLength, opt::maxIndelLength, opt::pBWT, bIsGapPrecent);
+	cleaner.simplify();
 	//SGSimpleBubbleVisitor sbVisit(opt::pBWT,opt::kmerLength,opt::maxBubbleGapDivergence, opt::maxBubbleDivergence, opt::maxIndelLength);
 
-	if (pGraph->visitP(trimVisit))
-		pGraph->simplify();
+	if (cleaner.trim())
+		cleaner.simplify();
 
 
-	if (pGraph->visitP(smoothingVisit))
+	if (cleaner.smooth())
 	{
-		pGraph->simplify();
-		if (pGraph->visitP(trimVisit))
-			pGraph->simplify();
+		cleaner.simplify();
+		if (cleaner.trim())
+			cleaner.simplify();
 
 	}
 
@@ -544,6 +543,6 @@ void outputGraphAndFasta(StringGraph* pGraph , std::string  name , int phase)
 	if(!name.empty()) out = out + name+ "-";
 
 	SGFastaVisitor fastaVisit (out+"contigs.fa");
-	pGraph->visit(fastaVisit);
+	fastaVisit.write(pGraph);
 	// pGraph->writeASQG(out+"graph.asqg.gz");
 }
@@ -159,7 +159,7 @@ int correctMain(int argc, char** argv)
     BWT* pRBWT = new BWT(opt::prefix + RBWT_EXT, opt::sampleRate);;
     SampledSuffixArray* pSSA = NULL;
     if(opt::algorithm == ECA_OVERLAP || opt::algorithm == ECA_HYBRID)
-        pSSA = new SampledSuffixArray(opt::prefix + SAI_EXT, SSA_FT_SAI);
+        pSSA = SampledSuffixArray::loadLexicoIndex(opt::prefix + BSAI_EXT, opt::prefix + SAI_EXT);
 
     BWTIndexSet indexSet;
     indexSet.pBWT = pBWT;
@@ -194,33 +194,24 @@ int filterMain(int argc, char** argv)
     std::cout << "RE-building index for " << opt::outFile << " in memory using ropebwt2\n";
     std::string prefix=getFilename(opt::outFile);
         //BWT *pBWT, *pRBWT;
-		#pragma omp parallel
-		{
-			#pragma omp single nowait
-			{	
-			    std::string bwt_filename = prefix + BWT_EXT;
-				BWTCA::runRopebwt2(opt::outFile, bwt_filename, opt::numThreads, false);
-				std::cout << "\t done bwt construction, generating .sai file\n";
-				pBWT = new BWT(bwt_filename);
-			}
-			#pragma omp single nowait
-			{	
-				std::string rbwt_filename = prefix + RBWT_EXT;
-				BWTCA::runRopebwt2(opt::outFile, rbwt_filename, opt::numThreads, true);
-				std::cout << "\t done rbwt construction, generating .rsai file\n";
-				pRBWT = new BWT(rbwt_filename);
-			}
-		}
+		std::string bwt_filename = prefix + BWT_EXT;
+		std::string rbwt_filename = prefix + RBWT_EXT;
+		BWTCA::runRopebwt2Joint(opt::outFile, bwt_filename, rbwt_filename, opt::numThreads);
+		std::cout << "\t done bwt and rbwt construction, generating .sai and .rsai files\n";
+		pBWT = new BWT(bwt_filename);
+		pRBWT = new BWT(rbwt_filename);
         std::string sai_filename = prefix + SAI_EXT;
 		SampledSuffixArray ssa;
         ssa.buildLexicoIndex(pBWT, opt::numThreads);
         ssa.writeLexicoIndex(sai_filename);
+        ssa.writeBinarySSA(prefix + BSAI_EXT);
         delete pBWT;
 
         std::string rsai_filename = prefix + RSAI_EXT;
         SampledSuffixArray rssa;
         rssa.buildLexicoIndex(pRBWT, opt::numThreads);
         rssa.writeLexicoIndex(rsai_filename);
+        rssa.writeBinarySSA(prefix + RBSAI_EXT);
         delete pRBWT;
 
     // Cleanup
@@ -12,6 +12,7 @@
 #include "BWT.h"
 #include "Timer.h"
 #include "BWTAlgorithms.h"
+#include "PackedReadTable.h"
 #include <iomanip>
 //
 // Getopt
@@ -25,6 +26,7 @@ SUBPROGRAM " Version " PACKAGE_VERSION "\n"
 static const char *GREP_USAGE_MESSAGE =
 "Usage: " PACKAGE_NAME " " SUBPROGRAM " [OPTION] ... READSFILE\n"
 "Get sequences kmer frequency\n"
+"The reads are taken from READSFILE.prs if it was written by index --read-store, otherwise READSFILE is parsed\n"
 "  -v, --verbose                        display verbose output\n"
 "      --help                           display this help and exit\n";
 
@@ -61,8 +63,14 @@ int grepMain(int argc, char** argv)
 	std::string  prefix = getFilename(opt::readsFile);
 	Timer* pLTimer = new Timer("Load Time");
 	BWT* pBWT = new BWT(prefix + BWT_EXT, BWT::DEFAULT_SAMPLE_RATE_SMALL);
-	SampledSuffixArray* pSSA = new SampledSuffixArray(prefix + SAI_EXT, SSA_FT_SAI);
-	ReadTable* pRT = new ReadTable(opt::readsFile);
+	SampledSuffixArray* pSSA = SampledSuffixArray::loadLexicoIndex(prefix + BSAI_EXT, prefix + SAI_EXT);
+	// Memory map the packed read store if there is one, instead of parsing every read
+	ReadTable* pRT = NULL;
+	PackedReadTable* pPRT = NULL;
+	if(getFilesize(prefix + PRS_EXT) > 0)
+		pPRT = new PackedReadTable(prefix + PRS_EXT);
+	else
+		pRT = new ReadTable(opt::readsFile);
 	delete pLTimer;
 	
 	std::vector<SeqItem> result;
@@ -77,7 +85,8 @@ int grepMain(int argc, char** argv)
 			for(int64_t idx = interval.lower; idx <= interval.upper; ++idx)
 			{
 
-				SeqItem  seqItem = pRT->getRead(pSSA->calcSA(idx,pBWT).getID());
+				size_t readID = pSSA->calcSA(idx,pBWT).getID();
+				SeqItem  seqItem = pPRT != NULL ? pPRT->getRead(readID) : pRT->getRead(readID);
 				
 				result.push_back(seqItem);
 				
@@ -133,6 +142,7 @@ int grepMain(int argc, char** argv)
 	delete pBWT;
 	delete pSSA;
 	delete pRT;
+	delete pPRT;
 	
     return 0;
 }
@@ -0,0 +1,159 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// hitconv - Convert the edge files of overlap between
+// ASQG edge records and binary hits
+//
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include "Util.h"
+#include "hitconv.h"
+#include "SGACommon.h"
+#include "ASQG.h"
+#include "OverlapHitFile.h"
+#include "Timer.h"
+
+//
+// Getopt
+//
+#define SUBPROGRAM "hitconv"
+
+static const char *HITCONV_VERSION_MESSAGE =
+SUBPROGRAM " Version " PACKAGE_VERSION "\n"
+"\n"
+"Copyright 2016 National Chung Cheng University\n";
+
+static const char *HITCONV_USAGE_MESSAGE =
+"Usage: " PACKAGE_NAME " " SUBPROGRAM " [OPTION] ... EDGEFILE\n"
+"Convert an edge file written by overlap between ASQG edge records and binary hits.\n"
+"Binary hits (" BINHITS_EXT ") are written as ASQG edge records and ASQG edge records as binary hits.\n"
+"\n"
+"      --help                           display this help and exit\n"
+"      -v, --verbose                    display verbose output\n"
+"      -o, --outfile=FILE               write the converted edges to FILE (default: EDGEFILE with the\n"
+"                                       extension replaced by " HITS_EXT GZIP_EXT " or " BINHITS_EXT ")\n"
+"\nReport bugs to " PACKAGE_BUGREPORT "\n\n";
+
+static const char* PROGRAM_IDENT =
+PACKAGE_NAME "::" SUBPROGRAM;
+
+namespace opt
+{
+	static unsigned int verbose;
+	static std::string edgeFile;
+	static std::string outFile;
+}
+
+static const char* shortopts = "o:v";
+
+enum { OPT_HELP = 1, OPT_VERSION };
+
+static const struct option longopts[] = {
+	{ "verbose",     no_argument,       NULL, 'v' },
+	{ "outfile",     required_argument, NULL, 'o' },
+	{ "help",        no_argument,       NULL, OPT_HELP },
+	{ "version",     no_argument,       NULL, OPT_VERSION },
+	{ NULL, 0, NULL, 0 }
+};
+
+//
+// Main
+//
+int hitconvMain(int argc, char** argv)
+{
+	parseHitconvOptions(argc, argv);
+	Timer* pTimer = new Timer(PROGRAM_IDENT);
+
+	size_t numEdges = 0;
+	Overlap ovr;
+	if(OverlapHitFile::isHitFile(opt::edgeFile))
+	{
+		if(opt::outFile.empty())
+			opt::outFile = stripExtension(opt::edgeFile) + HITS_EXT + GZIP_EXT;
+
+		OverlapHitFile::Reader reader(opt::edgeFile);
+		std::ostream* pWriter = createWriter(opt::outFile);
+		while(reader.read(ovr))
+		{
+			ASQG::EdgeRecord edgeRecord(ovr);
+			edgeRecord.write(*pWriter);
+			numEdges++;
+		}
+		delete pWriter;
+	}
+	else
+	{
+		if(opt::outFile.empty())
+			opt::outFile = stripGzippedExtension(opt::edgeFile) + BINHITS_EXT;
+
+		// Header and vertex records are left in the ASQG file, only the edges are converted
+		std::istream* pReader = createReader(opt::edgeFile);
+		OverlapHitFile::Writer writer(opt::outFile);
+		std::string recordLine;
+		while(getline(*pReader, recordLine))
+		{
+			if(ASQG::getRecordType(recordLine) != ASQG::RT_EDGE)
+				continue;
+			ASQG::EdgeRecord edgeRecord(recordLine);
+			writer.write(edgeRecord.getOverlap());
+			numEdges++;
+		}
+		delete pReader;
+	}
+
+	std::cout << "Converted " << numEdges << " edges of " << opt::edgeFile << " to " << opt::outFile << "\n";
+	delete pTimer;
+	return 0;
+}
+
+// 
+// Handle command line arguments
+//
+void parseHitconvOptions(int argc, char** argv)
+{
+	optind=1;	//reset getopt
+	bool die = false;
+	for (char c; (c = getopt_long(argc, argv, shortopts, longopts, NULL)) != -1;) 
+	{
+		std::istringstream arg(optarg != NULL ? optarg : "");
+		switch (c) 
+		{
+		case 'o': arg >> opt::outFile; break;
+		case '?': die = true; break;
+		case 'v': opt::verbose++; break;
+		case OPT_HELP:
+			std::cout << HITCONV_USAGE_MESSAGE;
+			exit(EXIT_SUCCESS);
+		case OPT_VERSION:
+			std::cout << HITCONV_VERSION_MESSAGE;
+			exit(EXIT_SUCCESS);
+		}
+	}
+
+	if (argc - optind < 1) 
+	{
+		std::cerr << SUBPROGRAM ": missing arguments\n";
+		die = true;
+	} 
+	else if (argc - optind > 1) 
+	{
+		std::cerr << SUBPROGRAM ": too many arguments\n";
+		die = true;
+	}
+
+	if (die) 
+	{
+		std::cout << "\n" << HITCONV_USAGE_MESSAGE;
+		exit(EXIT_FAILURE);
+	}
+
+	opt::edgeFile = argv[optind++];
+	if(opt::outFile == opt::edgeFile)
+	{
+		std::cerr << SUBPROGRAM ": the output file must differ from the input file\n";
+		exit(EXIT_FAILURE);
+	}
+}
@@ -0,0 +1,17 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// hitconv - Convert the edge files of overlap between
+// ASQG edge records and binary hits
+//
+#ifndef HITCONV_H
+#define HITCONV_H
+#include <getopt.h>
+#include "config.h"
+
+int hitconvMain(int argc, char** argv);
+void parseHitconvOptions(int argc, char** argv);
+
+#endif
@@ -19,6 +19,8 @@
 #include "Timer.h"
 #include "BWTCARopebwt.h"
 #include "SampledSuffixArray.h"
+#include "PackedReadTable.h"
+#include "BWTDiskConstruction.h"
 
 //
 // Getopt
@@ -42,10 +44,23 @@ static const char *INDEX_USAGE_MESSAGE =
 "                                       ropebwt - Li's ropebwt algorithm, suitable for short reads (<200bp) \n"
 "                                       ropebwt2 - Li's ropebwt2 algorithm, suitable for short and long reads (default)\n"
 "  -t, --threads=NUM                    use NUM threads to construct the index (default: 1)\n"
+"  -d, --disk=NUM                       build the index in batches of at most NUM reads with SA-IS and merge the batch BWTs on disk.\n"
+"                                       The batches are merged in a balanced tree and the progress is checkpointed to PREFIX.ckpt,\n"
+"                                       rerunning the same command resumes an interrupted build\n"
+"  -m, --max-memory=SIZE                bound the memory of each batch of the disk construction to SIZE, the batches are then\n"
+"                                       built one at a time with all threads instead of in parallel. The last merges hold the\n"
+"                                       compressed BWT of half the reads, a warning is printed if that exceeds SIZE.\n"
+"                                       SIZE is in MB unless followed by K, M or G (implies -d, default: no bound)\n"
+"  -g, --gap-array=N                    use N bits of storage for each element of the gap array used by the disk merge.\n"
+"                                       Acceptable values are 4,8,16 or 32 (default: 4)\n"
 "  -p, --prefix=PREFIX                  write index to file using PREFIX instead of prefix of READSFILE\n"
 "      --no-reverse                     suppress construction of the reverse BWT. Use this option when building the index\n"
 "                                       for reads that will be error corrected using the k-mer corrector, which only needs the forward index\n"
 "      --no-forward                     suppress construction of the forward BWT. Use this option when building the forward and reverse index separately\n"
+"      --two-pass                       ropebwt2 reads the input twice to build the forward and reverse BWT independently.\n"
+"                                       By default both BWTs are built in a single pass over READSFILE, sharing the -t threads\n"
+"      --read-store                     also write the reads as a memory-mappable 2-bit packed read store (PREFIX.prs),\n"
+"                                       used by grep instead of parsing READSFILE\n"
 "\nReport bugs to " PACKAGE_BUGREPORT "\n\n";
 
 namespace opt
@@ -58,15 +73,20 @@ namespace opt
     static int numReadsPerBatch = 2000000;
     static int numThreads = 8;
     static bool bDiskAlgo = false;
+    static size_t maxMemory = 0;
     static bool bBuildReverse = true;
     static bool bBuildForward = true;
+    static bool bTwoPass = false;
+    static bool bReadStore = false;
     static bool validate;
     static int gapArrayStorage = 4;
 }
 
 static const char* shortopts = "p:a:m:t:d:g:cv";
 
-enum { OPT_HELP = 1, OPT_VERSION, OPT_NO_REVERSE,OPT_NO_FWD };
+enum { OPT_HELP = 1, OPT_VERSION, OPT_NO_REVERSE,OPT_NO_FWD, OPT_TWO_PASS, OPT_READ_STORE };
+
+static bool parseMemorySize(const std::string& str, size_t& bytes);
 
 static const struct option longopts[] = {
     { "verbose",     no_argument,       NULL, 'v' },
@@ -75,9 +95,12 @@ static const struct option longopts[] = {
     { "threads",     required_argument, NULL, 't' },
     { "disk",        required_argument, NULL, 'd' },
     { "gap-array",   required_argument, NULL, 'g' },
+    { "max-memory",  required_argument, NULL, 'm' },
     { "algorithm",   required_argument, NULL, 'a' },
     { "no-reverse",  no_argument,       NULL, OPT_NO_REVERSE },
     { "no-forward",  no_argument,       NULL, OPT_NO_FWD },
+    { "two-pass",    no_argument,       NULL, OPT_TWO_PASS },
+    { "read-store",  no_argument,       NULL, OPT_READ_STORE },
     { "help",        no_argument,       NULL, OPT_HELP },
     { "version",     no_argument,       NULL, OPT_VERSION },
     { NULL, 0, NULL, 0 }
@@ -98,7 +121,13 @@ int indexMain(int argc, char** argv)
             indexInMemoryRopebwt2();
 	}
     else
-		std::cout << "Unknown BWT algorithm!\n";
+        indexOnDisk();
+
+    if(opt::bReadStore)
+    {
+        std::cout << "Writing packed read store " << opt::prefix + PRS_EXT << "\n";
+        PackedReadTable::write(opt::readsFile, opt::prefix + PRS_EXT);
+    }
  
 	
 	delete pTimer;
@@ -145,6 +174,7 @@ void indexInMemoryRopebwt()
 		SampledSuffixArray ssa;
 		ssa.buildLexicoIndex(pBWT, opt::numThreads);
 		ssa.writeLexicoIndex(sai_filename);
+		ssa.writeBinarySSA(opt::prefix + BSAI_EXT);
 		delete pBWT;
 	}
 	
@@ -155,6 +185,7 @@ void indexInMemoryRopebwt()
 		SampledSuffixArray rssa;
 		rssa.buildLexicoIndex(pRBWT, opt::numThreads);
 		rssa.writeLexicoIndex(rsai_filename);
+		rssa.writeBinarySSA(opt::prefix + RBSAI_EXT);
 		delete pRBWT;
 	}
 }
@@ -169,24 +200,36 @@ void indexInMemoryRopebwt2()
 	std::string rbwt_filename = opt::prefix + RBWT_EXT;
 	BWT* pBWT;
 	BWT* pRBWT;
-	#pragma omp parallel
+
+	// Parse the reads once and feed both ropes if both indices are requested
+	if(opt::bBuildForward && opt::bBuildReverse && !opt::bTwoPass)
 	{
-		#pragma omp single nowait
-		{	
-			if(opt::bBuildForward)
-			{
-				BWTCA::runRopebwt2(opt::readsFile, bwt_filename, opt::numThreads, false);
-				std::cout << "\t done bwt construction, generating .sai file\n";
-				pBWT = new BWT(bwt_filename);
+		BWTCA::runRopebwt2Joint(opt::readsFile, bwt_filename, rbwt_filename, opt::numThreads);
+		std::cout << "\t done bwt and rbwt construction, generating .sai and .rsai files\n";
+		pBWT = new BWT(bwt_filename);
+		pRBWT = new BWT(rbwt_filename);
+	}
+	else
+	{
+		#pragma omp parallel
+		{
+			#pragma omp single nowait
+			{	
+				if(opt::bBuildForward)
+				{
+					BWTCA::runRopebwt2(opt::readsFile, bwt_filename, opt::numThreads, false);
+					std::cout << "\t done bwt construction, generating .sai file\n";
+					pBWT = new BWT(bwt_filename);
+				}
 			}
-		}
-		#pragma omp single nowait
-		{	
-			if(opt::bBuildReverse)
-			{
-				BWTCA::runRopebwt2(opt::readsFile, rbwt_filename, opt::numThreads, true);
-				std::cout << "\t done rbwt construction, generating .rsai file\n";
-				pRBWT = new BWT(rbwt_filename);
+			#pragma omp single nowait
+			{	
+				if(opt::bBuildReverse)
+				{
+					BWTCA::runRopebwt2(opt::readsFile, rbwt_filename, opt::numThreads, true);
+					std::cout << "\t done rbwt construction, generating .rsai file\n";
+					pRBWT = new BWT(rbwt_filename);
+				}
 			}
 		}
 	}
@@ -198,6 +241,7 @@ void indexInMemoryRopebwt2()
 		SampledSuffixArray ssa;
 		ssa.buildLexicoIndex(pBWT, opt::numThreads);
 		ssa.writeLexicoIndex(sai_filename);
+		ssa.writeBinarySSA(opt::prefix + BSAI_EXT);
 		delete pBWT;
 	}
 
@@ -208,10 +252,48 @@ void indexInMemoryRopebwt2()
 		SampledSuffixArray rssa;
 		rssa.buildLexicoIndex(pRBWT, opt::numThreads);
 		rssa.writeLexicoIndex(rsai_filename);
+		rssa.writeBinarySSA(opt::prefix + RBSAI_EXT);
 		delete pRBWT;
 	}
 }
 
+// Build the BWTs in batches with SA-IS and merge them on disk, then sample the suffix arrays
+void indexOnDisk()
+{
+    std::cout << "Building index for " << opt::readsFile << " on disk using SAIS batches\n";
+
+    DiskBWTParameters params;
+    params.readsFile = opt::readsFile;
+    params.outPrefix = opt::prefix;
+    params.buildForward = opt::bBuildForward;
+    params.buildReverse = opt::bBuildReverse;
+    params.maxMemory = opt::maxMemory;
+    params.maxReadsPerBatch = opt::numReadsPerBatch;
+    params.numThreads = opt::numThreads;
+    params.gapArrayStorage = opt::gapArrayStorage;
+    buildBWTDisk(params);
+
+    if(opt::bBuildForward)
+    {
+        BWT* pBWT = new BWT(opt::prefix + BWT_EXT);
+        SampledSuffixArray ssa;
+        ssa.buildLexicoIndex(pBWT, opt::numThreads);
+        ssa.writeLexicoIndex(opt::prefix + SAI_EXT);
+        ssa.writeBinarySSA(opt::prefix + BSAI_EXT);
+        delete pBWT;
+    }
+
+    if(opt::bBuildReverse)
+    {
+        BWT* pRBWT = new BWT(opt::prefix + RBWT_EXT);
+        SampledSuffixArray rssa;
+        rssa.buildLexicoIndex(pRBWT, opt::numThreads);
+        rssa.writeLexicoIndex(opt::prefix + RSAI_EXT);
+        rssa.writeBinarySSA(opt::prefix + RBSAI_EXT);
+        delete pRBWT;
+    }
+}
+
 //
 void indexInMemorySAIS()
 {
@@ -282,10 +364,20 @@ void parseIndexOptions(int argc, char** argv)
             case 'd': opt::bDiskAlgo = true; arg >> opt::numReadsPerBatch; break;
             case 't': arg >> opt::numThreads; break;
             case 'g': arg >> opt::gapArrayStorage; break;
+            case 'm':
+                opt::bDiskAlgo = true;
+                if(!parseMemorySize(arg.str(), opt::maxMemory))
+                {
+                    std::cerr << SUBPROGRAM ": invalid argument, --max-memory,-m must be a positive size such as 4096 or 4G (found: " << arg.str() << ")\n";
+                    die = true;
+                }
+                break;
             case 'a': arg >> opt::algorithm; break;
             case 'v': opt::verbose++; break;
             case OPT_NO_REVERSE: opt::bBuildReverse = false; break;
             case OPT_NO_FWD: opt::bBuildForward = false; break;
+            case OPT_TWO_PASS: opt::bTwoPass = true; break;
+            case OPT_READ_STORE: opt::bReadStore = true; break;
             case OPT_HELP:
                 std::cout << INDEX_USAGE_MESSAGE;
                 exit(EXIT_SUCCESS);
@@ -316,6 +408,12 @@ void parseIndexOptions(int argc, char** argv)
         die = true;
     }
 
+    if(opt::bDiskAlgo && opt::numReadsPerBatch <= 0)
+    {
+        std::cerr << SUBPROGRAM ": invalid argument, --disk,-d must be positive (found: " << opt::numReadsPerBatch << ")\n";
+        die = true;
+    }
+
     if(opt::numThreads <= 0)
     {
         std::cerr << SUBPROGRAM ": invalid number of threads: " << opt::numThreads << "\n";
@@ -352,3 +450,24 @@ void parseIndexOptions(int argc, char** argv)
         exit(EXIT_FAILURE);
     }
 }
+
+// Parse a memory size in MB, or in the unit of a K, M or G suffix
+static bool parseMemorySize(const std::string& str, size_t& bytes)
+{
+    std::istringstream parser(str);
+    double size;
+    if(!(parser >> size) || size <= 0)
+        return false;
+
+    std::string unit;
+    parser >> unit;
+    if(unit.empty() || unit == "M" || unit == "m")
+        bytes = size * 1024 * 1024;
+    else if(unit == "K" || unit == "k")
+        bytes = size * 1024;
+    else if(unit == "G" || unit == "g")
+        bytes = size * 1024 * 1024 * 1024;
+    else
+        return false;
+    return bytes > 0;
+}
@@ -24,6 +24,7 @@
 #include "SequenceProcessFramework.h"
 #include "OverlapProcess.h"
 #include "ReadInfoTable.h"
+#include "MinimizerFilter.h"
 #include <sys/stat.h>
 
 /*Tatsuki include */
@@ -42,9 +43,16 @@ enum OutputType
 };
 
 // Functions
-size_t computeHitsSerial(const std::string& prefix, const std::string& readsFile, const OverlapAlgorithm* pOverlapper, int minOverlap, StringVector& filenameVec, std::ostream* pASQGWriter);
+size_t computeHitsSerial(const std::string& prefix, const std::string& readsFile, const OverlapAlgorithm* pOverlapper, int minOverlap, StringVector& filenameVec, std::ostream* pASQGWriter,
+						const MinimizerFilter* pFilter, MinimizerFilterStats& filterStats);
 
-size_t computeHitsParallel(int numThreads, const std::string& prefix, const std::string& readsFile, const OverlapAlgorithm* pOverlapper, int minOverlap, StringVector& filenameVec, std::ostream* pASQGWriter);
+size_t computeHitsParallel(int numThreads, const std::string& prefix, const std::string& readsFile, const OverlapAlgorithm* pOverlapper, int minOverlap, StringVector& filenameVec, std::ostream* pASQGWriter,
+						const MinimizerFilter* pFilter, MinimizerFilterStats& filterStats);
+
+void printFilterStats(const MinimizerFilterStats& stats);
+
+std::string getHitsFilename(const std::string& prefix, size_t idx, bool isBinary);
+void removeHitsFiles(const std::string& prefix, size_t firstIdx, bool isBinary);
 
 //
 // Getopt
@@ -71,6 +79,18 @@ static const char *OVERLAP_USAGE_MESSAGE =
 "      -x, --exhaustive                 output all overlaps, including transitive edges (default if e>0)\n"
 "          --exact                      output irreducible overlaps (default if e=0)\n"
 "      -l, --maxindel                   maximum indels allowed during inexact overlap computation\n"
+"          --binary-hits                write the edges of every thread as binary hits (" BINHITS_EXT ") instead of\n"
+"                                       gzipped ASQG edge records, which assemble and asmlong load without parsing\n"
+"\nMinimizer candidate filter:\n"
+"          --minimizer-filter           index the minimizers of the reads and run only the FM-index searches of the\n"
+"                                       read ends and strands that share minimizers with another read. Substring\n"
+"                                       reads are only detected by the searches that run\n"
+"          --minimizer-report           run all the searches but report the searches the filter would run, the\n"
+"                                       recall of its edges and the substring reads it would miss\n"
+"          --minimizer-k=K              k-mer size of the minimizers, at most 31 (default: 15)\n"
+"          --minimizer-w=W              window of the minimizers in k-mers (default: 10)\n"
+"          --minimizer-hits=N           minimizers a read must share with another to be a candidate (default: 2)\n"
+"                                       smaller k, w and N raise the recall of the filter and lower its speedup\n"
 "\nReport bugs to " PACKAGE_BUGREPORT "\n\n";
 
 static const char* PROGRAM_IDENT =
@@ -96,11 +116,19 @@ namespace opt
 	static int sampleRate = BWT::DEFAULT_SAMPLE_RATE_SMALL;
 	static bool bIrreducibleOnly = true;
 	static bool bExactIrreducible = false;
+	static bool bBinaryHits = false;
+
+	static bool bMinimizerFilter = false;
+	static bool bMinimizerReport = false;
+	static int minimizerK = 15;
+	static int minimizerW = 10;
+	static int minimizerHits = 2;
 }
 
 static const char* shortopts = "m:d:e:t:l:o:f:a:p:vx";
 
-enum { OPT_HELP = 1, OPT_VERSION, OPT_EXACT };
+enum { OPT_HELP = 1, OPT_VERSION, OPT_EXACT, OPT_BINARYHITS,
+       OPT_MINIMIZERFILTER, OPT_MINIMIZERREPORT, OPT_MINIMIZERK, OPT_MINIMIZERW, OPT_MINIMIZERHITS };
 
 static const struct option longopts[] = {
 	{ "verbose",     no_argument,       NULL, 'v' },
@@ -115,6 +143,12 @@ static const struct option longopts[] = {
 	{ "algorithm", required_argument, NULL, 'a' },
 	{ "exhaustive",  no_argument,       NULL, 'x' },
 	{ "exact",       no_argument,       NULL, OPT_EXACT },
+	{ "binary-hits", no_argument,       NULL, OPT_BINARYHITS },
+	{ "minimizer-filter", no_argument,  NULL, OPT_MINIMIZERFILTER },
+	{ "minimizer-report", no_argument,  NULL, OPT_MINIMIZERREPORT },
+	{ "minimizer-k", required_argument, NULL, OPT_MINIMIZERK },
+	{ "minimizer-w", required_argument, NULL, OPT_MINIMIZERW },
+	{ "minimizer-hits", required_argument, NULL, OPT_MINIMIZERHITS },
 	{ "help",        no_argument,       NULL, OPT_HELP },
 	{ "version",     no_argument,       NULL, OPT_VERSION },
 	{ NULL, 0, NULL, 0 }
@@ -196,6 +230,19 @@ int overlapMain(int argc, char** argv)
 	
 	Timer* pTimer = new Timer(PROGRAM_IDENT);
 
+	// Index the minimizers of the targets for the candidate filter
+	MinimizerFilter* pFilter = NULL;
+	if(opt::bMinimizerFilter || opt::bMinimizerReport)
+	{
+		Timer filterTimer("Minimizer index");
+		bool isSelf = opt::targetFile.empty() || opt::targetFile == opt::readsFile;
+		pFilter = new MinimizerFilter(isSelf ? opt::readsFile : opt::targetFile, opt::minimizerK, opt::minimizerW,
+		                              opt::minimizerHits, opt::minOverlap, opt::errorRate, isSelf);
+		printf("[%s] indexed %zu minimizers of %zu reads, ignoring minimizers occurring over %zu times\n", 
+		       PROGRAM_IDENT, pFilter->getNumMinimizers(), pFilter->getNumTargets(), pFilter->getMaxOcc());
+	}
+	MinimizerFilterStats filterStats;
+
 	// Make a prefix for the hit edges files
 	std::string outPrefix;
 	outPrefix = getFilename(opt::readsFile);
@@ -213,18 +260,25 @@ int overlapMain(int argc, char** argv)
 				<< "Algorithm: " << opt::algorithm << "\n";
 				
 	std::cout << "\n# start time of overlapping: " << asctime(localtime(&now))<<std::endl;
+
+	// The graph loaders take whichever format the thread0 file has, drop the edges of the other format
+	removeHitsFiles(outPrefix, 0, !opt::bBinaryHits);
 	
 	if(opt::numThreads <= 1)
 	{
 		printf("[%s] starting serial-mode overlap computation\n", PROGRAM_IDENT);
-		computeHitsSerial(outPrefix, opt::readsFile, pOverlapper, opt::minOverlap, hitsFilenames, pASQGWriter);
+		computeHitsSerial(outPrefix, opt::readsFile, pOverlapper, opt::minOverlap, hitsFilenames, pASQGWriter, pFilter, filterStats);
 	}
 	else
 	{
 		printf("[%s] starting parallel-mode overlap computation with %d threads\n", PROGRAM_IDENT, opt::numThreads);
-		computeHitsParallel(opt::numThreads, outPrefix, opt::readsFile, pOverlapper, opt::minOverlap, hitsFilenames, pASQGWriter);
+		computeHitsParallel(opt::numThreads, outPrefix, opt::readsFile, pOverlapper, opt::minOverlap, hitsFilenames, pASQGWriter, pFilter, filterStats);
 	}
 
+	if(pFilter != NULL)
+		printFilterStats(filterStats);
+
+	delete pFilter;
 	delete pOverlapper;
 	delete pBWT; 
 	delete pRBWT;
@@ -237,12 +291,14 @@ int overlapMain(int argc, char** argv)
 // Compute the hits for each read in the input file without threading
 // Return the number of reads processed
 size_t computeHitsSerial(const std::string& prefix, const std::string& readsFile, const OverlapAlgorithm* pOverlapper, int minOverlap, 
-						StringVector& filenameVec, std::ostream* pASQGWriter)
+						StringVector& filenameVec, std::ostream* pASQGWriter,
+						const MinimizerFilter* pFilter, MinimizerFilterStats& filterStats)
 {
-	std::string filename = prefix + "-thread0" +HITS_EXT + GZIP_EXT;
+	std::string filename = getHitsFilename(prefix, 0, opt::bBinaryHits);
 	filenameVec.push_back(filename);
+	removeHitsFiles(prefix, 1, opt::bBinaryHits);
 
-	OverlapProcess processor(filename, pOverlapper, minOverlap);
+	OverlapProcess processor(filename, pOverlapper, minOverlap, opt::bBinaryHits, pFilter, opt::bMinimizerReport);
 	OverlapPostProcess postProcessor(pASQGWriter, pOverlapper);
 
 	size_t numProcessed = 
@@ -250,6 +306,7 @@ size_t computeHitsSerial(const std::string& prefix, const std::string& readsFile
 	OverlapResult, 
 	OverlapProcess, 
 	OverlapPostProcess>(readsFile, &processor, &postProcessor);
+	filterStats.add(processor.getFilterStats());
 	return numProcessed;
 }
 
@@ -260,52 +317,23 @@ size_t computeHitsSerial(const std::string& prefix, const std::string& readsFile
 // The number of reads processsed is returned
 size_t computeHitsParallel(int numThreads, const std::string& prefix, const std::string& readsFile, 
 											const OverlapAlgorithm* pOverlapper, int minOverlap, 
-											StringVector& filenameVec, std::ostream* pASQGWriter)
+											StringVector& filenameVec, std::ostream* pASQGWriter,
+											const MinimizerFilter* pFilter, MinimizerFilterStats& filterStats)
 {
 	//std::string filename = prefix + HITS_EXT + GZIP_EXT;
 
 	std::vector<OverlapProcess*> processorVector;
 	for(int i = 0; i < numThreads; ++i)
 	{
-		std::stringstream ss;
-		ss << prefix << "-thread" << i << HITS_EXT << GZIP_EXT;
-		std::string outfile = ss.str();
+		std::string outfile = getHitsFilename(prefix, i, opt::bBinaryHits);
 		filenameVec.push_back(outfile);
-		OverlapProcess* pProcessor = new OverlapProcess(outfile, pOverlapper, minOverlap);
+		OverlapProcess* pProcessor = new OverlapProcess(outfile, pOverlapper, minOverlap, opt::bBinaryHits, pFilter, opt::bMinimizerReport);
 		processorVector.push_back(pProcessor);
 	}
 
 	//Remove previous edge files generated by larger threads, otherwise, subsequent assembly may load inconsistent edges files
-	std::stringstream ss;
-	size_t fileIdx=numThreads;
-	ss << prefix << "-thread" << fileIdx << HITS_EXT << GZIP_EXT;
-	std::string edgefile = ss.str();
-	
-	struct stat buffer;   
-	while(stat (edgefile.c_str(), &buffer) == 0)
-	{
-		remove(edgefile.c_str());
-		//search for next edge file
-		ss.str("");
-		fileIdx++;
-		ss << prefix << "-thread" << fileIdx << HITS_EXT << GZIP_EXT;
-		edgefile = ss.str();
-	}
-	/*
-	std::istream* pistream = createReader(edgefile);
-	while(pistream->peek()!=std::istream::traits_type::eof())
-	{
-		//std::cout << edgefile << std::endl;
-		unlink(edgefile.c_str());
-		//search for next edge file
-		ss.str("");
-		fileIdx++;
-		ss << prefix << "-thread" << fileIdx << HITS_EXT << GZIP_EXT;
-		edgefile = ss.str();
-		pistream = createReader(edgefile);		
-	}*/
+	removeHitsFiles(prefix, numThreads, opt::bBinaryHits);
 
-	
 	// The post processing is performed serially so only one post processor is created
 	OverlapPostProcess postProcessor(pASQGWriter, pOverlapper);
 	
@@ -316,11 +344,58 @@ size_t computeHitsParallel(int numThreads, const std::string& prefix, const std:
 	OverlapPostProcess>(readsFile, processorVector, &postProcessor);
 
 	for(int i = 0; i < numThreads; ++i)
+	{
+		filterStats.add(processorVector[i]->getFilterStats());
 		delete processorVector[i];
+	}
 
 	return numProcessed;
 }
 
+std::string getHitsFilename(const std::string& prefix, size_t idx, bool isBinary)
+{
+	std::stringstream ss;
+	ss << prefix << "-thread" << idx;
+	if(isBinary)
+		ss << BINHITS_EXT;
+	else
+		ss << HITS_EXT << GZIP_EXT;
+	return ss.str();
+}
+
+// Print how much of the search the minimizer filter selected and the edges it kept
+void printFilterStats(const MinimizerFilterStats& stats)
+{
+	double searchPct = stats.numReads > 0 ? 100.0 * stats.numSearches / (4 * stats.numReads) : 0.0;
+	double recallPct = stats.numEdges > 0 ? 100.0 * stats.numKeptEdges / stats.numEdges : 100.0;
+
+	printf("[%s] minimizer filter %s %zu of %zu searches (%.2f%%), %zu of %zu reads without candidates\n",
+	       PROGRAM_IDENT, opt::bMinimizerReport ? "selects" : "ran", stats.numSearches, 4 * stats.numReads, searchPct,
+	       stats.numSkippedReads, stats.numReads);
+	if(opt::bMinimizerReport)
+	{
+		printf("[%s] minimizer filter recall: %zu of %zu edges of the unfiltered search (%.2f%%)\n",
+		       PROGRAM_IDENT, stats.numKeptEdges, stats.numEdges, recallPct);
+		printf("[%s] minimizer filter misses %zu of %zu substring reads of the unfiltered search\n",
+		       PROGRAM_IDENT, stats.numMissedSubstrings, stats.numSubstrings);
+	}
+	else
+		printf("[%s] minimizer filter wrote %zu edges, run with --minimizer-report for its recall\n",
+		       PROGRAM_IDENT, stats.numEdges);
+}
+
+// Remove the edge files of thread firstIdx onwards
+void removeHitsFiles(const std::string& prefix, size_t firstIdx, bool isBinary)
+{
+	struct stat buffer;
+	std::string edgefile = getHitsFilename(prefix, firstIdx, isBinary);
+	while(stat(edgefile.c_str(), &buffer) == 0)
+	{
+		remove(edgefile.c_str());
+		edgefile = getHitsFilename(prefix, ++firstIdx, isBinary);
+	}
+}
+
 
 /*************************************************************************************************************************************************/
 // 
@@ -344,6 +419,12 @@ void parseOverlapOptions(int argc, char** argv)
 		case 'f': arg >> opt::targetFile; break;
 		case 'a': arg >> opt::algorithm; break;
 		case OPT_EXACT: opt::bExactIrreducible = true; break;
+		case OPT_BINARYHITS: opt::bBinaryHits = true; break;
+		case OPT_MINIMIZERFILTER: opt::bMinimizerFilter = true; break;
+		case OPT_MINIMIZERREPORT: opt::bMinimizerReport = true; break;
+		case OPT_MINIMIZERK: arg >> opt::minimizerK; break;
+		case OPT_MINIMIZERW: arg >> opt::minimizerW; break;
+		case OPT_MINIMIZERHITS: arg >> opt::minimizerHits; break;
 		case 'x': opt::bIrreducibleOnly = false; break;
 		case '?': die = true; break;
 		case 'v': opt::verbose++; break;
@@ -373,6 +454,24 @@ void parseOverlapOptions(int argc, char** argv)
 		die = true;
 	}
 
+	if(opt::bMinimizerFilter && opt::bMinimizerReport)
+	{
+		std::cerr << SUBPROGRAM ": --minimizer-filter and --minimizer-report can not be used together\n";
+		die = true;
+	}
+
+	if(opt::minimizerK <= 0 || opt::minimizerK > 31)
+	{
+		std::cerr << SUBPROGRAM ": invalid minimizer k-mer size: " << opt::minimizerK << ", must be between 1 and 31\n";
+		die = true;
+	}
+
+	if(opt::minimizerW <= 0 || opt::minimizerHits <= 0)
+	{
+		std::cerr << SUBPROGRAM ": the minimizer window and hits must be positive\n";
+		die = true;
+	}
+
 	if(!IS_POWER_OF_2(opt::sampleRate))
 	{
 		std::cerr << SUBPROGRAM ": invalid parameter to -d/--sample-rate, must be power of 2. got: " << opt::sampleRate << "\n";
@@ -0,0 +1,505 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// CompactStringGraph - Read-mostly string graph in flat arrays
+//
+#include <omp.h>
+#include <algorithm>
+#include <stdio.h>
+#include "CompactStringGraph.h"
+#include "Alphabet.h"
+
+CompactStringGraph::CompactStringGraph()
+{
+    clear();
+}
+
+void CompactStringGraph::clear()
+{
+    m_idArena.clear();
+    m_idStart.assign(1, 0);
+    m_seqArena.clear();
+    m_seqStart.assign(1, 0);
+    m_seqLen.clear();
+    m_vertexColor.clear();
+    m_containedVertices.clear();
+    m_coverage.clear();
+    m_originLength.clear();
+    m_superRepeatVertices.clear();
+    m_deletedVertices.clear();
+    m_numLiveVertices = 0;
+    m_sortedByID.clear();
+
+    m_edgeStart.assign(1, 0);
+    m_edges.clear();
+    m_deletedEdges.clear();
+    m_numLiveEdges = 0;
+    m_pendingEdges.clear();
+    m_pendingDegree.clear();
+
+    m_hasContainment = false;
+    m_hasTransitive = false;
+    m_isExactMode = false;
+    m_minOverlap = 0;
+    m_errorRate = 0.0f;
+}
+
+//
+// Construction
+//
+CompactStringGraph::VertexIdx CompactStringGraph::addVertex(const std::string& id, const std::string& seq, bool isContained)
+{
+    VertexIdx v = m_seqLen.size();
+    m_idArena.append(id);
+    m_idStart.push_back(m_idArena.size());
+
+    // 32 bases per word, the first base in the lowest bits
+    uint64_t start = m_seqStart.back();
+    m_seqArena.resize((start + seq.length() + 31) / 32, 0);
+    for(size_t i = 0; i < seq.length(); ++i)
+    {
+        uint64_t pos = start + i;
+        m_seqArena[pos >> 5] |= (uint64_t)DNA_ALPHABET::getBaseRank(seq[i]) << ((pos & 31) << 1);
+    }
+    // Start every sequence at a word boundary
+    m_seqStart.push_back((start + seq.length() + 31) & ~(uint64_t)31);
+
+    m_seqLen.push_back(seq.length());
+    m_vertexColor.push_back(GC_WHITE);
+    m_coverage.push_back(1);
+    m_originLength.push_back(seq.length());
+    m_originLength.push_back(seq.length());
+
+    if(m_containedVertices.size() * 64 <= v)
+    {
+        m_containedVertices.push_back(0);
+        m_superRepeatVertices.push_back(0);
+    }
+    if(isContained)
+        setBit(m_containedVertices, v);
+    return v;
+}
+
+void CompactStringGraph::finalizeVertices()
+{
+    size_t numVertices = getNumVertices();
+    resizeBits(m_deletedVertices, numVertices);
+    m_numLiveVertices = numVertices;
+
+    m_sortedByID.resize(numVertices);
+    for(size_t v = 0; v < numVertices; ++v)
+        m_sortedByID[v] = v;
+
+    const std::string& arena = m_idArena;
+    const std::vector<uint64_t>& idStart = m_idStart;
+    std::sort(m_sortedByID.begin(), m_sortedByID.end(), [&arena, &idStart](VertexIdx a, VertexIdx b)
+    {
+        return arena.compare(idStart[a], idStart[a + 1] - idStart[a], arena, idStart[b], idStart[b + 1] - idStart[b]) < 0;
+    });
+
+    m_pendingDegree.assign(numVertices, 0);
+}
+
+CompactStringGraph::VertexIdx CompactStringGraph::findVertex(const std::string& id) const
+{
+    size_t lo = 0, hi = m_sortedByID.size();
+    while(lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        VertexIdx v = m_sortedByID[mid];
+        int cmp = m_idArena.compare(m_idStart[v], m_idStart[v + 1] - m_idStart[v], id);
+        if(cmp == 0)
+            return v;
+        if(cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return NO_VERTEX;
+}
+
+void CompactStringGraph::addPendingEdge(VertexIdx start, VertexIdx end, EdgeDir dir, EdgeComp comp, const SeqCoord& coord, GraphColor c)
+{
+    PendingEdge pe;
+    pe.start = start;
+    pe.edge.twin = 0;
+    pe.edge.end = end;
+    pe.edge.matchStart = coord.interval.start;
+    pe.edge.matchEnd = coord.interval.end;
+    pe.edge.flags = (dir == ED_ANTISENSE ? DIR_FLAG : 0) | (comp == EC_REVERSE ? COMP_FLAG : 0);
+    pe.edge.color = c;
+    m_pendingEdges.push_back(pe);
+    m_pendingDegree[start]++;
+}
+
+void CompactStringGraph::addOverlap(const Overlap& o, VertexIdx v0, VertexIdx v1, bool allowContained, size_t maxEdges, GraphColor c)
+{
+    VertexIdx verts[2] = { v0, v1 };
+    EdgeComp comp = (o.match.isRC()) ? EC_REVERSE : EC_SAME;
+
+    bool isContainment = o.match.isContainment();
+    assert(allowContained || !isContainment);
+    (void)allowContained;
+
+    // One of the vertices is a strict substring of some other vertex and not in the graph
+    if(v0 == NO_VERTEX || v1 == NO_VERTEX)
+        return;
+
+    // Substring containment, mark the contained read but do not create edges
+    for(size_t idx = 0; idx < 2; ++idx)
+    {
+        if(!o.match.coord[idx].isExtreme())
+        {
+            assert(o.match.coord[1 - idx].isExtreme());
+            m_vertexColor[verts[1 - idx]] = GC_RED;
+            m_hasContainment = true;
+            return;
+        }
+    }
+
+    if(m_pendingDegree[v0] > maxEdges || m_pendingDegree[v1] > maxEdges)
+    {
+        WARN_ONCE("Edge limit reached for vertex when loading graph");
+        return;
+    }
+
+    EdgeIdx first = m_pendingEdges.size();
+    if(!isContainment)
+    {
+        for(size_t idx = 0; idx < 2; ++idx)
+        {
+            EdgeDir dir = o.match.coord[idx].isLeftExtreme() ? ED_ANTISENSE : ED_SENSE;
+            addPendingEdge(verts[idx], verts[1 - idx], dir, comp, o.match.coord[idx], c);
+        }
+        m_pendingEdges[first].edge.twin = first + 1;
+        m_pendingEdges[first + 1].edge.twin = first;
+    }
+    else
+    {
+        // Contained edges can be travelled in either direction, add two edges per vertex
+        // in the order of createEdgesFromOverlap
+        addPendingEdge(v0, v1, ED_SENSE, comp, o.match.coord[0], c);
+        addPendingEdge(v0, v1, ED_ANTISENSE, comp, o.match.coord[0], c);
+        addPendingEdge(v1, v0, ED_SENSE, comp, o.match.coord[1], c);
+        addPendingEdge(v1, v0, ED_ANTISENSE, comp, o.match.coord[1], c);
+        m_pendingEdges[first].edge.twin = first + 2;
+        m_pendingEdges[first + 2].edge.twin = first;
+        m_pendingEdges[first + 1].edge.twin = first + 3;
+        m_pendingEdges[first + 3].edge.twin = first + 1;
+
+        setBit(m_containedVertices, verts[o.getContainedIdx()]);
+        m_hasContainment = true;
+    }
+}
+
+// Counting sort of the pending edges by start vertex, stable so the edges of
+// a vertex keep the order they were added in
+void CompactStringGraph::finalizeEdges()
+{
+    size_t numVertices = getNumVertices();
+    m_edgeStart.assign(numVertices + 1, 0);
+    for(size_t v = 0; v < numVertices; ++v)
+        m_edgeStart[v + 1] = m_edgeStart[v] + m_pendingDegree[v];
+
+    std::vector<EdgeIdx> next(m_edgeStart.begin(), m_edgeStart.end() - 1);
+    std::vector<EdgeIdx> newPos(m_pendingEdges.size());
+    for(size_t i = 0; i < m_pendingEdges.size(); ++i)
+        newPos[i] = next[m_pendingEdges[i].start]++;
+
+    m_edges.resize(m_pendingEdges.size());
+    for(size_t i = 0; i < m_pendingEdges.size(); ++i)
+    {
+        CompactEdge& edge = m_edges[newPos[i]];
+        edge = m_pendingEdges[i].edge;
+        edge.twin = newPos[edge.twin];
+    }
+
+    resizeBits(m_deletedEdges, m_edges.size());
+    m_numLiveEdges = m_edges.size();
+
+    std::vector<PendingEdge>().swap(m_pendingEdges);
+    std::vector<uint32_t>().swap(m_pendingDegree);
+}
+
+//
+// Accessors
+//
+std::string CompactStringGraph::getSeq(VertexIdx v) const
+{
+    std::string seq(m_seqLen[v], 'A');
+    uint64_t start = m_seqStart[v];
+    for(size_t i = 0; i < seq.length(); ++i)
+    {
+        uint64_t pos = start + i;
+        seq[i] = DNA_ALPHABET::getBase((m_seqArena[pos >> 5] >> ((pos & 31) << 1)) & 3);
+    }
+    return seq;
+}
+
+SeqCoord CompactStringGraph::getMatchCoord(EdgeIdx e) const
+{
+    const CompactEdge& edge = m_edges[e];
+    return SeqCoord(edge.matchStart, edge.matchEnd, m_seqLen[getEnd(edge.twin)]);
+}
+
+size_t CompactStringGraph::countEdges(VertexIdx v, EdgeDir dir) const
+{
+    size_t count = 0;
+    for(EdgeIdx e = getFirstEdge(v); e < getLastEdge(v); ++e)
+        count += !isEdgeDeleted(e) && getDir(e) == dir;
+    return count;
+}
+
+size_t CompactStringGraph::countEdges(VertexIdx v) const
+{
+    size_t count = 0;
+    for(EdgeIdx e = getFirstEdge(v); e < getLastEdge(v); ++e)
+        count += !isEdgeDeleted(e);
+    return count;
+}
+
+//
+// Deletion
+//
+void CompactStringGraph::removeEdge(EdgeIdx e)
+{
+    if(isEdgeDeleted(e))
+        return;
+    EdgeIdx twin = getTwin(e);
+    setBit(m_deletedEdges, e);
+    setBit(m_deletedEdges, twin);
+    m_numLiveEdges -= (twin == e) ? 1 : 2;
+}
+
+void CompactStringGraph::removeVertex(VertexIdx v)
+{
+    if(isVertexDeleted(v))
+        return;
+    for(EdgeIdx e = getFirstEdge(v); e < getLastEdge(v); ++e)
+        removeEdge(e);
+    setBit(m_deletedVertices, v);
+    m_numLiveVertices--;
+}
+
+// Duplicates are marked over the whole graph first and removed afterwards, like
+// the marking and sweeping of SGDuplicateVisitor. The edges are sorted in place
+// as Vertex::markDuplicateEdges sorts the adjacency lists, so the edges that are
+// kept end up in the same order as in a Bigraph loaded from the same file.
+size_t CompactStringGraph::removeDuplicateEdges()
+{
+    sortEdgesByLen();
+
+    std::vector<uint64_t> isDup;
+    resizeBits(isDup, m_edges.size());
+    std::vector<uint64_t> isSeen;
+    resizeBits(isSeen, getNumVertices());
+
+    for(VertexIdx v = 0; v < getNumVertices(); ++v)
+    {
+        if(isVertexDeleted(v))
+            continue;
+
+        for(size_t d = 0; d < ED_COUNT; ++d)
+        {
+            for(EdgeIdx e = getFirstEdge(v); e < getLastEdge(v); ++e)
+            {
+                if(isEdgeDeleted(e) || getDir(e) != EDGE_DIRECTIONS[d])
+                    continue;
+                VertexIdx end = getEnd(e);
+                if(testBit(isSeen, end))
+                {
+                    setBit(isDup, e);
+                    setBit(isDup, getTwin(e));
+                }
+                else
+                {
+                    setBit(isSeen, end);
+                }
+            }
+            for(EdgeIdx e = getFirstEdge(v); e < getLastEdge(v); ++e)
+                isSeen[getEnd(e) >> 6] = 0;
+        }
+
+        // Vertex::markDuplicateEdges leaves the neighbours white
+        for(EdgeIdx e = getFirstEdge(v); e < getLastEdge(v); ++e)
+        {
+            if(!isEdgeDeleted(e))
+                m_vertexColor[getEnd(e)] = GC_WHITE;
+        }
+    }
+
+    size_t numLive = m_numLiveEdges;
+    for(EdgeIdx e = 0; e < m_edges.size(); ++e)
+    {
+        if(testBit(isDup, e))
+            removeEdge(e);
+    }
+    return numLive - m_numLiveEdges;
+}
+
+// Every vertex permutes its own range of the edge array, the twins and
+// the tombstones are remapped once all the ranges are sorted. The label
+// lengths are taken first as they read the twins in other ranges.
+void CompactStringGraph::sortEdgesByLen()
+{
+    size_t numVertices = getNumVertices();
+    std::vector<uint32_t> labelLen(m_edges.size());
+    #pragma omp parallel for schedule(static)
+    for(EdgeIdx e = 0; e < m_edges.size(); ++e)
+        labelLen[e] = getLabelLength(e);
+
+    std::vector<EdgeIdx> newPos(m_edges.size());
+    std::vector<uint32_t> numLive(numVertices);
+
+    #pragma omp parallel
+    {
+        std::vector<EdgeIdx> order;
+        std::vector<CompactEdge> buffer;
+
+        #pragma omp for schedule(dynamic, 1024)
+        for(VertexIdx v = 0; v < numVertices; ++v)
+        {
+            EdgeIdx first = getFirstEdge(v);
+            EdgeIdx last = getLastEdge(v);
+            order.clear();
+            for(EdgeIdx e = first; e < last; ++e)
+            {
+                if(!isEdgeDeleted(e))
+                    order.push_back(e);
+            }
+            numLive[v] = order.size();
+            std::sort(order.begin(), order.end(), [&labelLen](EdgeIdx a, EdgeIdx b) { return labelLen[a] < labelLen[b]; });
+            for(EdgeIdx e = first; e < last; ++e)
+            {
+                if(isEdgeDeleted(e))
+                    order.push_back(e);
+            }
+
+            buffer.assign(m_edges.begin() + first, m_edges.begin() + last);
+            for(size_t i = 0; i < order.size(); ++i)
+            {
+                newPos[order[i]] = first + i;
+                m_edges[first + i] = buffer[order[i] - first];
+            }
+        }
+    }
+
+    #pragma omp parallel for schedule(static)
+    for(EdgeIdx e = 0; e < m_edges.size(); ++e)
+        m_edges[e].twin = newPos[m_edges[e].twin];
+
+    resizeBits(m_deletedEdges, m_edges.size());
+    for(VertexIdx v = 0; v < numVertices; ++v)
+    {
+        for(EdgeIdx e = getFirstEdge(v) + numLive[v]; e < getLastEdge(v); ++e)
+            setBit(m_deletedEdges, e);
+    }
+}
+
+//
+// Conversion
+//
+Bigraph* CompactStringGraph::toBigraph() const
+{
+    Bigraph* pGraph = new Bigraph;
+    pGraph->setContainmentFlag(m_hasContainment);
+    pGraph->setTransitiveFlag(m_hasTransitive);
+    pGraph->setExactMode(m_isExactMode);
+    pGraph->setMinOverlap(m_minOverlap);
+    pGraph->setErrorRate(m_errorRate);
+
+    std::vector<Vertex*> verts(getNumVertices(), NULL);
+    for(VertexIdx v = 0; v < getNumVertices(); ++v)
+    {
+        if(isVertexDeleted(v))
+            continue;
+        Vertex* pVertex = new(pGraph->getVertexAllocator()) Vertex(getID(v), getSeq(v));
+        pVertex->setColor(m_vertexColor[v]);
+        pVertex->setContained(isContained(v));
+        pVertex->setSuperRepeat(isSuperRepeat(v));
+        pVertex->setCoverage(m_coverage[v]);
+        pVertex->setOriginLength(m_originLength[2 * v], ED_SENSE);
+        pVertex->setOriginLength(m_originLength[2 * v + 1], ED_ANTISENSE);
+        pGraph->addVertex(pVertex);
+        verts[v] = pVertex;
+    }
+
+    // Create all the edges before adding any, Bigraph::addEdge needs the twin
+    std::vector<Edge*> edges(m_edges.size(), NULL);
+    for(EdgeIdx e = 0; e < m_edges.size(); ++e)
+    {
+        if(!isEdgeDeleted(e))
+            edges[e] = new Edge(verts[getEnd(e)], getDir(e), getComp(e), getMatchCoord(e), getEdgeColor(e));
+    }
+
+    for(VertexIdx v = 0; v < getNumVertices(); ++v)
+    {
+        for(EdgeIdx e = getFirstEdge(v); e < getLastEdge(v); ++e)
+        {
+            if(edges[e] == NULL)
+                continue;
+            edges[e]->setTwin(edges[getTwin(e)]);
+            pGraph->addEdge(verts[v], edges[e]);
+        }
+    }
+    return pGraph;
+}
+
+//
+// Statistics
+//
+void CompactStringGraph::printStats() const
+{
+    int num_vertex = 0, num_edges = 0, num_island = 0, num_terminal = 0;
+    int num_monobranch = 0, num_dibranch = 0, num_simple = 0, num_straight = 0;
+    for(VertexIdx v = 0; v < getNumVertices(); ++v)
+    {
+        if(isVertexDeleted(v))
+            continue;
+        int s_count = countEdges(v, ED_SENSE);
+        int as_count = countEdges(v, ED_ANTISENSE);
+        if(s_count == 0 && as_count == 0)
+            ++num_island;
+        else if(s_count == 0 || as_count == 0)
+            ++num_terminal;
+
+        if(s_count > 1 && as_count > 1)
+            ++num_dibranch;
+        else if(s_count > 1 || as_count > 1)
+            ++num_monobranch;
+
+        if(s_count == 1 || as_count == 1)
+            ++num_simple;
+
+        if(s_count == 1 && as_count == 1)
+            ++num_straight;
+
+        num_edges += (s_count + as_count);
+        ++num_vertex;
+    }
+    printf("Vertices: %d Edges: %d Islands: %d Tips: %d Monobranch: %d Dibranch: %d Simple: %d Straight: %d\n",
+    num_vertex, num_edges, num_island, num_terminal, num_monobranch, num_dibranch, num_simple, num_straight);
+}
+
+size_t CompactStringGraph::getMemSize() const
+{
+    return m_idArena.capacity() +
+           m_idStart.capacity() * sizeof(uint64_t) +
+           m_seqArena.capacity() * sizeof(uint64_t) +
+           m_seqStart.capacity() * sizeof(uint64_t) +
+           m_seqLen.capacity() * sizeof(uint32_t) +
+           m_vertexColor.capacity() * sizeof(GraphColor) +
+           m_containedVertices.capacity() * sizeof(uint64_t) +
+           m_coverage.capacity() * sizeof(uint16_t) +
+           m_originLength.capacity() * sizeof(uint32_t) +
+           m_superRepeatVertices.capacity() * sizeof(uint64_t) +
+           m_deletedVertices.capacity() * sizeof(uint64_t) +
+           m_sortedByID.capacity() * sizeof(VertexIdx) +
+           m_edgeStart.capacity() * sizeof(EdgeIdx) +
+           m_edges.capacity() * sizeof(CompactEdge) +
+           m_deletedEdges.capacity() * sizeof(uint64_t) +
+           m_pendingEdges.capacity() * sizeof(PendingEdge) +
+           m_pendingDegree.capacity() * sizeof(uint32_t);
+}
@@ -0,0 +1,197 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// CompactStringGraph - Read-mostly string graph in flat arrays.
+// Vertices are numbered by integers, their IDs and sequences live
+// in two arenas (the sequences packed two bits per base like
+// DNAEncodedString). The edges of a vertex are a contiguous range
+// of one edge array (CSR), every edge holding the index of its end
+// vertex, the index of its twin and its match interval; the length
+// of the match coordinate is the length of the start vertex.
+// Vertices and edges are deleted by setting bits of tombstone
+// bitmaps, so the arrays never move once built.
+//
+// The graph is built by adding all the vertices, then the overlaps,
+// and finalizing the edges. Duplicate edges are removed in place and
+// SGReduction removes the containments and transitive edges on the
+// arrays; toBigraph then builds a Bigraph of what is left for the
+// passes that restructure the graph. Nothing else runs on this
+// layout, so the saving is limited to loading and reduction: the
+// peak memory still holds the Bigraph of the reduced graph next to
+// these arrays until the caller deletes them.
+//
+#ifndef COMPACTSTRINGGRAPH_H
+#define COMPACTSTRINGGRAPH_H
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "Bigraph.h"
+
+class CompactStringGraph
+{
+    public:
+        typedef uint32_t VertexIdx;
+        typedef uint64_t EdgeIdx;
+        static const VertexIdx NO_VERTEX = (VertexIdx)-1;
+
+        CompactStringGraph();
+
+        //
+        // Construction: add every vertex, call finalizeVertices,
+        // add the overlaps and call finalizeEdges
+        //
+        VertexIdx addVertex(const std::string& id, const std::string& seq, bool isContained);
+        void finalizeVertices();
+
+        // Index of the vertex named id, NO_VERTEX if there is none.
+        // Thread-safe once the vertices are finalized.
+        VertexIdx findVertex(const std::string& id) const;
+
+        // Add the edges of o between the vertices v0 = findVertex(o.id[0]) and
+        // v1 = findVertex(o.id[1]), following SGAlgorithms::createEdgesFromOverlap
+        void addOverlap(const Overlap& o, VertexIdx v0, VertexIdx v1, bool allowContained, size_t maxEdges = -1, GraphColor c = GC_WHITE);
+        void finalizeEdges();
+
+        //
+        // Vertices
+        //
+        size_t getNumVertices() const { return m_seqLen.size(); }
+        size_t getNumLiveVertices() const { return m_numLiveVertices; }
+        bool isVertexDeleted(VertexIdx v) const { return testBit(m_deletedVertices, v); }
+        std::string getID(VertexIdx v) const { return m_idArena.substr(m_idStart[v], m_idStart[v + 1] - m_idStart[v]); }
+        std::string getSeq(VertexIdx v) const;
+        size_t getSeqLen(VertexIdx v) const { return m_seqLen[v]; }
+        bool isContained(VertexIdx v) const { return testBit(m_containedVertices, v); }
+        bool isSuperRepeat(VertexIdx v) const { return testBit(m_superRepeatVertices, v); }
+        GraphColor getColor(VertexIdx v) const { return m_vertexColor[v]; }
+        void setColor(VertexIdx v, GraphColor c) { m_vertexColor[v] = c; }
+
+        //
+        // Edges, the edges of v are [getFirstEdge(v), getLastEdge(v)) including deleted ones
+        //
+        size_t getNumEdges() const { return m_edges.size(); }
+        size_t getNumLiveEdges() const { return m_numLiveEdges; }
+        EdgeIdx getFirstEdge(VertexIdx v) const { return m_edgeStart[v]; }
+        EdgeIdx getLastEdge(VertexIdx v) const { return m_edgeStart[v + 1]; }
+        bool isEdgeDeleted(EdgeIdx e) const { return testBit(m_deletedEdges, e); }
+        VertexIdx getEnd(EdgeIdx e) const { return m_edges[e].end; }
+        EdgeIdx getTwin(EdgeIdx e) const { return m_edges[e].twin; }
+        EdgeDir getDir(EdgeIdx e) const { return (m_edges[e].flags & DIR_FLAG) ? ED_ANTISENSE : ED_SENSE; }
+        EdgeComp getComp(EdgeIdx e) const { return (m_edges[e].flags & COMP_FLAG) ? EC_REVERSE : EC_SAME; }
+        EdgeDir getTwinDir(EdgeIdx e) const { return (getComp(e) == EC_SAME) ? !getDir(e) : getDir(e); }
+        GraphColor getEdgeColor(EdgeIdx e) const { return (GraphColor)m_edges[e].color; }
+        void setEdgeColor(EdgeIdx e, GraphColor c) { m_edges[e].color = c; }
+        SeqCoord getMatchCoord(EdgeIdx e) const;
+        size_t getMatchLength(EdgeIdx e) const { return m_edges[e].matchEnd - m_edges[e].matchStart + 1; }
+
+        // Length of the label of e, the part of its end vertex not covered by the overlap
+        size_t getLabelLength(EdgeIdx e) const { return m_seqLen[getEnd(e)] - getMatchLength(getTwin(e)); }
+
+        // Number of live edges of v in direction dir
+        size_t countEdges(VertexIdx v, EdgeDir dir) const;
+        size_t countEdges(VertexIdx v) const;
+
+        //
+        // Deletion
+        //
+        void removeEdge(EdgeIdx e);
+        void removeVertex(VertexIdx v);
+
+        // Remove the edges to the same vertex in the same direction as a shorter edge,
+        // like SGDuplicateVisitor. Returns the number of edges removed.
+        size_t removeDuplicateEdges();
+
+        // Sort the live edges of every vertex by label length like Vertex::sortAdjListByLen,
+        // the deleted edges are moved after them. Edge indices change.
+        void sortEdgesByLen();
+
+        //
+        // Graph
+        //
+        void setContainmentFlag(bool b) { m_hasContainment = b; }
+        bool hasContainment() const { return m_hasContainment; }
+        void setTransitiveFlag(bool b) { m_hasTransitive = b; }
+        bool hasTransitive() const { return m_hasTransitive; }
+        void setMinOverlap(int mo) { m_minOverlap = mo; }
+        int getMinOverlap() const { return m_minOverlap; }
+        void setErrorRate(double er) { m_errorRate = er; }
+        double getErrorRate() const { return m_errorRate; }
+        void setExactMode(bool b) { m_isExactMode = b; }
+        bool isExactMode() const { return m_isExactMode; }
+
+        // Build a Bigraph of the live vertices and edges, in index order
+        Bigraph* toBigraph() const;
+
+        // Print the counts of SGGraphStatsVisitor
+        void printStats() const;
+        size_t getMemSize() const;
+
+    private:
+        static const uint8_t DIR_FLAG = 1;
+        static const uint8_t COMP_FLAG = 2;
+
+        struct CompactEdge
+        {
+            EdgeIdx twin;
+            VertexIdx end;
+            uint32_t matchStart;
+            uint32_t matchEnd;
+            uint8_t flags;
+            uint8_t color;
+        };
+
+        // An edge before finalizeEdges, twin is the position of the twin in m_pendingEdges
+        struct PendingEdge
+        {
+            VertexIdx start;
+            CompactEdge edge;
+        };
+
+        static inline bool testBit(const std::vector<uint64_t>& bits, uint64_t i) { return (bits[i >> 6] >> (i & 63)) & 1; }
+        static inline void setBit(std::vector<uint64_t>& bits, uint64_t i) { bits[i >> 6] |= (uint64_t)1 << (i & 63); }
+        static inline void resizeBits(std::vector<uint64_t>& bits, uint64_t n) { bits.assign((n + 63) >> 6, 0); }
+
+        void clear();
+        void addPendingEdge(VertexIdx start, VertexIdx end, EdgeDir dir, EdgeComp comp, const SeqCoord& coord, GraphColor c);
+
+        // Vertices
+        std::string m_idArena;
+        std::vector<uint64_t> m_idStart;
+        std::vector<uint64_t> m_seqArena;
+        std::vector<uint64_t> m_seqStart;
+        std::vector<uint32_t> m_seqLen;
+        std::vector<GraphColor> m_vertexColor;
+        std::vector<uint64_t> m_containedVertices;
+
+        // State of the vertices of a Bigraph that differs from a freshly loaded vertex
+        std::vector<uint16_t> m_coverage;
+        std::vector<uint32_t> m_originLength;
+        std::vector<uint64_t> m_superRepeatVertices;
+
+        std::vector<uint64_t> m_deletedVertices;
+        size_t m_numLiveVertices;
+
+        // Vertex indices sorted by ID for findVertex
+        std::vector<VertexIdx> m_sortedByID;
+
+        // Edges
+        std::vector<EdgeIdx> m_edgeStart;
+        std::vector<CompactEdge> m_edges;
+        std::vector<uint64_t> m_deletedEdges;
+        size_t m_numLiveEdges;
+
+        std::vector<PendingEdge> m_pendingEdges;
+        std::vector<uint32_t> m_pendingDegree;
+
+        // Graph parameters
+        bool m_hasContainment;
+        bool m_hasTransitive;
+        bool m_isExactMode;
+        int m_minOverlap;
+        double m_errorRate;
+};
+
+#endif
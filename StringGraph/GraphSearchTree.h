@@ -438,8 +438,11 @@ void GraphSearchTree<VERTEX,EDGE,DISTANCE>::buildWalksContainingVertex(VERTEX* p
 
     // Search upwards from each leaf until pTarget is found.
     // When it is found, insert the pointer to the search node
-    // in the set
+    // in the set. The found nodes are kept in the order of
+    // the leaves, not of their addresses, so the order of the
+    // walks does not depend on the memory allocator.
     _SearchNodePtrSet leafSet;
+    _SearchNodePtrDeque foundNodes;
 
     // Find pTarget in each branch of the graph
     for(typename _SearchNodePtrDeque::const_iterator iter = completeLeafNodes.begin();
@@ -449,13 +452,12 @@ void GraphSearchTree<VERTEX,EDGE,DISTANCE>::buildWalksContainingVertex(VERTEX* p
         _SearchNode* pFoundNode = NULL;
         searchBranchForVertex(*iter, pTarget, pFoundNode);
         assert(pFoundNode != NULL);
-        leafSet.insert(pFoundNode);
+        if(leafSet.insert(pFoundNode).second)
+            foundNodes.push_back(pFoundNode);
     }
 
     // Construct all the walks to the found leaves
-    completeLeafNodes.clear();
-    completeLeafNodes.insert(completeLeafNodes.end(), leafSet.begin(), leafSet.end());
-    _buildWalksToLeaves(completeLeafNodes, walkBuilder);
+    _buildWalksToLeaves(foundNodes, walkBuilder);
 }
 
 // Main function for constructing a vector of walks from a set of leaves
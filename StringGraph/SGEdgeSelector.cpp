@@ -0,0 +1,317 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// SGEdgeSelector - Keep the best edges of every vertex while the
+// overlaps are loaded
+//
+#include <omp.h>
+#include <algorithm>
+#include <limits>
+#include "SGEdgeSelector.h"
+#include "SGAlgorithms.h"
+
+SGEdgeSelector::SGEdgeSelector(StringGraph* pGraph, size_t maxDegree)
+    : m_pGraph(pGraph), m_maxDegree(maxDegree), m_vertices(pGraph->getAllVertices()), m_numShort(0), m_numAdded(0), m_numDuplicates(0)
+{
+    std::sort(m_vertices.begin(), m_vertices.end());
+    m_candidates.resize(m_vertices.size());
+}
+
+//
+void SGEdgeSelector::add(const Overlap& ovr)
+{
+    Vertex* pVerts[2];
+    for(size_t idx = 0; idx < 2; ++idx)
+    {
+        // The vertices that are substrings of others are not in the graph
+        pVerts[idx] = m_pGraph->getVertex(ovr.id[idx]);
+        if(pVerts[idx] == NULL)
+            return;
+    }
+
+    // Let createEdgesFromOverlap mark the vertex of a substring containment
+    if(!ovr.match.coord[0].isExtreme() || !ovr.match.coord[1].isExtreme())
+    {
+        SGAlgorithms::createEdgesFromOverlap(m_pGraph, ovr, true);
+        return;
+    }
+
+    #pragma omp atomic
+    m_numAdded++;
+
+    Candidate c;
+    c.coord[0] = ovr.match.coord[0];
+    c.coord[1] = ovr.match.coord[1];
+    c.numDiff = ovr.match.getNumDiffs();
+    c.isRC = ovr.match.isRC();
+    for(size_t idx = 0; idx < 2; ++idx)
+    {
+        c.pOther = pVerts[1 - idx];
+        c.side = idx;
+        c.isFirst = ovr.id[idx] < ovr.id[1 - idx] || (ovr.id[idx] == ovr.id[1 - idx] && idx == 0);
+        if(ovr.isContainment())
+            c.dirKey = ED_COUNT;
+        else
+            c.dirKey = ovr.match.coord[idx].isLeftExtreme() ? ED_ANTISENSE : ED_SENSE;
+        addCandidate(pVerts[idx], c);
+    }
+}
+
+//
+void SGEdgeSelector::countShort(size_t n)
+{
+    #pragma omp atomic
+    m_numShort += n;
+}
+
+//
+void SGEdgeSelector::addCandidate(Vertex* pVertex, const Candidate& c)
+{
+    std::vector<Candidate>& heap = m_candidates[getIndex(pVertex)];
+    pVertex->setLock();
+
+    // Keep the better of two overlaps with the same vertex in the same direction
+    for(size_t i = 0; i < heap.size(); ++i)
+    {
+        if(heap[i].pOther == c.pOther && heap[i].dirKey == c.dirKey)
+        {
+            if(isBetter(c, heap[i]))
+            {
+                heap[i] = c;
+                std::make_heap(heap.begin(), heap.end(), isBetter);
+            }
+            pVertex->releaseLock();
+
+            // The duplicates are counted on one side of the overlaps
+            if(c.isFirst)
+            {
+                #pragma omp atomic
+                m_numDuplicates++;
+            }
+            return;
+        }
+    }
+
+    if(m_maxDegree == 0 || heap.size() < m_maxDegree)
+    {
+        heap.push_back(c);
+        std::push_heap(heap.begin(), heap.end(), isBetter);
+    }
+    else if(isBetter(c, heap.front()))
+    {
+        std::pop_heap(heap.begin(), heap.end(), isBetter);
+        heap.back() = c;
+        std::push_heap(heap.begin(), heap.end(), isBetter);
+    }
+    pVertex->releaseLock();
+}
+
+//
+size_t SGEdgeSelector::createEdges(bool allowContainments, size_t maxEdges, GraphColor color)
+{
+    // Sort the candidates by their other vertex to look up the twins
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for(size_t i = 0; i < m_candidates.size(); ++i)
+        std::sort(m_candidates[i].begin(), m_candidates[i].end(),
+                  [](const Candidate& a, const Candidate& b) { return a.pOther < b.pOther; });
+
+    // The states of the candidates of vertex i start at offsets[i]
+    std::vector<size_t> offsets(m_candidates.size() + 1, 0);
+    for(size_t i = 0; i < m_candidates.size(); ++i)
+        offsets[i + 1] = offsets[i] + m_candidates[i].size();
+    std::vector<uint8_t> states(offsets.back(), CS_UNMATCHED);
+
+    // An overlap is mutual if it is a candidate of both vertices. An overlap whose other
+    // vertex holds a different overlap in the same direction is a twin mismatch.
+    size_t numMismatched = 0;
+    #pragma omp parallel for schedule(dynamic, 1024) reduction(+:numMismatched)
+    for(size_t i = 0; i < m_candidates.size(); ++i)
+    {
+        for(size_t j = 0; j < m_candidates[i].size(); ++j)
+        {
+            bool isMismatched = false;
+            if(findTwin(i, m_candidates[i][j], isMismatched) != NO_TWIN)
+                states[offsets[i] + j] = CS_MUTUAL;
+            else if(isMismatched && m_candidates[i][j].isFirst)
+                numMismatched++;
+        }
+    }
+
+    // Every vertex allows its mutual overlaps from the best one down while it has
+    // at most maxEdges edges, the limit of createEdgesFromOverlap. The edges do not
+    // depend on the order they are created in, unlike when the limit is applied
+    // as they are created.
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for(size_t i = 0; i < m_candidates.size(); ++i)
+    {
+        const std::vector<Candidate>& candidates = m_candidates[i];
+        std::vector<size_t> ranked;
+        for(size_t j = 0; j < candidates.size(); ++j)
+        {
+            if(states[offsets[i] + j] == CS_MUTUAL)
+                ranked.push_back(j);
+        }
+        std::sort(ranked.begin(), ranked.end(),
+                  [&candidates](size_t a, size_t b) { return isBetter(candidates[a], candidates[b]); });
+
+        size_t numEdges = 0;
+        for(size_t k = 0; k < ranked.size() && numEdges <= maxEdges; ++k)
+        {
+            states[offsets[i] + ranked[k]] = CS_ALLOWED;
+            numEdges += candidates[ranked[k]].dirKey == ED_COUNT ? 2 : 1;
+        }
+    }
+
+    // The overlaps are kept by their vertex with the lower ID if both vertices allow them.
+    // Only the states of these candidates change, not those of the twins that are read.
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for(size_t i = 0; i < m_candidates.size(); ++i)
+    {
+        for(size_t j = 0; j < m_candidates[i].size(); ++j)
+        {
+            const Candidate& c = m_candidates[i][j];
+            if(!c.isFirst || states[offsets[i] + j] != CS_ALLOWED)
+                continue;
+
+            bool isMismatched = false;
+            size_t twin = findTwin(i, c, isMismatched);
+            if(states[offsets[getIndex(c.pOther)] + twin] == CS_ALLOWED)
+                states[offsets[i] + j] = CS_KEPT;
+        }
+    }
+
+    // Create the edges in the order of the vertex IDs, freeing the candidates of every
+    // vertex once its edges exist. The limit is already applied, so none is refused.
+    std::vector<size_t> order(m_vertices.size());
+    for(size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(),
+              [this](size_t a, size_t b) { return m_vertices[a]->getID() < m_vertices[b]->getID(); });
+
+    size_t numKept = 0;
+    size_t numOverLimit = 0;
+    for(size_t k = 0; k < order.size(); ++k)
+    {
+        size_t i = order[k];
+        for(size_t j = 0; j < m_candidates[i].size(); ++j)
+        {
+            const Candidate& c = m_candidates[i][j];
+            uint8_t state = states[offsets[i] + j];
+            if(state == CS_KEPT)
+            {
+                Overlap ovr(m_vertices[i]->getID(), c.coord[c.side], c.pOther->getID(), c.coord[1 - c.side], c.isRC, c.numDiff);
+                if(SGAlgorithms::createEdgesFromOverlap(m_pGraph, ovr, allowContainments, std::numeric_limits<size_t>::max(), color) != NULL)
+                    numKept++;
+            }
+            else if(c.isFirst && state != CS_UNMATCHED)
+            {
+                numOverLimit++;
+            }
+        }
+        std::vector<Candidate>().swap(m_candidates[i]);
+    }
+    std::vector<std::vector<Candidate> >().swap(m_candidates);
+
+    printf("SGEdgeSelector: Kept %zu of %zu overlaps, dropped %zu shorter than the minimum overlap, %zu duplicate, "
+           "%zu kept by one vertex only, %zu over the degree cap of %zu and %zu over the edge limit\n",
+           numKept, m_numShort + m_numAdded, m_numShort, m_numDuplicates, numMismatched,
+           m_numAdded - m_numDuplicates - numMismatched - numKept - numOverLimit, m_maxDegree, numOverLimit);
+    return numKept;
+}
+
+// The position of the twin of c, a candidate of vertex i, among the candidates of the other
+// vertex, sorted by their other vertex. isMismatched is set if the other vertex holds a
+// different overlap in the same direction.
+size_t SGEdgeSelector::findTwin(size_t i, const Candidate& c, bool& isMismatched) const
+{
+    Candidate key;
+    key.pOther = m_vertices[i];
+    const std::vector<Candidate>& others = m_candidates[getIndex(c.pOther)];
+    std::vector<Candidate>::const_iterator iter = std::lower_bound(others.begin(), others.end(), key,
+        [](const Candidate& a, const Candidate& b) { return a.pOther < b.pOther; });
+    for(; iter != others.end() && iter->pOther == key.pOther; ++iter)
+    {
+        if(isTwin(c, *iter))
+            return iter - others.begin();
+        if(iter->dirKey == getOtherDirKey(c))
+            isMismatched = true;
+    }
+    return NO_TWIN;
+}
+
+//
+size_t SGEdgeSelector::getBudgetDegree(const StringGraph* pGraph, size_t memoryBudget)
+{
+    VertexPtrVec vertices = pGraph->getAllVertices();
+    size_t vertexMem = 0;
+    for(size_t i = 0; i < vertices.size(); ++i)
+        vertexMem += vertices[i]->getMemSize();
+
+    if(vertexMem >= memoryBudget)
+    {
+        std::cerr << "Error: the memory budget of " << memoryBudget / (1024 * 1024) << " MB is smaller than the "
+                  << vertexMem / (1024 * 1024) << " MB of the vertices\n";
+        exit(EXIT_FAILURE);
+    }
+
+    // The candidates, two per overlap with a byte of state each while the edges
+    // are created, take more memory than the edges made of them
+    size_t maxOverlaps = (memoryBudget - vertexMem) / (2 * (sizeof(Candidate) + 1));
+    return std::max<size_t>(1, 2 * maxOverlaps / std::max<size_t>(1, vertices.size()));
+}
+
+//
+bool SGEdgeSelector::isBetter(const Candidate& a, const Candidate& b)
+{
+    int lenA = std::min(a.coord[0].length(), a.coord[1].length());
+    int lenB = std::min(b.coord[0].length(), b.coord[1].length());
+    if(lenA != lenB)
+        return lenA > lenB;
+    if(a.numDiff != b.numDiff)
+        return a.numDiff < b.numDiff;
+
+    // Break the ties independently of the addresses of the vertices. The
+    // intervals are compared with the vertex of the lower ID first, so that
+    // both vertices of two overlaps between them rank them the same way.
+    if(a.pOther != b.pOther)
+        return a.pOther->getID() < b.pOther->getID();
+    if(a.dirKey != b.dirKey)
+        return a.dirKey < b.dirKey;
+    for(size_t idx = 0; idx < 2; ++idx)
+    {
+        const Interval& ia = (idx == 0 ? a.getFirstCoord() : a.getSecondCoord()).interval;
+        const Interval& ib = (idx == 0 ? b.getFirstCoord() : b.getSecondCoord()).interval;
+        if(ia.start != ib.start)
+            return ia.start < ib.start;
+        if(ia.end != ib.end)
+            return ia.end < ib.end;
+    }
+    return a.isRC < b.isRC;
+}
+
+//
+bool SGEdgeSelector::isTwin(const Candidate& a, const Candidate& b)
+{
+    const Interval& a0 = a.getFirstCoord().interval;
+    const Interval& a1 = a.getSecondCoord().interval;
+    const Interval& b0 = b.getFirstCoord().interval;
+    const Interval& b1 = b.getSecondCoord().interval;
+    return a.isFirst != b.isFirst && a.isRC == b.isRC && a.numDiff == b.numDiff &&
+           a0.start == b0.start && a0.end == b0.end && a1.start == b1.start && a1.end == b1.end;
+}
+
+//
+uint8_t SGEdgeSelector::getOtherDirKey(const Candidate& c)
+{
+    if(c.dirKey == ED_COUNT)
+        return ED_COUNT;
+    return c.coord[1 - c.side].isLeftExtreme() ? ED_ANTISENSE : ED_SENSE;
+}
+
+//
+size_t SGEdgeSelector::getIndex(const Vertex* pVertex) const
+{
+    return std::lower_bound(m_vertices.begin(), m_vertices.end(), pVertex) - m_vertices.begin();
+}
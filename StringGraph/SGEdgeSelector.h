@@ -0,0 +1,96 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// SGEdgeSelector - Keep the best edges of every vertex while the
+// overlaps are loaded instead of creating every edge. Each vertex
+// holds at most maxDegree candidates, ranked by overlap length,
+// then by the number of differences; of two overlaps with the same
+// vertex in the same direction only the better one is a candidate,
+// so no duplicate edges are created. An overlap becomes an edge if
+// it is a candidate of both of its vertices. The ranking is a total
+// order that is the same from both vertices of an overlap, so the
+// kept edges do not depend on the order of the overlaps and the two
+// vertices keep the same one of two near-duplicate overlaps.
+//
+#ifndef SGEDGESELECTOR_H
+#define SGEDGESELECTOR_H
+
+#include "SGUtil.h"
+
+class SGEdgeSelector
+{
+    public:
+
+        // A maxDegree of 0 keeps all edges but the duplicates
+        SGEdgeSelector(StringGraph* pGraph, size_t maxDegree);
+
+        // Offer an overlap, thread-safe
+        void add(const Overlap& ovr);
+
+        // Count overlaps dropped for being shorter than the minimum overlap
+        void countShort(size_t n);
+
+        // Create the edges of the overlaps that are candidates of both vertices and
+        // print how many were dropped. Returns the number of overlaps kept. A vertex
+        // takes its best overlaps while it has at most maxEdges edges; an overlap is
+        // kept if both of its vertices take it, so the edges, and their order in the
+        // order of the vertex IDs, do not depend on the threads.
+        size_t createEdges(bool allowContainments, size_t maxEdges, GraphColor color);
+
+        // The degree cap that keeps the candidates of the vertices of pGraph
+        // within memoryBudget bytes of the whole graph
+        static size_t getBudgetDegree(const StringGraph* pGraph, size_t memoryBudget);
+
+    private:
+
+        // An overlap seen from one of its vertices, the ID of the vertex
+        // is not held to keep the candidates small
+        struct Candidate
+        {
+            Vertex* pOther;
+            SeqCoord coord[2];
+            int numDiff;
+            uint8_t side;   // index of the vertex in the overlap
+            uint8_t dirKey; // direction of the edge, ED_COUNT for a containment
+            bool isRC;
+            bool isFirst;   // the vertex has the lower ID of the two
+
+            // The coordinates of the vertex with the lower ID and of the other one
+            const SeqCoord& getFirstCoord() const { return coord[isFirst ? side : 1 - side]; }
+            const SeqCoord& getSecondCoord() const { return coord[isFirst ? 1 - side : side]; }
+        };
+
+        // Rank of two candidates of the same vertex
+        static bool isBetter(const Candidate& a, const Candidate& b);
+
+        // True if a and b are the two sides of the same overlap
+        static bool isTwin(const Candidate& a, const Candidate& b);
+
+        // The direction key of the other vertex of c
+        static uint8_t getOtherDirKey(const Candidate& c);
+
+        // States of the candidates in createEdges, each one implies the previous
+        enum CandidateState { CS_UNMATCHED, CS_MUTUAL, CS_ALLOWED, CS_KEPT };
+        static const size_t NO_TWIN = (size_t)-1;
+        size_t findTwin(size_t i, const Candidate& c, bool& isMismatched) const;
+
+        size_t getIndex(const Vertex* pVertex) const;
+        void addCandidate(Vertex* pVertex, const Candidate& c);
+
+        StringGraph* m_pGraph;
+        size_t m_maxDegree;
+
+        // Vertices sorted by address
+        VertexPtrVec m_vertices;
+
+        // Heaps of candidates of the vertices, the worst one on top
+        std::vector<std::vector<Candidate> > m_candidates;
+
+        size_t m_numShort;
+        size_t m_numAdded;
+        size_t m_numDuplicates;
+};
+
+#endif
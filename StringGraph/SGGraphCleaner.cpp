@@ -0,0 +1,160 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// SGGraphCleaner - Tip trimming and bubble smoothing driven by
+// a work-list of changed vertices
+//
+#include <omp.h>
+#include <algorithm>
+#include "SGGraphCleaner.h"
+
+SGGraphCleaner::SGGraphCleaner(StringGraph* pGraph, size_t trimLength, int maxIndelLength, BWT* pBWT, bool bIsGapPrecent)
+    : m_pGraph(pGraph), m_trimLength(trimLength), m_smoothingVisit(maxIndelLength, pBWT, bIsGapPrecent), m_trimAll(true), m_simplifyAll(true)
+{
+}
+
+//
+bool SGGraphCleaner::trim()
+{
+    VertexPtrVec vertices;
+    if(m_trimAll)
+    {
+        vertices = m_pGraph->getAllVertices();
+    }
+    else
+    {
+        std::sort(m_trimList.begin(), m_trimList.end());
+        m_trimList.erase(std::unique(m_trimList.begin(), m_trimList.end()), m_trimList.end());
+
+        // The work-list may name vertices removed or merged away since
+        vertices.resize(m_trimList.size());
+        #pragma omp parallel for schedule(static)
+        for(size_t i = 0; i < m_trimList.size(); ++i)
+            vertices[i] = m_pGraph->getVertex(m_trimList[i]);
+        vertices.erase(std::remove(vertices.begin(), vertices.end(), (Vertex*)NULL), vertices.end());
+    }
+    m_trimAll = false;
+    m_trimList.clear();
+
+    // Mark the islands and dead-ends as SGTrimVisitor::visit
+    enum { KEEP, ISLAND, TERMINAL };
+    std::vector<char> tipType(vertices.size(), KEEP);
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for(size_t i = 0; i < vertices.size(); ++i)
+    {
+        Vertex* pVertex = vertices[i];
+        if(pVertex->getSeqLen() >= m_trimLength)
+            continue;
+
+        if(pVertex->countEdges() == 0)
+            tipType[i] = ISLAND;
+        else if(pVertex->countEdges(ED_SENSE) == 0 || pVertex->countEdges(ED_ANTISENSE) == 0)
+            tipType[i] = TERMINAL;
+    }
+
+    VertexPtrVec tips;
+    int numIsland = 0;
+    int numTerminal = 0;
+    for(size_t i = 0; i < vertices.size(); ++i)
+    {
+        if(tipType[i] == KEEP)
+            continue;
+        tips.push_back(vertices[i]);
+        if(tipType[i] == ISLAND)
+            numIsland++;
+        else
+            numTerminal++;
+    }
+
+    removeVertices(tips);
+    printf("StringGraphTrim: Removed %d island and %d dead-end short vertices\n", numIsland, numTerminal);
+    return numTerminal > 0;
+}
+
+//
+bool SGGraphCleaner::smooth()
+{
+    m_smoothingVisit.previsit(m_pGraph);
+    VertexPtrVec vertices = m_pGraph->getAllVertices();
+
+    // Search the bubbles of every branching direction with all threads,
+    // the search does not look at the colors the popping sets
+    std::vector<SGBubble> bubbles(ED_COUNT * vertices.size());
+    #pragma omp parallel for schedule(dynamic, 64)
+    for(size_t i = 0; i < vertices.size(); ++i)
+    {
+        for(size_t idx = 0; idx < ED_COUNT; idx++)
+        {
+            EdgeDir dir = EDGE_DIRECTIONS[idx];
+            if(vertices[i]->countEdges(dir) > 1)
+                m_smoothingVisit.findBubble(vertices[i], dir, bubbles[ED_COUNT * i + idx]);
+        }
+    }
+
+    // Pop them in the order of the serial visit
+    bool modified = false;
+    for(size_t i = 0; i < vertices.size(); ++i)
+        modified = m_smoothingVisit.visit(vertices[i], &bubbles[ED_COUNT * i]) || modified;
+    std::vector<SGBubble>().swap(bubbles);
+
+    VertexPtrVec variants;
+    for(size_t i = 0; i < vertices.size(); ++i)
+    {
+        if(vertices[i]->getColor() == GC_RED)
+            variants.push_back(vertices[i]);
+    }
+
+    removeVertices(variants);
+    m_smoothingVisit.postvisit(m_pGraph);
+    return modified;
+}
+
+//
+void SGGraphCleaner::simplify()
+{
+    VertexIDVec mergedIDs;
+    if(m_simplifyAll)
+    {
+        m_pGraph->simplify(&mergedIDs);
+    }
+    else
+    {
+        m_pGraph->simplify(&mergedIDs, &m_simplifyList);
+    }
+    m_simplifyAll = false;
+    m_simplifyList.clear();
+
+    // A vertex merged into may be merged into a later one in turn
+    for(size_t i = 0; i < mergedIDs.size(); ++i)
+    {
+        Vertex* pVertex = m_pGraph->getVertex(mergedIDs[i]);
+        if(pVertex == NULL)
+            continue;
+        m_trimList.push_back(mergedIDs[i]);
+        m_simplifyList.push_back(mergedIDs[i]);
+
+        EdgePtrVec edges = pVertex->getEdges();
+        for(size_t j = 0; j < edges.size(); ++j)
+            m_simplifyList.push_back(edges[j]->getEndID());
+    }
+}
+
+//
+void SGGraphCleaner::removeVertices(const VertexPtrVec& vertices)
+{
+    for(size_t i = 0; i < vertices.size(); ++i)
+    {
+        EdgePtrVec edges = vertices[i]->getEdges();
+        for(size_t j = 0; j < edges.size(); ++j)
+        {
+            m_trimList.push_back(edges[j]->getEndID());
+            m_simplifyList.push_back(edges[j]->getEndID());
+        }
+    }
+
+    for(size_t i = 0; i < vertices.size(); ++i)
+        m_pGraph->removeConnectedVertex(vertices[i]);
+}
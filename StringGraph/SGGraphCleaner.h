@@ -0,0 +1,64 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// SGGraphCleaner - Tip trimming and bubble smoothing driven by
+// a work-list of changed vertices. Whether a vertex is a tip only
+// depends on its length and its edges, so after the first pass
+// only the vertices changed since the last trim are looked at:
+// the neighbours of removed vertices and the vertices simplify
+// merged others into. The tips are found with all threads.
+//
+// Simplify works the same way: after the first call only the unipaths
+// through the changed vertices are compacted, the rest of the graph has
+// no links left to merge.
+//
+// The bubbles are searched with all threads before any of them is
+// popped, then popped in the order of the graph as SGSmoothingVisitor
+// does, so the result is the same as with the serial visitors.
+// Unlike trim, smooth searches every branching vertex on each call:
+// a search walks up to 240 vertices away, so the vertices whose bubble
+// a change can affect are not kept. The assemblers smooth once per
+// cleaner, so each call is the first one anyway.
+//
+#ifndef SGGRAPHCLEANER_H
+#define SGGRAPHCLEANER_H
+
+#include "SGVisitors.h"
+
+class SGGraphCleaner
+{
+    public:
+        SGGraphCleaner(StringGraph* pGraph, size_t trimLength, int maxIndelLength, BWT* pBWT, bool bIsGapPrecent = true);
+
+        // Remove the islands and dead-end vertices shorter than the trim length
+        // like SGTrimVisitor. Returns true if a dead-end vertex was removed.
+        bool trim();
+
+        // Pop the bubbles like SGSmoothingVisitor, returns true if any vertex was removed
+        bool smooth();
+
+        // Compact the unipaths, the merged vertices are queued for trimming
+        void simplify();
+
+    private:
+
+        // Queue the neighbours of the vertices for trimming and simplifying
+        // and remove the vertices
+        void removeVertices(const VertexPtrVec& vertices);
+
+        StringGraph* m_pGraph;
+        size_t m_trimLength;
+        SGSmoothingVisitor m_smoothingVisit;
+
+        // Vertices changed since the last trim, all of them before the first
+        bool m_trimAll;
+        VertexIDVec m_trimList;
+
+        // Vertices changed since the last simplify, all of them before the first
+        bool m_simplifyAll;
+        VertexIDVec m_simplifyList;
+};
+
+#endif
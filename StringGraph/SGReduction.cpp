@@ -0,0 +1,353 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// SGReduction - Parallel containment removal and transitive reduction
+//
+#include <omp.h>
+#include <algorithm>
+#include <iostream>
+#include <unordered_map>
+#include "SGReduction.h"
+#include "SGVisitors.h"
+
+namespace SGReduction
+{
+
+// Colors of the vertices around the visited vertex, kept per thread.
+// A vertex that is not in the map is white.
+typedef std::unordered_map<const Vertex*, GraphColor> VertexMarks;
+typedef std::unordered_map<CompactStringGraph::VertexIdx, GraphColor> CompactMarks;
+
+template<typename Marks, typename Key>
+static inline GraphColor getMark(const Marks& marks, Key v)
+{
+    typename Marks::const_iterator iter = marks.find(v);
+    return iter != marks.end() ? iter->second : GC_WHITE;
+}
+
+// Delete the edges of pVertex listed in edges, keeping the order of the others
+static void deleteEdges(Vertex* pVertex, const EdgePtrVec& edges)
+{
+    for(size_t i = 0; i < edges.size(); ++i)
+        pVertex->deleteEdge(edges[i]);
+}
+
+size_t removeContainments(StringGraph* pGraph)
+{
+    size_t numRemoved = 0;
+    if(!pGraph->hasContainment())
+        return numRemoved;
+
+    if(!pGraph->hasTransitive() && !pGraph->isExactMode())
+    {
+        SGContainRemoveVisitor containVisit;
+        while(pGraph->hasContainment())
+        {
+            size_t numVertices = pGraph->getNumVertices();
+            pGraph->visit(containVisit);
+            numRemoved += numVertices - pGraph->getNumVertices();
+        }
+        return numRemoved;
+    }
+
+    // Without remodelling every edge of or to a contained vertex is deleted
+    // and no containment can appear, so one pass is enough
+    pGraph->setContainmentFlag(false);
+    VertexPtrVec vertices = pGraph->getAllVertices();
+    std::vector<EdgePtrVec> deleteEdgeVec(vertices.size());
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for(size_t i = 0; i < vertices.size(); ++i)
+    {
+        Vertex* pVertex = vertices[i];
+        EdgePtrVec edges = pVertex->getEdges();
+        for(size_t j = 0; j < edges.size(); ++j)
+        {
+            if(pVertex->isContained() || edges[j]->getEnd()->isContained())
+                deleteEdgeVec[i].push_back(edges[j]);
+        }
+    }
+
+    #pragma omp parallel for schedule(dynamic, 1024) reduction(+:numRemoved)
+    for(size_t i = 0; i < vertices.size(); ++i)
+    {
+        deleteEdges(vertices[i], deleteEdgeVec[i]);
+        if(vertices[i]->isContained())
+        {
+            vertices[i]->setColor(GC_BLACK);
+            numRemoved++;
+        }
+    }
+
+    pGraph->sweepVertices(GC_BLACK);
+    return numRemoved;
+}
+
+// Myers' marking about pVertex as in SGTransitiveReductionVisitor::visit,
+// the transitive edges are appended to transEdges
+static void markTransitiveEdges(Vertex* pVertex, VertexMarks& marks, EdgePtrVec& transEdges)
+{
+    static const size_t FUZZ = 10; // see myers
+
+    for(size_t idx = 0; idx < ED_COUNT; idx++)
+    {
+        EdgeDir dir = EDGE_DIRECTIONS[idx];
+        EdgePtrVec edges = pVertex->getEdges(dir); // These edges are already sorted
+        if(edges.size() == 0)
+            continue;
+
+        for(size_t i = 0; i < edges.size(); ++i)
+            marks[edges[i]->getEnd()] = GC_GRAY;
+
+        size_t longestLen = edges.back()->getSeqLen() + FUZZ;
+
+        // Stage 1
+        for(size_t i = 0; i < edges.size(); ++i)
+        {
+            Edge* pVWEdge = edges[i];
+            Vertex* pWVert = pVWEdge->getEnd();
+
+            EdgeDir transDir = !pVWEdge->getTwinDir();
+            if(getMark(marks, pWVert) == GC_GRAY)
+            {
+                EdgePtrVec w_edges = pWVert->getEdges(transDir);
+                for(size_t j = 0; j < w_edges.size(); ++j)
+                {
+                    Edge* pWXEdge = w_edges[j];
+                    size_t trans_len = pVWEdge->getSeqLen() + pWXEdge->getSeqLen();
+                    if(trans_len > longestLen)
+                        break;
+                    if(getMark(marks, pWXEdge->getEnd()) == GC_GRAY)
+                        marks[pWXEdge->getEnd()] = GC_BLACK;
+                }
+            }
+        }
+
+        // Stage 2
+        for(size_t i = 0; i < edges.size(); ++i)
+        {
+            Edge* pVWEdge = edges[i];
+            Vertex* pWVert = pVWEdge->getEnd();
+
+            EdgeDir transDir = !pVWEdge->getTwinDir();
+            EdgePtrVec w_edges = pWVert->getEdges(transDir);
+            for(size_t j = 0; j < w_edges.size(); ++j)
+            {
+                Edge* pWXEdge = w_edges[j];
+                if(pWXEdge->getSeqLen() >= FUZZ && j != 0)
+                    break;
+                if(getMark(marks, pWXEdge->getEnd()) == GC_GRAY)
+                    marks[pWXEdge->getEnd()] = GC_BLACK;
+            }
+        }
+
+        for(size_t i = 0; i < edges.size(); ++i)
+        {
+            if(getMark(marks, edges[i]->getEnd()) == GC_BLACK)
+                transEdges.push_back(edges[i]);
+        }
+
+        // Only the ends of the edges have marks, erasing them is cheaper
+        // than clearing the buckets of the map for every vertex
+        for(size_t i = 0; i < edges.size(); ++i)
+            marks.erase(edges[i]->getEnd());
+    }
+}
+
+size_t removeTransitiveEdges(StringGraph* pGraph)
+{
+    // The graph must not have containments
+    assert(!pGraph->hasContainment());
+
+    VertexPtrVec vertices = pGraph->getAllVertices();
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for(size_t i = 0; i < vertices.size(); ++i)
+    {
+        vertices[i]->setColor(GC_WHITE);
+        vertices[i]->setEdgeColors(GC_WHITE);
+        vertices[i]->sortAdjListByLen();
+    }
+
+    // Mark, every thread collects the transitive edges of its vertices
+    std::vector<EdgePtrVec> transEdgeVec(omp_get_max_threads());
+    #pragma omp parallel
+    {
+        VertexMarks marks;
+        EdgePtrVec& transEdges = transEdgeVec[omp_get_thread_num()];
+
+        #pragma omp for schedule(dynamic, 1024)
+        for(size_t i = 0; i < vertices.size(); ++i)
+            markTransitiveEdges(vertices[i], marks, transEdges);
+    }
+
+    // An edge is transitive if it or its twin was found transitive
+    for(size_t t = 0; t < transEdgeVec.size(); ++t)
+    {
+        for(size_t i = 0; i < transEdgeVec[t].size(); ++i)
+        {
+            transEdgeVec[t][i]->setColor(GC_BLACK);
+            transEdgeVec[t][i]->getTwin()->setColor(GC_BLACK);
+        }
+    }
+
+    // Sweep
+    size_t numRemoved = 0;
+    #pragma omp parallel for schedule(dynamic, 1024) reduction(+:numRemoved)
+    for(size_t i = 0; i < vertices.size(); ++i)
+        numRemoved += vertices[i]->sweepEdges(GC_BLACK);
+
+    std::cout << "Remove " << numRemoved/2 << " transitive edges." << std::endl;
+    pGraph->setTransitiveFlag(false);
+    return numRemoved/2;
+}
+
+//
+// CompactStringGraph
+//
+bool isRemodelNeeded(const CompactStringGraph* pGraph)
+{
+    return pGraph->hasContainment() && !pGraph->hasTransitive() && !pGraph->isExactMode();
+}
+
+// Removing a vertex tombstones its edges and their twins,
+// which are the edges to delete in removeContainments above
+size_t removeContainments(CompactStringGraph* pGraph)
+{
+    assert(!isRemodelNeeded(pGraph));
+    size_t numRemoved = 0;
+    if(!pGraph->hasContainment())
+        return numRemoved;
+
+    pGraph->setContainmentFlag(false);
+    for(CompactStringGraph::VertexIdx v = 0; v < pGraph->getNumVertices(); ++v)
+    {
+        if(!pGraph->isVertexDeleted(v) && pGraph->isContained(v))
+        {
+            pGraph->removeVertex(v);
+            numRemoved++;
+        }
+    }
+    return numRemoved;
+}
+
+// The live edges of v in direction dir, in the order of the edge array
+static void getCompactEdges(const CompactStringGraph* pGraph, CompactStringGraph::VertexIdx v, EdgeDir dir,
+                            std::vector<CompactStringGraph::EdgeIdx>& edges)
+{
+    edges.clear();
+    for(CompactStringGraph::EdgeIdx e = pGraph->getFirstEdge(v); e < pGraph->getLastEdge(v); ++e)
+    {
+        if(!pGraph->isEdgeDeleted(e) && pGraph->getDir(e) == dir)
+            edges.push_back(e);
+    }
+}
+
+// markTransitiveEdges on the edge arrays, the edges of every vertex are sorted by length
+static void markCompactTransitiveEdges(const CompactStringGraph* pGraph, CompactStringGraph::VertexIdx v, CompactMarks& marks,
+                                       std::vector<CompactStringGraph::EdgeIdx>& transEdges)
+{
+    static const size_t FUZZ = 10; // see myers
+
+    std::vector<CompactStringGraph::EdgeIdx> edges;
+    std::vector<CompactStringGraph::EdgeIdx> w_edges;
+    for(size_t idx = 0; idx < ED_COUNT; idx++)
+    {
+        getCompactEdges(pGraph, v, EDGE_DIRECTIONS[idx], edges);
+        if(edges.size() == 0)
+            continue;
+
+        for(size_t i = 0; i < edges.size(); ++i)
+            marks[pGraph->getEnd(edges[i])] = GC_GRAY;
+
+        size_t longestLen = pGraph->getLabelLength(edges.back()) + FUZZ;
+
+        // Stage 1
+        for(size_t i = 0; i < edges.size(); ++i)
+        {
+            CompactStringGraph::VertexIdx w = pGraph->getEnd(edges[i]);
+            if(getMark(marks, w) == GC_GRAY)
+            {
+                getCompactEdges(pGraph, w, !pGraph->getTwinDir(edges[i]), w_edges);
+                for(size_t j = 0; j < w_edges.size(); ++j)
+                {
+                    size_t trans_len = pGraph->getLabelLength(edges[i]) + pGraph->getLabelLength(w_edges[j]);
+                    if(trans_len > longestLen)
+                        break;
+                    CompactStringGraph::VertexIdx x = pGraph->getEnd(w_edges[j]);
+                    if(getMark(marks, x) == GC_GRAY)
+                        marks[x] = GC_BLACK;
+                }
+            }
+        }
+
+        // Stage 2
+        for(size_t i = 0; i < edges.size(); ++i)
+        {
+            CompactStringGraph::VertexIdx w = pGraph->getEnd(edges[i]);
+            getCompactEdges(pGraph, w, !pGraph->getTwinDir(edges[i]), w_edges);
+            for(size_t j = 0; j < w_edges.size(); ++j)
+            {
+                if(pGraph->getLabelLength(w_edges[j]) >= FUZZ && j != 0)
+                    break;
+                CompactStringGraph::VertexIdx x = pGraph->getEnd(w_edges[j]);
+                if(getMark(marks, x) == GC_GRAY)
+                    marks[x] = GC_BLACK;
+            }
+        }
+
+        for(size_t i = 0; i < edges.size(); ++i)
+        {
+            if(getMark(marks, pGraph->getEnd(edges[i])) == GC_BLACK)
+                transEdges.push_back(edges[i]);
+        }
+
+        // Only the ends of the edges have marks
+        for(size_t i = 0; i < edges.size(); ++i)
+            marks.erase(pGraph->getEnd(edges[i]));
+    }
+}
+
+size_t removeTransitiveEdges(CompactStringGraph* pGraph)
+{
+    // The graph must not have containments
+    assert(!pGraph->hasContainment());
+
+    pGraph->sortEdgesByLen();
+    for(CompactStringGraph::VertexIdx v = 0; v < pGraph->getNumVertices(); ++v)
+        pGraph->setColor(v, GC_WHITE);
+    for(CompactStringGraph::EdgeIdx e = 0; e < pGraph->getNumEdges(); ++e)
+        pGraph->setEdgeColor(e, GC_WHITE);
+
+    // Mark, every thread collects the transitive edges of its vertices
+    std::vector<std::vector<CompactStringGraph::EdgeIdx> > transEdgeVec(omp_get_max_threads());
+    #pragma omp parallel
+    {
+        CompactMarks marks;
+        std::vector<CompactStringGraph::EdgeIdx>& transEdges = transEdgeVec[omp_get_thread_num()];
+
+        #pragma omp for schedule(dynamic, 1024)
+        for(CompactStringGraph::VertexIdx v = 0; v < pGraph->getNumVertices(); ++v)
+        {
+            if(!pGraph->isVertexDeleted(v))
+                markCompactTransitiveEdges(pGraph, v, marks, transEdges);
+        }
+    }
+
+    // Sweep, removing an edge tombstones its twin too
+    size_t numLive = pGraph->getNumLiveEdges();
+    for(size_t t = 0; t < transEdgeVec.size(); ++t)
+    {
+        for(size_t i = 0; i < transEdgeVec[t].size(); ++i)
+            pGraph->removeEdge(transEdgeVec[t][i]);
+    }
+    size_t numRemoved = numLive - pGraph->getNumLiveEdges();
+
+    std::cout << "Remove " << numRemoved/2 << " transitive edges." << std::endl;
+    pGraph->setTransitiveFlag(false);
+    return numRemoved/2;
+}
+
+};
@@ -0,0 +1,42 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// SGReduction - Parallel containment removal and transitive
+// reduction. Each pass first marks, with all threads and without
+// vertex locks, the edges to delete; the marks of a vertex are kept
+// by its thread instead of in the vertex colors. A second pass then
+// sweeps the marked edges vertex by vertex. The graph is the same as
+// after SGContainRemoveVisitor and SGTransitiveReductionVisitor.
+// Both passes also run on the arrays of a CompactStringGraph.
+//
+#ifndef SGREDUCTION_H
+#define SGREDUCTION_H
+
+#include "SGUtil.h"
+#include "CompactStringGraph.h"
+
+namespace SGReduction
+{
+
+// Remove the contained vertices until the graph has no containment.
+// A graph that needs remodelling around the removed vertices, one that
+// is transitively reduced and not exact, goes through SGContainRemoveVisitor
+// since the new edges depend on the order of removal.
+// Returns the number of vertices removed.
+size_t removeContainments(StringGraph* pGraph);
+
+// Remove the transitive edges like SGTransitiveReductionVisitor,
+// returns the number of edge pairs removed
+size_t removeTransitiveEdges(StringGraph* pGraph);
+
+// The same passes on a compact graph. A compact graph can not be remodelled,
+// so its containments are only removed if isRemodelNeeded is false.
+bool isRemodelNeeded(const CompactStringGraph* pGraph);
+size_t removeContainments(CompactStringGraph* pGraph);
+size_t removeTransitiveEdges(CompactStringGraph* pGraph);
+
+};
+
+#endif
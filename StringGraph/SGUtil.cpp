@@ -7,455 +7,478 @@
 // SGUtils - Data structures/Functions related
 // to building and manipulating string graphs
 //
+#include <omp.h>
+#include <string.h>
+#include <sys/stat.h>
 #include "SGUtil.h"
 #include "SeqReader.h"
 #include "SGAlgorithms.h"
 #include "SGVisitors.h"
+#include "CompactStringGraph.h"
+#include "SGEdgeSelector.h"
 #include "../StriDe/SGACommon.h"
+#include "../SQG/OverlapHitFile.h"
 
-StringGraph* SGUtil::loadASQG(const StringVector & filenameList, const unsigned int minOverlap, bool allowContainments , size_t maxEdges ,GraphColor c)
+// The loaders cut their input into blocks of whole records of about this
+// size, which are parsed by different threads
+static const size_t LOAD_BLOCK_SIZE = 1 << 20;
+
+// Options shared by the block loaders
+struct LoadParams
 {
-	// Initialize graph
-	StringGraph* pGraph = new StringGraph;
-	int stage = 0;
-	int line = 0;
-	for(size_t i=0 ; i<filenameList.size() ;i++)
-	{		
-		
-		std::istream* pReader = createReader(filenameList[i]);
-		std::string recordLine;
-		while(getline(*pReader, recordLine))
-		{   
-			ASQG::RecordType rt = ASQG::getRecordType(recordLine);
-			switch(rt)
-			{
-			case ASQG::RT_HEADER:
-				{
-					if(stage != 0)
-					{
-						std::cerr << "Error: Unexpected header record found at line " << line << "\n";
-						exit(EXIT_FAILURE);
-					}
+	unsigned int minOverlap;
+	bool allowContainments;
+	size_t maxEdges;
+	GraphColor color;
 
-					ASQG::HeaderRecord headerRecord(recordLine);
-					const SQG::IntTag& overlapTag = headerRecord.getOverlapTag();
-					if(overlapTag.isInitialized())
-					pGraph->setMinOverlap(overlapTag.get());
-					else
-					pGraph->setMinOverlap(0);
-
-					const SQG::FloatTag& errorRateTag = headerRecord.getErrorRateTag();
-					if(errorRateTag.isInitialized())
-					pGraph->setErrorRate(errorRateTag.get());
-					
-					const SQG::IntTag& containmentTag = headerRecord.getContainmentTag();
-					if(containmentTag.isInitialized())
-						pGraph->setContainmentFlag(containmentTag.get());
-					else
-						pGraph->setContainmentFlag(false); // conservatively assume containments are present
-
-					const SQG::IntTag& transitiveTag = headerRecord.getTransitiveTag();
-					if(!transitiveTag.isInitialized())
-					{
-						std::cerr << "Warning: ASQG does not have transitive tag\n";
-						pGraph->setTransitiveFlag(true);
-					}
-					else
-					{
-						pGraph->setTransitiveFlag(transitiveTag.get());
-					}
+	// Containment flag of a graph whose header has no CN tag
+	bool assumeContainment;
 
-					break;
-				}
-			case ASQG::RT_VERTEX:
-				{
-					// progress the stage if we are done the header
-					if(stage == 0)
-					stage = 1;
+	// The hits files of overlap only hold edge records
+	bool isEdgeFile;
 
-					if(stage != 1)
-					{
-						std::cerr << "Error: Unexpected vertex record found at line " << line << "\n";
-						exit(EXIT_FAILURE);
-					}
+	// Offered the overlaps instead of creating their edges if not NULL
+	SGEdgeSelector* pSelector;
+};
 
-					ASQG::VertexRecord vertexRecord(recordLine);
-					const SQG::IntTag& ssTag = vertexRecord.getSubstringTag();
+// A block of the input and the records parsed out of it
+struct LoadBlock
+{
+	void clear()
+	{
+		data.clear();
+		headers.clear();
+		vertices.clear();
+		vertexSlots.clear();
+		overlaps.clear();
+		numShort = 0;
+		firstType = lastType = -1;
+	}
 
-					Vertex* pVertex = new(pGraph->getVertexAllocator()) Vertex(vertexRecord.getID(), vertexRecord.getSeq());
-					if(ssTag.isInitialized() && ssTag.get() == 1)
-					{
-						// Vertex is a substring of some other vertex, mark it as contained
-						pVertex->setContained(true);
-						pGraph->setContainmentFlag(true);
-					}
-					pGraph->addVertex(pVertex);
-					break;
-				}
-			case ASQG::RT_EDGE:
-				{
-					if(stage == 1)
-					stage = 2;
-					
-					if(stage != 2)
-					{
-						std::cerr << "Error: Unexpected edge record found at line " << line << "\n";
-						exit(EXIT_FAILURE);
-					}
+	std::string data;
+	StringVector headers;
+	std::vector<ASQG::VertexRecord> vertices;
+	std::vector<void*> vertexSlots;
+	OverlapVector overlaps;
 
-					ASQG::EdgeRecord edgeRecord(recordLine);
-					const Overlap& ovr = edgeRecord.getOverlap();
+	// Overlaps shorter than minOverlap, dropped while parsing
+	size_t numShort;
 
-	
-					// Add the edge to the graph
-					if(ovr.match.getMinOverlapLength() >= (int)minOverlap)
-						SGAlgorithms::createEdgesFromOverlap(pGraph, ovr, allowContainments, maxEdges,c);
-					break;
-				}
-			}
-			++line;
-		}
-		delete pReader;
-	}	
-	
-	// Completely delete the edges for all nodes that were marked as super-repetitive in the graph
-	//SGSuperRepeatVisitor superRepeatVisitor;
-	//pGraph->visitP(superRepeatVisitor);
+	// Type of the first and last record, -1 if the block has none
+	int firstType;
+	int lastType;
+};
 
-	// Remove any duplicate edges
-	SGDuplicateVisitor dupVisit;
-	pGraph->visit(dupVisit);
+template<typename GraphType>
+static void loadHeaderRecord(GraphType* pGraph, const std::string& recordLine, bool assumeContainment)
+{
+	ASQG::HeaderRecord headerRecord(recordLine);
+	const SQG::IntTag& overlapTag = headerRecord.getOverlapTag();
+	if(overlapTag.isInitialized())
+		pGraph->setMinOverlap(overlapTag.get());
+	else
+		pGraph->setMinOverlap(0);
+
+	const SQG::FloatTag& errorRateTag = headerRecord.getErrorRateTag();
+	if(errorRateTag.isInitialized())
+		pGraph->setErrorRate(errorRateTag.get());
+
+	const SQG::IntTag& containmentTag = headerRecord.getContainmentTag();
+	if(containmentTag.isInitialized())
+		pGraph->setContainmentFlag(containmentTag.get());
+	else
+		pGraph->setContainmentFlag(assumeContainment);
+
+	const SQG::IntTag& transitiveTag = headerRecord.getTransitiveTag();
+	if(!transitiveTag.isInitialized())
+	{
+		std::cerr << "Warning: ASQG does not have transitive tag\n";
+		pGraph->setTransitiveFlag(true);
+	}
+	else
+	{
+		pGraph->setTransitiveFlag(transitiveTag.get());
+	}
+}
 
-	return pGraph;
+// Read about LOAD_BLOCK_SIZE bytes of whole lines, returns false at the end of the file
+static bool readLineBlock(std::istream& in, std::string& block)
+{
+	block.resize(LOAD_BLOCK_SIZE);
+	in.read(&block[0], LOAD_BLOCK_SIZE);
+	block.resize(in.gcount());
+	if(block.empty())
+		return false;
+
+	if(block[block.size() - 1] != '\n')
+	{
+		std::string rest;
+		getline(in, rest);
+		block.append(rest);
+		block.push_back('\n');
+	}
+	return true;
 }
 
-StringGraph* SGUtil::loadASQGVertex(const std::string& filename, const unsigned int minOverlap, bool allowContainments, size_t maxEdges)
+static const char* getRecordName(int rt)
 {
-	// Initialize graph
-	StringGraph* pGraph = new StringGraph;
-	std::istream* pReader = createReader(filename);
-	int stage = 0;
-	int line = 0;
+	return rt == ASQG::RT_HEADER ? "header" : rt == ASQG::RT_VERTEX ? "vertex" : "edge";
+}
+
+// The records of a file come in the order header, vertices, edges
+static void parseLineBlock(LoadBlock* pBlock, const LoadParams* pParams, const std::string* pFilename)
+{
+	const char* p = pBlock->data.data();
+	const char* end = p + pBlock->data.size();
 	std::string recordLine;
+	while(p < end)
+	{
+		const char* eol = (const char*)memchr(p, '\n', end - p);
+		recordLine.assign(p, eol);
+		p = eol + 1;
+		if(recordLine.empty())
+			continue;
 
-	while(getline(*pReader, recordLine))
-	{ 	
 		ASQG::RecordType rt = ASQG::getRecordType(recordLine);
+		if(rt < pBlock->lastType || (pParams->isEdgeFile && rt != ASQG::RT_EDGE))
+		{
+			std::cerr << "Error: Unexpected " << getRecordName(rt) << " record found in " << *pFilename << "\n";
+			exit(EXIT_FAILURE);
+		}
+		if(pBlock->firstType < 0)
+			pBlock->firstType = rt;
+		pBlock->lastType = rt;
+
 		switch(rt)
 		{
 			case ASQG::RT_HEADER:
-			{
-				if(stage != 0)
-				{
-					std::cerr << "Error: Unexpected header record found at line " << line << "\n";
-					exit(EXIT_FAILURE);
-				}
-
-				ASQG::HeaderRecord headerRecord(recordLine);
-				const SQG::IntTag& overlapTag = headerRecord.getOverlapTag();
-				if(overlapTag.isInitialized())
-				pGraph->setMinOverlap(overlapTag.get());
-				else
-				pGraph->setMinOverlap(0);
-
-				const SQG::FloatTag& errorRateTag = headerRecord.getErrorRateTag();
-				if(errorRateTag.isInitialized())
-				pGraph->setErrorRate(errorRateTag.get());
-				
-				const SQG::IntTag& containmentTag = headerRecord.getContainmentTag();
-				if(containmentTag.isInitialized())
-				pGraph->setContainmentFlag(containmentTag.get());
-				else
-				pGraph->setContainmentFlag(true); // conservatively assume containments are present
-
-				const SQG::IntTag& transitiveTag = headerRecord.getTransitiveTag();
-				if(!transitiveTag.isInitialized())
-				{
-					std::cerr << "Warning: ASQG does not have transitive tag\n";
-					pGraph->setTransitiveFlag(true);
-				}
-				else
-				{
-					pGraph->setTransitiveFlag(transitiveTag.get());
-				}
-
+				pBlock->headers.push_back(recordLine);
 				break;
-			}
 			case ASQG::RT_VERTEX:
-			{
-				// progress the stage if we are done the header
-				if(stage == 0)
-				stage = 1;
-
-				if(stage != 1)
-				{
-					std::cerr << "Error: Unexpected vertex record found at line " << line << "\n";
-					exit(EXIT_FAILURE);
-				}
-
-				ASQG::VertexRecord vertexRecord(recordLine);
-				const SQG::IntTag& ssTag = vertexRecord.getSubstringTag();
-
-				Vertex* pVertex = new(pGraph->getVertexAllocator()) Vertex(vertexRecord.getID(), vertexRecord.getSeq());
-				if(ssTag.isInitialized() && ssTag.get() == 1)
-				{
-					// Vertex is a substring of some other vertex, mark it as contained
-					pVertex->setContained(true);
-					pGraph->setContainmentFlag(true);
-				}
-				pGraph->addVertex(pVertex);
+				pBlock->vertices.push_back(ASQG::VertexRecord(recordLine));
 				break;
-			}
 			case ASQG::RT_EDGE:
 			{
-				if(stage == 1)
-				stage = 2;
-				
-				if(stage != 2)
-				{
-					std::cerr << "Error: Unexpected edge record found at line " << line << "\n";
-					exit(EXIT_FAILURE);
-				}
-
 				ASQG::EdgeRecord edgeRecord(recordLine);
 				const Overlap& ovr = edgeRecord.getOverlap();
-
-
-				// Add the edge to the graph
-				if(ovr.match.getMinOverlapLength() >= (int)minOverlap)
-					SGAlgorithms::createEdgesFromOverlap(pGraph, ovr, allowContainments, maxEdges);
+				if(ovr.match.getMinOverlapLength() >= (int)pParams->minOverlap)
+					pBlock->overlaps.push_back(ovr);
+				else
+					pBlock->numShort++;
 				break;
 			}
-		}//end of switch
-		++line;
-	}//end of each line in the main asqg
-
-	delete pReader;
-	return pGraph;
+		}
+	}
 }
 
-StringGraph* SGUtil::loadASQGEdge(std::string ASQGFileName, const unsigned int minOverlap, bool allowContainments, size_t maxEdges, StringGraph* pGraph)
+static void parseHitsBlock(LoadBlock* pBlock, const LoadParams* pParams, const std::string* pFilename)
 {
-	std::string edgeFilePrefix = getFilename(ASQGFileName);
-	std::vector<std::istream*> EdgeFileVec;
-
-	//search for the edges files named with xxxx-thread??.edges.gz, if existed
-	std::stringstream ss;
-	size_t fileIdx=0;
-	ss << edgeFilePrefix << "-thread" << fileIdx << HITS_EXT << GZIP_EXT;
-	std::string edgefile = ss.str();
-	std::istream* pistream = createReader(edgefile);
-	while(pistream->peek()!=std::istream::traits_type::eof())
+	const char* p = pBlock->data.data();
+	const char* end = p + pBlock->data.size();
+	Overlap ovr;
+	while(p < end)
 	{
-		std::cout << edgefile << std::endl;
-		EdgeFileVec.push_back(pistream);
-		//search for next edge file
-		ss.str("");
-		fileIdx++;
-		ss << edgeFilePrefix << "-thread" << fileIdx << HITS_EXT << GZIP_EXT;
-		edgefile = ss.str();
-		pistream = createReader(edgefile);		
-	}
-
-	int line = 0;
-
-	#pragma omp parallel for
-	for(size_t i=0 ; i< EdgeFileVec.size() ;i++)
-	{
-		std::string recordLine;
-		while(getline(*EdgeFileVec[i],recordLine))
+		if(!OverlapHitFile::parseRecord(p, end, ovr))
 		{
-			ASQG::RecordType rt = ASQG::getRecordType(recordLine);
-			if (rt != ASQG::RT_EDGE)
-			{	
-				std::cerr << "Error: Unexpected edge record found at line " << line << "\n";
-				exit(EXIT_FAILURE);
-			}
-			ASQG::EdgeRecord edgeRecord(recordLine);
-			const Overlap& ovr = edgeRecord.getOverlap();
-			
-			// Add the edge to the graph
-			if(ovr.match.getMinOverlapLength() >= (int)minOverlap)
-				SGAlgorithms::createEdgesFromOverlap(pGraph, ovr, allowContainments, maxEdges);
-			
-			++line;
+			std::cerr << "Error: truncated or corrupt hit record in " << *pFilename << "\n";
+			exit(EXIT_FAILURE);
 		}
-		delete EdgeFileVec[i];
+		if(ovr.match.getMinOverlapLength() >= (int)pParams->minOverlap)
+			pBlock->overlaps.push_back(ovr);
+		else
+			pBlock->numShort++;
 	}
+	if(!pBlock->overlaps.empty() || pBlock->numShort > 0)
+		pBlock->firstType = pBlock->lastType = ASQG::RT_EDGE;
+}
 
-	// Completely delete the edges for all nodes that were marked as super-repetitive in the graph
-	//SGSuperRepeatVisitor superRepeatVisitor;
-	//pGraph->visitP(superRepeatVisitor);
+static void createBlockVertices(LoadBlock* pBlock)
+{
+	for(size_t i = 0; i < pBlock->vertices.size(); ++i)
+	{
+		const ASQG::VertexRecord& vertexRecord = pBlock->vertices[i];
+		Vertex* pVertex = ::new(pBlock->vertexSlots[i]) Vertex(vertexRecord.getID(), vertexRecord.getSeq());
 
-	// Remove any duplicate edges
-	SGDuplicateVisitor dupVisit;
-	pGraph->visit(dupVisit);
+		// Vertex is a substring of some other vertex, mark it as contained
+		const SQG::IntTag& ssTag = vertexRecord.getSubstringTag();
+		if(ssTag.isInitialized() && ssTag.get() == 1)
+			pVertex->setContained(true);
+	}
+}
 
-	return pGraph;
+static void createBlockEdges(StringGraph* pGraph, const LoadBlock* pBlock, const LoadParams* pParams)
+{
+	if(pParams->pSelector != NULL)
+	{
+		pParams->pSelector->countShort(pBlock->numShort);
+		for(size_t i = 0; i < pBlock->overlaps.size(); ++i)
+			pParams->pSelector->add(pBlock->overlaps[i]);
+		return;
+	}
+
+	// Add the edges to the graph, the short overlaps were dropped by the parser
+	for(size_t i = 0; i < pBlock->overlaps.size(); ++i)
+		SGAlgorithms::createEdgesFromOverlap(pGraph, pBlock->overlaps[i], pParams->allowContainments, pParams->maxEdges, pParams->color);
 }
 
-StringGraph*  SGUtil::loadASQG_Parallel(const StringVector & filenameList, const unsigned int minOverlap, 
-bool allowContainments , size_t maxEdges ,GraphColor c)
+// Read the next blocks of a file into batch and parse them with the tasks of the
+// current team. Returns the number of blocks read, sets isEOF at the end of the file.
+// lastType is the type of the last record parsed so far.
+static size_t parseBatch(std::istream* pReader, OverlapHitFile::Reader* pHitReader, std::vector<LoadBlock>& batch,
+                         const LoadParams* pParams, const std::string* pFilename, int& lastType, bool& isEOF)
 {
-	//RED_EDGE for dupEdge
-	assert (c != GC_RED);
-	
-	StringGraph* pGraph = new StringGraph;
-	size_t fileNumber = filenameList.size();
-	std::vector<StringVector> decodeFiles(fileNumber);
+	bool isBinary = pHitReader != NULL;
+	size_t numBlocks = 0;
+	for(; numBlocks < batch.size(); ++numBlocks)
+	{
+		LoadBlock* pBlock = &batch[numBlocks];
+		pBlock->clear();
+		isEOF = isBinary ? !pHitReader->readBlock(pBlock->data, LOAD_BLOCK_SIZE) : !readLineBlock(*pReader, pBlock->data);
+		if(isEOF)
+			break;
 
-	std::cout << "#Parallel decoding" << std::endl;
-	#pragma omp parallel for num_threads(fileNumber)
-	for ( size_t i = 0; i < fileNumber ;i ++)
+		#pragma omp task firstprivate(pBlock, pParams, pFilename)
+		{
+			if(isBinary)
+				parseHitsBlock(pBlock, pParams, pFilename);
+			else
+				parseLineBlock(pBlock, pParams, pFilename);
+		}
+	}
+	#pragma omp taskwait
+
+	for(size_t j = 0; j < numBlocks; ++j)
 	{
-		std::istream* pReader = createReader(filenameList[i]);
-		std::string recordLine;
-		while(getline(*pReader, recordLine)) 
-			decodeFiles[i].push_back(recordLine);
-		std::cout << filenameList[i] << " is decoded." << std::endl;
-		delete pReader;
-		
+		const LoadBlock& block = batch[j];
+		if(block.firstType < 0)
+			continue;
+		if(block.firstType < lastType)
+		{
+			std::cerr << "Error: Unexpected " << getRecordName(block.firstType) << " record found in " << *pFilename << "\n";
+			exit(EXIT_FAILURE);
+		}
+		lastType = block.lastType;
 	}
+	return numBlocks;
+}
 
-	std::cout << "#Serial loading." << std::endl;
-	for (size_t i=0;i<fileNumber;i++)
+// Parse the blocks of a batch with the tasks of the current team, then add their
+// vertices to the graph in file order and create their edges. Vertices are allocated
+// serially from the pool of the graph and constructed in parallel. The edges are
+// created in file order by the encountering thread, so the edge lists and the vertices
+// reaching maxEdges do not depend on the number of threads. Only the overlaps passed
+// to an edge selector, which ranks them independently of their order, are added in parallel.
+static void loadBlocksInTeam(const StringVector& filenameList, bool isBinary, const LoadParams& params, StringGraph* pGraph)
+{
+	std::vector<LoadBlock> batch(2 * omp_get_num_threads());
+	const LoadParams* pParams = &params;
+	for(size_t i = 0; i < filenameList.size(); ++i)
 	{
-		for (size_t j=0;j<decodeFiles[i].size();j++)
+		const std::string* pFilename = &filenameList[i];
+		std::istream* pReader = NULL;
+		OverlapHitFile::Reader* pHitReader = NULL;
+		if(isBinary)
+			pHitReader = new OverlapHitFile::Reader(filenameList[i]);
+		else
+			pReader = createReader(filenameList[i]);
+
+		int lastType = ASQG::RT_HEADER;
+		bool isEOF = false;
+		while(!isEOF)
 		{
-			ASQG::RecordType rt = ASQG::getRecordType(decodeFiles[i][j]);
-			switch(rt)
+			size_t numBlocks = parseBatch(pReader, pHitReader, batch, pParams, pFilename, lastType, isEOF);
+
+			bool hasVertices = false, hasEdges = false;
+			for(size_t j = 0; j < numBlocks; ++j)
 			{
-			case ASQG::RT_HEADER:
+				LoadBlock& block = batch[j];
+				for(size_t k = 0; k < block.headers.size(); ++k)
+					loadHeaderRecord(pGraph, block.headers[k], params.assumeContainment);
+
+				for(size_t k = 0; k < block.vertices.size(); ++k)
+					block.vertexSlots.push_back(pGraph->getVertexAllocator()->alloc());
+				hasVertices = hasVertices || !block.vertices.empty();
+				hasEdges = hasEdges || !block.overlaps.empty() || block.numShort > 0;
+			}
+
+			if(hasVertices)
+			{
+				for(size_t j = 0; j < numBlocks; ++j)
 				{
-					ASQG::HeaderRecord headerRecord(decodeFiles[i][j]);
-					const SQG::IntTag& overlapTag = headerRecord.getOverlapTag();
-					if(overlapTag.isInitialized())
-						pGraph->setMinOverlap(overlapTag.get());
-					else
-						pGraph->setMinOverlap(0);
-
-					const SQG::FloatTag& errorRateTag = headerRecord.getErrorRateTag();
-					if(errorRateTag.isInitialized())
-					pGraph->setErrorRate(errorRateTag.get());
-					
-					const SQG::IntTag& containmentTag = headerRecord.getContainmentTag();
-					if(containmentTag.isInitialized())
-					pGraph->setContainmentFlag(containmentTag.get());
-					else
-					pGraph->setContainmentFlag(true); // conservatively assume containments are present
-
-					const SQG::IntTag& transitiveTag = headerRecord.getTransitiveTag();
-					if(!transitiveTag.isInitialized())
-					{
-						std::cerr << "Warning: ASQG does not have transitive tag\n";
-						pGraph->setTransitiveFlag(true);
-					}
-					else
-					{
-						pGraph->setTransitiveFlag(transitiveTag.get());
-					}
-					break;
+					LoadBlock* pBlock = &batch[j];
+					#pragma omp task firstprivate(pBlock)
+					createBlockVertices(pBlock);
 				}
-			case ASQG::RT_VERTEX:
-				{
-					// progress the stage if we are done the header
-					ASQG::VertexRecord vertexRecord(decodeFiles[i][j]);
-					const SQG::IntTag& ssTag = vertexRecord.getSubstringTag();
+				#pragma omp taskwait
 
-					Vertex* pVertex = new(pGraph->getVertexAllocator()) Vertex(vertexRecord.getID(), vertexRecord.getSeq());
-					if(ssTag.isInitialized() && ssTag.get() == 1)
+				for(size_t j = 0; j < numBlocks; ++j)
+				{
+					for(size_t k = 0; k < batch[j].vertexSlots.size(); ++k)
 					{
-						// Vertex is a substring of some other vertex, mark it as contained
-						pVertex->setContained(true);
-						pGraph->setContainmentFlag(true);
+						Vertex* pVertex = (Vertex*)batch[j].vertexSlots[k];
+						if(pVertex->isContained())
+							pGraph->setContainmentFlag(true);
+						pGraph->addVertex(pVertex);
 					}
-					pGraph->addVertex(pVertex);
-					break;
 				}
-			case ASQG::RT_EDGE:
-				{
-					ASQG::EdgeRecord edgeRecord(decodeFiles[i][j]);
-					const Overlap& ovr = edgeRecord.getOverlap();
+			}
 
-						// Add the edge to the graph
-					if(ovr.match.getMinOverlapLength() >= (int)minOverlap)
-							SGAlgorithms::createEdgesFromOverlap(pGraph, ovr, allowContainments, maxEdges,c);
-					break;
+			if(hasEdges && params.pSelector != NULL)
+			{
+				for(size_t j = 0; j < numBlocks; ++j)
+				{
+					LoadBlock* pBlock = &batch[j];
+					#pragma omp task firstprivate(pBlock, pParams, pGraph)
+					createBlockEdges(pGraph, pBlock, pParams);
 				}
-			
+				#pragma omp taskwait
+			}
+			else if(hasEdges)
+			{
+				for(size_t j = 0; j < numBlocks; ++j)
+					createBlockEdges(pGraph, &batch[j], pParams);
 			}
-		
 		}
-		std::cout << filenameList[i] << " is finish." << std::endl;
+
+		delete pReader;
+		delete pHitReader;
 	}
-	
-	
+}
 
-		
-	// Completely delete the edges for all nodes that were marked as super-repetitive in the graph
-	//SGSuperRepeatVisitor superRepeatVisitor;
-	//pGraph->visitP(superRepeatVisitor);
+// Load the files into pGraph with all threads, independently of the number of files.
+// Called within a parallel region, e.g. from a single construct, the blocks are parsed
+// by the threads of the enclosing team once they reach a barrier.
+static void loadBlocks(const StringVector& filenameList, bool isBinary, const LoadParams& params, StringGraph* pGraph)
+{
+	if(omp_in_parallel())
+	{
+		loadBlocksInTeam(filenameList, isBinary, params, pGraph);
+		return;
+	}
 
-	// Remove any duplicate edges
-	SGDuplicateVisitor dupVisit;
-	pGraph->visit(dupVisit);
+	#pragma omp parallel
+	{
+		#pragma omp single
+		loadBlocksInTeam(filenameList, isBinary, params, pGraph);
+	}
+}
 
-	
-	//SGGraphStatsVisitor statsVisit;
-	//pGraph->visit(statsVisit);
+// Load a file into a compact graph. The blocks are parsed by the tasks of the current team,
+// the vertices and edges are added in file order by the encountering thread, so the edge
+// lists and the vertices reaching maxEdges do not depend on the number of threads.
+static void loadCompactFile(const std::string& filename, bool isBinary, const LoadParams& params,
+                            std::vector<LoadBlock>& batch, CompactStringGraph* pGraph, bool& isFinalized)
+{
+	std::istream* pReader = NULL;
+	OverlapHitFile::Reader* pHitReader = NULL;
+	if(isBinary)
+		pHitReader = new OverlapHitFile::Reader(filename);
+	else
+		pReader = createReader(filename);
+
+	std::vector<CompactStringGraph::VertexIdx> endpoints;
+	int lastType = ASQG::RT_HEADER;
+	bool isEOF = false;
+	while(!isEOF)
+	{
+		size_t numBlocks = parseBatch(pReader, pHitReader, batch, &params, &filename, lastType, isEOF);
+		for(size_t j = 0; j < numBlocks; ++j)
+		{
+			const LoadBlock& block = batch[j];
+			for(size_t k = 0; k < block.headers.size(); ++k)
+				loadHeaderRecord(pGraph, block.headers[k], params.assumeContainment);
 
+			for(size_t k = 0; k < block.vertices.size(); ++k)
+			{
+				// Vertex is a substring of some other vertex, mark it as contained
+				const ASQG::VertexRecord& vertexRecord = block.vertices[k];
+				const SQG::IntTag& ssTag = vertexRecord.getSubstringTag();
+				bool isContained = ssTag.isInitialized() && ssTag.get() == 1;
+				if(isContained)
+					pGraph->setContainmentFlag(true);
+				pGraph->addVertex(vertexRecord.getID(), vertexRecord.getSeq(), isContained);
+			}
 
-	return pGraph;
+			if(block.overlaps.empty())
+				continue;
+			if(!isFinalized)
+			{
+				pGraph->finalizeVertices();
+				isFinalized = true;
+			}
 
+			// Look up the endpoints in parallel, the vertices do not change any more
+			const OverlapVector& overlaps = block.overlaps;
+			endpoints.resize(2 * overlaps.size());
+			#pragma omp taskloop grainsize(1024) shared(overlaps, endpoints, pGraph)
+			for(size_t k = 0; k < overlaps.size(); ++k)
+			{
+				endpoints[2 * k] = pGraph->findVertex(overlaps[k].id[0]);
+				endpoints[2 * k + 1] = pGraph->findVertex(overlaps[k].id[1]);
+			}
 
+			for(size_t k = 0; k < overlaps.size(); ++k)
+			{
+				if(overlaps[k].match.getMinOverlapLength() >= (int)params.minOverlap)
+					pGraph->addOverlap(overlaps[k], endpoints[2 * k], endpoints[2 * k + 1], params.allowContainments, params.maxEdges, params.color);
+			}
+		}
+	}
+
+	delete pReader;
+	delete pHitReader;
 }
 
+static void loadCompactInTeam(const std::string& asqgFile, const StringVector& edgeFileVec, bool isBinary,
+                              const LoadParams& vertexParams, const LoadParams& edgeParams, CompactStringGraph* pGraph)
+{
+	std::vector<LoadBlock> batch(2 * omp_get_num_threads());
+	bool isFinalized = false;
+	loadCompactFile(asqgFile, false, vertexParams, batch, pGraph, isFinalized);
+	for(size_t i = 0; i < edgeFileVec.size(); ++i)
+		loadCompactFile(edgeFileVec[i], isBinary, edgeParams, batch, pGraph, isFinalized);
+
+	if(!isFinalized)
+		pGraph->finalizeVertices();
+	pGraph->finalizeEdges();
+}
 
+static LoadParams makeLoadParams(const unsigned int minOverlap, bool allowContainments, size_t maxEdges, GraphColor c, bool assumeContainment, bool isEdgeFile)
+{
+	LoadParams params;
+	params.minOverlap = minOverlap;
+	params.allowContainments = allowContainments;
+	params.maxEdges = maxEdges;
+	params.color = c;
+	params.assumeContainment = assumeContainment;
+	params.isEdgeFile = isEdgeFile;
+	params.pSelector = NULL;
+	return params;
+}
 
-StringGraph* SGUtil::loadASQG_EDGE_Parallel(const StringVector & filenameList, const unsigned int minOverlap, bool allowContainments, size_t maxEdges ,GraphColor c , StringGraph* pGraph)
+// Search for the edges files named with xxxx-thread??<ext>
+static StringVector findHitsFiles(const std::string& edgeFilePrefix, const std::string& ext)
 {
-	//RED_EDGE for dupEdge
-	assert (c != GC_RED);
-	
-	size_t fileNumber = filenameList.size();
-	std::vector<StringVector> decodeFiles(fileNumber);
-	
-	std::cout << "#Parallel decoding" << std::endl;
-	#pragma omp parallel for num_threads(fileNumber)
-	for ( size_t i = 0; i < fileNumber ;i ++)
-	{
-		std::istream* pReader = createReader(filenameList[i]);
-		std::string recordLine;
-		while(getline(*pReader, recordLine)) 
-			decodeFiles[i].push_back(recordLine);
-		std::cout << filenameList[i] << " is decoded." << std::endl;
-		delete pReader;
-		
-	}
-	
-	std::cout << "#Serial loading." << std::endl;
-	for (size_t i=0;i<fileNumber;i++)
+	StringVector hitsFileVec;
+	struct stat buffer;
+	while(true)
 	{
-		for (size_t j=0;j<decodeFiles[i].size();j++)
-		{
-			ASQG::RecordType rt = ASQG::getRecordType(decodeFiles[i][j]);
-			if (rt != ASQG::RT_EDGE)
-			{	
-				std::cerr << "Error: Unexpected edge record found at " << filenameList[i] << "\n";
-				exit(EXIT_FAILURE);
-			}
-			ASQG::EdgeRecord edgeRecord(decodeFiles[i][j]);
-			const Overlap& ovr = edgeRecord.getOverlap();
-			
-			// Add the edge to the graph
-			if(ovr.match.getMinOverlapLength() >= (int)minOverlap)
-				SGAlgorithms::createEdgesFromOverlap(pGraph, ovr, allowContainments, maxEdges,c);
-				
-		}
-		std::cout << filenameList[i] << " is finish." << std::endl;
+		std::stringstream ss;
+		ss << edgeFilePrefix << "-thread" << hitsFileVec.size() << ext;
+		if(stat(ss.str().c_str(), &buffer) != 0)
+			break;
+		std::cout << ss.str() << std::endl;
+		hitsFileVec.push_back(ss.str());
 	}
-	
-	
+	return hitsFileVec;
+}
+
+StringGraph* SGUtil::loadASQG(const StringVector & filenameList, const unsigned int minOverlap, bool allowContainments , size_t maxEdges ,GraphColor c)
+{
+	// Initialize graph
+	StringGraph* pGraph = new StringGraph;
+	loadBlocks(filenameList, false, makeLoadParams(minOverlap, allowContainments, maxEdges, c, false, false), pGraph);
+
 	// Completely delete the edges for all nodes that were marked as super-repetitive in the graph
 	//SGSuperRepeatVisitor superRepeatVisitor;
 	//pGraph->visitP(superRepeatVisitor);
@@ -464,121 +487,108 @@ StringGraph* SGUtil::loadASQG_EDGE_Parallel(const StringVector & filenameList, c
 	SGDuplicateVisitor dupVisit;
 	pGraph->visit(dupVisit);
 
-	
-	//SGGraphStatsVisitor statsVisit;
-	//pGraph->visit(statsVisit);
-
 	return pGraph;
 }
 
-
-StringGraph* SGUtil::loadASQG(const std::string& filename, const unsigned int minOverlap, bool allowContainments, size_t maxEdges)
+StringGraph* SGUtil::loadASQGVertex(const std::string& filename, const unsigned int minOverlap, bool allowContainments, size_t maxEdges)
 {
 	// Initialize graph
 	StringGraph* pGraph = new StringGraph;
+	loadBlocks(StringVector(1, filename), false, makeLoadParams(minOverlap, allowContainments, maxEdges, GC_WHITE, true, false), pGraph);
+	return pGraph;
+}
 
-	std::istream* pReader = createReader(filename);
+StringGraph* SGUtil::loadASQGEdge(std::string ASQGFileName, const unsigned int minOverlap, bool allowContainments, size_t maxEdges, StringGraph* pGraph)
+{
+	std::string edgeFilePrefix = getFilename(ASQGFileName);
 
-	int stage = 0;
-	int line = 0;
-	std::string recordLine;
+	// Binary hits written by overlap --binary-hits are decoded without tokenizing
+	if(OverlapHitFile::isHitFile(edgeFilePrefix + "-thread0" + BINHITS_EXT))
+		return loadHitsEdge(edgeFilePrefix, minOverlap, allowContainments, maxEdges, pGraph);
 
-	while(getline(*pReader, recordLine))
-	{ 	
-		ASQG::RecordType rt = ASQG::getRecordType(recordLine);
-		switch(rt)
-		{
-		case ASQG::RT_HEADER:
-			{
-				if(stage != 0)
-				{
-					std::cerr << "Error: Unexpected header record found at line " << line << "\n";
-					exit(EXIT_FAILURE);
-				}
+	StringVector edgeFileVec = findHitsFiles(edgeFilePrefix, std::string(HITS_EXT) + GZIP_EXT);
+	loadBlocks(edgeFileVec, false, makeLoadParams(minOverlap, allowContainments, maxEdges, GC_WHITE, true, true), pGraph);
 
-				ASQG::HeaderRecord headerRecord(recordLine);
-				const SQG::IntTag& overlapTag = headerRecord.getOverlapTag();
-				if(overlapTag.isInitialized())
-				pGraph->setMinOverlap(overlapTag.get());
-				else
-				pGraph->setMinOverlap(0);
-
-				const SQG::FloatTag& errorRateTag = headerRecord.getErrorRateTag();
-				if(errorRateTag.isInitialized())
-				pGraph->setErrorRate(errorRateTag.get());
-				
-				const SQG::IntTag& containmentTag = headerRecord.getContainmentTag();
-				if(containmentTag.isInitialized())
-				pGraph->setContainmentFlag(containmentTag.get());
-				else
-				pGraph->setContainmentFlag(true); // conservatively assume containments are present
+	// Completely delete the edges for all nodes that were marked as super-repetitive in the graph
+	//SGSuperRepeatVisitor superRepeatVisitor;
+	//pGraph->visitP(superRepeatVisitor);
 
-				const SQG::IntTag& transitiveTag = headerRecord.getTransitiveTag();
-				if(!transitiveTag.isInitialized())
-				{
-					std::cerr << "Warning: ASQG does not have transitive tag\n";
-					pGraph->setTransitiveFlag(true);
-				}
-				else
-				{
-					pGraph->setTransitiveFlag(transitiveTag.get());
-				}
+	// Remove any duplicate edges
+	SGDuplicateVisitor dupVisit;
+	pGraph->visit(dupVisit);
 
-				break;
-			}
-		case ASQG::RT_VERTEX:
-			{
-				// progress the stage if we are done the header
-				if(stage == 0)
-				stage = 1;
+	return pGraph;
+}
 
-				if(stage != 1)
-				{
-					std::cerr << "Error: Unexpected vertex record found at line " << line << "\n";
-					exit(EXIT_FAILURE);
-				}
+StringGraph* SGUtil::loadASQGEdgeSelected(std::string ASQGFileName, const unsigned int minOverlap, bool allowContainments,
+                                          size_t maxEdges, size_t maxDegree, size_t memoryBudget, StringGraph* pGraph)
+{
+	if(memoryBudget > 0)
+	{
+		size_t budgetDegree = SGEdgeSelector::getBudgetDegree(pGraph, memoryBudget);
+		maxDegree = maxDegree == 0 ? budgetDegree : std::min(maxDegree, budgetDegree);
+	}
 
-				ASQG::VertexRecord vertexRecord(recordLine);
-				const SQG::IntTag& ssTag = vertexRecord.getSubstringTag();
+	std::string edgeFilePrefix = getFilename(ASQGFileName);
+	bool isBinary = OverlapHitFile::isHitFile(edgeFilePrefix + "-thread0" + BINHITS_EXT);
+	StringVector edgeFileVec = findHitsFiles(edgeFilePrefix, isBinary ? std::string(BINHITS_EXT) : std::string(HITS_EXT) + GZIP_EXT);
+
+	SGEdgeSelector selector(pGraph, maxDegree);
+	LoadParams params = makeLoadParams(minOverlap, allowContainments, maxEdges, GC_WHITE, true, true);
+	params.pSelector = &selector;
+	loadBlocks(edgeFileVec, isBinary, params, pGraph);
+	selector.createEdges(allowContainments, maxEdges, GC_WHITE);
+	return pGraph;
+}
 
-				Vertex* pVertex = new(pGraph->getVertexAllocator()) Vertex(vertexRecord.getID(), vertexRecord.getSeq());
-				if(ssTag.isInitialized() && ssTag.get() == 1)
-				{
-					// Vertex is a substring of some other vertex, mark it as contained
-					pVertex->setContained(true);
-					pGraph->setContainmentFlag(true);
-				}
-				pGraph->addVertex(pVertex);
-				break;
-			}
-		case ASQG::RT_EDGE:
-			{
-				if(stage == 1)
-				stage = 2;
-				
-				if(stage != 2)
-				{
-					std::cerr << "Error: Unexpected edge record found at line " << line << "\n";
-					exit(EXIT_FAILURE);
-				}
+StringGraph* SGUtil::loadHitsEdge(const std::string& edgeFilePrefix, const unsigned int minOverlap, bool allowContainments, size_t maxEdges, StringGraph* pGraph)
+{
+	StringVector hitsFileVec = findHitsFiles(edgeFilePrefix, BINHITS_EXT);
+	loadBlocks(hitsFileVec, true, makeLoadParams(minOverlap, allowContainments, maxEdges, GC_WHITE, true, true), pGraph);
 
-				ASQG::EdgeRecord edgeRecord(recordLine);
-				const Overlap& ovr = edgeRecord.getOverlap();
+	// Remove any duplicate edges
+	SGDuplicateVisitor dupVisit;
+	pGraph->visit(dupVisit);
 
-				// Add the edge to the graph
-				if(ovr.match.getMinOverlapLength() >= (int)minOverlap)
-					SGAlgorithms::createEdgesFromOverlap(pGraph, ovr, allowContainments, maxEdges);
-				break;
-			}
-		}
-		++line;
-	}
+	return pGraph;
+}
+
+StringGraph*  SGUtil::loadASQG_Parallel(const StringVector & filenameList, const unsigned int minOverlap, 
+bool allowContainments , size_t maxEdges ,GraphColor c)
+{
+	//RED_EDGE for dupEdge
+	assert (c != GC_RED);
 	
-	// Completely delete the edges for all nodes that were marked as super-repetitive in the graph
-	//SGSuperRepeatVisitor superRepeatVisitor;
-	//pGraph->visitP(superRepeatVisitor);
+	StringGraph* pGraph = new StringGraph;
+	loadBlocks(filenameList, false, makeLoadParams(minOverlap, allowContainments, maxEdges, c, true, false), pGraph);
+
+	// Remove any duplicate edges
+	SGDuplicateVisitor dupVisit;
+	pGraph->visit(dupVisit);
 
+	return pGraph;
+}
+
+StringGraph* SGUtil::loadASQG_EDGE_Parallel(const StringVector & filenameList, const unsigned int minOverlap, bool allowContainments, size_t maxEdges ,GraphColor c , StringGraph* pGraph)
+{
+	//RED_EDGE for dupEdge
+	assert (c != GC_RED);
 	
+	loadBlocks(filenameList, false, makeLoadParams(minOverlap, allowContainments, maxEdges, c, true, true), pGraph);
+
+	// Remove any duplicate edges
+	SGDuplicateVisitor dupVisit;
+	pGraph->visit(dupVisit);
+
+	return pGraph;
+}
+
+StringGraph* SGUtil::loadASQG(const std::string& filename, const unsigned int minOverlap, bool allowContainments, size_t maxEdges)
+{
+	// Initialize graph
+	StringGraph* pGraph = new StringGraph;
+	loadBlocks(StringVector(1, filename), false, makeLoadParams(minOverlap, allowContainments, maxEdges, GC_WHITE, true, false), pGraph);
+
 	// Remove any duplicate edges
 	SGDuplicateVisitor dupVisit;
 	pGraph->visit(dupVisit);
@@ -590,7 +600,35 @@ StringGraph* SGUtil::loadASQG(const std::string& filename, const unsigned int mi
 	SGIdenticalRemoveVisitor irv;
 	pGraph->visit(irv);
 	*/
-	delete pReader;
+	return pGraph;
+}
+
+CompactStringGraph* SGUtil::loadCompactASQG(const std::string& asqgFile, const unsigned int minOverlap, bool allowContainments, size_t maxEdges)
+{
+	CompactStringGraph* pGraph = new CompactStringGraph;
+
+	// The edges are in the hits files of overlap if there are any
+	std::string edgeFilePrefix = getFilename(asqgFile);
+	bool isBinary = OverlapHitFile::isHitFile(edgeFilePrefix + "-thread0" + BINHITS_EXT);
+	StringVector edgeFileVec = findHitsFiles(edgeFilePrefix, isBinary ? std::string(BINHITS_EXT) : std::string(HITS_EXT) + GZIP_EXT);
+
+	LoadParams vertexParams = makeLoadParams(minOverlap, allowContainments, maxEdges, GC_WHITE, true, false);
+	LoadParams edgeParams = makeLoadParams(minOverlap, allowContainments, maxEdges, GC_WHITE, true, true);
+	if(omp_in_parallel())
+	{
+		loadCompactInTeam(asqgFile, edgeFileVec, isBinary, vertexParams, edgeParams, pGraph);
+	}
+	else
+	{
+		#pragma omp parallel
+		{
+			#pragma omp single
+			loadCompactInTeam(asqgFile, edgeFileVec, isBinary, vertexParams, edgeParams, pGraph);
+		}
+	}
+
+	// Remove any duplicate edges
+	pGraph->removeDuplicateEdges();
 	return pGraph;
 }
 
@@ -15,6 +15,7 @@
 
 // typedefs
 typedef Bigraph StringGraph;
+class CompactStringGraph;
 
 namespace SGUtil
 {
@@ -28,10 +29,25 @@ namespace SGUtil
 	StringGraph* loadASQGVertex(const std::string& filename, const unsigned int minOverlap, bool allowContainments = false, size_t maxEdges=-1);
 	StringGraph* loadASQGEdge(std::string ASQGFileName, const unsigned int minOverlap, bool allowContainments, size_t maxEdges, StringGraph* pGraph);
 
+	// Load the edges like loadASQGEdge, keeping only the maxDegree best edges of every vertex
+	// and no duplicate edges while loading, see SGEdgeSelector. With a memoryBudget in bytes
+	// for the whole graph the degree cap is lowered until the edges fit. 0 disables either limit.
+	// maxEdges limits the edges of a vertex as in loadASQGEdge.
+	StringGraph* loadASQGEdgeSelected(std::string ASQGFileName, const unsigned int minOverlap, bool allowContainments,
+	                                  size_t maxEdges, size_t maxDegree, size_t memoryBudget, StringGraph* pGraph);
+
+	// Load the edges from the binary hit files edgeFilePrefix-thread??.bedges written by overlap --binary-hits.
+	// loadASQGEdge calls this when the hit file of thread 0 exists.
+	StringGraph* loadHitsEdge(const std::string& edgeFilePrefix, const unsigned int minOverlap, bool allowContainments, size_t maxEdges, StringGraph* pGraph);
+
 	StringGraph* loadASQG_Parallel(const StringVector & filenameList, const unsigned int minOverlap, bool allowContainments = false, size_t maxEdges = -1,GraphColor c =GC_WHITE);
 	StringGraph* loadASQG_EDGE_Parallel(const StringVector & filenameList, const unsigned int minOverlap, bool allowContainments = false, size_t maxEdges = -1,GraphColor c =GC_WHITE , StringGraph* pGraph=NULL);
 
 
+	// Load the vertices of an ASQG file and the edges of its hits files, or of the ASQG file
+	// itself if there are none, into a CompactStringGraph. Duplicate edges are removed.
+	CompactStringGraph* loadCompactASQG(const std::string& asqgFile, const unsigned int minOverlap, bool allowContainments = false, size_t maxEdges = -1);
+
 	// Load a string graph from a fasta file.
 	// Returns a graph where each sequence in the fasta is a vertex but there are no edges in the graph.
 	StringGraph* loadFASTA(const std::string& filename);
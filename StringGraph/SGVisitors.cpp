@@ -19,10 +19,25 @@
 // fasta format
 //
 bool SGFastaVisitor::visit(StringGraph* /*pGraph*/, Vertex* pVertex)
+{
+	std::stringstream record;
+	writeRecord(pVertex, record);
+	m_writer.write(record.str());
+	return false;
+}
+
+//
+void SGFastaVisitor::write(StringGraph* pGraph)
+{
+	pGraph->writeVertexRecords(m_writer, [this](const Vertex* pVertex, std::ostream& out) { writeRecord(pVertex, out); });
+}
+
+//
+void SGFastaVisitor::writeRecord(const Vertex* pVertex, std::ostream& out) const
 {
 	size_t seqLen = pVertex->getSeqLen() ;
 
-	m_fileHandle << ">" << pVertex->getID() << " " << seqLen;
+	out << ">" << pVertex->getID() << " " << seqLen;
 
 	if (pBWT!=NULL && kmerLength!= 0)
 	{
@@ -44,16 +59,15 @@ bool SGFastaVisitor::visit(StringGraph* /*pGraph*/, Vertex* pVertex)
 			//cov += BWTAlgorithms::countSequenceOccurrences(kmer,pBWT);
 		}
 
-		m_fileHandle << " " << cov << " "<< (float)cov/ (seqLen-kmerLength+1) <<"\n";
+		out << " " << cov << " "<< (float)cov/ (seqLen-kmerLength+1) <<"\n";
 	}
 
 	else
-	m_fileHandle << " " << pVertex->getCoverage() << " " <<
+	out << " " << pVertex->getCoverage() << " " <<
 				pVertex->getOriginLength(ED_ANTISENSE) << " " <<
 				pVertex->getOriginLength(ED_SENSE) <<"\n";
 
-	m_fileHandle << pVertex->getSeq() << "\n";
-	return false;
+	out << pVertex->getSeq() << "\n";
 }
 
 
@@ -398,6 +412,12 @@ void SGSmoothingVisitor::previsit(StringGraph* pGraph)
 bool SGSmoothingVisitor::visit(StringGraph* pGraph, Vertex* pVertex)
 {
 	(void)pGraph;
+	return visit(pVertex, NULL);
+}
+
+//
+bool SGSmoothingVisitor::visit(Vertex* pVertex, const SGBubble* pBubbles)
+{
 	if(pVertex->getColor() == GC_RED)
 	return false;
 
@@ -415,6 +435,35 @@ bool SGSmoothingVisitor::visit(StringGraph* pGraph, Vertex* pVertex)
 			return false;
 		}
 
+		SGBubble localBubble;
+		const SGBubble* pBubble = &localBubble;
+		if(pBubbles != NULL)
+			pBubble = &pBubbles[idx];
+		else
+			findBubble(pVertex, dir, localBubble);
+
+		if(!pBubble->found)
+			continue;
+
+		for(size_t i = 0; i < pBubble->variantVertices.size(); ++i)
+		{
+			pBubble->variantVertices[i]->setColor(GC_RED);
+			found = true;
+		}
+
+		if(pBubble->isSimple)
+			m_simpleBubblesRemoved += 1;
+		else
+			m_complexBubblesRemoved += 1;
+
+			++m_numRemovedTotal;
+	}
+	return found;
+}
+
+//
+void SGSmoothingVisitor::findBubble(Vertex* pVertex, EdgeDir dir, SGBubble& bubble) const
+{
 		// The walks grow exponentially within repeats
 		const int MAX_WALKS = 240;
 		// The distance is the extended seq length excluding the starting vertex,
@@ -469,7 +518,7 @@ bool SGSmoothingVisitor::visit(StringGraph* pGraph, Vertex* pVertex)
 			}
 			
 			if(bIsDegenerate)	
-				continue;
+				return;
 			
 			// Now check the length diff of each walk against the selected walk instead of alignment
 			size_t selectedWalkLength=variantWalks[selectedIdx].getStartToEndDistance();
@@ -488,7 +537,7 @@ bool SGSmoothingVisitor::visit(StringGraph* pGraph, Vertex* pVertex)
 				}
 			}
 			
-			if( bFailIndelSizeCheck ) continue;
+			if( bFailIndelSizeCheck ) return;
 
 			assert(selectedIdx != (size_t)-1);
 			SGWalk& selectedWalk = variantWalks[selectedIdx];
@@ -511,22 +560,13 @@ bool SGSmoothingVisitor::visit(StringGraph* pGraph, Vertex* pVertex)
 					// If the vertex is also on the selected path, do not mark it
 					Vertex* currVertex = currEdge->getEnd();
 					if(!selectedWalk.containsVertex(currVertex->getID()))
-					{
-						currEdge->getEnd()->setColor(GC_RED);
-						found = true;
-					}
+						bubble.variantVertices.push_back(currVertex);
 				}
 			}
 
-			if(variantWalks.size() == 2)
-				m_simpleBubblesRemoved += 1;
-			else
-				m_complexBubblesRemoved += 1;
-
-				++m_numRemovedTotal;
+			bubble.found = true;
+			bubble.isSimple = variantWalks.size() == 2;
 		}
-	}
-	return found;
 }
 
 // Remove all the marked edges
@@ -56,16 +56,19 @@ private:
 struct SGFastaVisitor
 {
     // constructor
-    SGFastaVisitor(std::string filename,BWT* bwt=NULL,size_t k=0) : m_fileHandle(filename.c_str()),pBWT(bwt),kmerLength(k) {}
-    ~SGFastaVisitor() { m_fileHandle.close(); }
+    SGFastaVisitor(std::string filename,BWT* bwt=NULL,size_t k=0) : m_writer(filename),pBWT(bwt),kmerLength(k) {}
 
     // functions
     void previsit(StringGraph* /*pGraph*/) {}
     bool visit(StringGraph* pGraph, Vertex* pVertex);
     void postvisit(StringGraph* /*pGraph*/) {}
 
+    // Write the records of all vertices with all threads, in the order of visit
+    void write(StringGraph* pGraph);
+    void writeRecord(const Vertex* pVertex, std::ostream& out) const;
+
     // data
-    std::ofstream m_fileHandle;
+    BlockWriter m_writer;
 	BWT* pBWT ;
 	size_t kmerLength;
 };
@@ -149,6 +152,18 @@ struct SGSuperRepeatVisitor
     size_t m_num_superrepeats;
 };
 
+// A bubble found by SGSmoothingVisitor at a vertex in one direction
+struct SGBubble
+{
+    SGBubble() : found(false), isSimple(false) {}
+
+    bool found;
+    bool isSimple;
+
+    // The vertices of the walks that are not kept
+    VertexPtrVec variantVertices;
+};
+
 // Smooth out variation in the graph
 struct SGSmoothingVisitor
 {
@@ -162,6 +177,13 @@ struct SGSmoothingVisitor
     bool visit(StringGraph* pGraph, Vertex* pVertex);
     void postvisit(StringGraph*);
 
+    // Find the bubble of pVertex in direction dir without marking anything,
+    // safe to call from several threads
+    void findBubble(Vertex* pVertex, EdgeDir dir, SGBubble& bubble) const;
+
+    // visit with the bubbles of both directions found beforehand by findBubble
+    bool visit(Vertex* pVertex, const SGBubble* pBubbles);
+
     int m_simpleBubblesRemoved;
     int m_complexBubblesRemoved;
     int m_numRemovedTotal;
@@ -10,8 +10,18 @@
 
 // Find the interval in pBWT corresponding to w
 // If w does not exist in the BWT, the interval
-// coordinates [l, u] will be such that l > u
+// coordinates [l, u] will be such that l > u.
+// The interval cache attached to pBWT, if any, is used for the last k symbols
 BWTInterval BWTAlgorithms::findInterval(const BWT* pBWT, const std::string& w, int* count)
+{
+    const BWTIntervalCache* pIntervalCache = pBWT->getIntervalCache();
+    if(pIntervalCache != nullptr)
+        return findIntervalWithCache(pBWT, pIntervalCache, w, count);
+    return findIntervalDirect(pBWT, w, count);
+}
+
+// Find the interval in pBWT corresponding to w by a full backward search
+BWTInterval BWTAlgorithms::findIntervalDirect(const BWT* pBWT, const std::string& w, int* count)
 {
     int len = w.size();
     int j = len - 1;
@@ -39,28 +49,42 @@ BiBWTInterval BWTAlgorithms::findBiInterval(const BWTIndexSet& indices, const st
 // Find the interval in pBWT corresponding to w
 // using a cache of short k-mer intervals to avoid
 // some of the iterations
-BWTInterval BWTAlgorithms::findIntervalWithCache(const BWT* pBWT, const BWTIntervalCache* pIntervalCache, const std::string& w)
+BWTInterval BWTAlgorithms::findIntervalWithCache(const BWT* pBWT, const BWTIntervalCache* pIntervalCache, const std::string& w, int* count)
 {
-    size_t cacheLen = pIntervalCache->getCachedLength();
-    if(w.size() < cacheLen)
-        return findInterval(pBWT, w);
-
-    // Compute the interval using the cache for the last k bases
+    // Compute the interval using the cache for the last k bases,
+    // or for all of w if it is not longer than k
     int len = w.size();
+    size_t cacheLen = std::min(w.size(), pIntervalCache->getCachedLength());
     int j = len - cacheLen;
 
-    // Check whether the input string has a '$' in it.
-    // We don't cache these strings so if it does
-    // we have to do a direct lookup
-    if(index(w.c_str() + j, '$') != nullptr)
-        return findInterval(pBWT, w);
+    // The cache only holds strings over ACGT, strings with
+    // a '$' or an ambiguous base need a direct lookup.
+    // When the symbols are counted an empty interval
+    // is searched again as well, to count the same symbols
+    // as a direct search.
+    BWTInterval interval;
+    if(cacheLen == 0 || !pIntervalCache->lookup(w.c_str() + j, cacheLen, interval) || (count != nullptr && !interval.isValid()))
+    {
+        pIntervalCache->recordLookup(false);
+        return findIntervalDirect(pBWT, w, count);
+    }
+    pIntervalCache->recordLookup(true);
+
+    if(count != nullptr)
+    {
+        for(int i = j; i < len; ++i)
+            count[DNA_ALPHABET::getIdx(w[i])]++;
+    }
+
+    // The cached interval is the result of the direct search if it is empty
+    if(!interval.isValid())
+        return interval;
 
-    BWTInterval interval = pIntervalCache->lookup(w.c_str() + j);
     j -= 1;
     for(;j >= 0; --j)
     {
         char curr = w[j];
-        updateInterval(interval, curr, pBWT);
+        updateInterval(interval, curr, pBWT, count);
         if(!interval.isValid())
             return interval;
     }
@@ -78,8 +102,19 @@ BWTInterval BWTAlgorithms::findInterval(const BWTIndexSet& indices, const std::s
 
 // Find the intervals in pBWT/pRevBWT corresponding to w
 // If w does not exist in the BWT, the interval
-// coordinates [l, u] will be such that l > u
+// coordinates [l, u] will be such that l > u.
+// The interval caches attached to both indices, if any, are used for the last k symbols
 BWTIntervalPair BWTAlgorithms::findIntervalPair(const BWT* pBWT, const BWT* pRevBWT, const std::string& w)
+{
+    const BWTIntervalCache* pFwdCache = pBWT->getIntervalCache();
+    const BWTIntervalCache* pRevCache = pRevBWT->getIntervalCache();
+    if(pFwdCache != nullptr && pRevCache != nullptr && pFwdCache->getCachedLength() == pRevCache->getCachedLength())
+        return findIntervalPairWithCache(pBWT, pRevBWT, pFwdCache, pRevCache, w);
+    return findIntervalPairDirect(pBWT, pRevBWT, w);
+}
+
+// Find the intervals in pBWT/pRevBWT corresponding to w by a full backward search
+BWTIntervalPair BWTAlgorithms::findIntervalPairDirect(const BWT* pBWT, const BWT* pRevBWT, const std::string& w)
 {
     BWTIntervalPair intervals;
     int len = w.size();
@@ -105,20 +140,27 @@ BWTIntervalPair BWTAlgorithms::findIntervalPairWithCache(const BWT* pBWT,
                                                          const BWTIntervalCache* pRevCache,
                                                          const std::string& w)
 {
-    size_t cacheLen = pFwdCache->getCachedLength();
-    if(w.size() < cacheLen)
-        return findIntervalPair(pBWT, pRevBWT, w);
-
     // Compute the fwd and reverse interval using the cache for the last k bases
     BWTIntervalPair ip;
     int len = w.size();
+    size_t cacheLen = std::min(w.size(), pFwdCache->getCachedLength());
     int j = len - cacheLen;
 
     std::string ss = w.substr(j);
     std::string r_ss = reverse(ss);
     assert(ss.size() == cacheLen);
-    ip.interval[0] = pFwdCache->lookup(ss.c_str());
-    ip.interval[1] = pRevCache->lookup(r_ss.c_str());
+
+    // An empty pair is searched directly as the direct search
+    // stops at the first symbol where either interval is empty
+    if(cacheLen == 0 || !pFwdCache->lookup(ss.c_str(), cacheLen, ip.interval[0]) ||
+       !pRevCache->lookup(r_ss.c_str(), cacheLen, ip.interval[1]) || !ip.isValid())
+    {
+        pFwdCache->recordLookup(false);
+        pRevCache->recordLookup(false);
+        return findIntervalPairDirect(pBWT, pRevBWT, w);
+    }
+    pFwdCache->recordLookup(true);
+    pRevCache->recordLookup(true);
 
     // Extend the interval to the full length of w as normal
     j -= 1;
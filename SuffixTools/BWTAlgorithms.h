@@ -39,12 +39,15 @@ namespace BWTAlgorithms
 {
 
 // get the interval(s) in pBWT/pRevBWT that corresponds to the string w using a backward search algorithm
+// findInterval and findIntervalPair start from the interval caches attached to the indices, if any
 BWTInterval findInterval(const BWT* pBWT, const std::string& w, int* count = nullptr);
+BWTInterval findIntervalDirect(const BWT* pBWT, const std::string& w, int* count = nullptr);
 BiBWTInterval findBiInterval(const BWTIndexSet& indices, const std::string& w, int* count = nullptr);
-BWTInterval findIntervalWithCache(const BWT* pBWT, const BWTIntervalCache* pIntervalCache, const std::string& w);
+BWTInterval findIntervalWithCache(const BWT* pBWT, const BWTIntervalCache* pIntervalCache, const std::string& w, int* count = nullptr);
 BWTInterval findInterval(const BWTIndexSet& indices, const std::string& w);
 
 BWTIntervalPair findIntervalPair(const BWT* pBWT, const BWT* pRevBWT, const std::string& w);
+BWTIntervalPair findIntervalPairDirect(const BWT* pBWT, const BWT* pRevBWT, const std::string& w);
 BWTIntervalPair findIntervalPairWithCache(const BWT* pBWT, 
                                           const BWT* pRevBWT, 
                                           const BWTIntervalCache* pFwdCache, 
@@ -152,6 +155,17 @@ inline AlphaCount64 getExtCount(const BWTInterval& interval, const BWT* pBWT)
     return pBWT->getOccDiff(interval.lower - 1, interval.upper);
 }
 
+// Prefetch the markers the full occurrence counts at both ends of interval read.
+// Prefetching the intervals of a batch first lets their cache misses overlap.
+inline void prefetchInterval(const BWTInterval& interval, const BWT* pBWT)
+{
+    if(!interval.isValid())
+        return;
+    if(interval.lower > 0)
+        pBWT->prefetchMarkers(interval.lower - 1);
+    pBWT->prefetchMarkers(interval.upper);
+}
+
 // Return the count of all the possible one base extensions of the string w.
 // This returns the number of times the suffix w[i, l]A, w[i, l]C, etc 
 // appears in the FM-index for all i s.t. length(w[i, l]) >= minOverlap.
@@ -93,6 +93,44 @@ static unsigned char seq_nt6_table[128] = {
     5, 5, 5, 5, 4, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5
 };
 
+// Peak resident set size of this process in GB, used for reporting index construction memory
+static double peakrss()
+{
+	struct rusage r;
+	getrusage(RUSAGE_SELF, &r);
+#ifdef __linux__
+	return r.ru_maxrss / 1024.0 / 1024.0;
+#else
+	return r.ru_maxrss / 1024.0 / 1024.0 / 1024.0;
+#endif
+}
+
+// Write the runs of a multi-rope into a binary BWT file, the visited buckets are released while iterating
+static void writeRopeBWT(mrope_t* mr, const std::string& bwt_out_name, int64_t num_sequences, int64_t num_symbols)
+{
+    BWTWriterBinary* out_bwt = new BWTWriterBinary(bwt_out_name);
+    out_bwt->writeHeader(num_sequences, num_symbols, BWF_NOFMI);
+
+	mritr_t itr;
+	const uint8_t *block;
+
+	mr_itr_first(mr, &itr, 1);
+	while ((block = mr_itr_next_block(&itr)) != 0) {
+		const uint8_t *q = block + 2, *end = block + 2 + *rle_nptr(block);
+		while (q < end) {
+			int c = 0;
+			int64_t j, l;
+			rle_dec1(q, c, l);
+			for (j = 0; j < l; ++j) 
+				//putchar("$ACGTN"[c]);
+				out_bwt->writeBWChar("$ACGTN"[c]);
+		}		
+	}
+	
+    out_bwt->finalize();
+    delete out_bwt;
+}
+
 void BWTCA::runRopebwt(const std::string& input_filename, const std::string& bwt_out_name,
                        bool use_threads, bool do_reverse)
 {
@@ -223,26 +261,96 @@ void BWTCA::runRopebwt2(const std::string& input_filename, const std::string& bw
 	gzclose(fp);
 	
 	/*** output BWT char to BWTWriter ***/
-    BWTWriterBinary* out_bwt = new BWTWriterBinary(bwt_out_name);
-    out_bwt->writeHeader(num_sequences, num_symbols, BWF_NOFMI);
+	writeRopeBWT(mr, bwt_out_name, num_sequences, num_symbols);
+}
 
-	mritr_t itr;
-	const uint8_t *block;
 
-	mr_itr_first(mr, &itr, 1);
-	while ((block = mr_itr_next_block(&itr)) != 0) {
-		const uint8_t *q = block + 2, *end = block + 2 + *rle_nptr(block);
-		while (q < end) {
-			int c = 0;
-			int64_t j, l;
-			rle_dec1(q, c, l);
-			for (j = 0; j < l; ++j) 
-				//putchar("$ACGTN"[c]);
-				out_bwt->writeBWChar("$ACGTN"[c]);
-		}		
+// Build BWT and RBWT in a single pass over the input. Each read is parsed and encoded once,
+// then appended to two batch buffers: the forward BWT needs the reversed string (see mr_insert1)
+// while the reverse BWT takes the read as it is. The two buffers split the batch size of a single
+// ropebwt2 run so the memory bound of the batch stays the same as building one BWT.
+// Each threaded mr_insert_multi uses 5 threads (4 workers + master), thus both ropes are inserted
+// concurrently only if numThreads can hold both of them.
+void BWTCA::runRopebwt2Joint(const std::string& input_filename, const std::string& bwt_out_name,
+                       const std::string& rbwt_out_name, int numThreads)
+{
+	const int ropeThreads = 5;
+	mrope_t *mr[2];
+	gzFile fp;
+	kseq_t *ks;
+	int64_t m = (int64_t)(.97 * 5 * 1024 * 1024 * 1024) + 1;
+	int i, block_len = ROPE_DEF_BLOCK_LEN, max_nodes = ROPE_DEF_MAX_NODES, so = MR_SO_IO;
+	kstring_t buf[2] = { { 0, 0, 0 }, { 0, 0, 0 } };
+	double ct, rt;
+
+	// Thread budget: concurrent threaded inserts need 2x5 threads,
+	// sequential threaded inserts need 5, concurrent plain inserts need 2
+	bool bConcurrent = numThreads >= 2*ropeThreads || (numThreads >= 2 && numThreads < ropeThreads);
+	bool bThreaded = numThreads >= ropeThreads;
+	fprintf(stderr, "[%s] building BWT and RBWT in a single pass with %d threads (%s, %s rope insertion)\n", __func__,
+			numThreads, bConcurrent ? "concurrent" : "sequential", bThreaded ? "multi-threaded" : "single-threaded");
+
+	liftrlimit();
+	for (i = 0; i < 2; ++i) {
+		mr[i] = mr_init(max_nodes, block_len, so);
+		if (numThreads > 0) mr_thr_min(mr[i], numThreads);
 	}
-	
-    out_bwt->finalize();
-    delete out_bwt;
-}
+	fp = gzopen( input_filename.c_str(), "rb");
+	ks = kseq_init(fp);
+	ct = cputime(); rt = realtime();
+
+	for (;;) {
+		bool eof = kseq_read(ks) < 0; // read fasta/fastq
+		if (!eof) {
+			int l = ks->seq.l;
+			uint8_t *s = (uint8_t*)ks->seq.s;
+
+			// change encoding according to seq_nt6_table
+			for (i = 0; i < l; ++i) 
+				s[i] = s[i] < 128? seq_nt6_table[s[i]] : 5;
+
+			// RBWT takes the read as it is
+			kputsn((char*)s, l + 1, &buf[1]);
+
+			// BWT takes the reversed read
+			for (i = 0; i < l>>1; ++i) {
+				int tmp = s[l-1-i];
+				s[l-1-i] = s[i]; s[i] = tmp;
+			}
+			kputsn((char*)s, l + 1, &buf[0]);
+		}
+
+		//sort if buffer is full or no more reads
+		if ((int64_t) buf[0].l >= m || (eof && buf[0].l)) {
+			#pragma omp parallel for num_threads(2) if(bConcurrent)
+			for (int r = 0; r < 2; ++r)
+				mr_insert_multi(mr[r], buf[r].l, (uint8_t*)buf[r].s, bThreaded);
+			buf[0].l = buf[1].l = 0;
+		}
 
+		if (eof) break;
+	}
+
+	fprintf(stderr, "[%s] constructed FM-index in %.3f sec, %.3f CPU sec, peak memory %.3f GB\n", __func__,
+			realtime() - rt, cputime() - ct, peakrss());
+
+	free(buf[0].s);
+	free(buf[1].s);
+	kseq_destroy(ks);
+	gzclose(fp);
+
+	/*** output BWT char to BWTWriter ***/
+	const std::string* out_names[2] = { &bwt_out_name, &rbwt_out_name };
+	for (int r = 0; r < 2; ++r) {
+		int64_t c[6];
+		mr_get_c(mr[r], c);
+		fprintf(stderr, "[%s] %s symbol counts: ($, A, C, G, T, N) = (%ld, %ld, %ld, %ld, %ld, %ld)\n", __func__,
+				r == 0 ? "BWT" : "RBWT", (long)c[0], (long)c[1], (long)c[2], (long)c[3], (long)c[4], (long)c[5]);
+
+		int64_t num_sequences = (long)c[0];
+		int64_t num_symbols = (long)c[0]+(long)c[1]+(long)c[2]+(long)c[3]+(long)c[4]+(long)c[5];
+		writeRopeBWT(mr[r], *out_names[r], num_sequences, num_symbols);
+		mr_destroy(mr[r]);
+	}
+	fprintf(stderr, "[%s] done writing BWT and RBWT, peak memory %.3f GB\n", __func__, peakrss());
+}
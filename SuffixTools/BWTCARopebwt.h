@@ -19,6 +19,10 @@ namespace BWTCA
 
 	void runRopebwt2(const std::string& input_filename, const std::string& bwt_out_name,
                     int thr_min, bool do_reverse);
+
+	// Build both the BWT and the RBWT while reading the input only once
+	void runRopebwt2Joint(const std::string& input_filename, const std::string& bwt_out_name,
+                    const std::string& rbwt_out_name, int numThreads);
 
 };
 
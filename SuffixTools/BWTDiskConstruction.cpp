@@ -0,0 +1,523 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// BWTDiskConstruction - Build the BWT of a read set that
+// does not fit in memory by merging the BWTs of batches
+//
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <algorithm>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include "BWTDiskConstruction.h"
+#include "SuffixArray.h"
+#include "ReadTable.h"
+#include "SeqReader.h"
+#include "BWT.h"
+#include "BWTReader.h"
+#include "BWTWriter.h"
+#include "GapArray.h"
+#include "RankProcess.h"
+#include "SequenceProcessFramework.h"
+#include "Timer.h"
+
+// Memory estimates used to size the batches and the merges.
+// SA-IS holds the read table, about one byte per base plus the
+// per-read overhead, and an 8 byte suffix array entry per symbol
+static const size_t SAIS_BYTES_PER_SYMBOL = 10;
+static const size_t SAIS_BYTES_PER_READ = 128;
+
+// A merge holds the run-length encoded BWT receiving the reads,
+// at most one byte per symbol plus the markers, and its gap array
+static const double MERGE_BWT_BYTES_PER_SYMBOL = 2.0;
+
+static const char* CHECKPOINT_VERSION = "bwtdisk-2";
+
+// A BWT covering the reads [firstRead, firstRead + numReads) of the input
+struct BWTPiece
+{
+    BWTPiece(size_t first, size_t count, size_t symbols) : firstRead(first), numReads(count), numSymbols(symbols) {}
+
+    size_t firstRead;
+    size_t numReads;
+    size_t numSymbols;
+};
+typedef std::vector<BWTPiece> BWTPieceVector;
+
+// Insert the reads of piece inserted into the BWT of piece internal.
+// The inserted reads must precede the internal reads in the input
+// so that the merged BWT keeps the reads in input order.
+struct MergeStep
+{
+    MergeStep(size_t ins, size_t in, size_t out) : inserted(ins), internal(in), output(out) {}
+
+    size_t inserted;
+    size_t internal;
+    size_t output;
+};
+typedef std::vector<MergeStep> MergeStepVector;
+
+// The checkpoint is a text file with one line per completed step.
+// The first line records the parameters that decide the batches
+// and the merge plan, a checkpoint written with other parameters
+// is discarded.
+class DiskCheckpoint
+{
+    public:
+        DiskCheckpoint(const std::string& filename, const std::string& signature) : m_filename(filename), m_inputDone(false)
+        {
+            std::ifstream in(filename.c_str());
+            std::string line;
+            if(in.good() && getline(in, line) && line == signature)
+            {
+                while(getline(in, line))
+                {
+                    std::istringstream parser(line);
+                    std::string type;
+                    parser >> type;
+                    if(type == "batch")
+                    {
+                        size_t first, count, symbols;
+                        parser >> first >> count >> symbols;
+                        m_batches.push_back(BWTPiece(first, count, symbols));
+                    }
+                    else if(type == "input-done")
+                    {
+                        m_inputDone = true;
+                    }
+                    else if(type == "step")
+                    {
+                        std::string step;
+                        parser >> step;
+                        m_steps.insert(step);
+                    }
+                }
+
+                if(!m_batches.empty())
+                    std::cout << "[disk] resuming from checkpoint " << filename << " with " << m_batches.size() << " batches\n";
+                in.close();
+
+                m_pWriter = new std::ofstream(filename.c_str(), std::ios::app);
+            }
+            else
+            {
+                in.close();
+                m_pWriter = new std::ofstream(filename.c_str(), std::ios::trunc);
+                *m_pWriter << signature << std::endl;
+            }
+            assertFileOpen(*m_pWriter, filename);
+        }
+
+        ~DiskCheckpoint()
+        {
+            delete m_pWriter;
+        }
+
+        const BWTPieceVector& getBatches() const { return m_batches; }
+        bool isInputDone() const { return m_inputDone; }
+        bool isStepDone(const std::string& step) const { return m_steps.count(step) > 0; }
+
+        // Each record is flushed so that it survives the process being killed
+        void addBatch(const BWTPiece& batch)
+        {
+            m_batches.push_back(batch);
+            *m_pWriter << "batch " << batch.firstRead << " " << batch.numReads << " " << batch.numSymbols << std::endl;
+        }
+
+        void setInputDone()
+        {
+            m_inputDone = true;
+            *m_pWriter << "input-done" << std::endl;
+        }
+
+        void setStepDone(const std::string& step)
+        {
+            m_steps.insert(step);
+            *m_pWriter << "step " << step << std::endl;
+        }
+
+        // The build is complete
+        void remove()
+        {
+            delete m_pWriter;
+            m_pWriter = NULL;
+            unlink(m_filename.c_str());
+        }
+
+    private:
+        std::string m_filename;
+        std::ofstream* m_pWriter;
+        BWTPieceVector m_batches;
+        bool m_inputDone;
+        std::set<std::string> m_steps;
+};
+
+//
+static std::string getPieceFilename(const std::string& prefix, size_t id, const std::string& extension)
+{
+    std::stringstream ss;
+    ss << prefix << ".part" << id << extension;
+    return ss.str();
+}
+
+//
+static std::string getStepName(size_t id, const std::string& extension)
+{
+    std::stringstream ss;
+    ss << "part" << id << extension;
+    return ss.str();
+}
+
+//
+static bool fileExists(const std::string& filename)
+{
+    struct stat st;
+    return stat(filename.c_str(), &st) == 0;
+}
+
+// Files are written under a temporary name and renamed once complete,
+// so a file with the final name is never truncated
+static void renameFile(const std::string& from, const std::string& to)
+{
+    if(rename(from.c_str(), to.c_str()) != 0)
+    {
+        std::cerr << "Error: could not rename " << from << " to " << to << "\n";
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Peak resident set size of this process in MB
+static double getPeakMemoryMB()
+{
+    struct rusage r;
+    getrusage(RUSAGE_SELF, &r);
+#ifdef __linux__
+    return r.ru_maxrss / 1024.0;
+#else
+    return r.ru_maxrss / 1024.0 / 1024.0;
+#endif
+}
+
+//
+static void skipReads(SeqReader& reader, size_t n)
+{
+    SeqRecord record;
+    for(size_t i = 0; i < n; ++i)
+    {
+        if(!reader.get(record))
+        {
+            std::cerr << "Error: the reads file has fewer reads than recorded in the checkpoint\n";
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+// Build and write the BWTs of a single batch. The read table is
+// reversed in place for the reverse BWT and deleted afterwards.
+static void buildBatch(ReadTable* pRT, size_t id, const DiskBWTParameters& params, int numThreads)
+{
+    if(params.buildForward)
+    {
+        std::string filename = getPieceFilename(params.outPrefix, id, ".bwt");
+        SuffixArray* pSA = new SuffixArray(pRT, numThreads, true);
+        pSA->writeBWT(filename + ".tmp", pRT);
+        delete pSA;
+        renameFile(filename + ".tmp", filename);
+    }
+
+    if(params.buildReverse)
+    {
+        std::string filename = getPieceFilename(params.outPrefix, id, ".rbwt");
+        pRT->reverseAll();
+        SuffixArray* pSA = new SuffixArray(pRT, numThreads, true);
+        pSA->writeBWT(filename + ".tmp", pRT);
+        delete pSA;
+        renameFile(filename + ".tmp", filename);
+    }
+    delete pRT;
+}
+
+// Split the reads into batches and build their BWTs, numConcurrent batches at a time
+static void buildBatches(const DiskBWTParameters& params, DiskCheckpoint& checkpoint, size_t maxBatchBytes, int numConcurrent)
+{
+    size_t nextRead = 0;
+    for(size_t i = 0; i < checkpoint.getBatches().size(); ++i)
+        nextRead += checkpoint.getBatches()[i].numReads;
+
+    SeqReader reader(params.readsFile);
+    skipReads(reader, nextRead);
+
+    // A read that did not fit in the previous batch starts the next one
+    SeqRecord record;
+    bool hasPending = false;
+    bool eof = false;
+    while(!eof)
+    {
+        std::vector<ReadTable*> tables;
+        BWTPieceVector batches;
+        while((int)tables.size() < numConcurrent && !eof)
+        {
+            ReadTable* pRT = new ReadTable;
+            size_t numSymbols = 0;
+            while(pRT->getCount() < params.maxReadsPerBatch)
+            {
+                if(!hasPending && !reader.get(record))
+                {
+                    eof = true;
+                    break;
+                }
+                hasPending = false;
+
+                size_t readSymbols = record.seq.length() + 1;
+                size_t bytes = (numSymbols + readSymbols) * SAIS_BYTES_PER_SYMBOL + (pRT->getCount() + 1) * SAIS_BYTES_PER_READ;
+                if(pRT->getCount() > 0 && maxBatchBytes > 0 && bytes > maxBatchBytes)
+                {
+                    hasPending = true;
+                    break;
+                }
+
+                if(pRT->getCount() == 0 && maxBatchBytes > 0 && bytes > maxBatchBytes)
+                    std::cerr << "Warning: read " << record.id << " alone exceeds the memory of a batch\n";
+
+                pRT->addRead(record.toSeqItem());
+                numSymbols += readSymbols;
+            }
+
+            if(pRT->getCount() == 0)
+            {
+                delete pRT;
+                break;
+            }
+
+            batches.push_back(BWTPiece(nextRead, pRT->getCount(), numSymbols));
+            tables.push_back(pRT);
+            nextRead += pRT->getCount();
+        }
+
+        if(tables.empty())
+            break;
+
+        // The SA-IS construction of a batch is single-threaded apart from the
+        // initial sort, so the threads are spread over the concurrent batches
+        size_t firstID = checkpoint.getBatches().size();
+        int numBatchThreads = std::max(1, params.numThreads / (int)tables.size());
+
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(tables.size())
+        for(size_t i = 0; i < tables.size(); ++i)
+            buildBatch(tables[i], firstID + i, params, numBatchThreads);
+
+        for(size_t i = 0; i < batches.size(); ++i)
+        {
+            std::cout << "[disk] batch " << firstID + i << ": " << batches[i].numReads << " reads, "
+                      << batches[i].numSymbols << " symbols\n";
+            checkpoint.addBatch(batches[i]);
+        }
+    }
+    checkpoint.setInputDone();
+}
+
+// Plan the merges of the batches as a balanced binary tree like SGA: every
+// round merges the adjacent pieces pairwise and carries an odd piece at the
+// end over to the next round. Each read is inserted once per level, so for
+// b batches the merges insert the reads log2(b) times rather than up to b
+// times when the batches are folded one at a time.
+static MergeStepVector planMerges(BWTPieceVector& pieces)
+{
+    MergeStepVector steps;
+    std::vector<size_t> level;
+    for(size_t i = 0; i < pieces.size(); ++i)
+        level.push_back(i);
+
+    while(level.size() > 1)
+    {
+        std::vector<size_t> next;
+        for(size_t i = 0; i + 1 < level.size(); i += 2)
+        {
+            const BWTPiece& left = pieces[level[i]];
+            const BWTPiece& right = pieces[level[i + 1]];
+            BWTPiece merged(left.firstRead, left.numReads + right.numReads, left.numSymbols + right.numSymbols);
+            steps.push_back(MergeStep(level[i], level[i + 1], pieces.size()));
+            pieces.push_back(merged);
+            next.push_back(pieces.size() - 1);
+        }
+
+        if(level.size() % 2 == 1)
+            next.push_back(level.back());
+        level.swap(next);
+    }
+    return steps;
+}
+
+// Merge two BWTs. The ranks of every suffix of the inserted reads in the
+// internal BWT are counted in a gap array, then the merged BWT is written
+// by streaming both BWTs from disk: the symbols of the inserted BWT that
+// sort before the suffix at position i of the internal BWT are written
+// before its symbol.
+static void mergePieces(const DiskBWTParameters& params,
+                        const BWTPiece& inserted,
+                        const std::string& insertedFilename,
+                        const std::string& internalFilename,
+                        const std::string& outFilename,
+                        bool doReverse)
+{
+    BWT* pBWTInternal = new BWT(internalFilename);
+    GapArray* pGapArray = createGapArray(params.gapArrayStorage);
+    pGapArray->resize(pBWTInternal->getBWLen() + 1);
+
+    SeqReader reader(params.readsFile);
+    skipReads(reader, inserted.firstRead);
+    WorkItemGenerator<SequenceWorkItem> generator(&reader);
+    RankPostProcess postProcessor(pGapArray);
+
+    std::vector<RankProcess*> processorVector;
+    for(int i = 0; i < params.numThreads; ++i)
+        processorVector.push_back(new RankProcess(pBWTInternal, pGapArray, doReverse, false));
+
+    if(params.numThreads <= 1)
+    {
+        SequenceProcessFramework::processWorkSerial<SequenceWorkItem, RankResult, WorkItemGenerator<SequenceWorkItem>,
+                                                    RankProcess, RankPostProcess>(generator, processorVector[0], &postProcessor, inserted.numReads);
+    }
+    else
+    {
+        SequenceProcessFramework::processWorkParallelPthread<SequenceWorkItem, RankResult, WorkItemGenerator<SequenceWorkItem>,
+                                                             RankProcess, RankPostProcess>(generator, processorVector, &postProcessor, inserted.numReads);
+    }
+
+    for(size_t i = 0; i < processorVector.size(); ++i)
+        delete processorVector[i];
+    delete pBWTInternal;
+
+    if(postProcessor.getNumSymbolsProcessed() != inserted.numSymbols)
+    {
+        std::cerr << "Error: the reads inserted from " << params.readsFile << " do not match " << insertedFilename << "\n";
+        exit(EXIT_FAILURE);
+    }
+
+    IBWTReader* pInsertedReader = BWTReader::createReader(insertedFilename);
+    IBWTReader* pInternalReader = BWTReader::createReader(internalFilename);
+    size_t insertedStrings, insertedSymbols, internalStrings, internalSymbols;
+    BWFlag flag;
+    pInsertedReader->readHeader(insertedStrings, insertedSymbols, flag);
+    pInternalReader->readHeader(internalStrings, internalSymbols, flag);
+    assert(pGapArray->size() == internalSymbols + 1);
+
+    IBWTWriter* pWriter = BWTWriter::createWriter(outFilename);
+    pWriter->writeHeader(insertedStrings + internalStrings, insertedSymbols + internalSymbols, BWF_NOFMI);
+
+    size_t numInsertedWritten = 0;
+    for(size_t i = 0; i <= internalSymbols; ++i)
+    {
+        size_t gap = pGapArray->get(i);
+        for(size_t j = 0; j < gap; ++j)
+            pWriter->writeBWChar(pInsertedReader->readBWChar());
+        numInsertedWritten += gap;
+
+        if(i < internalSymbols)
+            pWriter->writeBWChar(pInternalReader->readBWChar());
+    }
+    assert(numInsertedWritten == insertedSymbols);
+    (void)numInsertedWritten;
+
+    pWriter->finalize();
+    delete pWriter;
+    delete pInsertedReader;
+    delete pInternalReader;
+    delete pGapArray;
+}
+
+// Execute the merge plan for the BWTs with the given extension
+static void mergeBatches(const DiskBWTParameters& params,
+                         DiskCheckpoint& checkpoint,
+                         const BWTPieceVector& pieces,
+                         const MergeStepVector& steps,
+                         const std::string& extension,
+                         bool doReverse)
+{
+    for(size_t i = 0; i < steps.size(); ++i)
+    {
+        const MergeStep& step = steps[i];
+        std::string stepName = getStepName(step.output, extension);
+        if(checkpoint.isStepDone(stepName))
+            continue;
+
+        std::string insertedFilename = getPieceFilename(params.outPrefix, step.inserted, extension);
+        std::string internalFilename = getPieceFilename(params.outPrefix, step.internal, extension);
+        std::string outFilename = getPieceFilename(params.outPrefix, step.output, extension);
+
+        Timer timer("merge", true);
+        mergePieces(params, pieces[step.inserted], insertedFilename, internalFilename, outFilename + ".tmp", doReverse);
+        renameFile(outFilename + ".tmp", outFilename);
+        checkpoint.setStepDone(stepName);
+
+        unlink(insertedFilename.c_str());
+        unlink(internalFilename.c_str());
+        printf("[disk] merged %s (%zu reads) into %s in %.2lfs, peak memory %.1lf MB\n",
+               insertedFilename.c_str(), pieces[step.inserted].numReads, internalFilename.c_str(),
+               timer.getElapsedWallTime(), getPeakMemoryMB());
+    }
+
+    // The last piece holds all the reads
+    std::string finalPiece = getPieceFilename(params.outPrefix, pieces.size() - 1, extension);
+    std::string outFilename = params.outPrefix + extension;
+    if(fileExists(finalPiece) || !fileExists(outFilename))
+        renameFile(finalPiece, outFilename);
+}
+
+//
+void buildBWTDisk(const DiskBWTParameters& params)
+{
+    Timer timer("buildBWTDisk", true);
+
+    // The merges run one at a time, so with a memory bound every batch gets the
+    // whole of it and is built with all the threads, which keeps the number of
+    // batches and merges down. Without a bound the batches are built in parallel.
+    int numConcurrent = params.maxMemory > 0 ? 1 : params.numThreads;
+    size_t maxBatchBytes = params.maxMemory;
+
+    std::stringstream signature;
+    signature << CHECKPOINT_VERSION << " " << params.readsFile << " " << getFilesize(params.readsFile) << " "
+              << params.maxMemory << " " << params.maxReadsPerBatch << " " << params.gapArrayStorage << " "
+              << params.buildForward << " " << params.buildReverse;
+    std::string checkpointFilename = params.outPrefix + ".ckpt";
+    DiskCheckpoint checkpoint(checkpointFilename, signature.str());
+
+    if(!checkpoint.isInputDone())
+        buildBatches(params, checkpoint, maxBatchBytes, numConcurrent);
+    printf("[disk] built %zu batches in %.2lfs, peak memory %.1lf MB\n",
+           checkpoint.getBatches().size(), timer.getElapsedWallTime(), getPeakMemoryMB());
+
+    if(checkpoint.getBatches().empty())
+    {
+        std::cerr << "Error: no reads found in " << params.readsFile << "\n";
+        exit(EXIT_FAILURE);
+    }
+
+    BWTPieceVector pieces = checkpoint.getBatches();
+    MergeStepVector steps = planMerges(pieces);
+
+    // The merges near the root receive the reads of half the read set
+    size_t maxInternalSymbols = 0;
+    for(size_t i = 0; i < steps.size(); ++i)
+        maxInternalSymbols = std::max(maxInternalSymbols, pieces[steps[i].internal].numSymbols);
+    size_t maxMergeBytes = maxInternalSymbols * (MERGE_BWT_BYTES_PER_SYMBOL + params.gapArrayStorage / 8.0);
+    if(params.maxMemory > 0 && maxMergeBytes > params.maxMemory)
+    {
+        std::cerr << "Warning: the largest merge holds a BWT of " << maxInternalSymbols << " symbols, about "
+                  << maxMergeBytes / (1024 * 1024) << " MB, more than the memory bound\n";
+    }
+
+    if(params.buildForward)
+        mergeBatches(params, checkpoint, pieces, steps, ".bwt", false);
+    if(params.buildReverse)
+        mergeBatches(params, checkpoint, pieces, steps, ".rbwt", true);
+
+    checkpoint.remove();
+    printf("[disk] done building the BWT of %zu reads in %zu merges, %.2lfs, peak memory %.1lf MB\n",
+           pieces.back().numReads, steps.size(), timer.getElapsedWallTime(), getPeakMemoryMB());
+}
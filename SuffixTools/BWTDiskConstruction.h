@@ -0,0 +1,49 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// BWTDiskConstruction - Build the BWT of a read set that
+// does not fit in memory. The reads are split into batches
+// that are indexed with SA-IS, then the batch BWTs are merged
+// pairwise in a balanced tree by inserting the reads of one
+// BWT into the other, guided by a gap array. Only the BWT
+// receiving the reads is held in memory during a merge, in
+// run-length encoded form, so the last merges hold the BWT
+// of about half the read set.
+//
+// Every finished batch and merge is recorded in a checkpoint
+// file next to the output, a run that is interrupted resumes
+// from the last completed step when it is started again.
+//
+#ifndef BWTDISKCONSTRUCTION_H
+#define BWTDISKCONSTRUCTION_H
+
+#include <string>
+
+struct DiskBWTParameters
+{
+    std::string readsFile;
+    std::string outPrefix;
+    bool buildForward;
+    bool buildReverse;
+
+    // Upper bound on the memory used by a batch in bytes, 0 for no bound.
+    // The batches are then built one at a time. A merge that needs more
+    // than the bound is reported, see BWTDiskConstruction.cpp
+    size_t maxMemory;
+
+    // Upper bound on the number of reads in a batch
+    size_t maxReadsPerBatch;
+
+    int numThreads;
+
+    // Bits per entry of the gap array, see createGapArray
+    int gapArrayStorage;
+};
+
+// Write outPrefix.bwt and/or outPrefix.rbwt for the reads in params.readsFile.
+// The result is identical to the BWT built from the whole read table by SA-IS.
+void buildBWTDisk(const DiskBWTParameters& params);
+
+#endif
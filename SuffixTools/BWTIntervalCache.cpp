@@ -7,42 +7,220 @@
 // BWTIntervalCache - Array of cached bwt intervals for all
 // substrings of a fixed length
 //
+#include <fstream>
+#include <sstream>
+#include <mutex>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "BWTIntervalCache.h"
 #include "BWTAlgorithms.h"
 
-BWTIntervalCache::BWTIntervalCache(size_t k, const BWT* pBWT) : m_kmer(k)
+static const uint32_t BIC_MAGIC_NUMBER = 0x31434942;
+static const uint32_t BIC_VERSION = 1;
+
+// The header records the bwt the table was built from
+// so a table for another index is never mapped by mistake
+struct BICHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t kmer;
+    uint64_t num_symbols;
+    uint64_t num_strings;
+};
+
+std::atomic<size_t> BWTIntervalCache::s_nextCounterId(0);
+
+// Guards the list of the thread counters
+static std::mutex& getThreadCountersMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+// The counters of every thread that searched a cache, they are never freed
+std::vector<BWTIntervalCache::ThreadCounters*>& BWTIntervalCache::getThreadCountersList()
+{
+    static std::vector<ThreadCounters*> counters;
+    return counters;
+}
+
+BWTIntervalCache::BWTIntervalCache(size_t k) : m_kmer(k), m_pTable(NULL), m_pMappedFile(NULL),
+                                               m_counterId(s_nextCounterId.fetch_add(1))
+{
+}
+
+BWTIntervalCache::BWTIntervalCache(size_t k, const BWT* pBWT, int numThreads) : m_kmer(k), m_pMappedFile(NULL),
+                                                                               m_counterId(s_nextCounterId.fetch_add(1))
+{
+    build(pBWT, numThreads);
+}
+
+//
+BWTIntervalCache::~BWTIntervalCache()
+{
+    delete m_pMappedFile;
+}
+
+//
+std::string BWTIntervalCache::getCacheFilename(const std::string& bwtFilename, size_t k)
+{
+    std::stringstream ss;
+    ss << bwtFilename << ".k" << k << ".bic";
+    return ss.str();
+}
+
+//
+BWTIntervalCache* BWTIntervalCache::load(size_t k, const BWT* pBWT, const std::string& bwtFilename, int numThreads)
 {
-    build(pBWT);
+    std::string cacheFilename = getCacheFilename(bwtFilename, k);
+    BWTIntervalCache* pCache = new BWTIntervalCache(k);
+
+    // Only map the table if it was written after the bwt
+    struct stat bwtStat, cacheStat;
+    if(stat(cacheFilename.c_str(), &cacheStat) == 0 && stat(bwtFilename.c_str(), &bwtStat) == 0 &&
+       cacheStat.st_mtime >= bwtStat.st_mtime && pCache->map(cacheFilename, pBWT))
+        return pCache;
+
+    pCache->build(pBWT, numThreads);
+    pCache->write(cacheFilename, pBWT);
+    return pCache;
 }
 
-// Build the table for the given bwt
-void BWTIntervalCache::build(const BWT* pBWT)
+//
+BWTIntervalCache* BWTIntervalCache::attach(size_t k, BWT* pBWT, const std::string& bwtFilename, int numThreads)
+{
+    BWTIntervalCache* pCache = load(k, pBWT, bwtFilename, numThreads);
+    pBWT->setIntervalCache(pCache);
+    return pCache;
+}
+
+// Build the table for the given bwt. Rather than searching every string from
+// scratch the strings are enumerated from their last symbol, so each interval
+// is a single backward step from the interval of its suffix.
+void BWTIntervalCache::build(const BWT* pBWT, int numThreads)
 {
     // Restrict the kmer parameter to something reasonable
     // so we don't try to allocate an absurdly large array
-    assert(m_kmer <= 12);
+    assert(m_kmer >= 1 && m_kmer <= 13);
 
-    size_t num_entries = 1 << 2*m_kmer;
+    size_t num_entries = getLevelOffset(m_kmer + 1);
     m_table.resize(num_entries);
+    m_pTable = &m_table[0];
+
+    // The suffixes of length taskDepth are independent subtrees,
+    // the few shorter strings are searched directly
+    size_t taskDepth = std::min(m_kmer, (size_t)3);
+    for(size_t len = 1; len < taskDepth; ++len)
+    {
+        for(size_t i = 0; i < ((size_t)1 << 2*len); ++i)
+            m_table[getLevelOffset(len) + i] = BWTAlgorithms::findIntervalDirect(pBWT, int2string(i, len));
+    }
+
+    int num_tasks = 1 << 2*taskDepth;
+
+    #pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+    for(int task = 0; task < num_tasks; ++task)
+    {
+        // Follow the same steps as BWTAlgorithms::findInterval, which stops
+        // extending once the interval is empty
+        BWTInterval interval;
+        for(size_t depth = 0; depth < taskDepth; ++depth)
+        {
+            if(depth >= 2 && !interval.isValid())
+                break;
+
+            char b = DNA_ALPHABET::getBase((task >> 2*depth) & 3);
+            if(depth == 0)
+                BWTAlgorithms::initInterval(interval, b, pBWT);
+            else
+                BWTAlgorithms::updateInterval(interval, b, pBWT);
+        }
+        fill(pBWT, interval, taskDepth, task);
+    }
+}
+
+//
+void BWTIntervalCache::fill(const BWT* pBWT, BWTInterval interval, size_t depth, size_t suffixCode)
+{
+    m_table[getLevelOffset(depth) + suffixCode] = interval;
+    if(depth == m_kmer)
+        return;
+
+    // The search of every longer string with this suffix ends here
+    if(depth >= 2 && !interval.isValid())
+    {
+        for(size_t len = depth + 1; len <= m_kmer; ++len)
+        {
+            size_t num_prefixes = (size_t)1 << 2*(len - depth);
+            for(size_t prefix = 0; prefix < num_prefixes; ++prefix)
+                m_table[getLevelOffset(len) + ((prefix << 2*depth) | suffixCode)] = interval;
+        }
+        return;
+    }
+
+    for(size_t rank = 0; rank < DNA_ALPHABET::size; ++rank)
+    {
+        BWTInterval extended = interval;
+        BWTAlgorithms::updateInterval(extended, DNA_ALPHABET::getBase(rank), pBWT);
+        fill(pBWT, extended, depth + 1, suffixCode | (rank << 2*depth));
+    }
+}
+
+// Write the table, failures are not fatal as the table is already in memory
+void BWTIntervalCache::write(const std::string& filename, const BWT* pBWT) const
+{
+    std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+    if(!out.good())
+    {
+        std::cerr << "Warning: could not write the interval cache " << filename << "\n";
+        return;
+    }
+
+    BICHeader header;
+    header.magic = BIC_MAGIC_NUMBER;
+    header.version = BIC_VERSION;
+    header.kmer = m_kmer;
+    header.num_symbols = pBWT->getBWLen();
+    header.num_strings = pBWT->getNumStrings();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(m_pTable), getTableBytes());
+    out.close();
+
+    if(!out.good())
+    {
+        std::cerr << "Warning: could not write the interval cache " << filename << "\n";
+        unlink(filename.c_str());
+    }
+}
 
-    // Construct the table
-    for(size_t i = 0; i < num_entries; ++i)
+// Map a table written by write(), returns false if it does not belong to pBWT
+bool BWTIntervalCache::map(const std::string& filename, const BWT* pBWT)
+{
+    m_pMappedFile = new MappedFile(filename);
+    const BICHeader* pHeader = reinterpret_cast<const BICHeader*>(m_pMappedFile->data());
+    if(m_pMappedFile->size() != sizeof(BICHeader) + getTableBytes() ||
+       pHeader->magic != BIC_MAGIC_NUMBER || pHeader->version != BIC_VERSION ||
+       pHeader->kmer != m_kmer || pHeader->num_symbols != pBWT->getBWLen() ||
+       pHeader->num_strings != pBWT->getNumStrings())
     {
-        std::string w = int2string(i);
-        //printf("i: %zu w: %s o: %zu\n", i, w.c_str(), string2int(w));
-        BWTInterval interval = BWTAlgorithms::findInterval(pBWT, w);
-        m_table[i] = interval;
+        delete m_pMappedFile;
+        m_pMappedFile = NULL;
+        return false;
     }
+
+    m_pTable = reinterpret_cast<const BWTInterval*>(m_pMappedFile->data(sizeof(BICHeader)));
+    return true;
 }
 
 // Construct the corresponding string for integer i
-std::string BWTIntervalCache::int2string(size_t i) const
+std::string BWTIntervalCache::int2string(size_t i, size_t len) const
 {
-    std::string out(m_kmer, 'A');
-    for(size_t k = 0; k < m_kmer; ++k)
+    std::string out(len, 'A');
+    for(size_t k = 0; k < len; ++k)
     {
         // Get the character as position k (0 = left-most position)
-        size_t code = (i >> 2*(m_kmer - k - 1)) & 3;
+        size_t code = (i >> 2*(len - k - 1)) & 3;
         char b = DNA_ALPHABET::getBase(code);
         out[k] = b;
     }
@@ -54,3 +232,38 @@ size_t BWTIntervalCache::getCachedLength() const
 {
     return m_kmer;
 }
+
+//
+size_t BWTIntervalCache::getTableBytes() const
+{
+    return getLevelOffset(m_kmer + 1) * sizeof(BWTInterval);
+}
+
+//
+BWTIntervalCache::ThreadCounters* BWTIntervalCache::registerThreadCounters()
+{
+    ThreadCounters* pCounters = new ThreadCounters();
+    std::lock_guard<std::mutex> lock(getThreadCountersMutex());
+    getThreadCountersList().push_back(pCounters);
+    return pCounters;
+}
+
+//
+void BWTIntervalCache::printInfo(const std::string& name) const
+{
+    uint64_t lookups = 0, hits = 0;
+    if(m_counterId < MAX_COUNTED_CACHES)
+    {
+        std::lock_guard<std::mutex> lock(getThreadCountersMutex());
+        for(const ThreadCounters* pCounters : getThreadCountersList())
+        {
+            lookups += pCounters->lookups[m_counterId].load(std::memory_order_relaxed);
+            hits += pCounters->hits[m_counterId].load(std::memory_order_relaxed);
+        }
+    }
+
+    printf("%s interval cache: k = %zu, %.1f MB (%s), %zu searches, hit ratio %.4lf\n",
+           name.c_str(), m_kmer, (double)getTableBytes() / (1024 * 1024),
+           m_pMappedFile != NULL ? "mapped" : "in memory",
+           (size_t)lookups, lookups > 0 ? (double)hits / lookups : 0.0);
+}
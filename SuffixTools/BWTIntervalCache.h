@@ -5,37 +5,112 @@
 //-----------------------------------------------
 //
 // BWTIntervalCache - Array of cached bwt intervals for all
-// substrings of a fixed length
+// substrings of a fixed length. The intervals of all shorter
+// substrings are kept as well, so a search for a string of
+// at most k symbols is a single lookup.
 //
 #ifndef BWTINTERVAL_CACHE_H
 #define BWTINTERVAL_CACHE_H
 
+#include <atomic>
 #include "BWT.h"
 #include "BWTInterval.h"
+#include "MappedFile.h"
 
 class BWTIntervalCache
 {
     public:
 
-        //
-        BWTIntervalCache(size_t k, const BWT* pBWT);
-        
+        // Build the table of all k-mers in memory
+        BWTIntervalCache(size_t k, const BWT* pBWT, int numThreads = 1);
+        ~BWTIntervalCache();
+
+        // Map the table stored next to bwtFilename if it is up to date,
+        // otherwise build it and try to store it for the next run
+        static BWTIntervalCache* load(size_t k, const BWT* pBWT, const std::string& bwtFilename, int numThreads = 1);
+
+        // Load the table of pBWT and attach it so that every backward search on pBWT uses it
+        static BWTIntervalCache* attach(size_t k, BWT* pBWT, const std::string& bwtFilename, int numThreads = 1);
+
+        // Return the name of the file holding the k-mer table of bwtFilename
+        static std::string getCacheFilename(const std::string& bwtFilename, size_t k);
+
         // Look up the bwt interval for the given string
         inline BWTInterval lookup(const char* w) const
         {
             // Convert the string to an integer index in the lookup table
             size_t idx = str2int(w);
-            return m_table[idx];
+            return m_pTable[getLevelOffset(m_kmer) + idx];
+        }
+
+        // Look up the bwt interval for the first len symbols of w, 1 <= len <= k.
+        // Returns false if they contain a symbol other than ACGT,
+        // which the table does not cover
+        inline bool lookup(const char* w, size_t len, BWTInterval& interval) const
+        {
+            assert(len >= 1 && len <= m_kmer);
+            size_t idx = 0;
+            for(size_t k = 0; k < len; ++k)
+            {
+                size_t rank;
+                switch(w[k])
+                {
+                    case 'A': rank = 0; break;
+                    case 'C': rank = 1; break;
+                    case 'G': rank = 2; break;
+                    case 'T': rank = 3; break;
+                    default: return false;
+                }
+                idx = (idx << 2) | rank;
+            }
+            interval = m_pTable[getLevelOffset(len) + idx];
+            return true;
+        }
+
+        // Count a search that was (hit) or was not (miss) answered from the table.
+        // Each thread counts in its own counters, without atomic read-modify-writes.
+        inline void recordLookup(bool hit) const
+        {
+            if(m_counterId >= MAX_COUNTED_CACHES)
+                return;
+            static thread_local ThreadCounters* pCounters = registerThreadCounters();
+            increment(pCounters->lookups[m_counterId]);
+            if(hit)
+                increment(pCounters->hits[m_counterId]);
         }
 
-        // 
+        //
         size_t getCachedLength() const;
 
+        // Return the size of the table in bytes
+        size_t getTableBytes() const;
+
+        // Print the table size and the hit ratio of the searches so far
+        void printInfo(const std::string& name) const;
+
     private:
 
+        BWTIntervalCache(const BWTIntervalCache&) = delete;
+        void operator=(const BWTIntervalCache&) = delete;
+        BWTIntervalCache(size_t k);
+
+        // The strings of length len start at this entry of the table
+        static inline size_t getLevelOffset(size_t len)
+        {
+            return (((size_t)1 << 2*len) - 4) / 3;
+        }
+
         // Build the array for the given BWt
-        void build(const BWT* pBWT);
-        
+        void build(const BWT* pBWT, int numThreads);
+
+        // Fill the entries of all strings ending with the depth symbols encoded in suffixCode,
+        // whose interval is interval
+        void fill(const BWT* pBWT, BWTInterval interval, size_t depth, size_t suffixCode);
+
+        // IO
+        void write(const std::string& filename, const BWT* pBWT) const;
+        bool map(const std::string& filename, const BWT* pBWT);
+
         // Map a string to an integer
         // Precondition: w must be at least m_kmer symbols long
         inline size_t str2int(const char* w) const
@@ -48,11 +123,37 @@ class BWTIntervalCache
             return out;
         }
 
-        // Map an integer to a string
-        std::string int2string(size_t i) const;
+        // Map an integer to a string of length len
+        std::string int2string(size_t i, size_t len) const;
+
+        // Search counters of a thread for every cache, only written by that thread.
+        // The caches past the first MAX_COUNTED_CACHES of the process are not counted.
+        static const size_t MAX_COUNTED_CACHES = 16;
+        struct ThreadCounters
+        {
+            std::atomic<uint64_t> lookups[MAX_COUNTED_CACHES];
+            std::atomic<uint64_t> hits[MAX_COUNTED_CACHES];
+        };
+
+        // Allocate the counters of the calling thread and keep them for printInfo
+        static ThreadCounters* registerThreadCounters();
+        static std::vector<ThreadCounters*>& getThreadCountersList();
+
+        static inline void increment(std::atomic<uint64_t>& counter)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        static std::atomic<size_t> s_nextCounterId;
 
         size_t m_kmer;
         std::vector<BWTInterval> m_table;
+
+        // Points to m_table or into m_pMappedFile
+        const BWTInterval* m_pTable;
+        MappedFile* m_pMappedFile;
+
+        size_t m_counterId;
 };
 
 #endif
@@ -23,7 +23,8 @@
 RLBWT::RLBWT(const std::string& filename, int sampleRate) : m_numStrings(0), 
                                                             m_numSymbols(0), 
                                                             m_largeSampleRate(DEFAULT_SAMPLE_RATE_LARGE),
-                                                            m_smallSampleRate(sampleRate)
+                                                            m_smallSampleRate(sampleRate),
+                                                            m_pIntervalCache(NULL)
 {
     IBWTReader* pReader = BWTReader::createReader(filename);
     pReader->read(this);
@@ -32,7 +33,7 @@ RLBWT::RLBWT(const std::string& filename, int sampleRate) : m_numStrings(0),
 }
 
 // Construct the BWT from a suffix array
-RLBWT::RLBWT(const SuffixArray* pSA, const ReadTable* pRT)
+RLBWT::RLBWT(const SuffixArray* pSA, const ReadTable* pRT) : m_pIntervalCache(NULL)
 {
     // Set up BWT state
     size_t n = pSA->getSize();
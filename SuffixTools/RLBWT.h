@@ -22,6 +22,8 @@
 // Defines
 //#define RLBWT_VALIDATE 1
 
+class BWTIntervalCache;
+
 //
 // RLBWT
 //
@@ -139,6 +141,52 @@ class RLBWT
             return running_count;
         }
 
+        // Return the symbol at idx and set occ to the number of times it appears in bwt[0, idx).
+        // This fuses getChar(idx) and getOcc(b, idx - 1) of an LF-mapping step into a single
+        // marker lookup and a single walk over the runs
+        inline char getCharOcc(size_t idx, size_t& occ) const
+        {
+            const LargeMarker& marker = getNearestMarker(idx);
+            size_t current_position = marker.getActualPosition();
+            size_t symbol_index = marker.unitIndex;
+            AlphaCount64 running_count = marker.counts;
+
+            if(current_position <= idx)
+            {
+                // Walk forwards until the run containing idx
+                while(current_position + m_rlString[symbol_index].getCount() <= idx)
+                {
+                    const RLUnit& curr_unit = m_rlString[symbol_index];
+                    running_count.add(curr_unit.getChar(), curr_unit.getCount());
+                    current_position += curr_unit.getCount();
+                    ++symbol_index;
+                }
+            }
+            else
+            {
+                // Walk backwards until the run containing idx
+                while(current_position > idx)
+                {
+                    --symbol_index;
+                    const RLUnit& curr_unit = m_rlString[symbol_index];
+                    running_count.subtract(curr_unit.getChar(), curr_unit.getCount());
+                    current_position -= curr_unit.getCount();
+                }
+            }
+
+            char b = m_rlString[symbol_index].getChar();
+            occ = running_count.get(b) + (idx - current_position);
+            return b;
+        }
+
+        // Prefetch the markers that getCharOcc/getOcc will read for idx
+        inline void prefetchMarkers(size_t idx) const
+        {
+            size_t small_idx = getNearestMarkerIdx(idx, m_smallSampleRate, m_smallShiftValue);
+            __builtin_prefetch(&m_smallMarkers[small_idx]);
+            __builtin_prefetch(&m_largeMarkers[(small_idx << m_smallShiftValue) >> m_largeShiftValue]);
+        }
+
         // Return the number of times each symbol in the alphabet appears in bwt[0, idx]
         inline AlphaCount64 getFullOcc(size_t idx) const 
         { 
@@ -239,6 +287,11 @@ class RLBWT
         inline size_t getBWLen() const { return m_numSymbols; }
         inline size_t getNumRuns() const { return m_rlString.size(); }
 
+        // Attach a table of k-mer intervals that BWTAlgorithms::findInterval
+        // uses to skip the first k steps of a backward search. Not owned by the bwt.
+        inline void setIntervalCache(const BWTIntervalCache* pCache) { m_pIntervalCache = pCache; }
+        inline const BWTIntervalCache* getIntervalCache() const { return m_pIntervalCache; }
+
         // Return the first letter of the suffix starting at idx
         inline char getF(size_t idx) const
         {
@@ -268,7 +321,7 @@ class RLBWT
 
 
         // Default constructor is not allowed
-        RLBWT() {}
+        RLBWT() : m_pIntervalCache(NULL) {}
         
         // Calculate the number of markers to place
         size_t getNumRequiredMarkers(size_t n, size_t d) const;
@@ -297,5 +350,7 @@ class RLBWT
         int m_smallShiftValue;
         int m_largeShiftValue;
 
+        // Optional interval table of short k-mers
+        const BWTIntervalCache* m_pIntervalCache;
 };
 #endif
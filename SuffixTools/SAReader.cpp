@@ -101,6 +101,25 @@ void SAReader::readElems(std::vector<uint32_t>& outVector)
     m_stage = SAIOS_DONE;
 }
 
+//
+void SAReader::readElems(std::vector<uint64_t>& outVector)
+{
+    assert(m_stage == SAIOS_ELEM);
+    size_t cap = outVector.capacity();
+    size_t num_read = 0;
+
+    SAElem e;
+    while(*m_pReader >> e)
+    {
+        assert(e.getPos() == 0);
+        outVector.push_back(e.getID());
+        ++num_read;
+    }
+    assert(cap >= num_read);
+    (void)cap;
+    m_stage = SAIOS_DONE;
+}
+
 SAElem SAReader::readElem()
 {
     assert(m_stage == SAIOS_ELEM);
@@ -13,12 +13,33 @@
 #include "SAReader.h"
 #include "SAWriter.h"
 #include "config.h"
+#include <sys/stat.h>
 
 #if HAVE_OPENMP
 #include <omp.h>
 #endif
 
 static const uint32_t SSA_MAGIC_NUMBER = 12412;
+
+// The binary sampled suffix array (.bsai) is a fixed size header followed by the raw
+// array of read IDs and, if the sample rate is not zero, the number of samples and the
+// raw sample array. The arrays are 8-byte aligned so the file can be mapped into memory as it is
+struct BSAIHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width; // size of the read IDs in bytes, 4 or 8
+    int32_t sampleRate;
+    uint64_t num_strings;
+};
+static const uint32_t BSAI_MAGIC_NUMBER = 0x49415342;
+static const uint32_t BSAI_VERSION = 2;
+
+// Number of reads whose LF walks are interleaved by a thread in buildLexicoIndex,
+// and the number of reads a thread takes from the collection at a time
+static const size_t LEXO_BATCH_SIZE = 32;
+static const int64_t LEXO_CHUNK_SIZE = 4096;
+
 #define SSA_READ(x) pReader->read(reinterpret_cast<char*>(&(x)), sizeof((x)));
 #define SSA_READ_N(x,n) pReader->read(reinterpret_cast<char*>(&(x)), (n));
 
@@ -26,20 +47,50 @@ static const uint32_t SSA_MAGIC_NUMBER = 12412;
 #define SSA_WRITE_N(x,n) pWriter->write(reinterpret_cast<const char*>(&(x)), (n));
 
 //
-SampledSuffixArray::SampledSuffixArray()
+SampledSuffixArray::SampledSuffixArray() : m_sampleRate(0), m_num_strings(0), m_pMappedFile(NULL),
+                                           m_pLexoIndex(NULL), m_pLexoIndexLarge(NULL), m_pSamples(NULL)
 {
 
 }
 
-SampledSuffixArray::SampledSuffixArray(const std::string& filename, SSAFileType filetype)
+SampledSuffixArray::SampledSuffixArray(const std::string& filename, SSAFileType filetype) : m_sampleRate(0), m_num_strings(0),
+                                           m_pMappedFile(NULL), m_pLexoIndex(NULL), m_pLexoIndexLarge(NULL), m_pSamples(NULL)
 {
-    // Read the sampled suffix array from a file - either from a .ssa or .sai file
+    // Read the sampled suffix array from a file - either from a .ssa, .sai or .bsai file
     if(filetype == SSA_FT_SSA)
         readSSA(filename);
+    else if(filetype == SSA_FT_BSAI)
+        readBinarySSA(filename);
     else
         readSAI(filename);
 }
 
+SampledSuffixArray::~SampledSuffixArray()
+{
+    delete m_pMappedFile;
+}
+
+// The binary index is only used if it is not older than the text index, as the sais
+// construction does not write it and may leave a stale one from a previous build
+SampledSuffixArray* SampledSuffixArray::loadLexicoIndex(const std::string& bsai_filename, const std::string& sai_filename)
+{
+    struct stat bsai_stat, sai_stat;
+    bool hasBinary = stat(bsai_filename.c_str(), &bsai_stat) == 0;
+    bool hasText = stat(sai_filename.c_str(), &sai_stat) == 0;
+    if(hasBinary && (!hasText || bsai_stat.st_mtime >= sai_stat.st_mtime))
+        return new SampledSuffixArray(bsai_filename, SSA_FT_BSAI);
+    return new SampledSuffixArray(sai_filename, SSA_FT_SAI);
+}
+
+void SampledSuffixArray::updateLookupPointers()
+{
+    delete m_pMappedFile;
+    m_pMappedFile = NULL;
+    m_pLexoIndex = m_saLexoIndex.empty() ? NULL : &m_saLexoIndex.front();
+    m_pLexoIndexLarge = m_saLexoIndexLarge.empty() ? NULL : &m_saLexoIndexLarge.front();
+    m_pSamples = m_saSamples.empty() ? NULL : &m_saSamples.front();
+}
+
 // 
 SAElem SampledSuffixArray::calcSA(int64_t idx, const BWT* pBWT) const
 {
@@ -49,10 +100,10 @@ SAElem SampledSuffixArray::calcSA(int64_t idx, const BWT* pBWT) const
     while(1)
     {
         // Check if this position is sampled. If the sample rate is zero we are using the lexo. index only
-        if(m_sampleRate > 0 && idx % m_sampleRate == 0 && !m_saSamples[idx / m_sampleRate].isEmpty())
+        if(m_sampleRate > 0 && idx % m_sampleRate == 0 && !m_pSamples[idx / m_sampleRate].isEmpty())
         {
             // A valid sample is stored for this idx
-            elem = m_saSamples[idx / m_sampleRate];
+            elem = m_pSamples[idx / m_sampleRate];
             break;
         }
 
@@ -64,8 +115,8 @@ SAElem SampledSuffixArray::calcSA(int64_t idx, const BWT* pBWT) const
         {
             // idx (before the update) corresponds to the start of a read.
             // We can directly look up the saElem for idx from the lexicographic index
-            assert(idx < (int64_t)m_saLexoIndex.size());
-            elem.setID(m_saLexoIndex[idx]);
+            assert(idx < (int64_t)m_num_strings);
+            elem.setID(lookupLexoRank(idx));
             elem.setPos(0);
             break;
         }
@@ -80,12 +131,6 @@ SAElem SampledSuffixArray::calcSA(int64_t idx, const BWT* pBWT) const
     return elem;
 }
 
-// Returns the ID of the read with lexicographic rank r
-size_t SampledSuffixArray::lookupLexoRank(size_t r) const
-{
-    return m_saLexoIndex[r];
-}
-
 // 
 void SampledSuffixArray::build(const BWT* pBWT, const ReadInfoTable* pRIT, int sampleRate)
 {
@@ -93,6 +138,8 @@ void SampledSuffixArray::build(const BWT* pBWT, const ReadInfoTable* pRIT, int s
 
     size_t numStrings = pRIT->getCount();
     m_saLexoIndex.resize(numStrings);
+    m_saLexoIndexLarge.clear();
+    m_num_strings = numStrings;
 
     size_t MAX_ELEMS = std::numeric_limits<SSA_INT_TYPE>::max();
     if(numStrings > MAX_ELEMS)
@@ -152,41 +199,99 @@ void SampledSuffixArray::build(const BWT* pBWT, const ReadInfoTable* pRIT, int s
             }
         }
     }
+
+    updateLookupPointers();
 }
 
 // A streamlined version of the above function
 void SampledSuffixArray::buildLexicoIndex(const BWT* pBWT, int num_threads)
 {
     int64_t numStrings = pBWT->getNumStrings();
-    m_saLexoIndex.resize(numStrings);
-    int64_t MAX_ELEMS = std::numeric_limits<SSA_INT_TYPE>::max();
-    assert(numStrings < MAX_ELEMS);
+    bool bLarge = numStrings > (int64_t)std::numeric_limits<SSA_INT_TYPE>::max();
+    if(bLarge)
+    {
+        m_saLexoIndex.clear();
+        m_saLexoIndexLarge.resize(numStrings);
+    }
+    else
+    {
+        m_saLexoIndexLarge.clear();
+        m_saLexoIndex.resize(numStrings);
+    }
+    m_sampleRate = 0;
+    m_num_strings = numStrings;
 
     (void)num_threads;
     // Parallelize this computaiton using openmp, if the compiler supports it
 #if HAVE_OPENMP
     omp_set_num_threads(num_threads);
-    #pragma omp parallel for schedule(guided)
+    #pragma omp parallel for schedule(dynamic)
 #endif
-    for(int64_t read_idx = 0; read_idx < numStrings; ++read_idx)
+    for(int64_t chunk_start = 0; chunk_start < numStrings; chunk_start += LEXO_CHUNK_SIZE)
     {
         // For each read, start from the end of the read and backtrack through the suffix array/BWT
-        // to calculate its lexicographic rank in the collection
-        size_t idx = read_idx;
-        while(1)
+        // to calculate its lexicographic rank in the collection. The walks of up to LEXO_BATCH_SIZE
+        // reads are advanced in lockstep: the markers of every lane are prefetched before
+        // any of them is used, which hides the latency of the independent rank queries
+        int64_t chunk_end = std::min(chunk_start + LEXO_CHUNK_SIZE, numStrings);
+        int64_t next_read = chunk_start;
+        int64_t lane_read[LEXO_BATCH_SIZE];
+        size_t lane_idx[LEXO_BATCH_SIZE];
+        size_t num_lanes = 0;
+
+        while(num_lanes < LEXO_BATCH_SIZE && next_read < chunk_end)
         {
-            char b = pBWT->getChar(idx);
-            idx = pBWT->getPC(b) + pBWT->getOcc(b, idx - 1);
-            if(b == '$')
+            lane_read[num_lanes] = next_read;
+            lane_idx[num_lanes] = next_read;
+            ++num_lanes;
+            ++next_read;
+        }
+
+        while(num_lanes > 0)
+        {
+            for(size_t i = 0; i < num_lanes; ++i)
+                pBWT->prefetchMarkers(lane_idx[i]);
+
+            size_t i = 0;
+            while(i < num_lanes)
             {
+                size_t occ;
+                char b = pBWT->getCharOcc(lane_idx[i], occ);
+                size_t idx = pBWT->getPC(b) + occ;
+                if(b != '$')
+                {
+                    lane_idx[i++] = idx;
+                    continue;
+                }
+
                 // There is a one-to-one mapping between read_index and the element
                 // of the array that is set - therefore we can perform this operation
                 // without a lock.
-                m_saLexoIndex[idx] = read_idx;
-                break; // done;
+                if(bLarge)
+                    m_saLexoIndexLarge[idx] = lane_read[i];
+                else
+                    m_saLexoIndex[idx] = lane_read[i];
+
+                // Start the next read of the chunk in this lane, or retire the lane by
+                // moving the last active lane into it
+                if(next_read < chunk_end)
+                {
+                    lane_read[i] = next_read;
+                    lane_idx[i] = next_read;
+                    ++next_read;
+                    ++i;
+                }
+                else
+                {
+                    --num_lanes;
+                    lane_read[i] = lane_read[num_lanes];
+                    lane_idx[i] = lane_idx[num_lanes];
+                }
             }
         }
     }
+
+    updateLookupPointers();
 }
 
 // Validate the sampled suffix array values are correct
@@ -248,15 +353,51 @@ void SampledSuffixArray::writeSSA(std::string filename)
 void SampledSuffixArray::writeLexicoIndex(const std::string& filename)
 {
     SAWriter writer(filename);
-    size_t num_strings = m_saLexoIndex.size();
+    size_t num_strings = m_num_strings;
     writer.writeHeader(num_strings, num_strings);
-    for(size_t i = 0; i < m_saLexoIndex.size(); ++i) 
+    for(size_t i = 0; i < num_strings; ++i) 
     {
-        SAElem elem(m_saLexoIndex[i], 0);
+        SAElem elem(lookupLexoRank(i), 0);
         writer.writeElem(elem);
     }
 }
 
+// Save the lexicographic index and the samples, if any, to disk in binary (.bsai)
+void SampledSuffixArray::writeBinarySSA(const std::string& filename)
+{
+    std::ostream* pWriter = createWriter(filename, std::ios::out | std::ios::binary);
+
+    BSAIHeader header;
+    header.magic = BSAI_MAGIC_NUMBER;
+    header.version = BSAI_VERSION;
+    header.width = m_pLexoIndexLarge != NULL ? sizeof(uint64_t) : sizeof(SSA_INT_TYPE);
+    header.sampleRate = m_saSamples.empty() ? 0 : m_sampleRate;
+    header.num_strings = m_num_strings;
+    SSA_WRITE(header)
+
+    // Write lexo index
+    size_t n = m_num_strings;
+    if(n > 0)
+    {
+        if(m_pLexoIndexLarge != NULL)
+            SSA_WRITE_N(m_pLexoIndexLarge[0], header.width * n)
+        else
+            SSA_WRITE_N(m_pLexoIndex[0], header.width * n)
+    }
+
+    // Write number of samples and samples, after padding the lexo index to 8 bytes
+    if(header.sampleRate > 0)
+    {
+        uint64_t padding = 0;
+        SSA_WRITE_N(padding, (8 - (header.width * n) % 8) % 8)
+        uint64_t num_samples = m_saSamples.size();
+        SSA_WRITE(num_samples)
+        SSA_WRITE_N(m_saSamples.front(), sizeof(SAElem) * num_samples)
+    }
+
+    delete pWriter;
+}
+
 
 void SampledSuffixArray::readSSA(std::string filename)
 {
@@ -274,6 +415,8 @@ void SampledSuffixArray::readSSA(std::string filename)
     size_t n = 0;
     SSA_READ(n)
     m_saLexoIndex.resize(n);
+    m_saLexoIndexLarge.clear();
+    m_num_strings = n;
 
     // Read lexo index
     SSA_READ_N(m_saLexoIndex.front(), sizeof(SSA_INT_TYPE) * n)
@@ -287,6 +430,8 @@ void SampledSuffixArray::readSSA(std::string filename)
     SSA_READ_N(m_saSamples.front(), sizeof(SAElem) * n)
 
     delete pReader;
+
+    updateLookupPointers();
 }
 
 void SampledSuffixArray::readSAI(std::string filename)
@@ -295,24 +440,110 @@ void SampledSuffixArray::readSAI(std::string filename)
     size_t num_strings, num_elems;
     reader.readHeader(num_strings, num_elems);
     assert(num_strings == num_elems);
-    m_saLexoIndex.reserve(num_strings);
-    reader.readElems(m_saLexoIndex);
+    if(num_strings > std::numeric_limits<SSA_INT_TYPE>::max())
+    {
+        m_saLexoIndexLarge.reserve(num_strings);
+        reader.readElems(m_saLexoIndexLarge);
+    }
+    else
+    {
+        m_saLexoIndex.reserve(num_strings);
+        reader.readElems(m_saLexoIndex);
+    }
 
     // Set the sample rate to zero to signify there are no samples
     m_sampleRate = 0;
 	m_num_strings = num_strings;
+    updateLookupPointers();
+}
+
+// Exit if the mapped file of a binary sampled suffix array does not hold
+// count elements of elemSize bytes from offset
+static void checkBinarySSASize(const MappedFile* pFile, size_t offset, size_t count, size_t elemSize, const std::string& filename)
+{
+    if(offset > pFile->size() || count > (pFile->size() - offset) / elemSize)
+    {
+        std::cerr << "Error: binary sampled suffix array " << filename << " is truncated\n";
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Memory map a binary sampled suffix array. Nothing is copied to the heap,
+// the lookups read the mapped arrays directly. Every size read from the file
+// is checked against the file before anything past it is read.
+void SampledSuffixArray::readBinarySSA(std::string filename)
+{
+    m_saLexoIndex.clear();
+    m_saLexoIndexLarge.clear();
+    m_saSamples.clear();
+    delete m_pMappedFile;
+    m_pMappedFile = new MappedFile(filename);
+
+    const BSAIHeader* pHeader = reinterpret_cast<const BSAIHeader*>(m_pMappedFile->data());
+    if(m_pMappedFile->size() < sizeof(BSAIHeader) || pHeader->magic != BSAI_MAGIC_NUMBER)
+    {
+        std::cerr << "Error: " << filename << " is not a binary sampled suffix array\n";
+        exit(EXIT_FAILURE);
+    }
+    if(pHeader->version != BSAI_VERSION)
+    {
+        std::cerr << "Error: " << filename << " is a binary sampled suffix array of version " << pHeader->version
+                  << ", expected version " << BSAI_VERSION << ". Rebuild the index.\n";
+        exit(EXIT_FAILURE);
+    }
+    if(pHeader->width != sizeof(uint64_t) && pHeader->width != sizeof(SSA_INT_TYPE))
+    {
+        std::cerr << "Error: binary sampled suffix array " << filename << " has read IDs of " << pHeader->width << " bytes\n";
+        exit(EXIT_FAILURE);
+    }
+
+    m_num_strings = pHeader->num_strings;
+    m_sampleRate = pHeader->sampleRate;
+
+    size_t offset = sizeof(BSAIHeader);
+    checkBinarySSASize(m_pMappedFile, offset, m_num_strings, pHeader->width, filename);
+    m_pLexoIndex = NULL;
+    m_pLexoIndexLarge = NULL;
+    if(pHeader->width == sizeof(uint64_t))
+        m_pLexoIndexLarge = reinterpret_cast<const uint64_t*>(m_pMappedFile->data(offset));
+    else
+        m_pLexoIndex = reinterpret_cast<const SSA_INT_TYPE*>(m_pMappedFile->data(offset));
+    offset += pHeader->width * m_num_strings;
+
+    m_pSamples = NULL;
+    size_t num_samples = 0;
+    if(m_sampleRate > 0)
+    {
+        offset += (8 - offset % 8) % 8;
+        checkBinarySSASize(m_pMappedFile, offset, 1, sizeof(uint64_t), filename);
+        num_samples = *reinterpret_cast<const uint64_t*>(m_pMappedFile->data(offset));
+        offset += sizeof(uint64_t);
+        checkBinarySSASize(m_pMappedFile, offset, num_samples, sizeof(SAElem), filename);
+        m_pSamples = reinterpret_cast<const SAElem*>(m_pMappedFile->data(offset));
+        offset += sizeof(SAElem) * num_samples;
+    }
+
+    if(offset != m_pMappedFile->size())
+    {
+        std::cerr << "Error: binary sampled suffix array " << filename << " has " << m_pMappedFile->size() - offset
+                  << " unexpected trailing bytes\n";
+        exit(EXIT_FAILURE);
+    }
 }
 
 // Print memory usage information
 void SampledSuffixArray::printInfo() const
 {
     double mb = (double)(1024*1024);
-    double lexoSize = (double)(sizeof(SSA_INT_TYPE) * m_saLexoIndex.capacity()) / mb;
+    double lexoSize = (double)(sizeof(SSA_INT_TYPE) * m_saLexoIndex.capacity() +
+                               sizeof(uint64_t) * m_saLexoIndexLarge.capacity()) / mb;
     double sampleSize = (double)(sizeof(SAElem) * m_saSamples.capacity()) / mb;
     
     printf("SampledSuffixArray info:\n");
     printf("Sample rate: %d\n", m_sampleRate);
-    printf("Contains %zu entries in lexicographic array (%.1lf MB)\n", m_saLexoIndex.size(), lexoSize);
+    printf("Contains %zu entries in lexicographic array (%.1lf MB)\n", m_num_strings, lexoSize);
     printf("Contains %zu entries in sample array (%.1lf MB)\n", m_saSamples.size(), sampleSize);
+    if(m_pMappedFile != NULL)
+        printf("Memory mapped: %.1lf MB\n", (double)m_pMappedFile->size() / mb);
     printf("Total size: %.1lf\n", lexoSize + sampleSize);
 }
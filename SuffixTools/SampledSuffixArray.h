@@ -15,13 +15,15 @@
 #include "SuffixArray.h"
 #include "BWT.h"
 #include "ReadInfoTable.h"
+#include "MappedFile.h"
 
 typedef uint32_t SSA_INT_TYPE;
 
 enum SSAFileType
 {
     SSA_FT_SSA,
-    SSA_FT_SAI
+    SSA_FT_SAI,
+    SSA_FT_BSAI
 };
 
 class SampledSuffixArray
@@ -30,17 +32,26 @@ class SampledSuffixArray
 
         SampledSuffixArray();
         SampledSuffixArray(const std::string& filename, SSAFileType filetype = SSA_FT_SSA);
+        ~SampledSuffixArray();
+
+        // Load the lexicographic index, memory-mapping the binary bsai_filename
+        // if it exists and parsing the text sai_filename otherwise
+        static SampledSuffixArray* loadLexicoIndex(const std::string& bsai_filename, const std::string& sai_filename);
         
         // Calculate the suffix array element for the given index
         SAElem calcSA(int64_t idx, const BWT* pBWT) const;
 
         // Returns the ID of the read with lexicographic rank r
-        size_t lookupLexoRank(size_t r) const;
+        inline size_t lookupLexoRank(size_t r) const
+        {
+            return m_pLexoIndexLarge == NULL ? m_pLexoIndex[r] : m_pLexoIndexLarge[r];
+        }
 
         // Construct the sampled SA using the bwt of a set of reads and their lengths
         void build(const BWT* pBWT, const ReadInfoTable* pRIT, int sampleRate = DEFAULT_SA_SAMPLE_RATE);
 
-        // Construct the lexicographic index (.sai) from the BWT
+        // Construct the lexicographic index (.sai) from the BWT. Each thread interleaves
+        // the LF walks of a batch of reads so their rank queries overlap in memory
         void buildLexicoIndex(const BWT* pBWT, int num_threads);
 
         // Validate using the full suffix array for the given set of reads. Very slow.
@@ -49,29 +60,45 @@ class SampledSuffixArray
 
         // I/O
         void writeLexicoIndex(const std::string& filename);
+        void writeBinarySSA(const std::string& filename);
         void writeSSA(std::string filename);
         void readSSA(std::string filename);
         void readSAI(std::string filename);
+        void readBinarySSA(std::string filename);
 
 		size_t getNumberOfReads(){return m_num_strings;};
 
     private:
 
+        SampledSuffixArray(const SampledSuffixArray&) = delete;
+        void operator=(const SampledSuffixArray&) = delete;
+
+        // Point the lookup pointers at the vectors after they are populated
+        void updateLookupPointers();
+
         // Unsigned integers indicating the start of every read in the
         // sequence collection. These elements are in lexicographic order
         // based on the whole read sequence. Tracing a read backwards through
         // the suffix array necessarily ends at one of these positions. These
         // are nominally SAElems representing the full length suffix but
         // we store them here as unsigned integers to save 4 bytes per entry.
-        // This limits the SampledSuffixArray to represent at most 2**32 strings.
-        // To improve this we could use a polymorphic vector with a runtime-determined
-        // size.
+        // Collections of more than 2**32 strings use the 64-bit m_saLexoIndexLarge
+        // instead, only one of the two vectors is populated.
         std::vector<SSA_INT_TYPE> m_saLexoIndex;
+        std::vector<uint64_t> m_saLexoIndexLarge;
 
         static const int DEFAULT_SA_SAMPLE_RATE = 64;
         int m_sampleRate;
         SAElemVector m_saSamples;
 		size_t m_num_strings;
+
+        // The lookups go through these pointers. They point either into the vectors
+        // above or into the memory map of a binary index (.bsai), in which case
+        // the vectors are empty and pages are only loaded when they are touched
+        MappedFile* m_pMappedFile;
+        const SSA_INT_TYPE* m_pLexoIndex;
+        const uint64_t* m_pLexoIndexLarge;
+        const SAElem* m_pSamples;
 };
 
 #endif
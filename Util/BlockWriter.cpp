@@ -0,0 +1,94 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// BlockWriter - Write a file from blocks of records formatted
+// with all threads
+//
+#include "BlockWriter.h"
+#include "Util.h"
+#include <iostream>
+#include <cstdlib>
+#include <zlib.h>
+
+//
+BlockWriter::BlockWriter(const std::string& filename) : m_filename(filename), m_bGzip(isGzip(filename)), m_hasBlock(false)
+{
+    m_pFile = fopen(filename.c_str(), "wb");
+    if(m_pFile == NULL)
+    {
+        std::cerr << "Error: could not open " << filename << " for write\n";
+        exit(EXIT_FAILURE);
+    }
+}
+
+//
+BlockWriter::~BlockWriter()
+{
+    // An empty gzip file is not valid, write an empty member
+    if(m_bGzip && !m_hasBlock)
+    {
+        std::string empty;
+        deflateBlock(empty);
+        writeRaw(empty);
+    }
+
+    if(fclose(m_pFile) != 0)
+    {
+        std::cerr << "Error: could not write " << m_filename << "\n";
+        exit(EXIT_FAILURE);
+    }
+}
+
+//
+void BlockWriter::write(const std::string& text)
+{
+    std::string block = text;
+    if(m_bGzip)
+        deflateBlock(block);
+    writeRaw(block);
+}
+
+//
+void BlockWriter::deflateBlock(std::string& block) const
+{
+    z_stream zs;
+    zs.zalloc = Z_NULL;
+    zs.zfree = Z_NULL;
+    zs.opaque = Z_NULL;
+
+    // A window of 15 bits plus 16 makes deflate write the gzip header and trailer
+    if(deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        std::cerr << "Error: could not initialize the compression of " << m_filename << "\n";
+        exit(EXIT_FAILURE);
+    }
+
+    std::string member(deflateBound(&zs, block.size()), '\0');
+    zs.next_in = (Bytef*)block.data();
+    zs.avail_in = block.size();
+    zs.next_out = (Bytef*)&member[0];
+    zs.avail_out = member.size();
+
+    int ret = deflate(&zs, Z_FINISH);
+    if(ret != Z_STREAM_END)
+    {
+        std::cerr << "Error: could not compress a block of " << m_filename << "\n";
+        exit(EXIT_FAILURE);
+    }
+    member.resize(zs.total_out);
+    deflateEnd(&zs);
+    block.swap(member);
+}
+
+//
+void BlockWriter::writeRaw(const std::string& data)
+{
+    if(!data.empty() && fwrite(data.data(), 1, data.size(), m_pFile) != data.size())
+    {
+        std::cerr << "Error: could not write " << m_filename << "\n";
+        exit(EXIT_FAILURE);
+    }
+    m_hasBlock = true;
+}
@@ -0,0 +1,83 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// BlockWriter - Write a file from blocks of records formatted
+// with all threads. The blocks are written in their order, so
+// the file does not depend on the number of threads. If the
+// filename ends in .gz every block is compressed by the thread
+// that formatted it into a gzip member of its own; a series of
+// members is a valid gzip file that zcat and gzstream read whole.
+//
+#ifndef BLOCKWRITER_H
+#define BLOCKWRITER_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <omp.h>
+
+class BlockWriter
+{
+    public:
+        BlockWriter(const std::string& filename);
+        ~BlockWriter();
+
+        // Write text as one block
+        void write(const std::string& text);
+
+        // Format the records [blockStarts[b], blockStarts[b+1]) of every block b
+        // by calling format(i, out) for each record i, and write the blocks in order.
+        // A few blocks per thread are held in memory at a time.
+        template<typename Formatter>
+        void writeBlocks(const std::vector<size_t>& blockStarts, Formatter format)
+        {
+            if(blockStarts.size() < 2)
+                return;
+
+            size_t numBlocks = blockStarts.size() - 1;
+            size_t batchSize = BLOCKS_PER_THREAD * omp_get_max_threads();
+            std::vector<std::string> batch;
+            for(size_t first = 0; first < numBlocks; first += batchSize)
+            {
+                size_t last = std::min(numBlocks, first + batchSize);
+                batch.assign(last - first, std::string());
+
+                #pragma omp parallel for schedule(dynamic, 1)
+                for(size_t b = first; b < last; ++b)
+                {
+                    std::ostringstream out;
+                    for(size_t i = blockStarts[b]; i < blockStarts[b + 1]; ++i)
+                        format(i, out);
+                    batch[b - first] = out.str();
+                    if(m_bGzip)
+                        deflateBlock(batch[b - first]);
+                }
+
+                for(size_t b = 0; b < batch.size(); ++b)
+                    writeRaw(batch[b]);
+            }
+        }
+
+    private:
+        BlockWriter(const BlockWriter&) = delete;
+        void operator=(const BlockWriter&) = delete;
+
+        static const size_t BLOCKS_PER_THREAD = 4;
+
+        // Replace block by a gzip member holding it
+        void deflateBlock(std::string& block) const;
+        void writeRaw(const std::string& data);
+
+        std::string m_filename;
+        FILE* m_pFile;
+        bool m_bGzip;
+
+        // True once a block has been written
+        bool m_hasBlock;
+};
+
+#endif
@@ -0,0 +1,56 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// MappedFile - Read-only memory map of a whole file
+//
+#include "MappedFile.h"
+#include <iostream>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//
+MappedFile::MappedFile(const std::string& filename) : m_filename(filename), m_pData(NULL), m_size(0)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        std::cerr << "Error: could not open " << filename << " for memory mapping\n";
+        exit(EXIT_FAILURE);
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        std::cerr << "Error: could not stat " << filename << "\n";
+        exit(EXIT_FAILURE);
+    }
+    m_size = st.st_size;
+
+    // mmap of an empty file is not allowed, m_pData stays NULL
+    if(m_size > 0)
+    {
+        void* p = mmap(NULL, m_size, PROT_READ, MAP_SHARED, fd, 0);
+        if(p == MAP_FAILED)
+        {
+            std::cerr << "Error: could not memory map " << filename << "\n";
+            exit(EXIT_FAILURE);
+        }
+        m_pData = static_cast<const char*>(p);
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+//
+MappedFile::~MappedFile()
+{
+    if(m_pData != NULL)
+        munmap(const_cast<char*>(m_pData), m_size);
+}
+
@@ -0,0 +1,36 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// MappedFile - Read-only memory map of a whole file.
+// Pages are loaded by the kernel on first access, so
+// opening a large index is instant and the resident
+// memory is proportional to the pages that are touched
+//
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <stdint.h>
+
+class MappedFile
+{
+    public:
+        MappedFile(const std::string& filename);
+        ~MappedFile();
+
+        // Return a pointer to the byte at offset
+        inline const char* data(size_t offset = 0) const { return m_pData + offset; }
+        inline size_t size() const { return m_size; }
+
+    private:
+        MappedFile(const MappedFile&) = delete;
+        void operator=(const MappedFile&) = delete;
+
+        std::string m_filename;
+        const char* m_pData;
+        size_t m_size;
+};
+
+#endif
@@ -0,0 +1,193 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// PackedReadTable - A 0-indexed table of reads stored
+// as 2-bit packed bases and accessed through a memory map
+//
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <unistd.h>
+#include "PackedReadTable.h"
+#include "SeqReader.h"
+
+static const uint32_t PRS_MAGIC_NUMBER = 0x31535250;
+static const uint32_t PRS_VERSION = 1;
+
+// Round n up to a multiple of 8 so every section of the file is aligned for uint64 access
+static inline uint64_t alignSection(uint64_t n)
+{
+    return (n + 7) & ~(uint64_t)7;
+}
+
+//
+PackedReadTable::PackedReadTable(const std::string& filename)
+{
+    m_pFile = new MappedFile(filename);
+    if(m_pFile->size() < sizeof(PackedReadHeader))
+    {
+        std::cerr << "Error: " << filename << " is not a packed read store\n";
+        exit(EXIT_FAILURE);
+    }
+
+    m_pHeader = reinterpret_cast<const PackedReadHeader*>(m_pFile->data());
+    if(m_pHeader->magic != PRS_MAGIC_NUMBER || m_pHeader->version != PRS_VERSION)
+    {
+        std::cerr << "Error: " << filename << " is not a packed read store (version " << PRS_VERSION << ")\n";
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t offset = alignSection(sizeof(PackedReadHeader));
+    m_pPacked = reinterpret_cast<const uint8_t*>(m_pFile->data(offset));
+    offset += alignSection((m_pHeader->num_bases + 3) / 4);
+    m_pBaseOffsets = reinterpret_cast<const uint64_t*>(m_pFile->data(offset));
+    offset += (m_pHeader->num_reads + 1) * sizeof(uint64_t);
+    m_pIDOffsets = reinterpret_cast<const uint64_t*>(m_pFile->data(offset));
+    offset += (m_pHeader->num_reads + 1) * sizeof(uint64_t);
+    m_pAmbiguous = reinterpret_cast<const uint64_t*>(m_pFile->data(offset));
+    offset += m_pHeader->num_ambiguous * sizeof(uint64_t);
+    m_pIDs = m_pFile->data(offset);
+
+    if(offset + m_pHeader->id_bytes != m_pFile->size())
+    {
+        std::cerr << "Error: packed read store " << filename << " is truncated\n";
+        exit(EXIT_FAILURE);
+    }
+}
+
+//
+PackedReadTable::~PackedReadTable()
+{
+    delete m_pFile;
+}
+
+//
+char PackedReadTable::getChar(size_t str_idx, size_t char_idx) const
+{
+    assert(str_idx < getCount() && char_idx < getReadLength(str_idx));
+    uint64_t pos = m_pBaseOffsets[str_idx] + char_idx;
+    if(std::binary_search(m_pAmbiguous, m_pAmbiguous + m_pHeader->num_ambiguous, pos))
+        return 'N';
+    return getBase(pos);
+}
+
+//
+std::string PackedReadTable::getReadID(size_t idx) const
+{
+    assert(idx < getCount());
+    return std::string(m_pIDs + m_pIDOffsets[idx], m_pIDOffsets[idx + 1] - m_pIDOffsets[idx]);
+}
+
+//
+std::string PackedReadTable::getReadSeq(size_t idx) const
+{
+    assert(idx < getCount());
+    uint64_t start = m_pBaseOffsets[idx];
+    uint64_t end = m_pBaseOffsets[idx + 1];
+
+    std::string seq(end - start, 'A');
+    for(uint64_t pos = start; pos < end; ++pos)
+        seq[pos - start] = getBase(pos);
+
+    // Restore the non-ACGT bases of this read
+    const uint64_t* pAmbiguousEnd = m_pAmbiguous + m_pHeader->num_ambiguous;
+    for(const uint64_t* p = std::lower_bound(m_pAmbiguous, pAmbiguousEnd, start); p != pAmbiguousEnd && *p < end; ++p)
+        seq[*p - start] = 'N';
+    return seq;
+}
+
+//
+SeqItem PackedReadTable::getRead(size_t idx) const
+{
+    SeqItem item;
+    item.id = getReadID(idx);
+    item.seq = getReadSeq(idx);
+    return item;
+}
+
+// The reads are parsed once. Packed bases are streamed into outFile, the ids are
+// staged in a temporary file and the offset arrays are kept in memory (16 bytes per read)
+// until the bases are complete.
+void PackedReadTable::write(const std::string& readsFile, const std::string& outFile)
+{
+    std::string idsTmpFile = outFile + ".ids.tmp";
+    std::ofstream out(outFile.c_str(), std::ios::out | std::ios::binary);
+    std::ofstream ids(idsTmpFile.c_str(), std::ios::out | std::ios::binary);
+    assertFileOpen(out, outFile);
+    assertFileOpen(ids, idsTmpFile);
+
+    PackedReadHeader header;
+    header.magic = PRS_MAGIC_NUMBER;
+    header.version = PRS_VERSION;
+    header.num_reads = 0;
+    header.num_bases = 0;
+    header.num_ambiguous = 0;
+    header.id_bytes = 0;
+
+    // Reserve space for the header, it is rewritten once the counts are known
+    std::vector<char> padding(alignSection(sizeof(PackedReadHeader)), 0);
+    out.write(&padding[0], padding.size());
+
+    std::vector<uint64_t> baseOffsets(1, 0);
+    std::vector<uint64_t> idOffsets(1, 0);
+    std::vector<uint64_t> ambiguous;
+    uint8_t currByte = 0;
+
+    SeqReader reader(readsFile, SRF_NO_VALIDATION);
+    SeqRecord record;
+    while(reader.get(record))
+    {
+        std::string seq = record.seq.toString();
+        for(size_t i = 0; i < seq.size(); ++i)
+        {
+            uint64_t pos = header.num_bases++;
+            uint8_t code = 0;
+            switch(seq[i])
+            {
+                case 'A': code = 0; break;
+                case 'C': code = 1; break;
+                case 'G': code = 2; break;
+                case 'T': code = 3; break;
+                default: ambiguous.push_back(pos); break;
+            }
+            currByte |= code << ((pos & 3) << 1);
+            if((pos & 3) == 3)
+            {
+                out.put(currByte);
+                currByte = 0;
+            }
+        }
+
+        ids.write(record.id.data(), record.id.size());
+        header.id_bytes += record.id.size();
+        baseOffsets.push_back(header.num_bases);
+        idOffsets.push_back(header.id_bytes);
+        header.num_reads += 1;
+    }
+    ids.close();
+
+    if(header.num_bases & 3)
+        out.put(currByte);
+    size_t packedBytes = (header.num_bases + 3) / 4;
+    out.write(&padding[0], alignSection(packedBytes) - packedBytes);
+
+    header.num_ambiguous = ambiguous.size();
+    out.write(reinterpret_cast<const char*>(&baseOffsets[0]), baseOffsets.size() * sizeof(uint64_t));
+    out.write(reinterpret_cast<const char*>(&idOffsets[0]), idOffsets.size() * sizeof(uint64_t));
+    if(!ambiguous.empty())
+        out.write(reinterpret_cast<const char*>(&ambiguous[0]), ambiguous.size() * sizeof(uint64_t));
+
+    // Append the ids
+    std::ifstream idsIn(idsTmpFile.c_str(), std::ios::in | std::ios::binary);
+    assertFileOpen(idsIn, idsTmpFile);
+    if(header.id_bytes > 0)
+        out << idsIn.rdbuf();
+    idsIn.close();
+    unlink(idsTmpFile.c_str());
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+}
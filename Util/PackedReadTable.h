@@ -0,0 +1,77 @@
+//----------------------------------------------
+// Copyright 2016 National Chung Cheng University
+// Released under the GPL
+//-----------------------------------------------
+//
+// PackedReadTable - A 0-indexed table of reads stored
+// on disk as 2-bit packed bases plus an offset index,
+// and accessed through a memory map. Unlike ReadTable
+// nothing is parsed at load time, which makes it suitable
+// for tools that only look up a few reads by index.
+//
+// File layout (.prs), all integers are little-endian uint64
+// unless noted, every section starts at a multiple of 8 bytes:
+//   header           PackedReadHeader
+//   packed bases     (num_bases + 3) / 4 bytes, 4 bases per byte, first base in the low bits
+//   base offsets     num_reads + 1 entries, start of each read in the base array
+//   id offsets       num_reads + 1 entries, start of each id in the id blob
+//   ambiguous bases  num_ambiguous sorted base positions that are not ACGT (read as 'N')
+//   id blob          id_bytes characters, not terminated
+// The bases come first so the writer can stream them while parsing the reads.
+//
+#ifndef PACKEDREADTABLE_H
+#define PACKEDREADTABLE_H
+
+#include "Util.h"
+#include "MappedFile.h"
+
+struct PackedReadHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t num_reads;
+    uint64_t num_bases;
+    uint64_t num_ambiguous;
+    uint64_t id_bytes;
+};
+
+class PackedReadTable
+{
+    public:
+        // Map the read store in filename
+        PackedReadTable(const std::string& filename);
+        ~PackedReadTable();
+
+        // Convert the reads in readsFile into a read store written to outFile
+        static void write(const std::string& readsFile, const std::string& outFile);
+
+        inline size_t getCount() const { return m_pHeader->num_reads; }
+        inline size_t getReadLength(size_t idx) const { return m_pBaseOffsets[idx + 1] - m_pBaseOffsets[idx]; }
+
+        // Get a particular character for a particular read
+        char getChar(size_t str_idx, size_t char_idx) const;
+
+        std::string getReadID(size_t idx) const;
+        std::string getReadSeq(size_t idx) const;
+        SeqItem getRead(size_t idx) const;
+
+    private:
+        PackedReadTable(const PackedReadTable&) = delete;
+        void operator=(const PackedReadTable&) = delete;
+
+        // Return the base at position pos of the concatenated reads
+        inline char getBase(uint64_t pos) const
+        {
+            return "ACGT"[(m_pPacked[pos >> 2] >> ((pos & 3) << 1)) & 3];
+        }
+
+        MappedFile* m_pFile;
+        const PackedReadHeader* m_pHeader;
+        const uint64_t* m_pBaseOffsets;
+        const uint64_t* m_pIDOffsets;
+        const uint64_t* m_pAmbiguous;
+        const uint8_t* m_pPacked;
+        const char* m_pIDs;
+};
+
+#endif